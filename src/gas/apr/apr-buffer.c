@@ -0,0 +1,106 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file apr-buffer.c
+ * @brief Read-ahead buffer of the buffered apr contexts.
+ */
+
+#include "context.h"
+#include "../memory.h"
+
+#include <string.h>
+
+#if HAVE_STDIO_H
+#include <stdio.h>
+#endif
+
+/**
+ * @brief Wrap @a device, an apr_socket_t* or apr_file_t*, with a read-ahead
+ * buffer of @a size bytes, or GAS_APR_BUFFER_SIZE when 0.
+ */
+GASresult gas_apr_buffer_new (GASaprbuffer** handle, GASvoid* device,
+                              GASunum size, GASvoid* user_data)
+{/*{{{*/
+    GASaprbuffer* b;
+
+    GAS_CHECK_PARAM(handle);
+    GAS_CHECK_PARAM(device);
+
+    if (size == 0) {
+        size = GAS_APR_BUFFER_SIZE;
+    }
+
+    b = (GASaprbuffer*)gas_alloc(sizeof(GASaprbuffer), user_data);
+    GAS_CHECK_MEM(b);
+    b->buffer = (GASubyte*)gas_alloc(size, user_data);
+    if (b->buffer == NULL) {
+        gas_free(b, user_data);
+        return GAS_ERR_MEMORY;
+    }
+    b->device = device;
+    b->size = size;
+    b->pos = 0;
+    b->end = 0;
+    b->user_data = user_data;
+
+    *handle = b;
+    return GAS_OK;
+}/*}}}*/
+
+/**
+ * @brief Release the handle, but not its device.
+ */
+GASresult gas_apr_buffer_destroy (GASaprbuffer* handle)
+{/*{{{*/
+    GAS_CHECK_PARAM(handle);
+
+    gas_free(handle->buffer, handle->user_data);
+    gas_free(handle, handle->user_data);
+    return GAS_OK;
+}/*}}}*/
+
+/**
+ * @brief Copy up to @a size bytes of read-ahead into @a buffer, without
+ * touching the device.
+ *
+ * @return The number of bytes copied.
+ */
+GASunum gas_apr_buffer_take (GASaprbuffer* handle, GASvoid* buffer,
+                             GASunum size)
+{/*{{{*/
+    GASunum avail;
+
+    if (handle == NULL) {
+        return 0;
+    }
+
+    avail = handle->end - handle->pos;
+    if (size > avail) {
+        size = avail;
+    }
+    if (size > 0) {
+        memcpy(buffer, handle->buffer + handle->pos, size);
+        handle->pos += size;
+    }
+    if (handle->pos == handle->end) {
+        handle->pos = 0;
+        handle->end = 0;
+    }
+    return size;
+}/*}}}*/
+
+// vim: sw=4 fdm=marker
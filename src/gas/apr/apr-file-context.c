@@ -166,6 +166,142 @@ GASresult gas_apr_file_seek (void *handle, unsigned long pos,
     return GAS_OK;
 }/*}}}*/
 
+/**
+ * @brief Put the file position of @a b back where its reader is, and empty
+ * the buffer.
+ */
+static
+GASresult gas_apr_file_unread (GASaprbuffer* b)
+{/*{{{*/
+    apr_status_t status;
+    apr_off_t offset;
+
+    if (b->pos == b->end) {
+        b->pos = 0;
+        b->end = 0;
+        return GAS_OK;
+    }
+
+    offset = -(apr_off_t)(b->end - b->pos);
+    b->pos = 0;
+    b->end = 0;
+
+    status = apr_file_seek((apr_file_t*)b->device, APR_CUR, &offset);
+    if (status != APR_SUCCESS) {
+        print_apr_error(status);
+        return GAS_ERR_UNKNOWN;
+    }
+    return GAS_OK;
+}/*}}}*/
+
+/**
+ * @brief called by gas to read from a GASaprbuffer.
+ *
+ * Loops until @a size_bytes are read or the file ends.
+ */
+static
+GASresult gas_apr_file_buffered_read (void *handle, void *buffer,
+                                      unsigned int size_bytes,
+                                      unsigned int *bytes_read,
+                                      void *user_data)
+{/*{{{*/
+    GASaprbuffer* b = (GASaprbuffer*)handle;
+    GASubyte* out = (GASubyte*)buffer;
+    apr_status_t status;
+    apr_size_t len;
+    unsigned int done;
+
+    if (!handle) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    done = gas_apr_buffer_take(b, out, size_bytes);
+
+    while (done < size_bytes) {
+        if (size_bytes - done >= b->size) {
+            /* nothing to gain from the copy */
+            status = apr_file_read_full((apr_file_t*)b->device, out + done,
+                                        size_bytes - done, &len);
+            done += len;
+        } else {
+            status = apr_file_read_full((apr_file_t*)b->device, b->buffer,
+                                        b->size, &len);
+            b->end = len;
+            done += gas_apr_buffer_take(b, out + done, size_bytes - done);
+        }
+
+        if (status != APR_SUCCESS) {
+            *bytes_read = done;
+            if (APR_STATUS_IS_EOF(status)) {
+                return done < size_bytes ? GAS_ERR_FILE_EOF : GAS_OK;
+            }
+            print_apr_error(status);
+            return GAS_ERR_UNKNOWN;
+        }
+    }
+
+    *bytes_read = done;
+    return GAS_OK;
+}/*}}}*/
+
+/**
+ * @brief called by gas to write to the file of a GASaprbuffer, where its
+ * reader is.
+ */
+static
+GASresult gas_apr_file_buffered_write (void *handle, void *buffer,
+                                       unsigned int size_bytes,
+                                       unsigned int *bytes_written,
+                                       void *user_data)
+{/*{{{*/
+    GASaprbuffer* b = (GASaprbuffer*)handle;
+    GASresult result;
+
+    if (!handle) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    result = gas_apr_file_unread(b);
+    if (result != GAS_OK) {
+        return result;
+    }
+
+    return gas_apr_file_write(b->device, buffer, size_bytes, bytes_written,
+                              user_data);
+}/*}}}*/
+
+/**
+ * @brief called by gas to seek through a GASaprbuffer.
+ *
+ * Seeks forward within the buffer only move its position.
+ */
+static
+GASresult gas_apr_file_buffered_seek (void *handle, unsigned long pos,
+                                      int whence, void *user_data)
+{/*{{{*/
+    GASaprbuffer* b = (GASaprbuffer*)handle;
+
+    if (!handle) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    if (whence == GAS_SEEK_CUR) {
+        if (pos <= b->end - b->pos) {
+            b->pos += pos;
+            return GAS_OK;
+        }
+        /* the file is already past the buffered bytes */
+        pos -= b->end - b->pos;
+        b->pos = 0;
+        b->end = 0;
+    } else {
+        b->pos = 0;
+        b->end = 0;
+    }
+
+    return gas_apr_file_seek(b->device, pos, whence, user_data);
+}/*}}}*/
+
 /**
  * @brief Creates a new gas context taylored for apr files.
  */
@@ -180,6 +316,24 @@ GAScontext* gas_new_apr_file_context (GASvoid* user_data)
     ctx->read = gas_apr_file_read;
     ctx->write = gas_apr_file_write;
     ctx->seek = gas_apr_file_seek;
+    ctx->writev = NULL;
+    return ctx;
+}/*}}}*/
+
+/**
+ * @brief Creates a new gas context for files read through a GASaprbuffer.
+ */
+GAScontext* gas_new_apr_buffered_file_context (GASvoid* user_data)
+{/*{{{*/
+    GAScontext *ctx = gas_new_apr_file_context(user_data);
+
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    ctx->read = gas_apr_file_buffered_read;
+    ctx->write = gas_apr_file_buffered_write;
+    ctx->seek = gas_apr_file_buffered_seek;
     return ctx;
 }/*}}}*/
 
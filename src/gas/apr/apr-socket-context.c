@@ -158,6 +158,150 @@ GASresult gas_apr_socket_seek (void *handle, unsigned long pos,
     return GAS_OK;
 }/*}}}*/
 
+/**
+ * @brief Refill the empty buffer of @a b with one recv, as large as it
+ * holds.
+ */
+static
+GASresult gas_apr_socket_fill (GASaprbuffer* b)
+{/*{{{*/
+    apr_status_t status;
+    apr_size_t len;
+
+    b->pos = 0;
+    b->end = 0;
+
+    len = b->size;
+    status = apr_socket_recv((apr_socket_t*)b->device, (char*)b->buffer, &len);
+    b->end = len;
+
+    if (len > 0) {
+        /* a status with data, like EOF, comes again on the next recv */
+        return GAS_OK;
+    }
+    if (status == APR_SUCCESS) {
+        return GAS_ERR_UNKNOWN;
+    }
+    if (APR_STATUS_IS_EOF(status)) {
+        return GAS_ERR_FILE_EOF;
+    }
+    print_apr_error(status);
+    return GAS_ERR_UNKNOWN;
+}/*}}}*/
+
+/**
+ * @brief called by gas to read from a GASaprbuffer.
+ *
+ * Only recvs when the buffer is empty, so as not to wait for bytes that the
+ * peer has not sent; a read is as short as what one recv returned.
+ */
+static
+GASresult gas_apr_socket_buffered_read (void *handle, void *buffer,
+                                        unsigned int size_bytes,
+                                        unsigned int *bytes_read,
+                                        void *user_data)
+{/*{{{*/
+    GASaprbuffer* b = (GASaprbuffer*)handle;
+    GASresult result;
+
+    if (!handle) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    *bytes_read = 0;
+
+    if (b->pos == b->end && size_bytes > 0) {
+        if (size_bytes >= b->size) {
+            /* nothing to gain from the copy */
+            return gas_apr_socket_read(b->device, buffer, size_bytes,
+                                       bytes_read, user_data);
+        }
+        result = gas_apr_socket_fill(b);
+        if (result != GAS_OK) {
+            return result;
+        }
+    }
+
+    *bytes_read = gas_apr_buffer_take(b, buffer, size_bytes);
+    return GAS_OK;
+}/*}}}*/
+
+/**
+ * @brief called by gas to write to the socket of a GASaprbuffer, looping
+ * on short sends.
+ */
+static
+GASresult gas_apr_socket_buffered_write (void *handle, void *buffer,
+                                         unsigned int size_bytes,
+                                         unsigned int *bytes_written,
+                                         void *user_data)
+{/*{{{*/
+    GASaprbuffer* b = (GASaprbuffer*)handle;
+    apr_status_t status;
+    apr_size_t len;
+    unsigned int done = 0;
+
+    if (!handle) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    while (done < size_bytes) {
+        len = size_bytes - done;
+        status = apr_socket_send((apr_socket_t*)b->device,
+                                 (char*)buffer + done, &len);
+        done += len;
+        if (status != APR_SUCCESS) {
+            *bytes_written = done;
+            print_apr_error(status);
+            return GAS_ERR_UNKNOWN;
+        }
+    }
+
+    *bytes_written = done;
+    return GAS_OK;
+}/*}}}*/
+
+/**
+ * @brief called by gas to seek through a GASaprbuffer.
+ *
+ * Skips within the buffer, refilling it as needed.
+ *
+ * @warning only support GAS_SEEK_CUR.
+ */
+static
+GASresult gas_apr_socket_buffered_seek (void *handle, unsigned long pos,
+                                        int whence, void *user_data)
+{/*{{{*/
+    GASaprbuffer* b = (GASaprbuffer*)handle;
+    GASresult result;
+    GASunum n;
+
+    if (!handle) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    if (whence != GAS_SEEK_CUR) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    while (pos > 0) {
+        if (b->pos == b->end) {
+            result = gas_apr_socket_fill(b);
+            if (result != GAS_OK) {
+                return result;
+            }
+        }
+        n = b->end - b->pos;
+        if (n > pos) {
+            n = pos;
+        }
+        b->pos += n;
+        pos -= n;
+    }
+
+    return GAS_OK;
+}/*}}}*/
+
 /**
  * @brief Creates a new gas context taylored for apr files.
  */
@@ -172,6 +316,24 @@ GAScontext* gas_new_apr_socket_context (GASvoid* user_data)
     ctx->read = gas_apr_socket_read;
     ctx->write = gas_apr_socket_write;
     ctx->seek = gas_apr_socket_seek;
+    ctx->writev = NULL;
+    return ctx;
+}/*}}}*/
+
+/**
+ * @brief Creates a new gas context for sockets read through a GASaprbuffer.
+ */
+GAScontext* gas_new_apr_buffered_socket_context (GASvoid* user_data)
+{/*{{{*/
+    GAScontext *ctx = gas_new_apr_socket_context(user_data);
+
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    ctx->read = gas_apr_socket_buffered_read;
+    ctx->write = gas_apr_socket_buffered_write;
+    ctx->seek = gas_apr_socket_buffered_seek;
     return ctx;
 }/*}}}*/
 
@@ -27,6 +27,48 @@
 GAScontext* gas_new_apr_file_context (GASvoid* user_data);
 GAScontext* gas_new_apr_socket_context (GASvoid* user_data);
 
+/**
+ * @brief Default size of the buffer of gas_apr_buffer_new().
+ */
+#define GAS_APR_BUFFER_SIZE 65536
+
+/**
+ * @brief The handle of the buffered apr contexts.
+ *
+ * Reads are served from @a buffer, which is filled with one large recv (or
+ * read) whenever it runs dry, and seeks forward within it only move
+ * @a pos.  The device must only be used through the handle while it holds
+ * read-ahead; gas_apr_buffer_take() drains it.
+ *
+ * @code
+ * ctx = gas_new_apr_buffered_socket_context(NULL);
+ * gas_apr_buffer_new(&handle, socket, 0, NULL);
+ * gas_parser_new(&p, ctx, handle);
+ * ...
+ * gas_apr_buffer_destroy(handle);
+ * @endcode
+ */
+typedef struct
+{
+    /** @brief The apr_socket_t* or apr_file_t* read from. */
+    GASvoid* device;
+    GASubyte* buffer;
+    GASunum size;
+    /** @brief Buffered bytes not yet read are buffer[pos, end). */
+    GASunum pos;
+    GASunum end;
+    GASvoid* user_data;
+} GASaprbuffer;
+
+GASresult gas_apr_buffer_new (GASaprbuffer** handle, GASvoid* device,
+                              GASunum size, GASvoid* user_data);
+GASresult gas_apr_buffer_destroy (GASaprbuffer* handle);
+GASunum gas_apr_buffer_take (GASaprbuffer* handle, GASvoid* buffer,
+                             GASunum size);
+
+GAScontext* gas_new_apr_buffered_file_context (GASvoid* user_data);
+GAScontext* gas_new_apr_buffered_socket_context (GASvoid* user_data);
+
 #endif /* GAS_APR_CONTEXT_H defined */
 
 // vim: sw=4 fdm=marker
@@ -0,0 +1,274 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file arena.c
+ * @brief arena allocator implementation
+ */
+
+#include "arena.h"
+
+#include <string.h>
+#if HAVE_STDIO_H
+#include <stdio.h>
+#endif
+
+#define GAS_ARENA_ALIGN 8
+#define gas_arena_align(n) \
+    (((n) + GAS_ARENA_ALIGN - 1) & ~(GASunum)(GAS_ARENA_ALIGN - 1))
+
+/* every allocation is preceded by its size, for realloc */
+#define BLOCK_HEADER_SIZE gas_arena_align(sizeof(GASarena_block))
+#define ALLOC_HEADER_SIZE gas_arena_align(sizeof(GASunum))
+/* beyond this, a block of the size and its headers would overflow */
+#define LARGEST_SIZE ((GASunum)-1 - BLOCK_HEADER_SIZE - 2 * ALLOC_HEADER_SIZE)
+
+#define block_data(b) ((GASubyte*)(b) + BLOCK_HEADER_SIZE)
+#define alloc_size(ptr) (*(GASunum*)((GASubyte*)(ptr) - ALLOC_HEADER_SIZE))
+
+/* gas_arena_new_block() {{{*/
+static GASarena_block* gas_arena_new_block (GASunum size)
+{
+    GASarena_block* b;
+
+    b = (GASarena_block*)gas_default_alloc(BLOCK_HEADER_SIZE + size, NULL);
+    if (b == NULL) {
+        return NULL;
+    }
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+
+    return b;
+}
+/*}}}*/
+/* GASallocator methods {{{*/
+static void* gas_arena_allocator_alloc (GASallocator* self, GASunum size)
+{
+    return gas_arena_alloc(size, self);
+}
+static void* gas_arena_allocator_realloc (GASallocator* self, void *ptr,
+                                          GASunum size)
+{
+    return gas_arena_realloc(ptr, size, self);
+}
+static void gas_arena_allocator_free (GASallocator* self, void *ptr)
+{
+    gas_arena_free(ptr, self);
+}
+/*}}}*/
+/* gas_arena_new() {{{*/
+/**
+ * @param block_size The size of each block, or 0 for GAS_ARENA_BLOCK_SIZE.
+ * Allocations larger than half a block get a block of their own.
+ */
+GASresult gas_arena_new (GASarena** arena, GASunum block_size)
+{
+    GASarena* a;
+
+    GAS_CHECK_PARAM(arena);
+
+    a = (GASarena*)gas_default_alloc(sizeof(GASarena), NULL);
+    GAS_CHECK_MEM(a);
+
+    a->allocator.alloc = gas_arena_allocator_alloc;
+    a->allocator.realloc = gas_arena_allocator_realloc;
+    a->allocator.free = gas_arena_allocator_free;
+    a->blocks = NULL;
+    a->block_size = block_size > 0 ? block_size : GAS_ARENA_BLOCK_SIZE;
+
+    *arena = a;
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_arena_destroy() {{{*/
+/**
+ * @brief Release the arena, and everything allocated from it.
+ */
+GASresult gas_arena_destroy (GASarena* arena)
+{
+    GASarena_block *b, *next;
+
+    GAS_CHECK_PARAM(arena);
+
+    for (b = arena->blocks; b != NULL; b = next) {
+        next = b->next;
+        gas_default_free(b, NULL);
+    }
+    gas_default_free(arena, NULL);
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_arena_clear() {{{*/
+/**
+ * @brief Release everything allocated from the arena, at once.
+ *
+ * One block is kept for reuse, so that an arena cleared between messages
+ * settles into a single block.
+ */
+GASresult gas_arena_clear (GASarena* arena)
+{
+    GASarena_block *b, *next, *keep = NULL;
+
+    GAS_CHECK_PARAM(arena);
+
+    for (b = arena->blocks; b != NULL; b = next) {
+        next = b->next;
+        if (keep == NULL && b->size == arena->block_size) {
+            keep = b;
+        } else {
+            gas_default_free(b, NULL);
+        }
+    }
+
+    if (keep) {
+        keep->next = NULL;
+        keep->used = 0;
+    }
+    arena->blocks = keep;
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_arena_initialize() {{{*/
+/**
+ * @brief Install the arena callbacks as the library allocator.
+ *
+ * Not needed with the default callbacks, which reach the arena through its
+ * GASallocator.
+ */
+GASresult gas_arena_initialize (void)
+{
+    return gas_memory_initialize(gas_arena_alloc, gas_arena_realloc,
+                                 gas_arena_free);
+}
+/*}}}*/
+/* gas_arena_alloc() {{{*/
+void* gas_arena_alloc (GASunum size, GASvoid* user_data)
+{
+    GASarena* arena = (GASarena*)user_data;
+    GASarena_block* b;
+    GASubyte* p;
+    GASunum need;
+
+    if (arena == NULL) {
+        return gas_default_alloc(size, NULL);
+    }
+    if (size > LARGEST_SIZE) {
+        return NULL;
+    }
+
+    need = ALLOC_HEADER_SIZE + gas_arena_align(size);
+    b = arena->blocks;
+
+    if (b == NULL || b->size - b->used < need) {
+        if (need > arena->block_size / 2) {
+            /* large allocations get their own block, behind the current */
+            b = gas_arena_new_block(need);
+            if (b == NULL) {
+                return NULL;
+            }
+            if (arena->blocks) {
+                b->next = arena->blocks->next;
+                arena->blocks->next = b;
+            } else {
+                arena->blocks = b;
+            }
+        } else {
+            b = gas_arena_new_block(arena->block_size);
+            if (b == NULL) {
+                return NULL;
+            }
+            b->next = arena->blocks;
+            arena->blocks = b;
+        }
+    }
+
+    p = block_data(b) + b->used + ALLOC_HEADER_SIZE;
+    b->used += need;
+    alloc_size(p) = size;
+
+    return p;
+}
+/*}}}*/
+/* gas_arena_realloc() {{{*/
+/**
+ * @brief Grow an allocation, in place when it is the latest in its block.
+ */
+void* gas_arena_realloc (void *ptr, GASunum size, GASvoid* user_data)
+{
+    GASarena* arena = (GASarena*)user_data;
+    GASarena_block* b;
+    GASunum old_size, old_end, new_end;
+    void* p;
+
+    if (arena == NULL) {
+        return gas_default_realloc(ptr, size, NULL);
+    }
+    if (ptr == NULL) {
+        return gas_arena_alloc(size, user_data);
+    }
+
+    old_size = alloc_size(ptr);
+    if (size <= old_size) {
+        alloc_size(ptr) = size;
+        return ptr;
+    }
+    if (size > LARGEST_SIZE) {
+        return NULL;
+    }
+
+    b = arena->blocks;
+    if ((GASubyte*)ptr > block_data(b) &&
+        (GASubyte*)ptr < block_data(b) + b->used) {
+        old_end = (GASubyte*)ptr - block_data(b) + gas_arena_align(old_size);
+    } else {
+        old_end = 0;
+    }
+    if (old_end > 0 && old_end == b->used) {
+        new_end = (GASubyte*)ptr - block_data(b) + gas_arena_align(size);
+        if (new_end <= b->size) {
+            b->used = new_end;
+            alloc_size(ptr) = size;
+            return ptr;
+        }
+    }
+
+    p = gas_arena_alloc(size, user_data);
+    if (p == NULL) {
+        return NULL;
+    }
+    memcpy(p, ptr, old_size);
+
+    return p;
+}
+/*}}}*/
+/* gas_arena_free() {{{*/
+/**
+ * @brief Arena memory is only released by gas_arena_clear(), so freeing it
+ * does nothing.
+ */
+void gas_arena_free (void *ptr, GASvoid* user_data)
+{
+    if (user_data == NULL) {
+        gas_default_free(ptr, NULL);
+    }
+}
+/*}}}*/
+
+/* vim: set sw=4 fdm=marker :*/
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file arena.h
+ * @brief arena allocator definition
+ */
+
+#ifndef GAS_ARENA_H
+#define GAS_ARENA_H
+
+#include "memory.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+/*}*/
+#endif
+
+/**
+ * @defgroup arena Arena
+ * @ingroup memory
+ * @brief Bump pointer allocation of whole trees.
+ *
+ * A GASarena is a GASallocator, see @ref memory.  Everything allocated with
+ * it as user_data, such as a tree from gas_read_buf() or gas_parse(), comes
+ * from the arena's blocks, and the whole tree is released at once with
+ * gas_arena_clear() or gas_arena_destroy(), rather than with gas_destroy().
+ *
+ * gas_arena_initialize() installs callbacks taking every non NULL user_data
+ * to be a GASarena, as before allocator objects.
+ */
+/*@{*/
+
+/**
+ * @brief Default size of an arena block, in bytes.
+ */
+#define GAS_ARENA_BLOCK_SIZE 65536
+
+typedef struct GASarena_block
+{
+    struct GASarena_block* next;
+    GASunum size;
+    GASunum used;
+} GASarena_block;
+
+typedef struct
+{
+    GASallocator allocator;
+    /** @brief The current block first, then older and oversized blocks. */
+    GASarena_block* blocks;
+    GASunum block_size;
+} GASarena;
+
+GASresult gas_arena_new (GASarena** arena, GASunum block_size);
+GASresult gas_arena_destroy (GASarena* arena);
+GASresult gas_arena_clear (GASarena* arena);
+
+GASresult gas_arena_initialize (void);
+
+void* gas_arena_alloc (GASunum size, GASvoid* user_data);
+void* gas_arena_realloc (void *ptr, GASunum size, GASvoid* user_data);
+void  gas_arena_free (void *ptr, GASvoid* user_data);
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_ARENA_H defined */
+
+/* vim: set sw=4 fdm=marker :*/
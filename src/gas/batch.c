@@ -0,0 +1,821 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file batch.c
+ * @brief Batch reading, with io_uring or a thread pool.
+ */
+
+#include "batch.h"
+#include "bufio.h"
+#include "codec.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#if HAVE_STDIO_H
+#include <stdio.h>
+#endif
+
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#if HAVE_LINUX_IO_URING_H && defined(__GNUC__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && \
+    defined(__NR_io_uring_register)
+#define GAS_BATCH_URING 1
+#endif
+#endif
+
+/* size of the first read of each file, which holds most small trees */
+#define GAS_BATCH_FIRST_READ 4096
+/* largest single read handed to the kernel */
+#define GAS_BATCH_MAX_READ (1u << 30)
+
+/* items {{{*/
+struct GASbatch_item
+{
+    struct GASbatch_item* next;
+    /* NULL for descriptors given by the caller, which are left open */
+    GASchar* path;
+    int fd;
+    GASvoid* tag;
+
+    GASubyte* buf;
+    GASunum capacity;
+    GASunum got;
+    /* length of the tree, once its size has been read */
+    GASunum want;
+    GASbool sized;
+    GASresult result;
+};
+
+struct GASbatch_queue
+{
+    struct GASbatch_item* head;
+    struct GASbatch_item* tail;
+};
+
+static GASvoid gas_batch_push (struct GASbatch_queue* q,
+                               struct GASbatch_item* it)
+{
+    it->next = NULL;
+    if (q->tail != NULL) {
+        q->tail->next = it;
+    } else {
+        q->head = it;
+    }
+    q->tail = it;
+}
+
+static struct GASbatch_item* gas_batch_pop (struct GASbatch_queue* q)
+{
+    struct GASbatch_item* it = q->head;
+
+    if (it != NULL) {
+        q->head = it->next;
+        if (q->head == NULL) {
+            q->tail = NULL;
+        }
+    }
+    return it;
+}
+
+/* buffers are handled by the io threads, so use the default allocator */
+static GASvoid gas_batch_item_free (struct GASbatch_item* it)
+{
+    gas_free(it->buf, NULL);
+    gas_free(it->path, NULL);
+    gas_free(it, NULL);
+}
+
+static GASvoid gas_batch_free_all (struct GASbatch_queue* q)
+{
+    struct GASbatch_item* it;
+
+    while ((it = gas_batch_pop(q)) != NULL) {
+        gas_batch_item_free(it);
+    }
+}
+
+/**
+ * @brief Room for the next read of @a it.
+ */
+static GASunum gas_batch_room (struct GASbatch_item* it)
+{
+    GASunum room = (it->sized ? it->want : it->capacity) - it->got;
+
+    return room > GAS_BATCH_MAX_READ ? GAS_BATCH_MAX_READ : room;
+}
+
+/**
+ * @brief Account for @a n more bytes read into @a it.
+ *
+ * The size at the head of the tree tells how much to read, and the buffer
+ * grows to fit it.
+ *
+ * @return Whether more should be read.  Otherwise, GASbatch_item::result
+ * is set.
+ */
+static GASbool gas_batch_advance (struct GASbatch_item* it, GASunum n)
+{
+    GASunum size;
+    GASnum length;
+    GASvoid* tmp;
+
+    it->got += n;
+
+    if (!it->sized) {
+        length = gas_codec_decode(it->buf, it->got, &size);
+        if (length > 0) {
+            /* gas_read_buf() returns the length as a GASnum */
+            if (size > ((GASunum)-1 >> 1) - length) {
+                it->result = GAS_ERR_OUT_OF_RANGE;
+                return GAS_FALSE;
+            }
+            it->sized = GAS_TRUE;
+            it->want = length + size;
+            if (it->want > it->capacity) {
+                tmp = gas_realloc(it->buf, it->want, NULL);
+                if (tmp == NULL) {
+                    it->result = GAS_ERR_MEMORY;
+                    return GAS_FALSE;
+                }
+                it->buf = (GASubyte*)tmp;
+                it->capacity = it->want;
+            }
+        } else if (it->got >= it->capacity) {
+            it->result = length < 0 ? length : GAS_ERR_UNKNOWN;
+            return GAS_FALSE;
+        }
+    }
+
+    if (it->sized && it->got >= it->want) {
+        it->result = GAS_OK;
+        return GAS_FALSE;
+    }
+    if (n == 0) {
+        it->result = GAS_ERR_FILE_EOF;
+        return GAS_FALSE;
+    }
+    return GAS_TRUE;
+}
+
+/**
+ * @brief Open and read @a it, blocking.
+ */
+static GASvoid gas_batch_load (struct GASbatch_item* it)
+{
+    ssize_t n;
+
+    if (it->path != NULL) {
+        it->fd = open(it->path, O_RDONLY);
+        if (it->fd < 0) {
+            it->result = GAS_ERR_FILE_NOT_FOUND;
+            return;
+        }
+    }
+
+    do {
+        n = pread(it->fd, it->buf + it->got, gas_batch_room(it),
+                  (off_t)it->got);
+        if (n < 0) {
+            if (errno == EINTR) {
+                n = 0;
+                continue;
+            }
+            it->result = GAS_ERR_UNKNOWN;
+            break;
+        }
+    } while (gas_batch_advance(it, (GASunum)n));
+
+    if (it->path != NULL) {
+        close(it->fd);
+    }
+}
+/*}}}*/
+
+#if GAS_BATCH_URING
+/* io_uring {{{*/
+struct GASring
+{
+    int fd;
+    unsigned entries;
+    unsigned to_submit;
+
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+
+    void* sq_ring;
+    size_t sq_size;
+    void* cq_ring;
+    size_t cq_size;
+    size_t sqes_size;
+};
+
+/**
+ * @brief Whether the ring supports the operations of a batch.
+ */
+static GASbool gas_ring_probe (int fd)
+{
+    struct io_uring_probe* probe;
+    size_t size = sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op);
+    GASbool ok;
+
+    probe = (struct io_uring_probe*)gas_alloc(size, NULL);
+    if (probe == NULL) {
+        return GAS_FALSE;
+    }
+    memset(probe, 0, size);
+
+    ok = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE,
+                 probe, 256) >= 0 &&
+         probe->last_op >= IORING_OP_READ &&
+         (probe->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED) &&
+         (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+
+    gas_free(probe, NULL);
+    return ok;
+}
+
+static GASvoid gas_ring_close (struct GASring* r)
+{
+    if (r->sqes != NULL) {
+        munmap(r->sqes, r->sqes_size);
+    }
+    if (r->cq_ring != NULL && r->cq_ring != r->sq_ring) {
+        munmap(r->cq_ring, r->cq_size);
+    }
+    if (r->sq_ring != NULL) {
+        munmap(r->sq_ring, r->sq_size);
+    }
+    close(r->fd);
+}
+
+/**
+ * @return GAS_OK, or an error when io_uring is unavailable.
+ */
+static GASresult gas_ring_open (struct GASring* r, unsigned entries)
+{
+    struct io_uring_params p;
+    GASubyte *sq, *cq;
+
+    memset(r, 0, sizeof(*r));
+    memset(&p, 0, sizeof(p));
+
+    r->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) {
+        return GAS_ERR_UNKNOWN;
+    }
+    if (!gas_ring_probe(r->fd)) {
+        close(r->fd);
+        return GAS_ERR_UNKNOWN;
+    }
+
+    r->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_size > r->sq_size) {
+            r->sq_size = r->cq_size;
+        }
+        r->cq_size = r->sq_size;
+    }
+
+    r->sq_ring = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ring == MAP_FAILED) {
+        r->sq_ring = NULL;
+        gas_ring_close(r);
+        return GAS_ERR_UNKNOWN;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ring = r->sq_ring;
+    } else {
+        r->cq_ring = mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, r->fd,
+                          IORING_OFF_CQ_RING);
+        if (r->cq_ring == MAP_FAILED) {
+            r->cq_ring = NULL;
+            gas_ring_close(r);
+            return GAS_ERR_UNKNOWN;
+        }
+    }
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = (struct io_uring_sqe*)mmap(NULL, r->sqes_size,
+                                         PROT_READ | PROT_WRITE,
+                                         MAP_SHARED | MAP_POPULATE, r->fd,
+                                         IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        gas_ring_close(r);
+        return GAS_ERR_UNKNOWN;
+    }
+
+    sq = (GASubyte*)r->sq_ring;
+    cq = (GASubyte*)r->cq_ring;
+    r->entries = p.sq_entries;
+    r->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned*)(sq + p.sq_off.array);
+    r->cq_head = (unsigned*)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+    return GAS_OK;
+}
+
+/**
+ * @brief Queue the next step of @a it: opening its path, or reading.
+ *
+ * Each item has at most one operation in flight, and there are no more
+ * items in flight than entries, so the queue has room.
+ */
+static GASvoid gas_ring_queue (struct GASring* r, struct GASbatch_item* it)
+{
+    unsigned tail = *r->sq_tail;
+    unsigned index = tail & *r->sq_mask;
+    struct io_uring_sqe* sqe = &r->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    if (it->fd < 0) {
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (unsigned long)it->path;
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    } else {
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = it->fd;
+        sqe->addr = (unsigned long)(it->buf + it->got);
+        sqe->len = (unsigned)gas_batch_room(it);
+        sqe->off = it->got;
+    }
+    sqe->user_data = (unsigned long)it;
+
+    r->sq_array[index] = index;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    r->to_submit++;
+}
+/*}}}*/
+#endif
+
+/* state {{{*/
+struct GASbatch_state
+{
+    /* added, and not started */
+    struct GASbatch_queue pending;
+    /* read, and not yet decoded */
+    struct GASbatch_queue done;
+
+#if HAVE_PTHREAD_H
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t finished;
+    pthread_t threads[GAS_BATCH_THREADS];
+    GASunum nb_threads;
+    GASbool stop;
+#endif
+
+#if GAS_BATCH_URING
+    struct GASring ring;
+    GASunum in_flight;
+#endif
+};
+/*}}}*/
+
+#if GAS_BATCH_URING
+/* gas_batch_uring_complete() {{{*/
+/**
+ * @brief Take the result @a res of the operation in flight for @a it.
+ */
+static GASvoid gas_batch_uring_complete (struct GASbatch_state* s,
+                                         struct GASbatch_item* it, int res)
+{
+    if (it->fd < 0) {
+        if (res < 0) {
+            it->result = GAS_ERR_FILE_NOT_FOUND;
+            goto finish;
+        }
+        it->fd = res;
+        gas_ring_queue(&s->ring, it);
+        return;
+    }
+
+    if (res < 0) {
+        it->result = GAS_ERR_UNKNOWN;
+    } else if (gas_batch_advance(it, (GASunum)res)) {
+        gas_ring_queue(&s->ring, it);
+        return;
+    }
+
+finish:
+    if (it->path != NULL && it->fd >= 0) {
+        close(it->fd);
+    }
+    s->in_flight--;
+    gas_batch_push(&s->done, it);
+}
+/*}}}*/
+/* gas_batch_uring_wait() {{{*/
+/**
+ * @brief Start pending files while there is room, then wait until one is
+ * read.
+ */
+static GASresult gas_batch_uring_wait (GASbatch* b)
+{
+    struct GASbatch_state* s = b->state;
+    struct GASring* r = &s->ring;
+    struct GASbatch_item* it;
+    struct io_uring_cqe* cqe;
+    unsigned head, tail;
+    long submitted;
+
+    while (s->done.head == NULL) {
+        while (s->in_flight < b->depth && s->pending.head != NULL) {
+            gas_ring_queue(r, gas_batch_pop(&s->pending));
+            s->in_flight++;
+        }
+
+        submitted = syscall(__NR_io_uring_enter, r->fd, r->to_submit, 1,
+                            IORING_ENTER_GETEVENTS, NULL, 0);
+        if (submitted < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return GAS_ERR_UNKNOWN;
+        }
+        r->to_submit -= (unsigned)submitted;
+
+        head = *r->cq_head;
+        tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            cqe = &r->cqes[head & *r->cq_mask];
+            it = (struct GASbatch_item*)(unsigned long)cqe->user_data;
+            gas_batch_uring_complete(s, it, cqe->res);
+            head++;
+        }
+        __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return GAS_OK;
+}
+/*}}}*/
+#endif
+
+#if HAVE_PTHREAD_H
+/* gas_batch_worker() {{{*/
+static void* gas_batch_worker (void* arg)
+{
+    struct GASbatch_state* s = (struct GASbatch_state*)arg;
+    struct GASbatch_item* it;
+
+    pthread_mutex_lock(&s->lock);
+    for (;;) {
+        while (!s->stop && s->pending.head == NULL) {
+            pthread_cond_wait(&s->work, &s->lock);
+        }
+        if (s->stop) {
+            break;
+        }
+        it = gas_batch_pop(&s->pending);
+        pthread_mutex_unlock(&s->lock);
+
+        gas_batch_load(it);
+
+        pthread_mutex_lock(&s->lock);
+        gas_batch_push(&s->done, it);
+        pthread_cond_signal(&s->finished);
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    return NULL;
+}
+/*}}}*/
+#endif
+
+/** @name cons/decons */
+/*@{*/
+/* gas_batch_new() {{{*/
+/**
+ * @param depth Most files in flight at once, or 0 for GAS_BATCH_DEPTH.
+ * @param flags GAS_BATCH_NO_URING, or 0.
+ *
+ * Without io_uring, at most GAS_BATCH_THREADS threads read files; without
+ * threads, gas_batch_next() reads them itself.
+ */
+GASresult gas_batch_new (GASbatch** batch, GASunum depth, unsigned int flags,
+                         GASvoid* user_data)
+{
+    GASbatch* b;
+    struct GASbatch_state* s;
+#if HAVE_PTHREAD_H
+    GASunum i;
+#endif
+
+    GAS_CHECK_PARAM(batch);
+
+    if (depth == 0) {
+        depth = GAS_BATCH_DEPTH;
+    }
+
+    b = (GASbatch*)gas_alloc(sizeof(GASbatch), user_data);
+    GAS_CHECK_MEM(b);
+    s = (struct GASbatch_state*)gas_alloc(sizeof(struct GASbatch_state),
+                                          user_data);
+    if (s == NULL) {
+        gas_free(b, user_data);
+        return GAS_ERR_MEMORY;
+    }
+    memset(b, 0, sizeof(GASbatch));
+    memset(s, 0, sizeof(struct GASbatch_state));
+    b->state = s;
+    b->depth = depth;
+    b->user_data = user_data;
+
+#if GAS_BATCH_URING
+    if (!(flags & GAS_BATCH_NO_URING) &&
+        gas_ring_open(&s->ring, depth > 4096 ? 4096 : (unsigned)depth)
+        == GAS_OK)
+    {
+        b->uring = GAS_TRUE;
+        if (b->depth > s->ring.entries) {
+            b->depth = s->ring.entries;
+        }
+        *batch = b;
+        return GAS_OK;
+    }
+#endif
+
+#if HAVE_PTHREAD_H
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->work, NULL);
+    pthread_cond_init(&s->finished, NULL);
+    for (i = 0; i < GAS_BATCH_THREADS && i < depth; i++) {
+        if (pthread_create(&s->threads[i], NULL, gas_batch_worker, s) != 0) {
+            break;
+        }
+        s->nb_threads++;
+    }
+#endif
+
+    *batch = b;
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_batch_destroy() {{{*/
+/**
+ * @brief Release the batch, dropping the files not yet returned.
+ *
+ * Files already being read are waited for.
+ */
+GASresult gas_batch_destroy (GASbatch* b)
+{
+    struct GASbatch_state* s;
+#if HAVE_PTHREAD_H
+    GASunum i;
+#endif
+
+    GAS_CHECK_PARAM(b);
+
+    s = b->state;
+
+#if GAS_BATCH_URING
+    if (b->uring) {
+        gas_batch_free_all(&s->pending);
+        while (s->in_flight > 0) {
+            if (gas_batch_uring_wait(b) != GAS_OK) {
+                /* the kernel may still write to the buffers */
+                break;
+            }
+            gas_batch_free_all(&s->done);
+        }
+        if (s->in_flight == 0) {
+            gas_ring_close(&s->ring);
+        }
+        gas_batch_free_all(&s->done);
+        gas_free(s, b->user_data);
+        gas_free(b, b->user_data);
+        return GAS_OK;
+    }
+#endif
+
+#if HAVE_PTHREAD_H
+    pthread_mutex_lock(&s->lock);
+    s->stop = GAS_TRUE;
+    gas_batch_free_all(&s->pending);
+    pthread_cond_broadcast(&s->work);
+    pthread_mutex_unlock(&s->lock);
+    for (i = 0; i < s->nb_threads; i++) {
+        pthread_join(s->threads[i], NULL);
+    }
+    pthread_cond_destroy(&s->finished);
+    pthread_cond_destroy(&s->work);
+    pthread_mutex_destroy(&s->lock);
+#endif
+
+    gas_batch_free_all(&s->pending);
+    gas_batch_free_all(&s->done);
+    gas_free(s, b->user_data);
+    gas_free(b, b->user_data);
+
+    return GAS_OK;
+}
+/*}}}*/
+/*@}*/
+
+/** @name files */
+/*@{*/
+/* gas_batch_add() {{{*/
+static GASresult gas_batch_add (GASbatch* b, struct GASbatch_item* it)
+{
+    struct GASbatch_state* s = b->state;
+
+    it->capacity = GAS_BATCH_FIRST_READ;
+    it->buf = (GASubyte*)gas_alloc(it->capacity, NULL);
+    if (it->buf == NULL) {
+        gas_batch_item_free(it);
+        return GAS_ERR_MEMORY;
+    }
+    b->nb_pending++;
+
+#if HAVE_PTHREAD_H
+    if (s->nb_threads > 0) {
+        pthread_mutex_lock(&s->lock);
+        gas_batch_push(&s->pending, it);
+        pthread_cond_signal(&s->work);
+        pthread_mutex_unlock(&s->lock);
+        return GAS_OK;
+    }
+#endif
+
+    gas_batch_push(&s->pending, it);
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_batch_add_path() {{{*/
+/**
+ * @brief Queue the file at @a path.
+ *
+ * @param tag Returned with the file's result.
+ */
+GASresult gas_batch_add_path (GASbatch* b, const char* path, GASvoid* tag)
+{
+    struct GASbatch_item* it;
+    size_t size;
+
+    GAS_CHECK_PARAM(b);
+    GAS_CHECK_PARAM(path);
+
+    it = (struct GASbatch_item*)gas_alloc(sizeof(struct GASbatch_item), NULL);
+    GAS_CHECK_MEM(it);
+    memset(it, 0, sizeof(struct GASbatch_item));
+
+    size = strlen(path) + 1;
+    it->path = (GASchar*)gas_alloc(size, NULL);
+    if (it->path == NULL) {
+        gas_free(it, NULL);
+        return GAS_ERR_MEMORY;
+    }
+    memcpy(it->path, path, size);
+    it->fd = -1;
+    it->tag = tag;
+
+    return gas_batch_add(b, it);
+}
+/*}}}*/
+/* gas_batch_add_fd() {{{*/
+/**
+ * @brief Queue the file open as @a fd, read from its start.
+ *
+ * The descriptor stays open, and must not be closed before its result is
+ * returned.
+ */
+GASresult gas_batch_add_fd (GASbatch* b, int fd, GASvoid* tag)
+{
+    struct GASbatch_item* it;
+
+    GAS_CHECK_PARAM(b);
+
+    if (fd < 0) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    it = (struct GASbatch_item*)gas_alloc(sizeof(struct GASbatch_item), NULL);
+    GAS_CHECK_MEM(it);
+    memset(it, 0, sizeof(struct GASbatch_item));
+    it->fd = fd;
+    it->tag = tag;
+
+    return gas_batch_add(b, it);
+}
+/*}}}*/
+/* gas_batch_next() {{{*/
+/**
+ * @brief Wait for the next file to be read, and decode it.
+ *
+ * @retval GAS_OK @a done holds the file's tag, result and tree.
+ * @retval GAS_ERR_OUT_OF_RANGE no files are left.
+ */
+GASresult gas_batch_next (GASbatch* b, GASbatch_result* done)
+{
+    struct GASbatch_state* s;
+    struct GASbatch_item* it;
+    GASchunk* tree = NULL;
+    GASnum length;
+#if GAS_BATCH_URING
+    GASresult result;
+#endif
+
+    GAS_CHECK_PARAM(b);
+    GAS_CHECK_PARAM(done);
+
+    s = b->state;
+    if (b->nb_pending == 0) {
+        return GAS_ERR_OUT_OF_RANGE;
+    }
+
+#if GAS_BATCH_URING
+    if (b->uring) {
+        result = gas_batch_uring_wait(b);
+        if (result != GAS_OK) { return result; }
+        it = gas_batch_pop(&s->done);
+    } else
+#endif
+#if HAVE_PTHREAD_H
+    if (s->nb_threads > 0) {
+        pthread_mutex_lock(&s->lock);
+        while (s->done.head == NULL) {
+            pthread_cond_wait(&s->finished, &s->lock);
+        }
+        it = gas_batch_pop(&s->done);
+        pthread_mutex_unlock(&s->lock);
+    } else
+#endif
+    {
+        it = gas_batch_pop(&s->pending);
+        gas_batch_load(it);
+    }
+    b->nb_pending--;
+
+    done->tag = it->tag;
+    done->result = it->result;
+    if (it->result == GAS_OK) {
+        length = gas_read_buf(it->buf, it->got, &tree, b->user_data);
+        if (length < 0) {
+            done->result = length;
+            tree = NULL;
+        }
+    }
+    done->tree = tree;
+
+    gas_batch_item_free(it);
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_batch_run() {{{*/
+/**
+ * @brief Call @a on_result with each remaining file, as it is read.
+ */
+GASresult gas_batch_run (GASbatch* b, GAS_ON_BATCH_RESULT on_result,
+                         GASvoid* data)
+{
+    GASbatch_result done;
+    GASresult result;
+
+    GAS_CHECK_PARAM(b);
+    GAS_CHECK_PARAM(on_result);
+
+    while ((result = gas_batch_next(b, &done)) == GAS_OK) {
+        on_result(&done, data);
+    }
+    return result == GAS_ERR_OUT_OF_RANGE ? GAS_OK : result;
+}
+/*}}}*/
+/*@}*/
+
+/* vim: set sw=4 fdm=marker :*/
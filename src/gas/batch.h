@@ -0,0 +1,128 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file batch.h
+ * @brief batch definition
+ */
+
+#ifndef GAS_BATCH_H
+#define GAS_BATCH_H
+
+#include "tree.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+/*}*/
+#endif
+
+/**
+ * @defgroup batch Batch Reading
+ * @ingroup io
+ * @brief Reads many files at once, each holding one tree.
+ *
+ * Files are opened and read in the background, with io_uring where the
+ * kernel offers it, or else by a pool of threads.  gas_batch_next() hands
+ * back each finished file, in completion order, decoded as by
+ * gas_read_buf():
+ *
+ * @code
+ * gas_batch_new(&b, 0, 0);
+ * for (i = 0; i < nb_paths; i++) {
+ *     gas_batch_add_path(b, paths[i], paths[i]);
+ * }
+ * while (gas_batch_next(b, &done) == GAS_OK) {
+ *     if (done.result == GAS_OK) {
+ *         use((const char*)done.tag, done.tree);
+ *         gas_destroy(done.tree);
+ *     }
+ * }
+ * @endcode
+ *
+ * Trees are decoded by the thread calling gas_batch_next(), with the
+ * batch's user_data.  A batch itself is used from one thread at a time.
+ */
+/*@{*/
+
+/**
+ * @brief Default number of files in flight at once.
+ */
+#define GAS_BATCH_DEPTH 64
+
+/**
+ * @brief Largest number of threads of the pool.
+ */
+#define GAS_BATCH_THREADS 4
+
+/**
+ * @brief Flag of gas_batch_new(), to use the thread pool even where
+ * io_uring is available.
+ */
+#define GAS_BATCH_NO_URING 0x1
+
+/**
+ * @brief A finished file.
+ */
+typedef struct
+{
+    /** @brief As given to gas_batch_add_path() or gas_batch_add_fd(). */
+    GASvoid* tag;
+    /** @brief GAS_OK, or the reason tree is NULL. */
+    GASresult result;
+    /** @brief The decoded tree, which now belongs to the caller. */
+    GASchunk* tree;
+} GASbatch_result;
+
+typedef GASvoid (*GAS_ON_BATCH_RESULT) (GASbatch_result* done,
+                                        GASvoid* user_data);
+
+typedef struct
+{
+    /** @brief Whether io_uring is used, rather than the thread pool. */
+    GASbool uring;
+    /** @brief Most files in flight at once. */
+    GASunum depth;
+    /** @brief Files added and not yet returned by gas_batch_next(). */
+    GASunum nb_pending;
+
+    GASvoid* user_data;
+
+    /** @brief Private state. */
+    struct GASbatch_state* state;
+} GASbatch;
+
+GASresult gas_batch_new (GASbatch** batch, GASunum depth, unsigned int flags,
+                         GASvoid* DEFAULT_NULL(user_data));
+GASresult gas_batch_destroy (GASbatch* b);
+
+GASresult gas_batch_add_path (GASbatch* b, const char* path,
+                              GASvoid* DEFAULT_NULL(tag));
+GASresult gas_batch_add_fd (GASbatch* b, int fd, GASvoid* DEFAULT_NULL(tag));
+
+GASresult gas_batch_next (GASbatch* b, GASbatch_result* done);
+GASresult gas_batch_run (GASbatch* b, GAS_ON_BATCH_RESULT on_result,
+                         GASvoid* DEFAULT_NULL(data));
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_BATCH_H defined */
+
+/* vim: set sw=4 fdm=marker :*/
@@ -27,6 +27,7 @@
 
 #include "tree.h"
 #include "bufio.h"
+#include "codec.h"
 
 #include <string.h>
 
@@ -40,77 +41,9 @@
  */
 GASnum gas_write_encoded_num_buf (GASubyte* buf, GASunum limit, GASunum value)
 {
-    GASunum off = 0;
-    GASunum i, coded_length;
-    GASubyte byte, mask;
-    GASunum zero_count, zero_bytes, zero_bits;
-    GASnum si;  /* a signed i */
-
     GAS_CHECK_PARAM(buf);
 
-    for (i = 1; 1; i++) {
-        if (value < ((1UL << (7UL*i))-1UL)) {
-            break;
-        }
-        if ((i * 7L) > (sizeof(GASunum) << 3)) {
-            /* warning, close to overflow */
-            /*i--;*/
-            break;
-        }
-    }
-    coded_length = i;  /* not including header */
-
-    zero_count = coded_length - 1;
-    zero_bytes = zero_count / 8;
-    zero_bits = zero_count % 8;
-
-    byte = 0x0;
-    for (i = 0; i < zero_bytes; i++) {
-        if (off >= limit) {
-            return GAS_ERR_UNKNOWN;
-        }
-        memcpy(buf+off, &byte, 1);
-        off++;
-    }
-
-    mask = 0x80;
-    mask >>= zero_bits;
-
-    /* write the first masked byte */
-    /*if ((coded_length - 1) <= sizeof(GASunum)) {*/
-    if (coded_length <= sizeof(GASunum)) {
-        byte = mask | ((value >> ((coded_length-zero_bytes-1)<<3)) & 0xff);
-    } else {
-        byte = mask;
-    }
-
-    if (off >= limit) {
-        return GAS_ERR_UNKNOWN;
-    }
-
-    memcpy(buf+off, &byte, 1);
-    off++;
-
-    /*
-     * write remaining bytes
-     * from coded length, subtract 1 byte because we count down to zero
-     * subtract an addition byte because one was already or'ed with the mask
-     *
-     * @internal
-     * @todo figure out why zero_bytes is subtracted
-     */
-    for (si = (GASnum)(coded_length - 2 - zero_bytes); si >= 0; si--) {
-        byte = (GASubyte)((value >> ((GASunum)si<<3)) & 0xffL);
-
-        if (off >= limit) {
-            return GAS_ERR_UNKNOWN;
-        }
-
-        memcpy(buf+off, &byte, 1);
-        off++;
-    }
-
-    return off;
+    return gas_codec_encode(buf, limit, value);
 }
 /*}}}*/
 /* gas_read_encoded_num_buf() {{{*/
@@ -126,59 +59,25 @@ GASnum gas_write_encoded_num_buf (GASubyte* buf, GASunum limit, GASunum value)
  */
 GASnum gas_read_encoded_num_buf (GASubyte* buf, GASunum limit, GASunum* result)
 {
-    GASunum offset;
-    GASunum i, zero_byte_count, first_bit_set;
-    GASubyte byte, mask = 0x00;
-    GASunum additional_bytes_to_read;
-
     GAS_CHECK_PARAM(buf);
     GAS_CHECK_PARAM(result);
 
-
-    offset = 0;
-
-    /* find first non 0x00 byte */
-    for (zero_byte_count = 0; 1; zero_byte_count++) {
-        byte = buf[offset++];
-        if (offset > limit) {
-            return GAS_ERR_UNKNOWN;
-        }
-        if (byte != 0x00)
-            break;
-    }
-
-    /* process initial byte */
-    for (first_bit_set = 7; first_bit_set >= 0; first_bit_set--)
-        if (byte & (1L << first_bit_set))
-            break;
-/*    assert(first_bit_set > 0);*/
-
-    for (i = 0; i < first_bit_set; i++)
-        mask |= (1L << i);
-
-    additional_bytes_to_read = (7-first_bit_set) + (7*zero_byte_count);
-
-    /* at this point, i have enough information to construct *result */
-    *result = mask & byte;
-    for (i = 0; i < additional_bytes_to_read; i++) {
-        byte = buf[offset++];
-        if (offset > limit) {
-            return GAS_ERR_UNKNOWN;
-        }
-        *result = (*result << 8) | byte;
-    }
-
-    return offset;
+    return gas_codec_decode(buf, limit, result);
 }
 /*}}}*/
 
 /* gas_write_buf() {{{*/
-#define write_field(field)                                                  \
+#define write_num(value)                                                    \
     do {                                                                    \
-        result = gas_write_encoded_num_buf(                                 \
-            buf+off, limit - off, self->field##_size);                      \
+        result = gas_codec_encode(buf + off, limit - off, value);           \
         if (result <= 0) { return result; }                                 \
         off += result;                                                      \
+    } while(0)
+
+#define write_field(field)                                                  \
+    do {                                                                    \
+        write_num(self->field##_size);                                      \
+        if (self->field##_size > limit - off) { return GAS_ERR_UNKNOWN; }   \
         memcpy(buf+off, self->field, self->field##_size);                   \
         off += self->field##_size;                                          \
     } while(0)
@@ -188,26 +87,27 @@ GASnum gas_read_encoded_num_buf (GASubyte* buf, GASunum limit, GASunum* result)
  */
 GASnum gas_write_buf (GASubyte* buf, GASunum limit, GASchunk* self)
 {
-    GASresult result;
+    GASnum result;
     GASunum i;
-    GASnum off = 0;
+    GASunum off = 0;
 
     GAS_CHECK_PARAM(buf);
     GAS_CHECK_PARAM(self);
-
+    /* children not read yet cannot be written, see @ref lazy */
+    if (self->lazy != NULL) { return GAS_ERR_INVALID_PARAM; }
 
     /* this GASchunk's size */
-    off += gas_write_encoded_num_buf(buf+off, limit - off, self->size);
+    write_num(self->size);
     write_field(id);
     /* attributes */
-    off += gas_write_encoded_num_buf(buf+off, limit - off, self->nb_attributes);
+    write_num(self->nb_attributes);
     for (i = 0; i < self->nb_attributes; i++) {
         write_field(attributes[i].key);
         write_field(attributes[i].value);
     }
     write_field(payload);
     /* children */
-    off += gas_write_encoded_num_buf(buf+off, limit - off, self->nb_children);
+    write_num(self->nb_children);
     for (i = 0; i < self->nb_children; i++) {
         result = gas_write_buf(buf + off, limit - off, self->children[i]);
         if (result <= 0) { return result; }
@@ -216,13 +116,111 @@ GASnum gas_write_buf (GASubyte* buf, GASunum limit, GASchunk* self)
 
     return off;
 }
+
+#undef write_field
+#undef write_num
+
+/*}}}*/
+/* gas_write_buf_update() {{{*/
+#define write_num(value)                                                    \
+    do {                                                                    \
+        length = gas_codec_length(value);                                   \
+        if (length > end) { return GAS_ERR_UNKNOWN; }                       \
+        end -= length;                                                      \
+        gas_codec_encode(buf + end, length, value);                         \
+    } while(0)
+
+#define write_field(field)                                                  \
+    do {                                                                    \
+        if (self->field##_size > end) { return GAS_ERR_UNKNOWN; }           \
+        end -= self->field##_size;                                          \
+        if (self->field##_size > 0) {                                       \
+            memcpy(buf + end, self->field, self->field##_size);             \
+        }                                                                   \
+        write_num(self->field##_size);                                      \
+    } while(0)
+
+/**
+ * @brief Write the chunk backwards, so that it ends at @a end.
+ *
+ * Children are written before the header that holds their parent's size, so
+ * every size is known by the time it is encoded.
+ *
+ * @return When positive, the number of bytes written.  Otherwise, an error
+ * code.
+ */
+static GASnum gas_write_buf_reverse (GASubyte* buf, GASunum end,
+                                     GASchunk* self)
+{
+    GASnum result;
+    GASunum i, length;
+    GASunum last = end;
+
+    GAS_CHECK_PARAM(self);
+    /* children not read yet cannot be written, see @ref lazy */
+    if (self->lazy != NULL) { return GAS_ERR_INVALID_PARAM; }
+
+    /* children */
+    for (i = self->nb_children; i > 0; i--) {
+        result = gas_write_buf_reverse(buf, end, self->children[i - 1]);
+        if (result <= 0) { return result; }
+        end -= result;
+    }
+    write_num(self->nb_children);
+    write_field(payload);
+    /* attributes */
+    for (i = self->nb_attributes; i > 0; i--) {
+        write_field(attributes[i - 1].value);
+        write_field(attributes[i - 1].key);
+    }
+    write_num(self->nb_attributes);
+    write_field(id);
+    /* this GASchunk's size */
+    self->size = last - end;
+    self->dirty = GAS_FALSE;
+    write_num(self->size);
+
+    return last - end;
+}
+
+#undef write_field
+#undef write_num
+
+/**
+ * @brief Write the chunk without a prior gas_update(), updating its sizes
+ * along the way.
+ *
+ * The tree is encoded from the end of @a buf towards its start in a single
+ * traversal, then moved to the start of @a buf.  The output is identical to
+ * gas_update() followed by gas_write_buf().
+ *
+ * @return When positive, the new buffer offset.  Otherwise, an error code.
+ */
+GASnum gas_write_buf_update (GASubyte* buf, GASunum limit, GASchunk* self)
+{
+    GASnum result;
+
+    GAS_CHECK_PARAM(buf);
+    GAS_CHECK_PARAM(self);
+
+    result = gas_write_buf_reverse(buf, limit, self);
+    if (result <= 0) {
+        return result;
+    }
+    memmove(buf, buf + limit - result, result);
+
+    return result;
+}
 /*}}}*/
 /* gas_read_buf() {{{*/
 
-#define read_field(field)                                                   \
+#define read_field(field, local)                                            \
     do {                                                                    \
         read_num(field##_size);                                             \
-        field = (GASubyte*)gas_alloc(field##_size + 1, user_data);          \
+        if (field##_size > limit - offset) {                                \
+            gas_destroy(c); return GAS_ERR_UNKNOWN;                         \
+        }                                                                   \
+        field = gas_field_alloc(local, field##_size, user_data);            \
         GAS_CHECK_MEM(field);                                               \
         memcpy(field, buf+offset, field##_size);                            \
         offset += field##_size;                                             \
@@ -230,15 +228,14 @@ GASnum gas_write_buf (GASubyte* buf, GASunum limit, GASchunk* self)
     } while (0)
 
 #define read_num(field)                                                     \
-    result = gas_read_encoded_num_buf(                                      \
-        buf + offset, limit - offset, &field);                              \
+    result = gas_codec_decode(buf + offset, limit - offset, &field);        \
     if (result <= 0) { gas_destroy(c); return result; }                     \
     offset += result;
 
 GASnum gas_read_buf (GASubyte* buf, GASunum limit, GASchunk** out,
                      GASvoid* user_data)
 {
-    GASresult result;
+    GASnum result;
     GASunum offset = 0;
     GASunum i;
     GASchunk* c = NULL;
@@ -251,24 +248,28 @@ GASnum gas_read_buf (GASubyte* buf, GASunum limit, GASchunk** out,
     }
 
     read_num(c->size);
-    read_field(c->id);
+    read_field(c->id, c->id_inline);
     read_num(c->nb_attributes);
     if (c->nb_attributes > 0) {
         c->attributes =
             (GASattribute*)gas_alloc(c->nb_attributes*sizeof(GASattribute),
                                      user_data);
         GAS_CHECK_MEM(c->attributes);
+        c->attributes_capacity = c->nb_attributes;
+        memset(c->attributes, 0, c->nb_attributes*sizeof(GASattribute));
     }
     for (i = 0; i < c->nb_attributes; i++) {
-        read_field(c->attributes[i].key);
-        read_field(c->attributes[i].value);
+        read_field(c->attributes[i].key, c->attributes[i].key_inline);
+        read_field(c->attributes[i].value,
+                   c->attributes[i].value_inline);
     }
-    read_field(c->payload);
+    read_field(c->payload, NULL);
     read_num(c->nb_children);
     if (c->nb_children > 0) {
         c->children = (GASchunk**)gas_alloc(c->nb_children * sizeof(GASchunk*),
                                             user_data);
         GAS_CHECK_MEM(c->children);
+        c->children_capacity = c->nb_children;
     }
     memset(c->children, 0, c->nb_children * sizeof(GASchunk*));
     for (i = 0; i < c->nb_children; i++) {
@@ -293,20 +294,22 @@ GASnum gas_read_buf (GASubyte* buf, GASunum limit, GASchunk** out,
 #define read_field(field)                                                   \
     do {                                                                    \
         read_num(field##_size);                                             \
+        if (field##_size > limit - offset) {                                \
+            gas_destroyn(c); return GAS_ERR_UNKNOWN;                        \
+        }                                                                   \
         field = buf + offset;                                               \
         offset += field##_size;                                             \
     } while (0)
 
 #define read_num(field)                                                     \
-    result = gas_read_encoded_num_buf(                                      \
-        buf + offset, limit - offset, &field);                              \
+    result = gas_codec_decode(buf + offset, limit - offset, &field);        \
     if (result <= 0) { gas_destroyn(c); return result; }                    \
     offset += result;
 
 GASnum gas_read_bufn (GASubyte* buf, GASunum limit, GASchunk** out,
                       GASvoid* user_data)
 {
-    GASresult result;
+    GASnum result;
     GASunum offset = 0;
     GASunum i;
     GASchunk* c = NULL;
@@ -326,6 +329,8 @@ GASnum gas_read_bufn (GASubyte* buf, GASunum limit, GASchunk** out,
             (GASattribute*)gas_alloc(c->nb_attributes*sizeof(GASattribute),
                                      user_data);
         GAS_CHECK_MEM(c->attributes);
+        c->attributes_capacity = c->nb_attributes;
+        memset(c->attributes, 0, c->nb_attributes*sizeof(GASattribute));
     }
     for (i = 0; i < c->nb_attributes; i++) {
         read_field(c->attributes[i].key);
@@ -337,6 +342,7 @@ GASnum gas_read_bufn (GASubyte* buf, GASunum limit, GASchunk** out,
         c->children = (GASchunk**)gas_alloc(c->nb_children * sizeof(GASchunk*),
                                             user_data);
         GAS_CHECK_MEM(c->children);
+        c->children_capacity = c->nb_children;
     }
     memset(c->children, 0, c->nb_children * sizeof(GASchunk*));
     for (i = 0; i < c->nb_children; i++) {
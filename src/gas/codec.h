@@ -0,0 +1,264 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file codec.h
+ * @brief gas number codec
+ *
+ * An encoded number of L bytes is the big endian integer (1 << 7L) | value,
+ * so the position of the highest set bit gives the length, and the remaining
+ * 7L bits hold the value (see doc/number-encoding.text).  Values whose bits
+ * are all ones are reserved, and pushed to the next length.
+ *
+ * Every io path (buffers, file descriptors, streams, the parser and writer,
+ * and the Qt wrapper) shares these routines.  They are header only, so that
+ * they inline into the hot loops.
+ */
+
+#ifndef GAS_CODEC_H
+#define GAS_CODEC_H
+
+#include "swap.h"
+
+#include <string.h>
+
+/**
+ * @defgroup codec Number Codec
+ * @ingroup io
+ */
+/*@{*/
+
+#ifdef GAS_INLINE
+#  define GAS_CODEC_INLINE static GAS_INLINE
+#else
+#  define GAS_CODEC_INLINE static
+#endif
+
+/**
+ * @brief The longest possible encoding of a GASunum, in bytes.
+ */
+#define GAS_CODEC_MAX_LENGTH ((GAS_SIZEOF_UNUM * 8) / 7 + 1)
+
+#if GAS_SIZEOF_UNUM == 8
+#  define gas_codec_swap(x) swap64(x)
+#else
+#  define gas_codec_swap(x) swap32(x)
+#endif
+
+/* gas_codec_msb() {{{*/
+/**
+ * @brief Index of the highest set bit of a non-zero byte.
+ */
+GAS_CODEC_INLINE int gas_codec_msb (GASubyte byte)
+{
+#if defined(__GNUC__)
+    return (int)(sizeof(unsigned int) * 8 - 1) - __builtin_clz(byte);
+#else
+    int i = 7;
+    while ((byte & (1 << i)) == 0) {
+        i--;
+    }
+    return i;
+#endif
+}
+/*}}}*/
+/* gas_codec_load() {{{*/
+/**
+ * @brief Load a full GASunum from @a buf, in network byte order.
+ */
+GAS_CODEC_INLINE GASunum gas_codec_load (const GASubyte* buf)
+{
+    GASunum word;
+    memcpy(&word, buf, sizeof(word));
+#if GAS_BIG_ENDIAN
+    return word;
+#else
+    return gas_codec_swap(word);
+#endif
+}
+/*}}}*/
+/* gas_codec_length() {{{*/
+/**
+ * @brief The number of bytes required to encode @a value.
+ */
+GAS_CODEC_INLINE GASunum gas_codec_length (GASunum value)
+{
+    GASunum bits;
+
+    /* all ones is reserved, so value + 1 must fit in 7 bits per byte */
+    value += 1;
+    if (value == 0) {
+        return GAS_CODEC_MAX_LENGTH;
+    }
+#if defined(__GNUC__) && GAS_USE_LONG_TYPES
+    bits = sizeof(GASunum) * 8 - __builtin_clzl(value);
+#elif defined(__GNUC__)
+    bits = sizeof(GASunum) * 8 - __builtin_clz(value);
+#else
+    for (bits = 0; value != 0; bits++) {
+        value >>= 1;
+    }
+#endif
+    return (bits + 6) / 7;
+}
+/*}}}*/
+/* gas_codec_peek_length() {{{*/
+/**
+ * @brief Determine the encoded length from the leading bytes of a number.
+ *
+ * Stream based readers fetch one byte, peek, and then fetch the remainder of
+ * the number with a single read.
+ *
+ * @return The full encoded length, or 0 when all @a avail bytes are leading
+ * zeros and more are needed.  Negative values are error codes.
+ */
+GAS_CODEC_INLINE GASnum gas_codec_peek_length (const GASubyte* buf,
+                                               GASunum avail)
+{
+    GASunum zero_bytes;
+    GASunum length;
+
+    for (zero_bytes = 0; zero_bytes < avail; zero_bytes++) {
+        if (buf[zero_bytes] != 0x00) {
+            break;
+        }
+        if ((zero_bytes + 1) * 8 >= GAS_CODEC_MAX_LENGTH) {
+            return GAS_ERR_OUT_OF_RANGE;
+        }
+    }
+    if (zero_bytes == avail) {
+        return 0;
+    }
+
+    length = (zero_bytes << 3) + 8 - gas_codec_msb(buf[zero_bytes]);
+    if (length > GAS_CODEC_MAX_LENGTH) {
+        return GAS_ERR_OUT_OF_RANGE;
+    }
+    return (GASnum)length;
+}
+/*}}}*/
+/* gas_codec_decode() {{{*/
+/**
+ * @brief Decode a number from the first @a limit bytes of @a buf.
+ *
+ * @return When positive, the number of bytes consumed.  Otherwise, an error
+ * code.
+ */
+GAS_CODEC_INLINE GASnum gas_codec_decode (const GASubyte* buf, GASunum limit,
+                                          GASunum* result)
+{
+    GASnum length;
+    GASunum value, i;
+
+    /* common case, a single load and shift */
+    if (limit >= GAS_SIZEOF_UNUM && buf[0] != 0x00) {
+        length = 8 - gas_codec_msb(buf[0]);
+        if (length <= GAS_SIZEOF_UNUM) {
+            value = gas_codec_load(buf) >> ((GAS_SIZEOF_UNUM - length) << 3);
+            *result = value & (((GASunum)1 << (7 * length)) - 1);
+            return length;
+        }
+    }
+
+    /* short buffers, leading zero bytes, and wide numbers */
+    length = gas_codec_peek_length(buf, limit);
+    if (length < 0) {
+        return length;
+    }
+    if (length == 0 || (GASunum)length > limit) {
+        return GAS_ERR_UNKNOWN;
+    }
+
+    i = (GASunum)(length - 1) >> 3;
+    value = buf[i] & (0x7f >> ((length - 1) & 7));
+    for (i++; i < (GASunum)length; i++) {
+        if ((value >> ((GAS_SIZEOF_UNUM - 1) << 3)) != 0) {
+            return GAS_ERR_OUT_OF_RANGE;
+        }
+        value = (value << 8) | buf[i];
+    }
+
+    *result = value;
+    return length;
+}
+/*}}}*/
+/* gas_codec_encode_fixed() {{{*/
+/**
+ * @brief Encode @a value in exactly @a length bytes of @a buf.
+ *
+ * Lengths beyond gas_codec_length() give a longer, equally valid encoding,
+ * which lets a number be reserved before its value is known.
+ *
+ * @return When positive, @a length.  Otherwise, an error code.
+ */
+GAS_CODEC_INLINE GASnum gas_codec_encode_fixed (GASubyte* buf, GASunum length,
+                                                GASunum value)
+{
+    GASunum word, i;
+
+    if (length < gas_codec_length(value) || length > GAS_CODEC_MAX_LENGTH) {
+        return GAS_ERR_OUT_OF_RANGE;
+    }
+
+    if (length <= GAS_SIZEOF_UNUM) {
+        word = (value | ((GASunum)1 << (7 * length)))
+            << ((GAS_SIZEOF_UNUM - length) << 3);
+#if !GAS_BIG_ENDIAN
+        word = gas_codec_swap(word);
+#endif
+        memcpy(buf, &word, length);
+        return (GASnum)length;
+    }
+
+    /* wider than a GASunum, leading bytes carry only the marker */
+    for (i = length; i > 0; i--) {
+        buf[i - 1] = (GASubyte)(value & 0xff);
+        value >>= 8;
+    }
+    buf[(length - 1) >> 3] |= 0x80 >> ((length - 1) & 7);
+
+    return (GASnum)length;
+}
+/*}}}*/
+/* gas_codec_encode() {{{*/
+/**
+ * @brief Encode @a value into the first @a limit bytes of @a buf.
+ *
+ * Exactly gas_codec_length() bytes are stored; nothing beyond them is
+ * touched.
+ *
+ * @return When positive, the number of bytes produced.  Otherwise, an error
+ * code.
+ */
+GAS_CODEC_INLINE GASnum gas_codec_encode (GASubyte* buf, GASunum limit,
+                                          GASunum value)
+{
+    GASunum length;
+
+    length = gas_codec_length(value);
+    if (length > limit) {
+        return GAS_ERR_UNKNOWN;
+    }
+
+    return gas_codec_encode_fixed(buf, length, value);
+}
+/*}}}*/
+
+/*@}*/
+
+#endif /* GAS_CODEC_H defined */
+
+/* vim: set sw=4 fdm=marker :*/
@@ -20,7 +20,9 @@
  */
 
 #include "context.h"
+#include "fdio.h"
 
+#include <limits.h>
 #include <string.h>
 
 #if HAVE_STDIO_H
@@ -28,18 +30,6 @@
 #endif
 
 #if HAVE_FPRINTF
-GASresult gas_default_open (const char *name, const char *mode,
-                            void **handle, void **userdata);
-GASresult gas_default_close (void *handle, void *userdata);
-GASresult gas_default_read (void *handle, void *buffer, unsigned int sizebytes,
-                            unsigned int *bytesread, void *userdata);
-GASresult gas_default_read (void *handle, void *buffer, unsigned int sizebytes,
-                            unsigned int *bytesread, void *userdata);
-GASresult gas_default_write (void *handle, void *buffer, unsigned int sizebytes,
-                             unsigned int *byteswritten, void *userdata);
-GASresult gas_default_seek (void *handle, unsigned long pos,
-                            int whence, void *userdata);
-
 /* default callbacks {{{*/
 GASresult gas_default_open (const char *name, const char *mode, void **handle, void **userdata)
 {
@@ -114,6 +104,52 @@ GASresult gas_default_seek (void *handle, unsigned long pos,
 
     return GAS_OK;
 }
+
+/**
+ * @brief Flushes the stream, then hands the whole list to writev() on its
+ * descriptor.  Without writev(), the buffers are written one by one.
+ */
+GASresult gas_default_writev (void *handle, const GASiovec *iov,
+                              unsigned int iovcnt,
+                              unsigned long *byteswritten, void *userdata)
+{
+#if HAVE_SYS_UIO_H && HAVE_UNISTD_H
+    GASresult result;
+    GASunum written = 0;
+
+    if (!handle) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    if (fflush((FILE *)handle) != 0) {
+        return GAS_ERR_UNKNOWN;
+    }
+    result = gas_writev_fd(fileno((FILE *)handle), iov, iovcnt, &written);
+    if (byteswritten) {
+        *byteswritten = written;
+    }
+    return result;
+#else
+    unsigned int i;
+    unsigned long written = 0;
+
+    if (!handle) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        if (fwrite(iov[i].iov_base, 1, iov[i].iov_len, (FILE *)handle)
+            != iov[i].iov_len) {
+            return GAS_ERR_UNKNOWN;
+        }
+        written += iov[i].iov_len;
+    }
+    if (byteswritten) {
+        *byteswritten = written;
+    }
+    return GAS_OK;
+#endif
+}
 /*}}}*/
 
 #endif /* HAVE_FPRINTF */
@@ -135,9 +171,20 @@ GASresult gas_context_new (GAScontext** ctx_out, GASvoid* user_data)/*{{{*/
     ctx->write     = gas_default_write;
     ctx->seek      = gas_default_seek;
     ctx->user_data = NULL;
+    /* no writev nor 64 bit defaults, as contexts overriding open, read or
+     * write would be bypassed by them */
+    ctx->writev    = NULL;
+    ctx->read64    = NULL;
+    ctx->write64   = NULL;
+    ctx->seek64    = NULL;
+    ctx->readv     = NULL;
+    ctx->pread     = NULL;
+    ctx->pwrite    = NULL;
+    ctx->borrow    = NULL;
 #else
     memset(ctx, 0, sizeof(GAScontext));
 #endif
+    ctx->version = GAS_CONTEXT_VERSION;
 
     *ctx_out = ctx;
 
@@ -153,4 +200,113 @@ GASresult gas_context_destroy (GAScontext* s, GASvoid* user_data)/*{{{*/
     return GAS_OK;
 }/*}}}*/
 
+/** @name sized io */
+/*@{*/
+/* gas_context_read() {{{*/
+/**
+ * @brief Read up to @a size bytes, in one call of the context.
+ *
+ * As with the callbacks, fewer bytes may be read: without read64, at most
+ * UINT_MAX at a time.
+ */
+GASresult gas_context_read (GAScontext* ctx, GASvoid* handle, GASvoid* buffer,
+                            GASunum size, GASunum* bytes_read)
+{
+    GASresult result;
+    size_t done = 0;
+    unsigned int piece = 0;
+
+    GAS_CHECK_PARAM(ctx);
+    GAS_CHECK_PARAM(bytes_read);
+
+    if (gas_context_has(ctx, read64)) {
+        result = ctx->read64(handle, buffer, size, &done, ctx->user_data);
+        *bytes_read = done;
+        return result;
+    }
+
+    if (size > UINT_MAX) {
+        size = UINT_MAX;
+    }
+    result = ctx->read(handle, buffer, (unsigned int)size, &piece,
+                       ctx->user_data);
+    *bytes_read = piece;
+    return result;
+}
+/*}}}*/
+/* gas_context_write() {{{*/
+/**
+ * @brief Write all @a size bytes, or fail.
+ *
+ * Contexts without a write callback fail with GAS_ERR_UNKNOWN.
+ */
+GASresult gas_context_write (GAScontext* ctx, GASvoid* handle,
+                             const GASvoid* buffer, GASunum size)
+{
+    GASresult result;
+    const GASubyte* in = (const GASubyte*)buffer;
+    size_t done = 0;
+    unsigned int piece;
+
+    GAS_CHECK_PARAM(ctx);
+
+    if (gas_context_has(ctx, write64)) {
+        result = ctx->write64(handle, buffer, size, &done, ctx->user_data);
+        if (result == GAS_OK && done != size) {
+            return GAS_ERR_UNKNOWN;
+        }
+        return result;
+    }
+    if (ctx->write == NULL) {
+        /* a read only context */
+        return GAS_ERR_UNKNOWN;
+    }
+
+    while (size > 0) {
+        piece = size > UINT_MAX ? UINT_MAX : (unsigned int)size;
+        done = piece;
+        result = ctx->write(handle, (GASvoid*)in, piece, &piece,
+                            ctx->user_data);
+        if (result != GAS_OK) { return result; }
+        if (piece != done) {
+            return GAS_ERR_UNKNOWN;
+        }
+        in += piece;
+        size -= piece;
+    }
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_context_seek() {{{*/
+/**
+ * @brief Seek to @a pos, relative to @a whence.
+ *
+ * Without seek64, positions past ULONG_MAX are reached in steps, which is
+ * not possible from the end.
+ */
+GASresult gas_context_seek (GAScontext* ctx, GASvoid* handle, GASunum pos,
+                            int whence)
+{
+    GASresult result;
+
+    GAS_CHECK_PARAM(ctx);
+
+    if (gas_context_has(ctx, seek64)) {
+        return ctx->seek64(handle, (int64_t)pos, whence, ctx->user_data);
+    }
+
+    while (pos > ULONG_MAX) {
+        if (whence == GAS_SEEK_END) {
+            return GAS_ERR_OUT_OF_RANGE;
+        }
+        result = ctx->seek(handle, ULONG_MAX, whence, ctx->user_data);
+        if (result != GAS_OK) { return result; }
+        pos -= ULONG_MAX;
+        whence = GAS_SEEK_CUR;
+    }
+    return ctx->seek(handle, (unsigned long)pos, whence, ctx->user_data);
+}
+/*}}}*/
+/*@}*/
+
 /* vim: set sw=4 fdm=marker :*/
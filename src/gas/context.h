@@ -24,6 +24,10 @@
 #ifndef GAS_SESSION_H
 #define GAS_SESSION_H
 
+#if HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -45,6 +49,32 @@ typedef GASresult (*GAS_FILE_WRITE_CALLBACK) (void *handle, void *buffer,
                                               unsigned int sizebytes,
                                               unsigned int *byteswritten,
                                               void *userdata);
+/**
+ * @brief One buffer of a vectored write.
+ *
+ * Where available, this is struct iovec, so that lists may be handed to
+ * writev() directly.
+ */
+#if HAVE_SYS_UIO_H
+typedef struct iovec GASiovec;
+#else
+typedef struct
+{
+    void *iov_base;
+    GASunum iov_len;
+} GASiovec;
+#endif
+
+/**
+ * @brief Writes a list of buffers, in order, as with writev().
+ *
+ * The callback must write every buffer in full, or fail.
+ */
+typedef GASresult (*GAS_FILE_WRITEV_CALLBACK) (void *handle,
+                                               const GASiovec *iov,
+                                               unsigned int iovcnt,
+                                               unsigned long *byteswritten,
+                                               void *userdata);
 /**
  * @brief provides the ability to seek forward (GAS_SEEK_CUR).
  */
@@ -53,6 +83,66 @@ typedef GASresult (*GAS_FILE_SEEK_CALLBACK)  (void *handle,
                                               int whence,
                                               void *userdata);
 
+/**
+ * @name 64 bit callbacks
+ * @brief Optional callbacks of GAS_CONTEXT_VERSION contexts.
+ *
+ * They take full size_t sizes and uint64_t offsets, and report the bytes
+ * transferred through @a done.  A short read returns GAS_OK, or
+ * GAS_ERR_FILE_EOF at the end of the input; writes transfer everything or
+ * fail.
+ */
+/*@{*/
+typedef GASresult (*GAS_FILE_READ64_CALLBACK)  (void *handle, void *buffer,
+                                                size_t size, size_t *done,
+                                                void *userdata);
+typedef GASresult (*GAS_FILE_WRITE64_CALLBACK) (void *handle,
+                                                const void *buffer,
+                                                size_t size, size_t *done,
+                                                void *userdata);
+typedef GASresult (*GAS_FILE_SEEK64_CALLBACK)  (void *handle, int64_t pos,
+                                                int whence, void *userdata);
+/**
+ * @brief Reads into a list of buffers, in order, as with readv().
+ */
+typedef GASresult (*GAS_FILE_READV_CALLBACK)   (void *handle,
+                                                const GASiovec *iov,
+                                                unsigned int iovcnt,
+                                                size_t *done,
+                                                void *userdata);
+/**
+ * @brief Reads at @a offset without moving the handle, as with pread().
+ */
+typedef GASresult (*GAS_FILE_PREAD_CALLBACK)   (void *handle, void *buffer,
+                                                size_t size, uint64_t offset,
+                                                size_t *done, void *userdata);
+/**
+ * @brief Writes at @a offset without moving the handle, as with pwrite().
+ */
+typedef GASresult (*GAS_FILE_PWRITE_CALLBACK)  (void *handle,
+                                                const void *buffer,
+                                                size_t size, uint64_t offset,
+                                                size_t *done, void *userdata);
+/**
+ * @brief Lends the @a size bytes of input at @a offset, rather than copying
+ * them, as a mapping can.
+ *
+ * The bytes stay valid, and must not be changed, until the handle is closed.
+ */
+typedef GASresult (*GAS_FILE_BORROW_CALLBACK)  (void *handle, uint64_t offset,
+                                                size_t size,
+                                                const void **data,
+                                                void *userdata);
+/*@}*/
+
+/**
+ * @brief Version of GAScontext filled in by gas_context_new().
+ *
+ * Version 0 contexts end at GAScontext::writev, so that contexts initialised
+ * member by member, or in full, before the version existed still work.
+ */
+#define GAS_CONTEXT_VERSION 1
+
 typedef struct
 {
     GAS_FILE_OPEN_CALLBACK  open;
@@ -61,11 +151,91 @@ typedef struct
     GAS_FILE_WRITE_CALLBACK write;
     GAS_FILE_SEEK_CALLBACK  seek;
     void *user_data;
+
+    /**
+     * @brief Optional, used by the writer to flush many buffers at once.
+     *
+     * When NULL, the context is not vectored, and each buffer goes through
+     * write instead.  gas_context_new() leaves it NULL; contexts keeping the
+     * default open and write may set it to gas_default_writev().
+     */
+    GAS_FILE_WRITEV_CALLBACK writev;
+
+    /**
+     * @brief GAS_CONTEXT_VERSION, or 0 when the members below are absent.
+     */
+    unsigned int version;
+
+    /**
+     * @name version 1
+     * @brief Optional, each NULL falls back to the callbacks above.
+     *
+     * read64, write64 and seek64 replace read, write and seek.  The parser
+     * reads through pread when present, tracking GASparser::offset itself,
+     * and otherwise through readv, to fill its read-ahead buffer in the
+     * same call as a large field.  The emitter patches sizes with pwrite
+     * rather than seeking back and forth.  borrow is used by parsers with
+     * GASparser::borrow set.
+     */
+    /*@{*/
+    GAS_FILE_READ64_CALLBACK  read64;
+    GAS_FILE_WRITE64_CALLBACK write64;
+    GAS_FILE_SEEK64_CALLBACK  seek64;
+    GAS_FILE_READV_CALLBACK   readv;
+    GAS_FILE_PREAD_CALLBACK   pread;
+    GAS_FILE_PWRITE_CALLBACK  pwrite;
+    GAS_FILE_BORROW_CALLBACK  borrow;
+    /*@}*/
 } GAScontext;
 
+/**
+ * @brief Whether @a ctx has the version 1 callback @a member.
+ */
+#define gas_context_has(ctx, member) \
+    ((ctx)->version >= 1 && (ctx)->member != NULL)
+
 GASresult gas_context_new (GAScontext** ctx, GASvoid* DEFAULT_NULL(user_data));
 GASresult gas_context_destroy (GAScontext* s, GASvoid* DEFAULT_NULL(user_data));
 
+/**
+ * @name sized io
+ * @brief Use the 64 bit callbacks when present, or else the original ones,
+ * in pieces they can take.
+ */
+/*@{*/
+GASresult gas_context_read (GAScontext* ctx, GASvoid* handle, GASvoid* buffer,
+                            GASunum size, GASunum* bytes_read);
+GASresult gas_context_write (GAScontext* ctx, GASvoid* handle,
+                             const GASvoid* buffer, GASunum size);
+GASresult gas_context_seek (GAScontext* ctx, GASvoid* handle, GASunum pos,
+                            int whence);
+/*@}*/
+
+#if HAVE_FPRINTF || defined(DOXYGEN)
+/**
+ * @name default callbacks
+ * @brief stdio based callbacks, installed by gas_context_new().
+ *
+ * gas_default_writev() expects the FILE handles of gas_default_open(), so it
+ * is not installed, and is only set alongside gas_default_open() and
+ * gas_default_write().
+ */
+/*@{*/
+GASresult gas_default_open (const char *name, const char *mode,
+                            void **handle, void **userdata);
+GASresult gas_default_close (void *handle, void *userdata);
+GASresult gas_default_read (void *handle, void *buffer, unsigned int sizebytes,
+                            unsigned int *bytesread, void *userdata);
+GASresult gas_default_write (void *handle, void *buffer, unsigned int sizebytes,
+                             unsigned int *byteswritten, void *userdata);
+GASresult gas_default_seek (void *handle, unsigned long pos,
+                            int whence, void *userdata);
+GASresult gas_default_writev (void *handle, const GASiovec *iov,
+                              unsigned int iovcnt,
+                              unsigned long *byteswritten, void *userdata);
+/*@}*/
+#endif
+
 
 /*@}*/
 
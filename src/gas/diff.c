@@ -0,0 +1,686 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file diff.c
+ * @brief tree difference implementation
+ */
+
+#include "diff.h"
+#include "codec.h"
+
+#include <string.h>
+
+/**
+ * @brief How many children gas_diff() looks past a changed one, for
+ * children inserted or removed before it.
+ */
+#define GAS_DIFF_LOOKAHEAD 8
+
+/** @name helpers */
+/*@{*/
+/* gas_bytes_equal() {{{*/
+static GASbool gas_bytes_equal (const GASubyte* a, GASunum a_size,
+                                const GASubyte* b, GASunum b_size)
+{
+    if (a_size != b_size) {
+        return GAS_FALSE;
+    }
+    if (a_size == 0 || a == b) {
+        return GAS_TRUE;
+    }
+    /* a payload left to the writer's callback */
+    if (a == NULL || b == NULL) {
+        return GAS_FALSE;
+    }
+    return memcmp(a, b, a_size) == 0;
+}
+/*}}}*/
+/* gas_attributes_equal() {{{*/
+static GASbool gas_attributes_equal (GASchunk* a, GASchunk* b)
+{
+    GASattribute *x, *y;
+    GASunum i;
+
+    if (a->nb_attributes != b->nb_attributes) {
+        return GAS_FALSE;
+    }
+    for (i = 0; i < a->nb_attributes; i++) {
+        x = &a->attributes[i];
+        y = &b->attributes[i];
+        if (!gas_bytes_equal(x->key, x->key_size, y->key, y->key_size) ||
+            !gas_bytes_equal(x->value, x->value_size, y->value, y->value_size))
+        {
+            return GAS_FALSE;
+        }
+    }
+    return GAS_TRUE;
+}
+/*}}}*/
+/* gas_keys_unique() {{{*/
+static GASbool gas_keys_unique (GASchunk* c)
+{
+    GASattribute* a;
+    GASunum i;
+
+    for (i = 0; i < c->nb_attributes; i++) {
+        a = &c->attributes[i];
+        if (gas_index_of_attribute(c, a->key, a->key_size) != (GASnum)i) {
+            return GAS_FALSE;
+        }
+    }
+    return GAS_TRUE;
+}
+/*}}}*/
+/* gas_copy_tree() {{{*/
+/**
+ * @brief A deep copy of @a c, allocated with @a user_data.
+ */
+static GASresult gas_copy_tree (GASchunk* c, GASvoid* user_data,
+                                GASchunk** copy)
+{
+    GASchunk *d, *child;
+    GASattribute* a;
+    GASresult result;
+    GASunum i;
+
+    result = gas_new(&d, c->id, c->id_size, user_data);
+    if (result != GAS_OK) { return result; }
+
+    result = gas_reserve_attributes(d, c->nb_attributes);
+    if (result != GAS_OK) { goto abort; }
+    for (i = 0; i < c->nb_attributes; i++) {
+        a = &c->attributes[i];
+        result = gas_append_attribute(d, a->key, a->key_size,
+                                      a->value, a->value_size);
+        if (result != GAS_OK) { goto abort; }
+    }
+
+    if (c->payload != NULL || c->payload_size > 0) {
+        result = gas_set_payload(d, c->payload, c->payload_size);
+        if (result != GAS_OK) { goto abort; }
+    }
+
+    result = gas_reserve_children(d, c->nb_children);
+    if (result != GAS_OK) { goto abort; }
+    for (i = 0; i < c->nb_children; i++) {
+        if (c->children[i] == NULL) {
+            /* pruned by the parser */
+            continue;
+        }
+        result = gas_copy_tree(c->children[i], user_data, &child);
+        if (result != GAS_OK) { goto abort; }
+        result = gas_add_child(d, child);
+        if (result != GAS_OK) {
+            gas_destroy(child);
+            goto abort;
+        }
+    }
+
+    *copy = d;
+    return GAS_OK;
+
+abort:
+    gas_destroy(d);
+    return result;
+}
+/*}}}*/
+/*@}*/
+
+/* gas_equal() {{{*/
+/**
+ * @brief Checks to see if two trees have the same ids, attributes, payloads
+ * and children, in the same order.
+ */
+GASbool gas_equal (GASchunk* a, GASchunk* b)
+{
+    GASunum i;
+
+    if (a == b) {
+        /* also shared subtrees */
+        return GAS_TRUE;
+    }
+    if (a == NULL || b == NULL) {
+        return GAS_FALSE;
+    }
+    if ((!a->dirty && !b->dirty && a->size != b->size) ||
+        a->nb_attributes != b->nb_attributes ||
+        a->nb_children != b->nb_children ||
+        !gas_bytes_equal(a->id, a->id_size, b->id, b->id_size) ||
+        !gas_bytes_equal(a->payload, a->payload_size,
+                         b->payload, b->payload_size))
+    {
+        return GAS_FALSE;
+    }
+
+    if (!gas_attributes_equal(a, b)) {
+        return GAS_FALSE;
+    }
+    for (i = 0; i < a->nb_children; i++) {
+        if (!gas_equal(a->children[i], b->children[i])) {
+            return GAS_FALSE;
+        }
+    }
+
+    return GAS_TRUE;
+}
+/*}}}*/
+
+/** @name diff */
+/*@{*/
+/* gas_diff_new_op() {{{*/
+static GASresult gas_diff_new_op (GASchunk* ops, const GASchar* name,
+                                  GASchunk** op)
+{
+    return gas_new_named(op, name, ops->user_data);
+}
+/*}}}*/
+/* gas_diff_add_op() {{{*/
+/**
+ * @brief Append @a op to @a ops, or release it on failure.
+ */
+static GASresult gas_diff_add_op (GASchunk* ops, GASchunk* op)
+{
+    GASresult result;
+
+    result = gas_add_child(ops, op);
+    if (result != GAS_OK) {
+        gas_destroy(op);
+    }
+    return result;
+}
+/*}}}*/
+/* gas_diff_op() {{{*/
+/**
+ * @brief Append an operation named @a name to @a ops.
+ */
+static GASresult gas_diff_op (GASchunk* ops, const GASchar* name,
+                              GASchunk** op)
+{
+    GASresult result;
+
+    result = gas_diff_new_op(ops, name, op);
+    if (result != GAS_OK) { return result; }
+    return gas_diff_add_op(ops, *op);
+}
+/*}}}*/
+/* gas_diff_set_index() {{{*/
+static GASresult gas_diff_set_index (GASchunk* op, GASunum index)
+{
+    GASubyte buf[GAS_CODEC_MAX_LENGTH];
+    GASnum length;
+
+    length = gas_codec_encode(buf, sizeof(buf), index);
+    if (length < 0) { return length; }
+    return gas_set_payload(op, buf, length);
+}
+/*}}}*/
+/* gas_diff_subtree_op() {{{*/
+/**
+ * @brief Append an "insert" or "replace" of @a index, carrying a copy of
+ * @a c.
+ */
+static GASresult gas_diff_subtree_op (GASchunk* ops, const GASchar* name,
+                                      GASunum index, GASchunk* c)
+{
+    GASchunk *op, *copy;
+    GASresult result;
+
+    result = gas_diff_op(ops, name, &op);
+    if (result != GAS_OK) { return result; }
+    result = gas_diff_set_index(op, index);
+    if (result != GAS_OK) { return result; }
+
+    result = gas_copy_tree(c, ops->user_data, &copy);
+    if (result != GAS_OK) { return result; }
+    return gas_diff_add_op(op, copy);
+}
+/*}}}*/
+/* gas_diff_attributes() {{{*/
+static GASresult gas_diff_attributes (GASchunk* from, GASchunk* to,
+                                      GASchunk* ops)
+{
+    GASchunk *set = NULL, *unset = NULL, *all;
+    GASattribute *a, *b;
+    GASbool in_place;
+    GASresult result;
+    GASnum index;
+    GASunum i, j;
+
+    /*
+     * "unset" and "set" only do when the kept keys stay in order, with the
+     * new keys after them.  Otherwise, send the lot.
+     */
+    in_place = gas_keys_unique(from) && gas_keys_unique(to);
+    for (i = 0, j = 0; in_place && i < from->nb_attributes; i++) {
+        a = &from->attributes[i];
+        index = gas_index_of_attribute(to, a->key, a->key_size);
+        if (index >= 0) {
+            in_place = (GASunum)index == j;
+            j++;
+        }
+    }
+    for (; in_place && j < to->nb_attributes; j++) {
+        b = &to->attributes[j];
+        in_place = !gas_has_attribute(from, b->key, b->key_size);
+    }
+
+    if (!in_place) {
+        if (gas_attributes_equal(from, to)) {
+            return GAS_OK;
+        }
+        result = gas_diff_op(ops, "attributes", &all);
+        if (result != GAS_OK) { return result; }
+        result = gas_reserve_attributes(all, to->nb_attributes);
+        if (result != GAS_OK) { return result; }
+        for (j = 0; j < to->nb_attributes; j++) {
+            b = &to->attributes[j];
+            result = gas_append_attribute(all, b->key, b->key_size,
+                                          b->value, b->value_size);
+            if (result != GAS_OK) { return result; }
+        }
+        return GAS_OK;
+    }
+
+    for (i = 0; i < from->nb_attributes; i++) {
+        a = &from->attributes[i];
+        if (gas_has_attribute(to, a->key, a->key_size)) {
+            continue;
+        }
+        if (unset == NULL) {
+            result = gas_diff_op(ops, "unset", &unset);
+            if (result != GAS_OK) { return result; }
+        }
+        result = gas_append_attribute(unset, a->key, a->key_size, "", 0);
+        if (result != GAS_OK) { return result; }
+    }
+
+    for (j = 0; j < to->nb_attributes; j++) {
+        b = &to->attributes[j];
+        index = gas_index_of_attribute(from, b->key, b->key_size);
+        if (index >= 0) {
+            a = &from->attributes[index];
+            if (gas_bytes_equal(a->value, a->value_size,
+                                b->value, b->value_size)) {
+                continue;
+            }
+        }
+        if (set == NULL) {
+            result = gas_diff_op(ops, "set", &set);
+            if (result != GAS_OK) { return result; }
+        }
+        result = gas_append_attribute(set, b->key, b->key_size,
+                                      b->value, b->value_size);
+        if (result != GAS_OK) { return result; }
+    }
+
+    return GAS_OK;
+}
+/*}}}*/
+static GASresult gas_diff_chunk (GASchunk* from, GASchunk* to, GASchunk* ops);
+/* gas_diff_child() {{{*/
+/**
+ * @brief Append the operations turning child @a index, @a from, into @a to.
+ *
+ * A child with another id, or changed so much that describing the change
+ * takes more room than the child itself, is replaced whole.
+ */
+static GASresult gas_diff_child (GASchunk* from, GASchunk* to, GASunum index,
+                                 GASchunk* ops)
+{
+    GASchunk* op;
+    GASresult result;
+
+    if (gas_equal(from, to)) {
+        return GAS_OK;
+    }
+    if (from == NULL || to == NULL ||
+        !gas_bytes_equal(from->id, from->id_size, to->id, to->id_size))
+    {
+        goto replace;
+    }
+
+    result = gas_diff_new_op(ops, "child", &op);
+    if (result != GAS_OK) { return result; }
+    result = gas_diff_set_index(op, index);
+    if (result == GAS_OK) {
+        result = gas_diff_chunk(from, to, op);
+    }
+    if (result == GAS_OK) {
+        result = gas_update(op);
+    }
+    if (result != GAS_OK) {
+        gas_destroy(op);
+        return result;
+    }
+    if (op->size < to->size) {
+        return gas_diff_add_op(ops, op);
+    }
+    gas_destroy(op);
+
+replace:
+    if (to == NULL) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+    return gas_diff_subtree_op(ops, "replace", index, to);
+}
+/*}}}*/
+/* gas_diff_resync() {{{*/
+/**
+ * @brief Look a few children ahead for where @a a and @a b agree again.
+ *
+ * @return Whether they do, after @a *removed children of @a a, or after
+ * @a *inserted children of @a b.
+ */
+static GASbool gas_diff_resync (GASchunk** a, GASunum m, GASchunk** b,
+                                GASunum n, GASunum* removed,
+                                GASunum* inserted)
+{
+    GASunum d;
+
+    *removed = *inserted = 0;
+    for (d = 1; d <= GAS_DIFF_LOOKAHEAD; d++) {
+        if (d < n && gas_equal(a[0], b[d])) {
+            *inserted = d;
+            return GAS_TRUE;
+        }
+        if (d < m && gas_equal(a[d], b[0])) {
+            *removed = d;
+            return GAS_TRUE;
+        }
+    }
+    return GAS_FALSE;
+}
+/*}}}*/
+/* gas_diff_children() {{{*/
+static GASresult gas_diff_children (GASchunk* from, GASchunk* to,
+                                    GASchunk* ops)
+{
+    GASchunk **a = from->children, **b = to->children;
+    GASunum m = from->nb_children, n = to->nb_children;
+    GASunum i, j, last, removed, inserted;
+    GASresult result;
+    GASchunk* op;
+
+    /* the unchanged tail needs no visit */
+    for (last = 0; last < m && last < n; last++) {
+        if (!gas_equal(a[m - 1 - last], b[n - 1 - last])) {
+            break;
+        }
+    }
+    m -= last;
+    n -= last;
+
+    /*
+     * The target holds b[0, j) followed by a[i, m) at each step, so the
+     * next operation applies at j.
+     */
+    i = j = 0;
+    while (i < m || j < n) {
+        removed = inserted = 0;
+        if (i == m) {
+            inserted = 1;
+        } else if (j == n) {
+            removed = 1;
+        } else if (gas_equal(a[i], b[j])) {
+            i++;
+            j++;
+            continue;
+        } else if (!gas_diff_resync(&a[i], m - i, &b[j], n - j,
+                                    &removed, &inserted)) {
+            result = gas_diff_child(a[i], b[j], j, ops);
+            if (result != GAS_OK) { return result; }
+            i++;
+            j++;
+            continue;
+        }
+
+        for (; removed > 0; removed--, i++) {
+            result = gas_diff_op(ops, "remove", &op);
+            if (result != GAS_OK) { return result; }
+            result = gas_diff_set_index(op, j);
+            if (result != GAS_OK) { return result; }
+        }
+        for (; inserted > 0; inserted--, j++) {
+            if (b[j] == NULL) {
+                return GAS_ERR_INVALID_PARAM;
+            }
+            result = gas_diff_subtree_op(ops, "insert", j, b[j]);
+            if (result != GAS_OK) { return result; }
+        }
+    }
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_diff_chunk() {{{*/
+/**
+ * @brief Append to @a ops the operations turning @a from into @a to.
+ */
+static GASresult gas_diff_chunk (GASchunk* from, GASchunk* to, GASchunk* ops)
+{
+    GASchunk* op;
+    GASresult result;
+
+    if (!gas_bytes_equal(from->id, from->id_size, to->id, to->id_size)) {
+        result = gas_diff_op(ops, "id", &op);
+        if (result != GAS_OK) { return result; }
+        result = gas_set_payload(op, to->id != NULL ? to->id : (GASubyte*)"",
+                                 to->id_size);
+        if (result != GAS_OK) { return result; }
+    }
+
+    result = gas_diff_attributes(from, to, ops);
+    if (result != GAS_OK) { return result; }
+
+    if (!gas_bytes_equal(from->payload, from->payload_size,
+                         to->payload, to->payload_size))
+    {
+        result = gas_diff_op(ops, "payload", &op);
+        if (result != GAS_OK) { return result; }
+        result = gas_set_payload(op, to->payload, to->payload_size);
+        if (result != GAS_OK) { return result; }
+    }
+
+    return gas_diff_children(from, to, ops);
+}
+/*}}}*/
+/* gas_diff() {{{*/
+/**
+ * @brief Build the patch turning @a old_tree into @a new_tree.
+ *
+ * The sizes of both trees are brought up to date.  The patch shares nothing
+ * with either tree, and is allocated with @a user_data.
+ *
+ * @see gas_patch()
+ */
+GASresult gas_diff (GASchunk* old_tree, GASchunk* new_tree, GASchunk** patch,
+                    GASvoid* user_data)
+{
+    GASchunk* p;
+    GASresult result;
+
+    GAS_CHECK_PARAM(old_tree);
+    GAS_CHECK_PARAM(new_tree);
+    GAS_CHECK_PARAM(patch);
+
+    /* sizes rule out most unequal subtrees, and weigh ops against copies */
+    result = gas_update(old_tree);
+    if (result != GAS_OK) { return result; }
+    result = gas_update(new_tree);
+    if (result != GAS_OK) { return result; }
+
+    result = gas_new_named(&p, "patch", user_data);
+    if (result != GAS_OK) { return result; }
+    result = gas_diff_chunk(old_tree, new_tree, p);
+    if (result != GAS_OK) {
+        gas_destroy(p);
+        return result;
+    }
+
+    *patch = p;
+    return GAS_OK;
+}
+/*}}}*/
+/*@}*/
+
+/** @name patch */
+/*@{*/
+/* gas_patch_index() {{{*/
+static GASresult gas_patch_index (GASchunk* op, GASunum* index)
+{
+    GASnum length;
+
+    if (op->payload == NULL) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+    length = gas_codec_decode(op->payload, op->payload_size, index);
+    if (length < 0) { return length; }
+    if ((GASunum)length != op->payload_size) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_patch_insert() {{{*/
+/**
+ * @brief Insert a copy of the only child of @a op at @a index.
+ */
+static GASresult gas_patch_insert (GASchunk* c, GASunum index, GASchunk* op)
+{
+    GASchunk* child;
+    GASresult result;
+
+    if (index > c->nb_children) {
+        return GAS_ERR_OUT_OF_RANGE;
+    }
+    if (op->nb_children != 1 || op->children[0] == NULL) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    result = gas_copy_tree(op->children[0], c->user_data, &child);
+    if (result != GAS_OK) { return result; }
+    result = gas_add_child(c, child);
+    if (result != GAS_OK) {
+        gas_destroy(child);
+        return result;
+    }
+
+    /* rotate it into place, the sizes do not depend on the order */
+    memmove(&c->children[index + 1], &c->children[index],
+            (c->nb_children - 1 - index) * sizeof(GASchunk*));
+    c->children[index] = child;
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_patch_chunk() {{{*/
+static GASresult gas_patch_chunk (GASchunk* c, GASchunk* ops)
+{
+    GASchunk *op, *child;
+    GASattribute* a;
+    GASresult result;
+    GASnum found;
+    GASunum i, j, index;
+
+    for (i = 0; i < ops->nb_children; i++) {
+        op = ops->children[i];
+        if (op == NULL) {
+            return GAS_ERR_INVALID_PARAM;
+        }
+
+        if (gas_id_is(op, "id")) {
+            result = gas_set_id(c, op->payload != NULL ? op->payload
+                                                       : (GASubyte*)"",
+                                op->payload_size);
+        } else if (gas_id_is(op, "payload")) {
+            result = gas_set_payload(c, op->payload, op->payload_size);
+        } else if (gas_id_is(op, "set")) {
+            result = gas_reserve_attributes(c, op->nb_attributes);
+            for (j = 0; result == GAS_OK && j < op->nb_attributes; j++) {
+                a = &op->attributes[j];
+                result = gas_set_attribute(c, a->key, a->key_size,
+                                           a->value, a->value_size);
+            }
+        } else if (gas_id_is(op, "unset")) {
+            result = GAS_OK;
+            for (j = 0; result == GAS_OK && j < op->nb_attributes; j++) {
+                a = &op->attributes[j];
+                found = gas_index_of_attribute(c, a->key, a->key_size);
+                result = found < 0 ? found : gas_delete_attribute_at(c, found);
+            }
+        } else if (gas_id_is(op, "attributes")) {
+            result = GAS_OK;
+            while (result == GAS_OK && c->nb_attributes > 0) {
+                result = gas_delete_attribute_at(c, c->nb_attributes - 1);
+            }
+            for (j = 0; result == GAS_OK && j < op->nb_attributes; j++) {
+                a = &op->attributes[j];
+                result = gas_append_attribute(c, a->key, a->key_size,
+                                              a->value, a->value_size);
+            }
+        } else {
+            result = gas_patch_index(op, &index);
+            if (result != GAS_OK) { return result; }
+
+            if (gas_id_is(op, "child")) {
+                child = gas_writable_child(c, index);
+                result = child == NULL ? GAS_ERR_INVALID_PARAM
+                                       : gas_patch_chunk(child, op);
+            } else if (gas_id_is(op, "insert")) {
+                result = gas_patch_insert(c, index, op);
+            } else if (gas_id_is(op, "replace")) {
+                result = gas_delete_child_at(c, index);
+                if (result == GAS_OK) {
+                    result = gas_patch_insert(c, index, op);
+                }
+            } else if (gas_id_is(op, "remove")) {
+                result = gas_delete_child_at(c, index);
+            } else {
+                result = GAS_ERR_INVALID_PARAM;
+            }
+        }
+
+        if (result != GAS_OK) { return result; }
+    }
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_patch() {{{*/
+/**
+ * @brief Apply a patch from gas_diff() to the tree it was made from.
+ *
+ * Inserted subtrees are copied, so @a patch can be released afterwards, or
+ * applied again elsewhere.  A failure, such as a patch made from another
+ * tree, leaves @a tree partly patched; to keep the original, patch a copy
+ * made with gas_clone() and gas_unshare(), which only copies what the patch
+ * touches.
+ */
+GASresult gas_patch (GASchunk* tree, GASchunk* patch)
+{
+    GAS_CHECK_PARAM(tree);
+    GAS_CHECK_PARAM(patch);
+
+    if (!gas_id_is(patch, "patch")) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+    return gas_patch_chunk(tree, patch);
+}
+/*}}}*/
+/*@}*/
+
+/* vim: set sw=4 fdm=marker :*/
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file diff.h
+ * @brief tree difference definition
+ */
+
+#ifndef GAS_DIFF_H
+#define GAS_DIFF_H
+
+#include "tree.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+/*}*/
+#endif
+
+/**
+ * @defgroup diff Differences
+ * @ingroup access
+ * @brief Patches turning one tree into another, for sending just the change.
+ *
+ * gas_diff() describes the change from one tree to another as a patch, which
+ * is itself a tree, written and read like any other.  gas_patch() applies it
+ * to a copy of the old tree, in place.
+ *
+ * The patch root has the id "patch".  Each chunk of the patch lists, as its
+ * children and in order, the operations on one chunk of the target:
+ *
+ * - "id", "payload": set the id, or the payload, to the op's payload.
+ * - "set": set each of the op's attributes, appending new keys.
+ * - "unset": delete the attributes with the op's attribute keys.
+ * - "attributes": replace all of the attributes with the op's.
+ * - "child": apply the op's own operations to the child at an index.
+ * - "insert", "replace": add the op's only child at an index, or put it in
+ *   place of the child there.
+ * - "remove": delete the child at an index.
+ *
+ * Indices are the op's payload, encoded like the sizes of the format, and
+ * refer to the children as left by the previous operations.
+ *
+ * Children are matched up looking a few ahead, so an appended, inserted or
+ * removed child costs one operation, and an edit deep in the tree costs one
+ * "child" operation per level.  Subtrees shared through gas_clone() compare
+ * equal without being visited.
+ */
+/*@{*/
+
+GASbool gas_equal (GASchunk* a, GASchunk* b);
+
+GASresult gas_diff (GASchunk* old_tree, GASchunk* new_tree, GASchunk** patch,
+                    GASvoid* DEFAULT_NULL(user_data));
+GASresult gas_patch (GASchunk* tree, GASchunk* patch);
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_DIFF_H defined */
+
+/* vim: set sw=4 fdm=marker :*/
@@ -14,10 +14,17 @@ CHECK_INCLUDE_FILES(unistd.h     HAVE_UNISTD_H    )
 CHECK_INCLUDE_FILES(libgen.h     HAVE_LIBGEN_H    )
 CHECK_INCLUDE_FILES(stdio.h      HAVE_STDIO_H     )
 CHECK_INCLUDE_FILES(netinet/in.h HAVE_NETINET_IN_H)
+CHECK_INCLUDE_FILES(sys/uio.h    HAVE_SYS_UIO_H   )
+CHECK_INCLUDE_FILES(sys/mman.h   HAVE_SYS_MMAN_H  )
+CHECK_INCLUDE_FILES(pthread.h    HAVE_PTHREAD_H   )
+CHECK_INCLUDE_FILES(linux/io_uring.h HAVE_LINUX_IO_URING_H)
+
+find_package(Threads)
 
 include(CheckFunctionExists)
 check_function_exists("fprintf" HAVE_FPRINTF)
 check_function_exists("htonl"   HAVE_HTONL)
+check_function_exists("posix_fadvise" HAVE_POSIX_FADVISE)
 
 include(CheckTypeSize)
 check_type_size("short int" GAS_SIZEOF_SHORT_INT)
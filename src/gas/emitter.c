@@ -0,0 +1,701 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file emitter.c
+ * @brief emitter implementation
+ */
+
+#include "emitter.h"
+#include "codec.h"
+#include "fdio.h"
+
+#include <string.h>
+#if HAVE_STDIO_H
+#include <stdio.h>
+#endif
+#if HAVE_UNISTD_H
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+/* where the innermost chunk is */
+enum
+{
+    STATE_ATTRIBUTES,           /* attributes may still come */
+    STATE_PAYLOAD,              /* payload written, children may come */
+    STATE_CHILDREN              /* number of children written */
+};
+
+#define top(e) (&(e)->frames[(e)->depth - 1])
+
+/** @name sink */
+/*@{*/
+/* gas_emitter_write() {{{*/
+/**
+ * @brief Hand @a size bytes straight to the fd or context.
+ */
+static GASresult gas_emitter_write (GASemitter* e, const GASvoid* data,
+                                    GASunum size)
+{
+    GASiovec iov;
+    GASunum written;
+
+    if (size == 0) {
+        return GAS_OK;
+    }
+
+    if (e->sink == GAS_EMITTER_FD) {
+        iov.iov_base = (GASvoid*)data;
+        iov.iov_len = size;
+        return gas_writev_fd(e->fd, &iov, 1, &written);
+    }
+
+    return gas_context_write(e->context, e->handle, data, size);
+}
+/*}}}*/
+/* gas_emitter_flush() {{{*/
+/**
+ * @brief Hand buffered output to the fd or context.
+ *
+ * The emitter flushes by itself after each top level chunk.
+ */
+GASresult gas_emitter_flush (GASemitter* e)
+{
+    GASresult result;
+
+    GAS_CHECK_PARAM(e);
+
+    if (e->sink == GAS_EMITTER_BUF || e->buffer_used == 0) {
+        return GAS_OK;
+    }
+
+    result = gas_emitter_write(e, e->buffer, e->buffer_used);
+    e->buffer_used = 0;
+
+    return result;
+}
+/*}}}*/
+/* gas_emitter_put() {{{*/
+static GASresult gas_emitter_put (GASemitter* e, const GASvoid* data,
+                                  GASunum size)
+{
+    GASresult result;
+
+    if (e->sink == GAS_EMITTER_BUF) {
+        if (size > e->limit - e->pos) {
+            return GAS_ERR_UNKNOWN;
+        }
+        if (size > 0) {
+            memcpy(e->buf + e->pos, data, size);
+        }
+        e->pos += size;
+        return GAS_OK;
+    }
+
+    if (size > GAS_EMITTER_BUFFER_SIZE - e->buffer_used) {
+        result = gas_emitter_flush(e);
+        if (result != GAS_OK) { return result; }
+    }
+    if (size >= GAS_EMITTER_BUFFER_SIZE) {
+        result = gas_emitter_write(e, data, size);
+        if (result != GAS_OK) { return result; }
+    } else if (size > 0) {
+        memcpy(e->buffer + e->buffer_used, data, size);
+        e->buffer_used += size;
+    }
+    e->pos += size;
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_emitter_put_num() {{{*/
+static GASresult gas_emitter_put_num (GASemitter* e, GASunum value)
+{
+    GASubyte buf[GAS_CODEC_MAX_LENGTH];
+    GASnum length;
+
+    length = gas_codec_encode(buf, sizeof(buf), value);
+    if (length <= 0) {
+        return GAS_ERR_UNKNOWN;
+    }
+    return gas_emitter_put(e, buf, length);
+}
+/*}}}*/
+/* gas_emitter_reserve() {{{*/
+/**
+ * @brief Emit a placeholder number, for gas_emitter_patch().
+ */
+static GASresult gas_emitter_reserve (GASemitter* e, GASunum* at)
+{
+    GASubyte buf[GAS_CODEC_MAX_LENGTH];
+
+    if (!e->seekable) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+    if (gas_codec_encode_fixed(buf, e->size_width, 0) <= 0) {
+        return GAS_ERR_OUT_OF_RANGE;
+    }
+
+    *at = e->pos;
+    return gas_emitter_put(e, buf, e->size_width);
+}
+/*}}}*/
+/* gas_emitter_patch() {{{*/
+/**
+ * @brief Overwrite the number reserved at @a at with @a value.
+ *
+ * Placeholders are smaller than the output buffer, so each one is either
+ * still buffered, or already written in full.  The position of the fd or
+ * context is left where the flushed output ends, which need not be the
+ * end of the file.
+ */
+static GASresult gas_emitter_patch (GASemitter* e, GASunum at, GASunum value)
+{
+    GASubyte buf[GAS_CODEC_MAX_LENGTH];
+    GASunum flushed = e->pos - e->buffer_used;
+    GASresult result, restored;
+    size_t done = 0;
+#if HAVE_UNISTD_H
+    ssize_t n;
+#endif
+
+    if (gas_codec_encode_fixed(buf, e->size_width, value) <= 0) {
+        return GAS_ERR_OUT_OF_RANGE;
+    }
+
+    if (e->sink == GAS_EMITTER_BUF) {
+        memcpy(e->buf + at, buf, e->size_width);
+        return GAS_OK;
+    }
+    if (at >= flushed) {
+        memcpy(e->buffer + (at - flushed), buf, e->size_width);
+        return GAS_OK;
+    }
+
+    if (e->sink == GAS_EMITTER_FD) {
+#if HAVE_UNISTD_H
+        do {
+            n = pwrite(e->fd, buf, e->size_width, (off_t)(e->base + at));
+        } while (n < 0 && errno == EINTR);
+        return n == (ssize_t)e->size_width ? GAS_OK : GAS_ERR_UNKNOWN;
+#else
+        return GAS_ERR_UNKNOWN;
+#endif
+    }
+
+    if (gas_context_has(e->context, pwrite)) {
+        result = e->context->pwrite(e->handle, buf, e->size_width,
+                                    e->base + at, &done,
+                                    e->context->user_data);
+        if (result == GAS_OK && done != e->size_width) {
+            return GAS_ERR_UNKNOWN;
+        }
+        return result;
+    }
+
+    result = gas_context_seek(e->context, e->handle, e->base + at,
+                              GAS_SEEK_SET);
+    if (result != GAS_OK) { return result; }
+    result = gas_emitter_write(e, buf, e->size_width);
+    restored = gas_context_seek(e->context, e->handle, e->base + flushed,
+                                GAS_SEEK_SET);
+    return result != GAS_OK ? result : restored;
+}
+/*}}}*/
+/*@}*/
+
+/** @name cons/decons */
+/*@{*/
+/* gas_emitter_alloc() {{{*/
+static GASresult gas_emitter_alloc (GASemitter** emitter, GASvoid* user_data)
+{
+    GASemitter* e;
+
+    GAS_CHECK_PARAM(emitter);
+
+    e = (GASemitter*)gas_alloc(sizeof(GASemitter), user_data);
+    GAS_CHECK_MEM(e);
+    memset(e, 0, sizeof(GASemitter));
+
+    e->size_width = GAS_EMITTER_SIZE_WIDTH;
+    e->fd = -1;
+    e->user_data = user_data;
+
+    *emitter = e;
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_emitter_new_buf() {{{*/
+/**
+ * @brief Emit into @a buf.  The bytes used so far are GASemitter::pos.
+ */
+GASresult gas_emitter_new_buf (GASemitter** emitter, GASubyte* buf,
+                               GASunum limit, GASvoid* user_data)
+{
+    GASresult result;
+
+    GAS_CHECK_PARAM(buf);
+
+    result = gas_emitter_alloc(emitter, user_data);
+    if (result != GAS_OK) { return result; }
+
+    (*emitter)->sink = GAS_EMITTER_BUF;
+    (*emitter)->seekable = GAS_TRUE;
+    (*emitter)->buf = buf;
+    (*emitter)->limit = limit;
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_emitter_new_fd() {{{*/
+/**
+ * @brief Emit to @a fd, which is seekable when it refers to a regular file.
+ */
+GASresult gas_emitter_new_fd (GASemitter** emitter, int fd,
+                              GASvoid* user_data)
+{
+    GASresult result;
+#if HAVE_UNISTD_H
+    off_t base;
+#endif
+
+    result = gas_emitter_alloc(emitter, user_data);
+    if (result != GAS_OK) { return result; }
+
+    (*emitter)->sink = GAS_EMITTER_FD;
+    (*emitter)->fd = fd;
+#if HAVE_UNISTD_H
+    base = lseek(fd, 0, SEEK_CUR);
+    if (base >= 0) {
+        (*emitter)->seekable = GAS_TRUE;
+        (*emitter)->base = base;
+    }
+#endif
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_emitter_new() {{{*/
+/**
+ * @brief Emit through @a context.
+ *
+ * A context keeping the default open, write and seek callbacks is seekable
+ * when its stream is.  Set GASemitter::seekable, and GASemitter::base, for
+ * other contexts that seek, or that have a pwrite callback, which then
+ * patches sizes in place.
+ */
+GASresult gas_emitter_new (GASemitter** emitter, GAScontext* context,
+                           GASvoid* handle, GASvoid* user_data)
+{
+    GASresult result;
+#if HAVE_FPRINTF
+    long base;
+#endif
+
+    GAS_CHECK_PARAM(context);
+
+    result = gas_emitter_alloc(emitter, user_data);
+    if (result != GAS_OK) { return result; }
+
+    (*emitter)->sink = GAS_EMITTER_CONTEXT;
+    (*emitter)->context = context;
+    (*emitter)->handle = handle;
+#if HAVE_FPRINTF
+    /* only the default callbacks are known to take a FILE handle */
+    if (context->open == gas_default_open &&
+        context->write == gas_default_write &&
+        context->seek == gas_default_seek && handle != NULL)
+    {
+        base = ftell((FILE*)handle);
+        if (base >= 0) {
+            (*emitter)->seekable = GAS_TRUE;
+            (*emitter)->base = base;
+        }
+    }
+#endif
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_emitter_destroy() {{{*/
+/**
+ * @brief Release the emitter, without flushing it.
+ */
+GASresult gas_emitter_destroy (GASemitter* e)
+{
+    GAS_CHECK_PARAM(e);
+
+    if (e->attributes) {
+        gas_free(e->attributes, e->user_data);
+    }
+    if (e->frames) {
+        gas_free(e->frames, e->user_data);
+    }
+    gas_free(e, e->user_data);
+
+    return GAS_OK;
+}
+/*}}}*/
+/*@}*/
+
+/** @name chunk structure */
+/*@{*/
+/* gas_emitter_end_attributes() {{{*/
+/**
+ * @brief Emit the innermost chunk's attributes, and an empty payload when
+ * none was given.
+ */
+static GASresult gas_emitter_end_attributes (GASemitter* e,
+                                             GASbool empty_payload)
+{
+    GASemitter_frame* f = top(e);
+    GASresult result;
+
+    if (f->state != STATE_ATTRIBUTES) {
+        return GAS_OK;
+    }
+
+    result = gas_emitter_put_num(e, e->nb_attributes);
+    if (result != GAS_OK) { return result; }
+    result = gas_emitter_put(e, e->attributes, e->attributes_used);
+    if (result != GAS_OK) { return result; }
+    e->attributes_used = 0;
+    e->nb_attributes = 0;
+
+    if (empty_payload) {
+        result = gas_emitter_put_num(e, 0);
+        if (result != GAS_OK) { return result; }
+        f->state = STATE_PAYLOAD;
+    }
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_emitter_begin() {{{*/
+static GASresult gas_emitter_begin (GASemitter* e,
+                                    const GASvoid* id, GASunum id_size,
+                                    GASunum size)
+{
+    GASemitter_frame* f;
+    GASresult result;
+    GASvoid* tmp;
+    GASunum cap;
+
+    GAS_CHECK_PARAM(e);
+    if (id == NULL && id_size > 0) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    if (size == GAS_EMITTER_NONE && !e->seekable) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    /* the parent's attributes, payload and number of children */
+    if (e->depth > 0) {
+        f = top(e);
+        result = gas_emitter_end_attributes(e, GAS_TRUE);
+        if (result != GAS_OK) { return result; }
+        if (f->state == STATE_PAYLOAD) {
+            if (f->children_given) {
+                result = gas_emitter_put_num(e, f->nb_children);
+            } else {
+                result = gas_emitter_reserve(e, &f->children_header);
+            }
+            if (result != GAS_OK) { return result; }
+            f->state = STATE_CHILDREN;
+        }
+        if (f->children_given && f->children_seen == f->nb_children) {
+            return GAS_ERR_OUT_OF_RANGE;
+        }
+        f->children_seen++;
+    }
+
+    if (e->depth == e->frames_capacity) {
+        cap = e->frames_capacity > 0 ? e->frames_capacity * 2 : 16;
+        tmp = gas_realloc(e->frames, cap * sizeof(GASemitter_frame),
+                          e->user_data);
+        GAS_CHECK_MEM(tmp);
+        e->frames = (GASemitter_frame*)tmp;
+        e->frames_capacity = cap;
+    }
+    f = &e->frames[e->depth++];
+    memset(f, 0, sizeof(GASemitter_frame));
+    f->state = STATE_ATTRIBUTES;
+    f->size = size;
+    f->header = GAS_EMITTER_NONE;
+    f->children_header = GAS_EMITTER_NONE;
+
+    if (size == GAS_EMITTER_NONE) {
+        result = gas_emitter_reserve(e, &f->header);
+    } else {
+        result = gas_emitter_put_num(e, size);
+    }
+    if (result != GAS_OK) { return result; }
+    f->start = e->pos;
+
+    result = gas_emitter_put_num(e, id_size);
+    if (result != GAS_OK) { return result; }
+    return gas_emitter_put(e, id, id_size);
+}
+/*}}}*/
+/* gas_emitter_begin_chunk() {{{*/
+/**
+ * @brief Open a chunk, as a child of the open chunk if there is one.
+ *
+ * Its size is backpatched, so the sink must be seekable.
+ */
+GASresult gas_emitter_begin_chunk (GASemitter* e,
+                                   const GASvoid* id, GASunum id_size)
+{
+    return gas_emitter_begin(e, id, id_size, GAS_EMITTER_NONE);
+}
+/*}}}*/
+/* gas_emitter_begin_chunk_sized() {{{*/
+/**
+ * @brief Open a chunk whose size is known in advance.
+ *
+ * @param size What GASchunk::size will be: the bytes following the size
+ * itself.  gas_emitter_end_chunk() fails when it turns out otherwise.
+ */
+GASresult gas_emitter_begin_chunk_sized (GASemitter* e,
+                                         const GASvoid* id, GASunum id_size,
+                                         GASunum size)
+{
+    if (size == GAS_EMITTER_NONE) {
+        return GAS_ERR_OUT_OF_RANGE;
+    }
+    return gas_emitter_begin(e, id, id_size, size);
+}
+/*}}}*/
+/* gas_emitter_attribute() {{{*/
+GASresult gas_emitter_attribute (GASemitter* e,
+                                 const GASvoid* key, GASunum key_size,
+                                 const GASvoid* value, GASunum value_size)
+{
+    GASunum need, cap;
+    GASubyte* tmp;
+    GASubyte* p;
+
+    GAS_CHECK_PARAM(e);
+    if (key == NULL && key_size > 0) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+    if (value == NULL && value_size > 0) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    if (e->depth == 0 || top(e)->state != STATE_ATTRIBUTES) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    need = e->attributes_used + 2 * GAS_CODEC_MAX_LENGTH
+        + key_size + value_size;
+    if (need > e->attributes_capacity) {
+        cap = e->attributes_capacity > 0 ? e->attributes_capacity : 256;
+        while (cap < need) {
+            cap *= 2;
+        }
+        tmp = (GASubyte*)gas_realloc(e->attributes, cap, e->user_data);
+        GAS_CHECK_MEM(tmp);
+        e->attributes = tmp;
+        e->attributes_capacity = cap;
+    }
+
+    p = e->attributes + e->attributes_used;
+    p += gas_codec_encode(p, GAS_CODEC_MAX_LENGTH, key_size);
+    if (key_size > 0) {
+        memcpy(p, key, key_size);
+    }
+    p += key_size;
+    p += gas_codec_encode(p, GAS_CODEC_MAX_LENGTH, value_size);
+    if (value_size > 0) {
+        memcpy(p, value, value_size);
+    }
+    p += value_size;
+
+    e->attributes_used = p - e->attributes;
+    e->nb_attributes++;
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_emitter_payload() {{{*/
+GASresult gas_emitter_payload (GASemitter* e,
+                               const GASvoid* payload, GASunum payload_size)
+{
+    GASresult result;
+
+    GAS_CHECK_PARAM(e);
+    if (payload == NULL && payload_size > 0) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    if (e->depth == 0 || top(e)->state != STATE_ATTRIBUTES) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    result = gas_emitter_end_attributes(e, GAS_FALSE);
+    if (result != GAS_OK) { return result; }
+    result = gas_emitter_put_num(e, payload_size);
+    if (result != GAS_OK) { return result; }
+    result = gas_emitter_put(e, payload, payload_size);
+    if (result != GAS_OK) { return result; }
+    top(e)->state = STATE_PAYLOAD;
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_emitter_payload_callback() {{{*/
+/**
+ * @brief Emit a payload of @a payload_size bytes, produced piecewise by
+ * @a callback into the emitter's own buffer.
+ */
+GASresult gas_emitter_payload_callback (GASemitter* e, GASunum payload_size,
+                                        GAS_EMIT_PAYLOAD callback,
+                                        GASvoid* data)
+{
+    GASresult result;
+    GASunum remaining = payload_size;
+    GASunum room;
+    GASnum n;
+
+    GAS_CHECK_PARAM(e);
+    GAS_CHECK_PARAM(callback);
+
+    if (e->depth == 0 || top(e)->state != STATE_ATTRIBUTES) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    result = gas_emitter_end_attributes(e, GAS_FALSE);
+    if (result != GAS_OK) { return result; }
+    result = gas_emitter_put_num(e, payload_size);
+    if (result != GAS_OK) { return result; }
+
+    while (remaining > 0) {
+        if (e->sink == GAS_EMITTER_BUF) {
+            room = e->limit - e->pos;
+            if (room == 0) {
+                return GAS_ERR_UNKNOWN;
+            }
+        } else {
+            if (e->buffer_used == GAS_EMITTER_BUFFER_SIZE) {
+                result = gas_emitter_flush(e);
+                if (result != GAS_OK) { return result; }
+            }
+            room = GAS_EMITTER_BUFFER_SIZE - e->buffer_used;
+        }
+        if (room > remaining) {
+            room = remaining;
+        }
+
+        n = callback(e->sink == GAS_EMITTER_BUF ?
+                     e->buf + e->pos : e->buffer + e->buffer_used,
+                     room, data);
+        if (n <= 0 || (GASunum)n > room) {
+            return n < 0 ? n : GAS_ERR_UNKNOWN;
+        }
+
+        if (e->sink != GAS_EMITTER_BUF) {
+            e->buffer_used += n;
+        }
+        e->pos += n;
+        remaining -= n;
+    }
+    top(e)->state = STATE_PAYLOAD;
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_emitter_children() {{{*/
+/**
+ * @brief Give the number of children of the open chunk in advance, so it
+ * need not be backpatched.
+ */
+GASresult gas_emitter_children (GASemitter* e, GASunum nb_children)
+{
+    GAS_CHECK_PARAM(e);
+
+    if (e->depth == 0 || top(e)->state == STATE_CHILDREN) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    top(e)->children_given = GAS_TRUE;
+    top(e)->nb_children = nb_children;
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_emitter_end_chunk() {{{*/
+/**
+ * @brief Close the open chunk, resolving its size.
+ *
+ * @retval GAS_ERR_OUT_OF_RANGE A size or number of children given in advance
+ * was wrong, or a backpatched number did not fit in size_width bytes.
+ */
+GASresult gas_emitter_end_chunk (GASemitter* e)
+{
+    GASemitter_frame* f;
+    GASresult result;
+    GASunum size;
+
+    GAS_CHECK_PARAM(e);
+
+    if (e->depth == 0) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+    f = top(e);
+
+    result = gas_emitter_end_attributes(e, GAS_TRUE);
+    if (result != GAS_OK) { return result; }
+
+    if (f->state == STATE_PAYLOAD) {
+        if (f->children_given && f->nb_children != 0) {
+            return GAS_ERR_OUT_OF_RANGE;
+        }
+        result = gas_emitter_put_num(e, 0);
+        if (result != GAS_OK) { return result; }
+    } else if (f->children_given) {
+        if (f->children_seen != f->nb_children) {
+            return GAS_ERR_OUT_OF_RANGE;
+        }
+    } else {
+        result = gas_emitter_patch(e, f->children_header, f->children_seen);
+        if (result != GAS_OK) { return result; }
+    }
+
+    size = e->pos - f->start;
+    if (f->header == GAS_EMITTER_NONE) {
+        if (size != f->size) {
+            return GAS_ERR_OUT_OF_RANGE;
+        }
+    } else {
+        result = gas_emitter_patch(e, f->header, size);
+        if (result != GAS_OK) { return result; }
+    }
+
+    e->depth--;
+    if (e->depth == 0) {
+        return gas_emitter_flush(e);
+    }
+
+    return GAS_OK;
+}
+/*}}}*/
+/*@}*/
+
+/* vim: set sw=4 fdm=marker :*/
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file emitter.h
+ * @brief emitter definition
+ */
+
+#include "context.h"
+#include "tree.h"
+
+#ifndef GAS_EMITTER_H
+#define GAS_EMITTER_H
+
+#ifdef __cplusplus
+extern "C"
+{
+/*}*/
+#endif
+
+/**
+ * @defgroup emitter Emitter
+ * @ingroup io
+ * @brief Write chunks as they are produced, without building a tree.
+ *
+ * @code
+ * gas_emitter_begin_chunk(e, "root", 4);
+ * gas_emitter_attribute(e, "key", 3, "value", 5);
+ * gas_emitter_payload(e, data, data_size);
+ *     gas_emitter_begin_chunk(e, "child", 5);
+ *     gas_emitter_end_chunk(e);
+ * gas_emitter_end_chunk(e);
+ * @endcode
+ *
+ * Within a chunk, attributes come first, then at most one payload, then the
+ * children.  Attributes are held by the emitter until the payload or the
+ * first child, so that their count can precede them.
+ *
+ * A chunk's size, and the number of its children, precede their content.
+ * On seekable sinks (buffers, regular files, and contexts using the default
+ * callbacks) both are reserved as size_width bytes and backpatched once
+ * known.  Otherwise, they must be given in advance, with
+ * gas_emitter_begin_chunk_sized() and gas_emitter_children(), and are
+ * checked when the chunk ends.  Given sizes are encoded minimally, while
+ * backpatched sizes take size_width bytes; both decode the same.
+ */
+/*@{*/
+
+/**
+ * @brief Size of the emitter's output buffer, for fd and context sinks.
+ */
+#define GAS_EMITTER_BUFFER_SIZE 4096
+/**
+ * @brief Default number of bytes reserved for a backpatched number.
+ */
+#define GAS_EMITTER_SIZE_WIDTH GAS_SIZEOF_UNUM
+
+/**
+ * @brief Produces up to @a limit bytes of payload into @a buf.
+ *
+ * @return When positive, the number of bytes produced.  Otherwise, an error
+ * code.
+ */
+typedef GASnum (*GAS_EMIT_PAYLOAD) (GASvoid* buf, GASunum limit,
+                                    GASvoid* data);
+
+typedef enum
+{
+    GAS_EMITTER_BUF,
+    GAS_EMITTER_FD,
+    GAS_EMITTER_CONTEXT
+} GASemitter_sink;
+
+/** @brief An open chunk. */
+typedef struct
+{
+    /** @brief Where the size was reserved, or GAS_EMITTER_NONE. */
+    GASunum header;
+    /** @brief Where the chunk's content starts. */
+    GASunum start;
+    /** @brief The size given in advance, if any. */
+    GASunum size;
+    /** @brief Where the number of children was reserved, if it was. */
+    GASunum children_header;
+    GASunum nb_children;
+    GASunum children_seen;
+    GASbool children_given;
+    int state;
+} GASemitter_frame;
+
+/**
+ * @brief Not a position, such as an unreserved header.
+ */
+#define GAS_EMITTER_NONE ((GASunum)-1)
+
+typedef struct
+{
+    GASemitter_sink sink;
+    GASbool seekable;
+    /** @brief Bytes reserved for each backpatched number. */
+    GASunum size_width;
+
+    /** @brief Bytes emitted so far. */
+    GASunum pos;
+    /**
+     * @brief Sink offset of the first byte emitted.
+     *
+     * Backpatching seeks to base + position.  Set this when a context's
+     * handle was not at its start.
+     */
+    GASunum base;
+
+    /* GAS_EMITTER_BUF */
+    GASubyte* buf;
+    GASunum limit;
+
+    /* GAS_EMITTER_FD */
+    int fd;
+
+    /* GAS_EMITTER_CONTEXT */
+    GAScontext* context;
+    GASvoid* handle;
+
+    /** @brief Output not yet handed to the fd or context. */
+    GASubyte buffer[GAS_EMITTER_BUFFER_SIZE];
+    GASunum buffer_used;
+
+    /** @brief Encoded attributes of the innermost chunk, and their count. */
+    GASubyte* attributes;
+    GASunum attributes_used;
+    GASunum attributes_capacity;
+    GASunum nb_attributes;
+
+    GASemitter_frame* frames;
+    GASunum depth;
+    GASunum frames_capacity;
+
+    GASvoid* user_data;
+} GASemitter;
+
+GASresult gas_emitter_new_buf (GASemitter** emitter, GASubyte* buf,
+                               GASunum limit,
+                               GASvoid* DEFAULT_NULL(user_data));
+GASresult gas_emitter_new_fd (GASemitter** emitter, int fd,
+                              GASvoid* DEFAULT_NULL(user_data));
+GASresult gas_emitter_new (GASemitter** emitter, GAScontext* context,
+                           GASvoid* handle,
+                           GASvoid* DEFAULT_NULL(user_data));
+GASresult gas_emitter_destroy (GASemitter* e);
+
+GASresult gas_emitter_begin_chunk (GASemitter* e,
+                                   const GASvoid* id, GASunum id_size);
+GASresult gas_emitter_begin_chunk_sized (GASemitter* e,
+                                         const GASvoid* id, GASunum id_size,
+                                         GASunum size);
+GASresult gas_emitter_attribute (GASemitter* e,
+                                 const GASvoid* key, GASunum key_size,
+                                 const GASvoid* value, GASunum value_size);
+GASresult gas_emitter_payload (GASemitter* e,
+                               const GASvoid* payload, GASunum payload_size);
+GASresult gas_emitter_payload_callback (GASemitter* e, GASunum payload_size,
+                                        GAS_EMIT_PAYLOAD callback,
+                                        GASvoid* data);
+GASresult gas_emitter_children (GASemitter* e, GASunum nb_children);
+GASresult gas_emitter_end_chunk (GASemitter* e);
+GASresult gas_emitter_flush (GASemitter* e);
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_EMITTER_H defined */
+
+/* vim: set sw=4 fdm=marker :*/
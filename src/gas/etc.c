@@ -83,6 +83,22 @@ int gas_cmp (const GASubyte *a, GASunum a_len, const GASubyte *b, GASunum b_len)
     return result;
 }/*}}}*/
 
+/**
+ * @brief FNV-1a hash of @a size bytes.
+ */
+GASunum gas_hash (const GASvoid* bytes, GASunum size)/*{{{*/
+{
+    const GASubyte* b = (const GASubyte*)bytes;
+    GASunum h = 2166136261u;
+    GASunum i;
+
+    for (i = 0; i < size; i++) {
+        h ^= b[i];
+        h *= 16777619u;
+    }
+    return h;
+}/*}}}*/
+
 #if HAVE_FPRINTF
 GASresult gas_hexdump_f (FILE* fs, const GASvoid *input, GASunum size)/*{{{*/
 {
@@ -22,6 +22,7 @@
  */
 
 #include "fdio.h"
+#include "codec.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -35,73 +36,97 @@
 #include <unistd.h>
 #endif
 
+#if HAVE_POSIX_FADVISE
+#include <fcntl.h>
+#endif
+
+#include <limits.h>
+
+#ifndef IOV_MAX
+#  ifdef UIO_MAXIOV
+#    define IOV_MAX UIO_MAXIOV
+#  else
+#    define IOV_MAX 16
+#  endif
+#endif
+
 #ifdef MSVC
 GASnum read (int fd, GASvoid *buf, GASunum count);
 GASnum write (int fd, const GASvoid *buf, GASunum count);
 #endif
 
-/* gas_write_encoded_num_fd() {{{*/
-GASresult gas_write_encoded_num_fd (int fd, GASunum value)
+/* gas_writev_fd() {{{*/
+/**
+ * @brief Write a list of buffers, in IOV_MAX sized writev() batches.
+ *
+ * Partial writes and interruptions are resumed, so on success every buffer
+ * has been written in full.
+ *
+ * @param bytes_written When not NULL, receives the number of bytes written,
+ * even on failure.
+ */
+GASresult gas_writev_fd (int fd, const GASiovec* iov, GASunum iovcnt,
+                         GASunum* bytes_written)
 {
-    GASunum i, coded_length;
-    GASubyte byte, mask;
-    GASunum zero_count, zero_bytes, zero_bits;
-    GASnum si;  /* a signed i */
-    GASnum bytes_written;
-
-    for (i = 1; 1; i++) {
-        if (value < ((1UL << (7UL*i))-1UL)) {
-            break;
+    GASresult result = GAS_OK;
+    GASunum i = 0, offset = 0, total = 0, batch;
+    GASnum n;
+
+    GAS_CHECK_PARAM(iov);
+
+    while (i < iovcnt) {
+        if (offset > 0) {
+            /* the rest of a partially written buffer */
+            n = write(fd, (GASubyte*)iov[i].iov_base + offset,
+                      iov[i].iov_len - offset);
+        } else {
+#if HAVE_SYS_UIO_H
+            batch = iovcnt - i < IOV_MAX ? iovcnt - i : IOV_MAX;
+            n = writev(fd, iov + i, (int)batch);
+#else
+            batch = 1;
+            n = write(fd, iov[i].iov_base, iov[i].iov_len);
+#endif
         }
-        if ((i * 7L) > (sizeof(GASunum) << 3)) {
-            /* warning, close to overflow */
-            /* i--; */
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            result = GAS_ERR_UNKNOWN;
             break;
         }
-    }
-    coded_length = i;  /* not including header */
-
-    zero_count = coded_length - 1;
-    zero_bytes = zero_count / 8;
-    zero_bits = zero_count % 8;
-
-    byte = 0x0;
-    for (i = 0; i < zero_bytes; i++) {
-        bytes_written = write(fd, &byte, 1);
-        if (bytes_written != 1) {
-            return GAS_ERR_UNKNOWN;
+        total += n;
+
+        /* advance over the buffers written */
+        n += offset;
+        offset = 0;
+        while (i < iovcnt && (GASunum)n >= iov[i].iov_len) {
+            n -= iov[i].iov_len;
+            i++;
         }
+        offset = n;
     }
 
-    mask = 0x80;
-    mask >>= zero_bits;
-
-    /* write the first masked byte */
-    /*if ((coded_length - 1) <= sizeof(GASunum)) {*/
-    if (coded_length <= sizeof(GASunum)) {
-        byte = mask | ((value >> ((coded_length-zero_bytes-1)<<3)) & 0xff);
-    } else {
-        byte = mask;
+    if (bytes_written) {
+        *bytes_written = total;
     }
-    bytes_written = write(fd, &byte, 1);
-    if (bytes_written != 1) {
+    return result;
+}
+/*}}}*/
+/* gas_write_encoded_num_fd() {{{*/
+GASresult gas_write_encoded_num_fd (int fd, GASunum value)
+{
+    GASubyte buf[GAS_CODEC_MAX_LENGTH];
+    GASnum length, bytes_written;
+
+    length = gas_codec_encode(buf, sizeof(buf), value);
+    if (length <= 0) {
         return GAS_ERR_UNKNOWN;
     }
 
-    /*
-     * write remaining bytes
-     * from coded length, subtract 1 byte because we count down to zero
-     * subtract an addition byte because one was already or'ed with the mask
-     *
-     * @internal
-     * @todo figure out why zero_bytes is subtracted
-     */
-    for (si = coded_length - 2 - zero_bytes; si >= 0; si--) {
-        byte = ((value >> (si<<3)) & 0xff);
-        bytes_written = write(fd, &byte, 1);
-        if (bytes_written != 1) {
-            return GAS_ERR_UNKNOWN;
-        }
+    bytes_written = write(fd, buf, length);
+    if (bytes_written != length) {
+        return GAS_ERR_UNKNOWN;
     }
 
     return GAS_OK;
@@ -110,156 +135,555 @@ GASresult gas_write_encoded_num_fd (int fd, GASunum value)
 /* gas_read_encoded_num_fd() {{{*/
 GASresult gas_read_encoded_num_fd (int fd, GASunum* value)
 {
-    GASunum retval;
-    GASunum i, bytes_read, zero_byte_count, first_bit_set;
-    GASubyte byte, mask = 0x00;
-    GASunum additional_bytes_to_read;
+    GASubyte buf[GAS_CODEC_MAX_LENGTH];
+    GASnum length = 0, bytes_read;
+    GASunum have = 0;
 
     GAS_CHECK_PARAM(value);
 
-    /* find first non 0x00 byte */
-    for (zero_byte_count = 0; 1; zero_byte_count++) {
-        bytes_read = read(fd, &byte, 1);
+    /* leading bytes, until the length is known */
+    do {
+        bytes_read = read(fd, buf + have, 1);
+        if (bytes_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_read == 0) {
+            return GAS_ERR_FILE_EOF;
+        }
         if (bytes_read != 1) {
             return GAS_ERR_UNKNOWN;
         }
-        if (byte != 0x00)
-            break;
+        have++;
+        length = gas_codec_peek_length(buf, have);
+    } while (length == 0);
+
+    if (length < 0) {
+        return length;
     }
 
-    /* process initial byte */
-    for (first_bit_set = 7; first_bit_set >= 0; first_bit_set--)
-        if (byte & (1L << first_bit_set))
-            break;
+    /* remainder of the number */
+    while (have < (GASunum)length) {
+        bytes_read = read(fd, buf + have, length - have);
+        if (bytes_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_read == 0) {
+            return GAS_ERR_FILE_EOF;
+        }
+        if (bytes_read < 0) {
+            return GAS_ERR_UNKNOWN;
+        }
+        have += bytes_read;
+    }
 
-    for (i = 0; i < first_bit_set; i++)
-        mask |= (1L << i);
+    length = gas_codec_decode(buf, length, value);
+    return length < 0 ? length : GAS_OK;
+}
+/*}}}*/
 
-    additional_bytes_to_read = (7-first_bit_set) + (7*zero_byte_count);
+/* gas_write_fd() {{{*/
+/* length of the list gathered before it is handed to gas_writev_fd() */
+#if IOV_MAX < 1024
+#define GAS_FD_IOV_SIZE IOV_MAX
+#else
+#define GAS_FD_IOV_SIZE 1024
+#endif
+/* room for the encoded numbers referenced by the list */
+#define GAS_FD_SCRATCH_SIZE 4096
 
-    /* at this point, i have enough information to construct retval */
-    retval = mask & byte;
-    for (i = 0; i < additional_bytes_to_read; i++) {
-        bytes_read = read(fd, &byte, 1);
-        if (bytes_read != 1) {
-            return GAS_ERR_UNKNOWN;
+typedef struct
+{
+    int fd;
+    GASiovec iov[GAS_FD_IOV_SIZE];
+    GASunum iov_count;
+    GASubyte scratch[GAS_FD_SCRATCH_SIZE];
+    GASunum scratch_used;
+    GASunum total;
+} GASfd_gather;
+
+static GASresult gas_fd_flush (GASfd_gather* g)
+{
+    GASresult result;
+    GASunum bytes_written = 0;
+
+    result = gas_writev_fd(g->fd, g->iov, g->iov_count, &bytes_written);
+    g->total += bytes_written;
+    g->iov_count = 0;
+    g->scratch_used = 0;
+
+    return result;
+}
+
+static GASresult gas_fd_field (GASfd_gather* g, const GASvoid* data,
+                               GASunum size)
+{
+    GASresult result;
+    GASiovec* last;
+
+    if (size == 0) {
+        return GAS_OK;
+    }
+
+    /* encoded numbers land next to each other in scratch */
+    if (g->iov_count > 0) {
+        last = &g->iov[g->iov_count - 1];
+        if ((const GASubyte*)last->iov_base + last->iov_len == data) {
+            last->iov_len += size;
+            return GAS_OK;
         }
-        retval = (retval << 8) | byte;
     }
 
-    *value = retval;
+    if (g->iov_count == GAS_FD_IOV_SIZE) {
+        result = gas_fd_flush(g);
+        if (result != GAS_OK) { return result; }
+    }
+    g->iov[g->iov_count].iov_base = (GASvoid*)data;
+    g->iov[g->iov_count].iov_len = size;
+    g->iov_count++;
+
     return GAS_OK;
 }
-/*}}}*/
 
-/* gas_write_fd() {{{*/
+static GASresult gas_fd_num (GASfd_gather* g, GASunum value)
+{
+    GASresult result;
+    GASnum length;
+
+    if (g->scratch_used + GAS_CODEC_MAX_LENGTH > GAS_FD_SCRATCH_SIZE ||
+        g->iov_count == GAS_FD_IOV_SIZE) {
+        result = gas_fd_flush(g);
+        if (result != GAS_OK) { return result; }
+    }
+
+    length = gas_codec_encode(g->scratch + g->scratch_used,
+                              GAS_CODEC_MAX_LENGTH, value);
+    if (length <= 0) {
+        return GAS_ERR_UNKNOWN;
+    }
+    g->scratch_used += length;
+
+    return gas_fd_field(g, g->scratch + g->scratch_used - length, length);
+}
+
 #define write_field(field)                                                  \
     do {                                                                    \
-        result = gas_write_encoded_num_fd(fd, self->field##_size);          \
+        result = gas_fd_num(g, self->field##_size);                         \
+        if (result != GAS_OK) { return result; }                            \
+        result = gas_fd_field(g, self->field, self->field##_size);          \
         if (result != GAS_OK) { return result; }                            \
-        write(fd, self->field, self->field##_size);                         \
     } while(0)
 
-GASresult gas_write_fd (int fd, GASchunk* self)
+static GASresult gas_fd_chunk (GASfd_gather* g, GASchunk* self)
 {
     GASresult result;
     GASunum i;
 
     GAS_CHECK_PARAM(self);
+    /* children not read yet cannot be written, see @ref lazy */
+    if (self->lazy != NULL) { return GAS_ERR_INVALID_PARAM; }
 
     /* this GASchunk's size */
-    gas_write_encoded_num_fd(fd, self->size);
+    result = gas_fd_num(g, self->size);
+    if (result != GAS_OK) { return result; }
     write_field(id);
     /* attributes */
-    gas_write_encoded_num_fd(fd, self->nb_attributes);
+    result = gas_fd_num(g, self->nb_attributes);
+    if (result != GAS_OK) { return result; }
     for (i = 0; i < self->nb_attributes; i++) {
         write_field(attributes[i].key);
         write_field(attributes[i].value);
     }
     write_field(payload);
     /* children */
-    gas_write_encoded_num_fd(fd, self->nb_children);
+    result = gas_fd_num(g, self->nb_children);
+    if (result != GAS_OK) { return result; }
     for (i = 0; i < self->nb_children; i++) {
-        result = gas_write_fd(fd, self->children[i]);
-        if (result != GAS_OK) {
-            return result;
-        }
+        result = gas_fd_chunk(g, self->children[i]);
+        if (result != GAS_OK) { return result; }
     }
 
     return GAS_OK;
 }
+
+#undef write_field
+
+/**
+ * @brief Write a tree, gathering its fields in place, and its encoded
+ * numbers in a scratch area, for gas_writev_fd().
+ *
+ * @param bytes_written When not NULL, receives the number of bytes written,
+ * even on failure.
+ */
+GASresult gas_write_fd (int fd, GASchunk* self, GASunum* bytes_written)
+{
+    GASfd_gather g;
+    GASresult result;
+
+    GAS_CHECK_PARAM(self);
+
+    g.fd = fd;
+    g.iov_count = 0;
+    g.scratch_used = 0;
+    g.total = 0;
+
+    result = gas_fd_chunk(&g, self);
+    if (result == GAS_OK) {
+        result = gas_fd_flush(&g);
+    }
+
+    if (bytes_written) {
+        *bytes_written = g.total;
+    }
+    return result;
+}
 /*}}}*/
 /* gas_read_fd() {{{*/
+/**
+ * @brief Buffer at least @a want bytes, unless the input ends first.
+ */
+static GASresult gas_fd_fill (GASfdreader* r, GASunum want)
+{
+    GASunum avail = r->end - r->pos;
+    GASunum room;
+    GASnum n;
+
+    if (avail >= want) {
+        return GAS_OK;
+    }
 
-#define read_field(field)                                                   \
+    if (r->pos > 0) {
+        memmove(r->buffer, r->buffer + r->pos, avail);
+        r->pos = 0;
+        r->end = avail;
+    }
+
+    while (r->end < want) {
+        room = r->size - r->end;
+        if (room > r->limit) {
+            room = r->limit;
+        }
+        if (room == 0) {
+            return GAS_ERR_FILE_EOF;
+        }
+        n = read(r->fd, r->buffer + r->end, room);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return GAS_ERR_UNKNOWN;
+        }
+        if (n == 0) {
+            return GAS_ERR_FILE_EOF;
+        }
+        r->end += n;
+        r->limit -= n;
+    }
+
+    return GAS_OK;
+}
+
+static GASresult gas_fd_read_num (GASfdreader* r, GASunum* value)
+{
+    GASresult result;
+    GASnum length;
+
+    result = gas_fd_fill(r, 1);
+    if (result != GAS_OK) { return result; }
+
+    /* leading bytes, until the length is known */
+    while ((length = gas_codec_peek_length(r->buffer + r->pos,
+                                           r->end - r->pos)) == 0) {
+        result = gas_fd_fill(r, r->end - r->pos + 1);
+        if (result != GAS_OK) { return result; }
+    }
+    if (length < 0) {
+        return length;
+    }
+
+    result = gas_fd_fill(r, length);
+    if (result != GAS_OK) { return result; }
+
+    length = gas_codec_decode(r->buffer + r->pos, length, value);
+    if (length < 0) {
+        return length;
+    }
+    r->pos += length;
+
+    return GAS_OK;
+}
+
+/**
+ * @brief Copy @a size bytes out of the buffer, reading those it lacks
+ * straight into @a out when they would not fit.
+ */
+static GASresult gas_fd_read_bytes (GASfdreader* r, GASubyte* out,
+                                    GASunum size)
+{
+    GASresult result;
+    GASunum n = r->end - r->pos;
+    GASnum got;
+
+    if (n > size) {
+        n = size;
+    }
+    memcpy(out, r->buffer + r->pos, n);
+    r->pos += n;
+    out += n;
+    size -= n;
+
+    while (size >= r->size) {
+        /* the buffer is empty */
+        n = size < r->limit ? size : r->limit;
+        if (n == 0) {
+            return GAS_ERR_FILE_EOF;
+        }
+        got = read(r->fd, out, n);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return GAS_ERR_UNKNOWN;
+        }
+        if (got == 0) {
+            return GAS_ERR_FILE_EOF;
+        }
+        r->limit -= got;
+        out += got;
+        size -= got;
+    }
+
+    if (size > 0) {
+        result = gas_fd_fill(r, size);
+        if (result != GAS_OK) { return result; }
+        memcpy(out, r->buffer + r->pos, size);
+        r->pos += size;
+    }
+
+    return GAS_OK;
+}
+
+#define read_num(num)                                                       \
     do {                                                                    \
-        result = gas_read_encoded_num_fd(fd, &field##_size);                \
-        if (result != GAS_OK) { return result; }                            \
-        field = (GASubyte*)gas_alloc(field##_size + 1, user_data);          \
-        GAS_CHECK_MEM(field);                                               \
-        bytes_read = read(fd, field, field##_size);                         \
-        if (bytes_read < 0) { return GAS_ERR_UNKNOWN; }                     \
-        if (bytes_read != (GASnum)field##_size) {return GAS_ERR_UNKNOWN;}   \
+        result = gas_fd_read_num(r, &num);                                  \
+        if (result != GAS_OK) { goto abort; }                               \
+        if (num > size) { result = GAS_ERR_UNKNOWN; goto abort; }           \
+    } while (0)
+
+/* the arrays of @a count items must fit a GASunum */
+#define read_count(count, type)                                             \
+    do {                                                                    \
+        read_num(count);                                                    \
+        if ((count) > (GASunum)-1 / sizeof(type)) {                         \
+            result = GAS_ERR_OUT_OF_RANGE; goto abort;                      \
+        }                                                                   \
+    } while (0)
+
+#define read_field(field, local)                                            \
+    do {                                                                    \
+        read_num(field##_size);                                             \
+        if (field##_size == (GASunum)-1) {                                  \
+            /* no room for the terminator */                                \
+            result = GAS_ERR_OUT_OF_RANGE; goto abort;                      \
+        }                                                                   \
+        field = gas_field_alloc(local, field##_size, r->user_data);         \
+        if (field == NULL) { result = GAS_ERR_MEMORY; goto abort; }         \
+        result = gas_fd_read_bytes(r, field, field##_size);                 \
+        if (result != GAS_OK) { goto abort; }                               \
         ((GASubyte*)field)[field##_size] = 0;                               \
     } while (0)
 
-GASresult gas_read_fd (int fd, GASchunk** out, GASvoid* user_data)
+/**
+ * @brief Read the rest of a chunk of @a size bytes, its size already read.
+ *
+ * Sizes and counts larger than @a size can only come from a corrupt
+ * stream, and are refused before anything is allocated for them.  So are
+ * those whose storage would not fit a GASunum, with GAS_ERR_OUT_OF_RANGE.
+ */
+static GASresult gas_fd_read_chunk (GASfdreader* r, GASunum size,
+                                    GASchunk** out)
 {
     GASresult result;
-    GASunum i;
+    GASunum i, count, child_size;
     GASchunk* c = NULL;
-    GASnum bytes_read;
 
-    result = gas_new(&c, NULL, 0, user_data);
-    if (result != GAS_OK) {
-        return result;
+    result = gas_new(&c, NULL, 0, r->user_data);
+    if (result != GAS_OK) { goto abort; }
+    c->size = size;
+
+    read_field(c->id, c->id_inline);
+
+    read_count(count, GASattribute);
+    if (count > 0) {
+        c->attributes = (GASattribute*)gas_alloc(
+            count * sizeof(GASattribute), r->user_data);
+        if (c->attributes == NULL) { result = GAS_ERR_MEMORY; goto abort; }
+        memset(c->attributes, 0, count * sizeof(GASattribute));
+        c->attributes_capacity = count;
+        c->nb_attributes = count;
+    }
+    for (i = 0; i < c->nb_attributes; i++) {
+        read_field(c->attributes[i].key, c->attributes[i].key_inline);
+        read_field(c->attributes[i].value,
+                   c->attributes[i].value_inline);
     }
 
-    result = gas_read_encoded_num_fd(fd, &c->size);
-    if (result != GAS_OK) {
-        return result;
+    read_field(c->payload, NULL);
+
+    read_count(count, GASchunk*);
+    if (count > 0) {
+        c->children = (GASchunk**)gas_alloc(count * sizeof(GASchunk*),
+                                            r->user_data);
+        if (c->children == NULL) { result = GAS_ERR_MEMORY; goto abort; }
+        memset(c->children, 0, count * sizeof(GASchunk*));
+        c->children_capacity = count;
+        c->nb_children = count;
     }
+    for (i = 0; i < c->nb_children; i++) {
+        read_num(child_size);
+        result = gas_fd_read_chunk(r, child_size, &c->children[i]);
+        if (result != GAS_OK) { goto abort; }
+        c->children[i]->parent = c;
+    }
+
+    *out = c;
+    return GAS_OK;
 
-    if (c->size == 0) {
+abort:
+    if (c != NULL) {
         gas_destroy(c);
-        return GAS_ERR_UNKNOWN;
     }
+    *out = NULL;
+    return result;
+}
+
+#undef read_field
+#undef read_count
+#undef read_num
+
+/**
+ * @brief Read one tree, without reading past it.
+ *
+ * Its size is read first, then the rest in reads of up to
+ * GAS_FD_READER_SIZE bytes, so consecutive trees, on pipes and sockets as
+ * well, can be read with consecutive calls.  To read many trees, prefer a
+ * GASfdreader, whose buffer reads ahead.
+ *
+ * @retval GAS_ERR_FILE_EOF when the input ends, before or within the tree.
+ */
+GASresult gas_read_fd (int fd, GASchunk** out, GASvoid* user_data)
+{
+    GASfdreader r;
+    GASresult result;
+    GASunum size;
+
+    GAS_CHECK_PARAM(out);
 
-    read_field(c->id);
-    result = gas_read_encoded_num_fd(fd, &c->nb_attributes);
+    result = gas_read_encoded_num_fd(fd, &size);
     if (result != GAS_OK) {
         return result;
     }
-    if (c->nb_attributes > 0) {
-        c->attributes = (GASattribute*)gas_alloc(
-            c->nb_attributes * sizeof(GASattribute), user_data);
-        GAS_CHECK_MEM(c->attributes);
+    if (size == 0) {
+        return GAS_ERR_UNKNOWN;
     }
-    for (i = 0; i < c->nb_attributes; i++) {
-        read_field(c->attributes[i].key);
-        read_field(c->attributes[i].value);
+
+    r.fd = fd;
+    r.size = size < GAS_FD_READER_SIZE ? size : GAS_FD_READER_SIZE;
+    r.buffer = (GASubyte*)gas_alloc(r.size, user_data);
+    GAS_CHECK_MEM(r.buffer);
+    r.pos = 0;
+    r.end = 0;
+    r.limit = size;
+    r.user_data = user_data;
+
+    result = gas_fd_read_chunk(&r, size, out);
+    if (result == GAS_OK && (r.limit != 0 || r.pos != r.end)) {
+        /* the fields do not add up to the size */
+        gas_destroy(*out);
+        *out = NULL;
+        result = GAS_ERR_UNKNOWN;
+    }
+
+    gas_free(r.buffer, user_data);
+    return result;
+}
+/*}}}*/
+/* gas_fd_reader_new() {{{*/
+/**
+ * @brief Read trees from @a fd, through a buffer of @a size bytes, or
+ * GAS_FD_READER_SIZE when 0.
+ *
+ * Regular files are advised to be read sequentially.
+ */
+GASresult gas_fd_reader_new (GASfdreader** reader, int fd, GASunum size,
+                             GASvoid* user_data)
+{
+    GASfdreader* r;
+
+    GAS_CHECK_PARAM(reader);
+
+    if (size < GAS_CODEC_MAX_LENGTH) {
+        size = GAS_FD_READER_SIZE;
+    }
+
+    r = (GASfdreader*)gas_alloc(sizeof(GASfdreader), user_data);
+    GAS_CHECK_MEM(r);
+    r->buffer = (GASubyte*)gas_alloc(size, user_data);
+    if (r->buffer == NULL) {
+        gas_free(r, user_data);
+        return GAS_ERR_MEMORY;
     }
-    read_field(c->payload);
-    result = gas_read_encoded_num_fd(fd, &c->nb_children);
+    r->fd = fd;
+    r->size = size;
+    r->pos = 0;
+    r->end = 0;
+    r->limit = ~(GASunum)0;
+    r->user_data = user_data;
+
+#if HAVE_POSIX_FADVISE
+    /* fails harmlessly with ESPIPE on pipes and sockets */
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    *reader = r;
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_fd_reader_destroy() {{{*/
+/**
+ * @brief Release the reader, but leave its file descriptor open.
+ */
+GASresult gas_fd_reader_destroy (GASfdreader* r)
+{
+    GAS_CHECK_PARAM(r);
+
+    gas_free(r->buffer, r->user_data);
+    gas_free(r, r->user_data);
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_read_fd_reader() {{{*/
+/**
+ * @brief Read the next tree.
+ *
+ * @retval GAS_ERR_FILE_EOF when the input ends, before or within the tree.
+ */
+GASresult gas_read_fd_reader (GASfdreader* r, GASchunk** out)
+{
+    GASresult result;
+    GASunum size;
+
+    GAS_CHECK_PARAM(r);
+    GAS_CHECK_PARAM(out);
+
+    result = gas_fd_read_num(r, &size);
     if (result != GAS_OK) {
         return result;
     }
-    if (c->nb_children > 0) {
-        c->children = (GASchunk**)gas_alloc(c->nb_children * sizeof(GASchunk*),
-                                            user_data);
-        GAS_CHECK_MEM(c->children);
-    }
-    for (i = 0; i < c->nb_children; i++) {
-        result = gas_read_fd(fd, &c->children[i], user_data);
-        if (result != GAS_OK) {
-            gas_destroy(c);
-            return result;
-        }
-        c->children[i]->parent = c;
+    if (size == 0) {
+        return GAS_ERR_UNKNOWN;
     }
 
-    *out = c;
-    return GAS_OK;
+    return gas_fd_read_chunk(r, size, out);
 }
 /*}}}*/
 
@@ -19,6 +19,7 @@
  * @brief fdio definition
  */
 
+#include "context.h"
 #include "tree.h"
 
 #ifndef GAS_FDIO_H
@@ -37,11 +38,54 @@ extern "C"
  */
 /*@{*/
 
+/**
+ * @brief Default buffer size of gas_fd_reader_new().
+ */
+#define GAS_FD_READER_SIZE 65536
 
-GASresult gas_write_fd (int fd, GASchunk* self);
+/**
+ * @brief Buffered reader of consecutive trees from a file descriptor.
+ *
+ * The buffer is refilled in large reads, resumed when short, and kept from
+ * one tree to the next, so it reads ahead of the tree returned:
+ *
+ * @code
+ * gas_fd_reader_new(&r, fd, 0, NULL);
+ * while ((result = gas_read_fd_reader(r, &root)) == GAS_OK) {
+ *     ...
+ *     gas_destroy(root);
+ * }
+ * // result is GAS_ERR_FILE_EOF after the last tree
+ * gas_fd_reader_destroy(r);
+ * @endcode
+ */
+typedef struct
+{
+    int fd;
+    GASubyte* buffer;
+    GASunum size;
+    /** @brief Buffered bytes not yet decoded are buffer[pos, end). */
+    GASunum pos;
+    GASunum end;
+    /** @brief Number of bytes that may still be read from fd. */
+    GASunum limit;
+    GASvoid* user_data;
+} GASfdreader;
+
+GASresult gas_fd_reader_new (GASfdreader** reader, int fd, GASunum size,
+                             GASvoid* DEFAULT_NULL(user_data));
+GASresult gas_fd_reader_destroy (GASfdreader* r);
+GASresult gas_read_fd_reader (GASfdreader* r, GASchunk** out);
+
+
+GASresult gas_write_fd (int fd, GASchunk* self,
+                        GASunum* DEFAULT_NULL(bytes_written));
 GASresult gas_read_fd (int fd, GASchunk** out,
                        GASvoid* DEFAULT_NULL(user_data));
 
+GASresult gas_writev_fd (int fd, const GASiovec* iov, GASunum iovcnt,
+                         GASunum* DEFAULT_NULL(bytes_written));
+
 GASresult gas_write_encoded_num_fd (int fd, GASunum value);
 GASresult gas_read_encoded_num_fd (int fd, GASunum* value);
 
@@ -0,0 +1,365 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file flat.c
+ * @brief flat tree implementation
+ */
+
+#include "flat.h"
+#include "codec.h"
+
+#include <string.h>
+#if HAVE_STDIO_H
+#include <stdio.h>
+#endif
+
+/* the smallest encodings of an attribute and a chunk, for sanity checks */
+#define MIN_ATTRIBUTE_SIZE 2
+#define MIN_CHUNK_SIZE     5
+
+/* gas_flat_grow() {{{*/
+/**
+ * @brief Make room for @a count more records in @a array, doubling.
+ */
+static GASresult gas_flat_grow (GASflat* f, void** array, uint32_t* capacity,
+                                uint32_t used, GASunum count, GASunum record)
+{
+    GASunum need = used + count;
+    GASunum cap = *capacity;
+    void* tmp;
+
+    if (need <= cap) {
+        return GAS_OK;
+    }
+    if (need >= GAS_FLAT_NONE) {
+        return GAS_ERR_OUT_OF_RANGE;
+    }
+
+    cap = cap > 0 ? cap : 16;
+    while (cap < need) {
+        cap *= 2;
+    }
+    if (cap >= GAS_FLAT_NONE) {
+        cap = GAS_FLAT_NONE - 1;
+    }
+
+    tmp = gas_realloc(*array, cap * record, f->user_data);
+    GAS_CHECK_MEM(tmp);
+    *array = tmp;
+    *capacity = (uint32_t)cap;
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_flat_read_chunk() {{{*/
+
+#define read_num(field)                                                     \
+    do {                                                                    \
+        result = gas_codec_decode(f->buf + offset, limit - offset, &field); \
+        if (result <= 0) { return result < 0 ? result : GAS_ERR_UNKNOWN; }  \
+        offset += result;                                                   \
+    } while (0)
+
+#define read_field(record, field)                                           \
+    do {                                                                    \
+        read_num(num);                                                      \
+        if (num > limit - offset) {                                         \
+            return GAS_ERR_UNKNOWN;                                         \
+        }                                                                   \
+        record.field##_offset = (uint32_t)offset;                           \
+        record.field##_size = (uint32_t)num;                                \
+        offset += num;                                                      \
+    } while (0)
+
+/**
+ * @brief Append the chunk at @a offset, and its subtree, depth first.
+ *
+ * @return When positive, the offset following the chunk.  Otherwise, an
+ * error code.
+ */
+static GASnum gas_flat_read_chunk (GASflat* f, GASunum offset, GASunum limit,
+                                   uint32_t parent, uint32_t* out)
+{
+    GASnum result;
+    GASunum num, i;
+    uint32_t index, first, child;
+
+    result = gas_flat_grow(f, (void**)&f->chunks, &f->chunks_capacity,
+                           f->nb_chunks, 1, sizeof(GASflat_chunk));
+    if (result != GAS_OK) { return result; }
+    index = f->nb_chunks++;
+    memset(&f->chunks[index], 0, sizeof(GASflat_chunk));
+    f->chunks[index].parent = parent;
+
+    read_num(num);
+    if (num > limit - offset) {
+        return GAS_ERR_UNKNOWN;
+    }
+    f->chunks[index].size = (uint32_t)num;
+
+    read_field(f->chunks[index], id);
+
+/* attributes {{{*/
+    read_num(num);
+    if (num > (limit - offset) / MIN_ATTRIBUTE_SIZE) {
+        return GAS_ERR_UNKNOWN;
+    }
+    result = gas_flat_grow(f, (void**)&f->attributes, &f->attributes_capacity,
+                           f->nb_attributes, num, sizeof(GASflat_attribute));
+    if (result != GAS_OK) { return result; }
+    first = f->nb_attributes;
+    f->nb_attributes += (uint32_t)num;
+    f->chunks[index].first_attribute = first;
+    f->chunks[index].nb_attributes = (uint32_t)num;
+
+    for (i = first; i < f->nb_attributes; i++) {
+        read_field(f->attributes[i], key);
+        read_field(f->attributes[i], value);
+    }
+/*}}}*/
+
+    read_field(f->chunks[index], payload);
+
+/* children {{{*/
+    read_num(num);
+    if (num > (limit - offset) / MIN_CHUNK_SIZE) {
+        return GAS_ERR_UNKNOWN;
+    }
+    result = gas_flat_grow(f, (void**)&f->children, &f->children_capacity,
+                           f->nb_children, num, sizeof(uint32_t));
+    if (result != GAS_OK) { return result; }
+    first = f->nb_children;
+    f->nb_children += (uint32_t)num;
+    f->chunks[index].first_child = first;
+    f->chunks[index].nb_children = (uint32_t)num;
+
+    for (i = first; i < first + num; i++) {
+        result = gas_flat_read_chunk(f, offset, limit, index, &child);
+        if (result <= 0) { return result; }
+        f->children[i] = child;
+        offset = result;
+    }
+/*}}}*/
+
+    *out = index;
+    return offset;
+}
+
+#undef read_field
+#undef read_num
+
+/*}}}*/
+/* gas_flat_read_buf() {{{*/
+/**
+ * @brief Parse the chunk at the start of @a buf into a flat tree.
+ *
+ * @a buf is referenced by the flat tree, and must remain valid until
+ * gas_flat_destroy().
+ *
+ * @return When positive, the number of bytes parsed.  Otherwise, an error
+ * code.
+ */
+GASnum gas_flat_read_buf (const GASubyte* buf, GASunum limit, GASflat** out,
+                          GASvoid* user_data)
+{
+    GASflat* f;
+    GASnum result;
+    uint32_t root;
+
+    GAS_CHECK_PARAM(buf);
+    GAS_CHECK_PARAM(out);
+
+    if (limit >= GAS_FLAT_NONE) {
+        /* offsets are 32 bit */
+        return GAS_ERR_OUT_OF_RANGE;
+    }
+
+    f = (GASflat*)gas_alloc(sizeof(GASflat), user_data);
+    GAS_CHECK_MEM(f);
+    memset(f, 0, sizeof(GASflat));
+    f->buf = buf;
+    f->user_data = user_data;
+
+    result = gas_flat_read_chunk(f, 0, limit, GAS_FLAT_NONE, &root);
+    if (result <= 0) {
+        gas_flat_destroy(f);
+        *out = NULL;
+        return result;
+    }
+
+    *out = f;
+    return result;
+}
+/*}}}*/
+/* gas_flat_destroy() {{{*/
+/**
+ * @brief Release the flat tree, but not the buffer it refers to.
+ */
+GASresult gas_flat_destroy (GASflat* f)
+{
+    GAS_CHECK_PARAM(f);
+
+    if (f->chunks) {
+        gas_free(f->chunks, f->user_data);
+    }
+    if (f->attributes) {
+        gas_free(f->attributes, f->user_data);
+    }
+    if (f->children) {
+        gas_free(f->children, f->user_data);
+    }
+    gas_free(f, f->user_data);
+
+    return GAS_OK;
+}
+/*}}}*/
+
+/** @name access */
+/*@{*/
+/* gas_flat_get_id() {{{*/
+const GASubyte* gas_flat_get_id (const GASflat* f, uint32_t c, GASunum* len)
+{
+    const GASflat_chunk* chunk = &f->chunks[c];
+
+    if (len) {
+        *len = chunk->id_size;
+    }
+    return f->buf + chunk->id_offset;
+}
+/*}}}*/
+/* gas_flat_id_is() {{{*/
+GASbool gas_flat_id_is (const GASflat* f, uint32_t c, const GASchar* id)
+{
+    const GASflat_chunk* chunk = &f->chunks[c];
+
+    return gas_cmp(f->buf + chunk->id_offset, chunk->id_size,
+                   (const GASubyte*)id, strlen(id)) == 0;
+}
+/*}}}*/
+/* gas_flat_index_of_attribute() {{{*/
+/**
+ * @return signed index, relative to the chunk's attributes
+ * @retval GAS_ERR_ATTR_NOT_FOUND failure, attribute not found
+ */
+GASnum gas_flat_index_of_attribute (const GASflat* f, uint32_t c,
+                                    const GASvoid* key, GASunum key_size)
+{
+    const GASflat_chunk* chunk = &f->chunks[c];
+    const GASflat_attribute* a = &f->attributes[chunk->first_attribute];
+    GASunum i;
+
+    GAS_CHECK_PARAM(key);
+
+    for (i = 0; i < chunk->nb_attributes; i++) {
+        if (a[i].key_size == key_size &&
+            memcmp(f->buf + a[i].key_offset, key, key_size) == 0)
+        {
+            return i;
+        }
+    }
+    return GAS_ERR_ATTR_NOT_FOUND;
+}
+/*}}}*/
+/* gas_flat_has_attribute() {{{*/
+GASbool gas_flat_has_attribute (const GASflat* f, uint32_t c,
+                                const GASvoid* key, GASunum key_size)
+{
+    return gas_flat_index_of_attribute(f, c, key, key_size) >= 0;
+}
+/*}}}*/
+/* gas_flat_get_attribute_at() {{{*/
+/**
+ * @return The value, or NULL when @a index is out of range.
+ */
+const GASubyte* gas_flat_get_attribute_at (const GASflat* f, uint32_t c,
+                                           GASunum index, GASunum* len)
+{
+    const GASflat_chunk* chunk = &f->chunks[c];
+    const GASflat_attribute* a;
+
+    if (index >= chunk->nb_attributes) {
+        return NULL;
+    }
+
+    a = &f->attributes[chunk->first_attribute + index];
+    if (len) {
+        *len = a->value_size;
+    }
+    return f->buf + a->value_offset;
+}
+/*}}}*/
+/* gas_flat_get_attribute() {{{*/
+/**
+ * @return The value, or NULL when the attribute is not found.
+ */
+const GASubyte* gas_flat_get_attribute (const GASflat* f, uint32_t c,
+                                        const GASvoid* key, GASunum key_size,
+                                        GASunum* len)
+{
+    GASnum index;
+
+    index = gas_flat_index_of_attribute(f, c, key, key_size);
+    if (index < 0) {
+        return NULL;
+    }
+    return gas_flat_get_attribute_at(f, c, index, len);
+}
+/*}}}*/
+/* gas_flat_get_payload() {{{*/
+const GASubyte* gas_flat_get_payload (const GASflat* f, uint32_t c,
+                                      GASunum* len)
+{
+    const GASflat_chunk* chunk = &f->chunks[c];
+
+    if (len) {
+        *len = chunk->payload_size;
+    }
+    return f->buf + chunk->payload_offset;
+}
+/*}}}*/
+/* gas_flat_get_parent() {{{*/
+/**
+ * @return The parent's index, or GAS_FLAT_NONE for the root.
+ */
+uint32_t gas_flat_get_parent (const GASflat* f, uint32_t c)
+{
+    return f->chunks[c].parent;
+}
+/*}}}*/
+/* gas_flat_nb_children() {{{*/
+GASunum gas_flat_nb_children (const GASflat* f, uint32_t c)
+{
+    return f->chunks[c].nb_children;
+}
+/*}}}*/
+/* gas_flat_get_child_at() {{{*/
+/**
+ * @return The child's index, or GAS_FLAT_NONE when @a index is out of range.
+ */
+uint32_t gas_flat_get_child_at (const GASflat* f, uint32_t c, GASunum index)
+{
+    const GASflat_chunk* chunk = &f->chunks[c];
+
+    if (index >= chunk->nb_children) {
+        return GAS_FLAT_NONE;
+    }
+    return f->children[chunk->first_child + index];
+}
+/*}}}*/
+/*@}*/
+
+/* vim: set sw=4 fdm=marker :*/
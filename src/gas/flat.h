@@ -0,0 +1,129 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file flat.h
+ * @brief flat tree definition
+ */
+
+#include "tree.h"
+
+#ifndef GAS_FLAT_H
+#define GAS_FLAT_H
+
+#ifdef __cplusplus
+extern "C"
+{
+/*}*/
+#endif
+
+/**
+ * @defgroup flat Flat Trees
+ * @ingroup access
+ * @brief Read-only trees, as arrays of records indexing into a buffer.
+ *
+ * gas_flat_read_buf() parses a buffer into three contiguous arrays: chunk
+ * records, attribute records, and child indices.  Records refer to each
+ * other by 32 bit index, and to ids, keys, values and payloads by offset into
+ * the source buffer, which must outlive the flat tree.  Nothing is copied,
+ * and the fields are not null terminated.
+ *
+ * Chunks are stored depth first, so the root is chunk 0.  The accessors
+ * mirror their @ref access counterparts, taking a chunk index in place of a
+ * GASchunk.
+ */
+/*@{*/
+
+/**
+ * @brief An invalid index, such as the parent of the root.
+ */
+#define GAS_FLAT_NONE 0xffffffffu
+
+typedef struct
+{
+    uint32_t parent;
+    uint32_t size;
+    uint32_t id_offset;
+    uint32_t id_size;
+    uint32_t first_attribute;
+    uint32_t nb_attributes;
+    uint32_t payload_offset;
+    uint32_t payload_size;
+    /** @brief Start of this chunk's range in GASflat::children. */
+    uint32_t first_child;
+    uint32_t nb_children;
+} GASflat_chunk;
+
+typedef struct
+{
+    uint32_t key_offset;
+    uint32_t key_size;
+    uint32_t value_offset;
+    uint32_t value_size;
+} GASflat_attribute;
+
+typedef struct
+{
+    const GASubyte* buf;
+
+    uint32_t nb_chunks;
+    uint32_t chunks_capacity;
+    GASflat_chunk* chunks;
+
+    uint32_t nb_attributes;
+    uint32_t attributes_capacity;
+    GASflat_attribute* attributes;
+
+    uint32_t nb_children;
+    uint32_t children_capacity;
+    uint32_t* children;
+
+    GASvoid* user_data;
+} GASflat;
+
+GASnum gas_flat_read_buf (const GASubyte* buf, GASunum limit, GASflat** out,
+                          GASvoid* DEFAULT_NULL(user_data));
+GASresult gas_flat_destroy (GASflat* f);
+
+const GASubyte* gas_flat_get_id (const GASflat* f, uint32_t c, GASunum* len);
+GASbool gas_flat_id_is (const GASflat* f, uint32_t c, const GASchar* id);
+
+GASnum gas_flat_index_of_attribute (const GASflat* f, uint32_t c,
+                                    const GASvoid* key, GASunum key_size);
+GASbool gas_flat_has_attribute (const GASflat* f, uint32_t c,
+                                const GASvoid* key, GASunum key_size);
+const GASubyte* gas_flat_get_attribute_at (const GASflat* f, uint32_t c,
+                                           GASunum index, GASunum* len);
+const GASubyte* gas_flat_get_attribute (const GASflat* f, uint32_t c,
+                                        const GASvoid* key, GASunum key_size,
+                                        GASunum* len);
+
+const GASubyte* gas_flat_get_payload (const GASflat* f, uint32_t c,
+                                      GASunum* len);
+
+uint32_t gas_flat_get_parent (const GASflat* f, uint32_t c);
+GASunum gas_flat_nb_children (const GASflat* f, uint32_t c);
+uint32_t gas_flat_get_child_at (const GASflat* f, uint32_t c, GASunum index);
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_FLAT_H defined */
+
+/* vim: set sw=4 fdm=marker :*/
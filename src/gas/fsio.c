@@ -21,6 +21,7 @@
  */
 
 #include "fsio.h"
+#include "codec.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -33,63 +34,18 @@
 /* gas_write_encoded_num_fs() {{{*/
 GASresult gas_write_encoded_num_fs (FILE* fs, GASunum value)
 {
-    GASunum i, coded_length;
-    GASubyte byte, mask;
-    GASunum zero_count, zero_bytes, zero_bits;
-    GASnum si;  /* a signed i */
+    GASubyte buf[GAS_CODEC_MAX_LENGTH];
+    GASnum length;
 
     GAS_CHECK_PARAM(fs);
 
-    for (i = 1; 1; i++) {
-        if (value < ((1UL << (7UL*i))-1UL)) {
-            break;
-        }
-        if ((i * 7L) > (sizeof(GASunum) << 3)) {
-            /* warning, close to overflow */
-            /* i--; */
-            break;
-        }
-    }
-    coded_length = i;  /* not including header */
-
-    zero_count = coded_length - 1;
-    zero_bytes = zero_count / 8;
-    zero_bits = zero_count % 8;
-
-    byte = 0x0;
-    for (i = 0; i < zero_bytes; i++) {
-        if (fwrite(&byte, 1, 1, fs) != 1) {
-            return GAS_ERR_UNKNOWN;
-        }
-    }
-
-    mask = 0x80;
-    mask >>= zero_bits;
-
-    /* write the first masked byte */
-    /*if ((coded_length - 1) <= sizeof(GASunum)) {*/
-    if (coded_length <= sizeof(GASunum)) {
-        byte = mask | ((value >> ((coded_length-zero_bytes-1)<<3)) & 0xff);
-    } else {
-        byte = mask;
-    }
-    if (fwrite(&byte, 1, 1, fs) != 1) {
+    length = gas_codec_encode(buf, sizeof(buf), value);
+    if (length <= 0) {
         return GAS_ERR_UNKNOWN;
     }
 
-    /*
-     * write remaining bytes
-     * from coded length, subtract 1 byte because we count down to zero
-     * subtract an addition byte because one was already or'ed with the mask
-     *
-     * @internal
-     * @todo figure out why zero_bytes is subtracted
-     */
-    for (si = coded_length - 2 - zero_bytes; si >= 0; si--) {
-        byte = ((value >> (si<<3)) & 0xff);
-        if (fwrite(&byte, 1, 1, fs) != 1) {
-            return GAS_ERR_UNKNOWN;
-        }
+    if (fwrite(buf, 1, length, fs) != (size_t)length) {
+        return GAS_ERR_UNKNOWN;
     }
 
     return GAS_OK;
@@ -115,6 +71,8 @@ GASresult gas_write_fs (FILE* fs, GASchunk* self)
 
     GAS_CHECK_PARAM(fs);
     GAS_CHECK_PARAM(self);
+    /* children not read yet cannot be written, see @ref lazy */
+    if (self->lazy != NULL) { return GAS_ERR_INVALID_PARAM; }
 
     /* this GASchunk's size */
     result = gas_write_encoded_num_fs(fs, self->size);
@@ -151,67 +109,42 @@ GASresult gas_write_fs (FILE* fs, GASchunk* self)
 /* gas_read_encoded_num_fs() {{{*/
 GASresult gas_read_encoded_num_fs (FILE* fs, GASunum *value)
 {
-    GASunum retval = 0x0;
-    GASunum i, bytes_read, zero_byte_count, first_bit_set;
-    GASubyte byte, mask = 0x00;
-    GASunum additional_bytes_to_read;
+    GASubyte buf[GAS_CODEC_MAX_LENGTH];
+    GASnum length;
+    GASunum have = 0;
 
     GAS_CHECK_PARAM(fs);
     GAS_CHECK_PARAM(value);
 
-    /* find first non 0x00 byte */
-    for (zero_byte_count = 0; 1; zero_byte_count++) {
-        bytes_read = fread(&byte, 1, 1, fs);
-        if (feof(fs)) {
-            return GAS_ERR_FILE_EOF;
-        }
-        if (bytes_read == 0) {
-            return GAS_ERR_UNKNOWN;
-        }
-        if (bytes_read != 1) {
-            return GAS_ERR_UNKNOWN;
+    /* leading bytes, until the length is known */
+    do {
+        if (fread(buf + have, 1, 1, fs) != 1) {
+            return feof(fs) ? GAS_ERR_FILE_EOF : GAS_ERR_UNKNOWN;
         }
-        if (byte != 0x00)
-            break;
-    }
-
-    /* process initial byte */
-    for (first_bit_set = 7; first_bit_set >= 0; first_bit_set--)
-        if (byte & (1L << first_bit_set))
-            break;
-
-    for (i = 0; i < first_bit_set; i++)
-        mask |= (1L << i);
+        have++;
+        length = gas_codec_peek_length(buf, have);
+    } while (length == 0);
 
-    additional_bytes_to_read = (7-first_bit_set) + (7*zero_byte_count);
+    if (length < 0) {
+        return length;
+    }
 
-    /* at this point, i have enough information to construct retval */
-    retval = mask & byte;
-    for (i = 0; i < additional_bytes_to_read; i++) {
-        bytes_read = fread(&byte, 1, 1, fs);
-        if (feof(fs)) {
-            return GAS_ERR_FILE_EOF;
-        }
-        if (bytes_read == 0) {
-            return GAS_ERR_UNKNOWN;
-        }
-        if (bytes_read != 1) {
-            return GAS_ERR_UNKNOWN;
-        }
-        retval = (retval << 8) | byte;
+    /* remainder of the number */
+    if (fread(buf + have, 1, length - have, fs) != length - have) {
+        return feof(fs) ? GAS_ERR_FILE_EOF : GAS_ERR_UNKNOWN;
     }
 
-    *value = retval;
-    return GAS_OK;
+    length = gas_codec_decode(buf, length, value);
+    return length < 0 ? length : GAS_OK;
 }
 /*}}}*/
 /* gas_read_fs() {{{*/
 
-#define read_field(field)                                                   \
+#define read_field(field, local)                                            \
     do {                                                                    \
         result = gas_read_encoded_num_fs(fs, &field##_size);                \
         if (result != GAS_OK) { return result; }                            \
-        field = (GASubyte*)gas_alloc(field##_size + 1, user_data);          \
+        field = gas_field_alloc(local, field##_size, user_data);            \
         GAS_CHECK_MEM(field);                                               \
         if (fread(field, 1, field##_size, fs) != field##_size) {            \
             if (feof(fs)) { return GAS_ERR_FILE_EOF; }                      \
@@ -233,7 +166,7 @@ GASresult gas_read_fs (FILE* fs, GASchunk **out, GASvoid* user_data)
 
     result = gas_read_encoded_num_fs(fs, &c->size);
     if (result != GAS_OK) { return result; }
-    read_field(c->id);
+    read_field(c->id, c->id_inline);
     result = gas_read_encoded_num_fs(fs, &c->nb_attributes);
     if (result != GAS_OK) { return result; }
     if (c->nb_attributes > 0) {
@@ -241,18 +174,22 @@ GASresult gas_read_fs (FILE* fs, GASchunk **out, GASvoid* user_data)
             c->nb_attributes * sizeof(GASattribute), user_data
             );
         GAS_CHECK_MEM(c->attributes);
+        c->attributes_capacity = c->nb_attributes;
+        memset(c->attributes, 0, c->nb_attributes * sizeof(GASattribute));
     }
     for (i = 0; i < c->nb_attributes; i++) {
-        read_field(c->attributes[i].key);
-        read_field(c->attributes[i].value);
+        read_field(c->attributes[i].key, c->attributes[i].key_inline);
+        read_field(c->attributes[i].value,
+                   c->attributes[i].value_inline);
     }
-    read_field(c->payload);
+    read_field(c->payload, NULL);
     result = gas_read_encoded_num_fs(fs, &c->nb_children);
     if (result != GAS_OK) { return result; }
     if (c->nb_children > 0) {
         c->children = (GASchunk**)gas_alloc(c->nb_children * sizeof(GASchunk*),
                                             user_data);
         GAS_CHECK_MEM(c->children);
+        c->children_capacity = c->nb_children;
     }
     for (i = 0; i < c->nb_children; i++) {
          result = gas_read_fs(fs, &c->children[i], user_data);
@@ -0,0 +1,315 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file intern.c
+ * @brief intern table implementation
+ */
+
+#include "intern.h"
+
+#include <string.h>
+
+/* gas_intern_new() {{{*/
+GASresult gas_intern_new (GASintern** table, GASvoid* user_data)
+{
+    GASintern* t;
+
+    GAS_CHECK_PARAM(table);
+
+    t = (GASintern*)gas_alloc(sizeof(GASintern), user_data);
+    GAS_CHECK_MEM(t);
+    memset(t, 0, sizeof(GASintern));
+    t->user_data = user_data;
+
+    *table = t;
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_intern_destroy() {{{*/
+/**
+ * @brief Release the table, and the bytes it interned.
+ */
+GASresult gas_intern_destroy (GASintern* t)
+{
+    GASunum i;
+
+    GAS_CHECK_PARAM(t);
+
+    for (i = 0; i < t->nb_symbols; i++) {
+        gas_free(t->strings[i], t->user_data);
+    }
+    gas_free(t->strings, t->user_data);
+    gas_free(t->sizes, t->user_data);
+    gas_free(t->buckets, t->user_data);
+    gas_free(t, t->user_data);
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_intern_find() {{{*/
+/**
+ * @return The slot holding @a bytes, or the empty slot where they belong.
+ */
+static GASunum gas_intern_find (GASintern* t, const GASvoid* bytes,
+                                GASunum size)
+{
+    GASunum mask = t->nb_buckets - 1;
+    GASunum slot = gas_hash(bytes, size) & mask;
+    GASunum symbol;
+
+    while ((symbol = t->buckets[slot]) != 0) {
+        if (t->sizes[symbol - 1] == size &&
+            memcmp(t->strings[symbol - 1], bytes, size) == 0)
+        {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+/*}}}*/
+/* gas_intern_rehash() {{{*/
+/**
+ * @brief Double the hash, keeping it at most half full.
+ */
+static GASresult gas_intern_rehash (GASintern* t)
+{
+    GASunum* old = t->buckets;
+    GASunum size = t->nb_buckets > 0 ? t->nb_buckets * 2 : 64;
+    GASunum i;
+
+    t->buckets = (GASunum*)gas_alloc(size * sizeof(GASunum), t->user_data);
+    if (t->buckets == NULL) {
+        t->buckets = old;
+        return GAS_ERR_MEMORY;
+    }
+    memset(t->buckets, 0, size * sizeof(GASunum));
+    t->nb_buckets = size;
+
+    for (i = 0; i < t->nb_symbols; i++) {
+        t->buckets[gas_intern_find(t, t->strings[i], t->sizes[i])] = i + 1;
+    }
+    gas_free(old, t->user_data);
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_intern() {{{*/
+/**
+ * @brief Add @a bytes to the table, unless they are already there.
+ *
+ * @return When positive, the symbol of @a bytes.  Otherwise, an error code.
+ */
+GASnum gas_intern (GASintern* t, const GASvoid* bytes, GASunum size)
+{
+    GASunum slot, capacity;
+    GASresult result;
+    GASubyte* copy;
+    GASvoid* tmp;
+
+    GAS_CHECK_PARAM(t);
+    GAS_CHECK_PARAM(bytes);
+
+    if (t->nb_buckets == 0 || (t->nb_symbols + 1) * 2 > t->nb_buckets) {
+        result = gas_intern_rehash(t);
+        if (result != GAS_OK) { return result; }
+    }
+
+    slot = gas_intern_find(t, bytes, size);
+    if (t->buckets[slot] != 0) {
+        return t->buckets[slot];
+    }
+
+    if (t->nb_symbols == t->capacity) {
+        /* capacity only grows once both arrays have; a larger strings array
+         * left by a failure below is harmless */
+        capacity = t->capacity > 0 ? t->capacity * 2 : 32;
+        tmp = gas_realloc(t->strings, capacity * sizeof(GASubyte*),
+                          t->user_data);
+        GAS_CHECK_MEM(tmp);
+        t->strings = (GASubyte**)tmp;
+        tmp = gas_realloc(t->sizes, capacity * sizeof(GASunum),
+                          t->user_data);
+        GAS_CHECK_MEM(tmp);
+        t->sizes = (GASunum*)tmp;
+        t->capacity = capacity;
+    }
+
+    copy = (GASubyte*)gas_alloc(size + 1, t->user_data);
+    GAS_CHECK_MEM(copy);
+    memcpy(copy, bytes, size);
+    copy[size] = 0;
+
+    t->strings[t->nb_symbols] = copy;
+    t->sizes[t->nb_symbols] = size;
+    t->nb_symbols++;
+    t->buckets[slot] = t->nb_symbols;
+
+    return t->nb_symbols;
+}
+/*}}}*/
+/* gas_intern_lookup() {{{*/
+/**
+ * @brief The symbol of @a bytes, without adding them.
+ *
+ * @return The symbol, or 0 when @a bytes are not interned.
+ */
+GASnum gas_intern_lookup (GASintern* t, const GASvoid* bytes, GASunum size)
+{
+    GAS_CHECK_PARAM(t);
+    GAS_CHECK_PARAM(bytes);
+
+    if (t->nb_buckets == 0) {
+        return 0;
+    }
+    return t->buckets[gas_intern_find(t, bytes, size)];
+}
+/*}}}*/
+/* gas_intern_bytes() {{{*/
+/**
+ * @return The interned bytes of @a symbol, or NULL if there is no such
+ * symbol.
+ */
+const GASubyte* gas_intern_bytes (GASintern* t, GASunum symbol,
+                                  GASunum* size)
+{
+    if (t == NULL || symbol == 0 || symbol > t->nb_symbols) {
+        return NULL;
+    }
+    if (size) {
+        *size = t->sizes[symbol - 1];
+    }
+    return t->strings[symbol - 1];
+}
+/*}}}*/
+
+/** @name trees */
+/*@{*/
+/* gas_intern_chunk() {{{*/
+/**
+ * @brief Replace the id and attribute keys of @a c, but not those of its
+ * children, with the table's copies.
+ */
+GASresult gas_intern_chunk (GASintern* t, GASchunk* c)
+{
+    GASattribute* a;
+    GASnum symbol;
+    GASunum i;
+
+    GAS_CHECK_PARAM(t);
+    GAS_CHECK_PARAM(c);
+
+    if (c->id != NULL && c->id_symbol == 0) {
+        symbol = gas_intern(t, c->id, c->id_size);
+        if (symbol < 0) { return symbol; }
+        gas_field_free(c->id, c->id_inline, c->user_data);
+        c->id = t->strings[symbol - 1];
+        c->id_symbol = symbol;
+    }
+
+    for (i = 0; i < c->nb_attributes; i++) {
+        a = &c->attributes[i];
+        if (a->key == NULL || a->key_symbol != 0) {
+            continue;
+        }
+        symbol = gas_intern(t, a->key, a->key_size);
+        if (symbol < 0) { return symbol; }
+        gas_field_free(a->key, a->key_inline, c->user_data);
+        a->key = t->strings[symbol - 1];
+        a->key_symbol = symbol;
+    }
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_intern_tree() {{{*/
+GASresult gas_intern_tree (GASintern* t, GASchunk* c)
+{
+    GASresult result;
+    GASunum i;
+
+    result = gas_intern_chunk(t, c);
+    if (result != GAS_OK) { return result; }
+
+    for (i = 0; i < c->nb_children; i++) {
+        if (c->children[i] == NULL) {
+            /* pruned by the parser */
+            continue;
+        }
+        result = gas_intern_tree(t, c->children[i]);
+        if (result != GAS_OK) { return result; }
+    }
+
+    return GAS_OK;
+}
+/*}}}*/
+/*@}*/
+
+/** @name symbol access */
+/*@{*/
+/* gas_id_is_symbol() {{{*/
+/**
+ * @brief Checks to see if the id of @a c was interned as @a symbol.
+ */
+GASbool gas_id_is_symbol (const GASchunk* c, GASunum symbol)
+{
+    return c != NULL && symbol != 0 && c->id_symbol == symbol;
+}
+/*}}}*/
+/* gas_index_of_attribute_symbol() {{{*/
+/**
+ * @return signed index
+ * @retval GAS_ERR_ATTR_NOT_FOUND failure, attribute not found
+ */
+GASnum gas_index_of_attribute_symbol (GASchunk* c, GASunum symbol)
+{
+    GASunum i;
+
+    GAS_CHECK_PARAM(c);
+
+    if (symbol != 0) {
+        for (i = 0; i < c->nb_attributes; i++) {
+            if (c->attributes[i].key_symbol == symbol) {
+                return i;
+            }
+        }
+    }
+    return GAS_ERR_ATTR_NOT_FOUND;
+}
+/*}}}*/
+/* gas_get_child_by_symbol() {{{*/
+/**
+ * @return The first child whose id was interned as @a symbol, or NULL.
+ */
+GASchunk* gas_get_child_by_symbol (GASchunk* c, GASunum symbol)
+{
+    GASunum i;
+
+    if (c == NULL || symbol == 0) {
+        return NULL;
+    }
+    for (i = 0; i < c->nb_children; i++) {
+        if (c->children[i] != NULL && c->children[i]->id_symbol == symbol) {
+            return c->children[i];
+        }
+    }
+    return NULL;
+}
+/*}}}*/
+/*@}*/
+
+/* vim: set sw=4 fdm=marker :*/
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file intern.h
+ * @brief intern table definition
+ */
+
+#ifndef GAS_INTERN_H
+#define GAS_INTERN_H
+
+#include "tree.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+/*}*/
+#endif
+
+/**
+ * @defgroup intern Intern Table
+ * @ingroup access
+ * @brief Shared storage, and integer symbols, for repeated ids and keys.
+ *
+ * gas_intern_tree(), or a parser given a table, replaces the ids and
+ * attribute keys of a tree with the table's single copy of each, and
+ * records its symbol in GASchunk::id_symbol and GASattribute::key_symbol.
+ * Symbols start at 1; 0 marks bytes that are not interned.
+ *
+ * @code
+ * GASnum item = gas_intern(t, "item", 4);
+ * for (i = 0; i < gas_nb_children(root); i++) {
+ *     if (gas_id_is_symbol(gas_get_child_at(root, i), item)) {
+ *         ...
+ *     }
+ * }
+ * @endcode
+ *
+ * Interned bytes belong to the table, so the table must outlive the trees
+ * using it, and a tree should only be interned in one table.  Setting an id,
+ * or editing a key through the tree functions, gives the chunk its own copy
+ * again.
+ */
+/*@{*/
+
+typedef struct
+{
+    GASunum nb_symbols;
+    /** @brief The interned bytes by symbol - 1, each null terminated. */
+    GASubyte** strings;
+    GASunum* sizes;
+    GASunum capacity;
+
+    /** @brief Open addressing hash of the symbols, by their bytes. */
+    GASunum* buckets;
+    GASunum nb_buckets;
+
+    GASvoid* user_data;
+} GASintern;
+
+GASresult gas_intern_new (GASintern** table,
+                          GASvoid* DEFAULT_NULL(user_data));
+GASresult gas_intern_destroy (GASintern* t);
+
+GASnum gas_intern (GASintern* t, const GASvoid* bytes, GASunum size);
+GASnum gas_intern_lookup (GASintern* t, const GASvoid* bytes, GASunum size);
+const GASubyte* gas_intern_bytes (GASintern* t, GASunum symbol,
+                                  GASunum* DEFAULT_NULL(size));
+
+GASresult gas_intern_chunk (GASintern* t, GASchunk* c);
+GASresult gas_intern_tree (GASintern* t, GASchunk* c);
+
+GASbool gas_id_is_symbol (const GASchunk* c, GASunum symbol);
+GASnum gas_index_of_attribute_symbol (GASchunk* c, GASunum symbol);
+GASchunk* gas_get_child_by_symbol (GASchunk* c, GASunum symbol);
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_INTERN_H defined */
+
+/* vim: set sw=4 fdm=marker :*/
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file lazy.c
+ * @brief lazy reading implementation
+ */
+
+#include "lazy.h"
+
+#include <string.h>
+
+#if HAVE_STDIO_H
+#include <stdio.h>
+#endif
+
+/* recently used list {{{*/
+static GASvoid gas_lazy_unlink (struct GASlazy* lru, GASlazy_link* link)
+{
+    if (link->prev) {
+        link->prev->next = link->next;
+    } else {
+        lru->head = link->next;
+    }
+    if (link->next) {
+        link->next->prev = link->prev;
+    } else {
+        lru->tail = link->prev;
+    }
+    lru->count--;
+}
+
+static GASvoid gas_lazy_push (struct GASlazy* lru, GASlazy_link* link)
+{
+    link->prev = NULL;
+    link->next = lru->head;
+    if (lru->head) {
+        lru->head->prev = link;
+    } else {
+        lru->tail = link;
+    }
+    lru->head = link;
+    lru->count++;
+}
+
+/**
+ * @brief Whether @a c is @a below, or above it.
+ */
+static GASbool gas_lazy_holds (GASchunk* c, GASchunk* below)
+{
+    for (; below != NULL; below = below->parent) {
+        if (below == c) {
+            return GAS_TRUE;
+        }
+    }
+    return GAS_FALSE;
+}
+
+/**
+ * @brief Release the least recently used subtrees beyond the limit, except
+ * those holding @a keep.
+ */
+static GASvoid gas_lazy_evict (GASparser* p, GASchunk* keep)
+{
+    struct GASlazy* lru = p->lru;
+    GASlazy_link* link = lru->tail;
+    GASchunk* parent;
+    GASchunk* victim;
+
+    while (lru->count > p->lazy_limit && link != NULL) {
+        parent = link->parent;
+        victim = parent->children[link->index];
+        if (gas_lazy_holds(victim, keep)) {
+            link = link->prev;
+            continue;
+        }
+
+        gas_lazy_unlink(lru, link);
+        parent->lazy->links[link->index] = NULL;
+        parent->children[link->index] = NULL;
+        gas_free(link, parent->user_data);
+
+        if (victim->refs > 1) {
+            /* kept by gas_clone(), it is no longer this parent's */
+            victim->parent = NULL;
+            victim->detached = GAS_TRUE;
+        }
+        gas_destroy(victim);
+
+        /* the links of the victim's children went with it */
+        link = lru->tail;
+    }
+}
+/*}}}*/
+
+/* gas_lazy_new() {{{*/
+/**
+ * @brief Give @a c, whose children are about to be skipped, room for
+ * their offsets.
+ */
+GASresult gas_lazy_new (GASparser* p, GASchunk* c)
+{
+    struct GASlazy_children* r;
+    GASunum n = c->nb_children;
+
+    GAS_CHECK_PARAM(p);
+    GAS_CHECK_PARAM(c);
+
+    r = (struct GASlazy_children*)gas_alloc(sizeof(struct GASlazy_children),
+                                            c->user_data);
+    GAS_CHECK_MEM(r);
+    memset(r, 0, sizeof(struct GASlazy_children));
+    r->parser = p;
+    c->lazy = r;
+
+    r->offsets = (GASunum*)gas_alloc(n * sizeof(GASunum), c->user_data);
+    GAS_CHECK_MEM(r->offsets);
+    if (p->lazy_limit > 0) {
+        r->links = (GASlazy_link**)gas_alloc(n * sizeof(GASlazy_link*),
+                                             c->user_data);
+        GAS_CHECK_MEM(r->links);
+        memset(r->links, 0, n * sizeof(GASlazy_link*));
+    }
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_lazy_release() {{{*/
+/**
+ * @brief Forget where the children of @a c are, as it is destroyed.
+ */
+GASvoid gas_lazy_release (GASchunk* c)
+{
+    struct GASlazy_children* r = c->lazy;
+    GASunum i;
+
+    if (r == NULL) {
+        return;
+    }
+
+    if (r->links) {
+        for (i = 0; i < c->nb_children; i++) {
+            if (r->links[i] != NULL) {
+                gas_lazy_unlink(r->parser->lru, r->links[i]);
+                gas_free(r->links[i], c->user_data);
+            }
+        }
+        gas_free(r->links, c->user_data);
+    }
+    gas_free(r->offsets, c->user_data);
+    gas_free(r, c->user_data);
+    c->lazy = NULL;
+}
+/*}}}*/
+/* gas_load_child_at() {{{*/
+/**
+ * @brief The child of @a c at @a index, read first if it was not yet.
+ *
+ * Unlike gas_get_child_at(), reports why a child could not be read.
+ *
+ * @param child Receives the child, or NULL when the parser's callbacks
+ * pruned it.
+ */
+GASresult gas_load_child_at (GASchunk* c, GASunum index, GASchunk** child)
+{
+    struct GASlazy_children* r;
+    GASlazy_link* link;
+    GASparser* p;
+    GASchunk* loaded = NULL;
+    GASresult result;
+
+    GAS_CHECK_PARAM(c);
+    GAS_CHECK_PARAM(child);
+
+    if (index >= c->nb_children) {
+        return GAS_ERR_OUT_OF_RANGE;
+    }
+
+    r = c->lazy;
+    if (r == NULL || c->children[index] != NULL) {
+        if (r != NULL && r->links != NULL && r->links[index] != NULL) {
+            gas_lazy_unlink(r->parser->lru, r->links[index]);
+            gas_lazy_push(r->parser->lru, r->links[index]);
+        }
+        *child = c->children[index];
+        return GAS_OK;
+    }
+
+    p = r->parser;
+    p->buffer_pos = 0;
+    p->buffer_end = 0;
+    p->offset = r->offsets[index];
+    if (!gas_context_has(p->context, pread)) {
+        result = gas_context_seek(p->context, p->handle, p->offset,
+                                  GAS_SEEK_SET);
+        if (result != GAS_OK) { return result; }
+    }
+
+    result = gas_read_parser(p, &loaded, c->user_data);
+    if (result != GAS_OK) { return result; }
+
+    *child = loaded;
+    if (loaded == NULL) {
+        return GAS_OK;
+    }
+    loaded->parent = c;
+    c->children[index] = loaded;
+
+    if (r->links != NULL) {
+        link = (GASlazy_link*)gas_alloc(sizeof(GASlazy_link), c->user_data);
+        GAS_CHECK_MEM(link);
+        link->parent = c;
+        link->index = index;
+        r->links[index] = link;
+        gas_lazy_push(p->lru, link);
+        gas_lazy_evict(p, loaded);
+    }
+
+    return GAS_OK;
+}
+/*}}}*/
+
+/* vim: set sw=4 fdm=marker :*/
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file lazy.h
+ * @brief lazy reading definition
+ */
+
+#ifndef GAS_LAZY_H
+#define GAS_LAZY_H
+
+#include "parser.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+/*}*/
+#endif
+
+/**
+ * @defgroup lazy Lazy Reading
+ * @ingroup io
+ * @brief Trees whose children are read from the input when first accessed.
+ *
+ * With GASparser::lazy set, gas_read_parser() reads the fields of a chunk,
+ * then only the size of each child, seeking over the rest.  The offsets are
+ * kept in GASchunk::lazy, and the children are left NULL until
+ * gas_get_child_at(), gas_get_child_by_id() or gas_load_child_at() reads
+ * them, just as lazily.  A few leaves of a large file cost a few reads:
+ *
+ * @code
+ * ctx->open("archive.gas", "rb", &handle, &ctx->user_data);
+ * gas_parser_new(&p, ctx, handle);
+ * p->lazy = GAS_TRUE;
+ * p->lazy_limit = 64;
+ * gas_read_parser(p, &root);
+ * leaf = gas_get_child_at(gas_get_child_at(root, 3), 7);
+ * ...
+ * gas_destroy(root);
+ * gas_parser_destroy(p);
+ * ctx->close(handle, ctx->user_data);
+ * @endcode
+ *
+ * Children are read at their offset with the context's pread, or after a
+ * seek otherwise, so GASparser::offset must match the handle's position
+ * when the tree is read.
+ *
+ * With GASparser::lazy_limit, loaded subtrees are released, least recently
+ * accessed first, beyond that many; only the chunks above the one just
+ * loaded are spared.  A chunk returned earlier may be gone after the next
+ * access, unless kept with gas_clone().
+ *
+ * A lazy tree is read only.  The mutators, gas_unshare() and
+ * gas_writable_child() refuse its chunks with GAS_ERR_INVALID_PARAM, as
+ * does gas_add_child() with a lazily read child.  The writers refuse it too,
+ * before writing anything; read it without GASparser::lazy to write it.
+ */
+/*@{*/
+
+/**
+ * @brief A loaded child, in the recently used list of its parser.
+ */
+typedef struct GASlazy_link
+{
+    /** @brief More recently used. */
+    struct GASlazy_link* prev;
+    /** @brief Less recently used. */
+    struct GASlazy_link* next;
+    GASchunk* parent;
+    GASunum index;
+} GASlazy_link;
+
+/**
+ * @brief The children of a chunk not read yet, see GASchunk::lazy.
+ */
+struct GASlazy_children
+{
+    GASparser* parser;
+    /** @brief Position of each child in the input. */
+    GASunum* offsets;
+    /**
+     * @brief The link of each loaded child, or NULL.  Only allocated with a
+     * GASparser::lazy_limit.
+     */
+    GASlazy_link** links;
+};
+
+/**
+ * @brief The loaded children of a parser, most recently used first.
+ */
+struct GASlazy
+{
+    GASlazy_link* head;
+    GASlazy_link* tail;
+    GASunum count;
+};
+
+GASresult gas_load_child_at (GASchunk* c, GASunum index, GASchunk** child);
+
+/**
+ * @name internal
+ * @brief used by the parser and the tree.
+ */
+/*@{*/
+GASresult gas_lazy_new (GASparser* p, GASchunk* c);
+GASvoid gas_lazy_release (GASchunk* c);
+/*@}*/
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_LAZY_H defined */
+
+/* vim: set sw=4 fdm=marker :*/
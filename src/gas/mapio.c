@@ -0,0 +1,256 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file mapio.c
+ * @brief Memory mapped file context.
+ */
+
+#include "mapio.h"
+
+#include <string.h>
+
+#if HAVE_STDIO_H
+#include <stdio.h>
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** @name callbacks */
+/*@{*/
+/* gas_map_open() {{{*/
+/**
+ * @brief Map all of @a name, which may only be opened for reading.
+ */
+GASresult gas_map_open (const char *name, const char *mode,
+                        void **handle, void **userdata)
+{
+    GASmap* map;
+    struct stat st;
+    void* data = NULL;
+    int fd;
+
+    GAS_CHECK_PARAM(name);
+    GAS_CHECK_PARAM(handle);
+
+    if (mode != NULL && strpbrk(mode, "wa+") != NULL) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    fd = open(name, O_RDONLY);
+    if (fd < 0) {
+        return GAS_ERR_FILE_NOT_FOUND;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return GAS_ERR_UNKNOWN;
+    }
+    if ((off_t)(size_t)st.st_size != st.st_size) {
+        close(fd);
+        return GAS_ERR_OUT_OF_RANGE;
+    }
+    /* an empty file has nothing to map */
+    if (st.st_size > 0) {
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        return GAS_ERR_UNKNOWN;
+    }
+
+    map = (GASmap*)gas_alloc(sizeof(GASmap), NULL);
+    if (map == NULL) {
+        if (data != NULL) {
+            munmap(data, (size_t)st.st_size);
+        }
+        return GAS_ERR_MEMORY;
+    }
+    map->data = (GASubyte*)data;
+    map->size = (GASunum)st.st_size;
+    map->pos = 0;
+
+    if (userdata) {
+        *userdata = NULL;
+    }
+    *handle = map;
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_map_close() {{{*/
+/**
+ * @brief Unmap the file; fields borrowed from it are no longer valid.
+ */
+GASresult gas_map_close (void *handle, void *userdata)
+{
+    GASmap* map = (GASmap*)handle;
+
+    GAS_CHECK_PARAM(map);
+
+    if (map->data != NULL) {
+        munmap(map->data, map->size);
+    }
+    gas_free(map, NULL);
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_map_read64() {{{*/
+GASresult gas_map_read64 (void *handle, void *buffer, size_t size,
+                          size_t *done, void *userdata)
+{
+    GASmap* map = (GASmap*)handle;
+    GASresult result;
+
+    GAS_CHECK_PARAM(map);
+
+    result = gas_map_pread(handle, buffer, size, map->pos, done, userdata);
+    map->pos += *done;
+    return result;
+}
+/*}}}*/
+/* gas_map_read() {{{*/
+GASresult gas_map_read (void *handle, void *buffer, unsigned int sizebytes,
+                        unsigned int *bytesread, void *userdata)
+{
+    GASresult result;
+    size_t done = 0;
+
+    GAS_CHECK_PARAM(bytesread);
+
+    result = gas_map_read64(handle, buffer, sizebytes, &done, userdata);
+    *bytesread = (unsigned int)done;
+    return result;
+}
+/*}}}*/
+/* gas_map_write() {{{*/
+/**
+ * @brief Refuse to write: mappings are opened read only.
+ */
+GASresult gas_map_write (void *handle, void *buffer, unsigned int sizebytes,
+                         unsigned int *byteswritten, void *userdata)
+{
+    if (byteswritten != NULL) {
+        *byteswritten = 0;
+    }
+    return GAS_ERR_UNKNOWN;
+}
+/*}}}*/
+/* gas_map_seek64() {{{*/
+/**
+ * @brief Move the position, which is allowed past the end, as with lseek().
+ */
+GASresult gas_map_seek64 (void *handle, int64_t pos, int whence,
+                          void *userdata)
+{
+    GASmap* map = (GASmap*)handle;
+    int64_t base;
+
+    GAS_CHECK_PARAM(map);
+
+    switch (whence) {
+        case GAS_SEEK_SET: base = 0; break;
+        case GAS_SEEK_CUR: base = (int64_t)map->pos; break;
+        case GAS_SEEK_END: base = (int64_t)map->size; break;
+        default: return GAS_ERR_INVALID_PARAM;
+    }
+    if (base + pos < 0) {
+        return GAS_ERR_OUT_OF_RANGE;
+    }
+    map->pos = (GASunum)(base + pos);
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_map_seek() {{{*/
+GASresult gas_map_seek (void *handle, unsigned long pos, int whence,
+                        void *userdata)
+{
+    return gas_map_seek64(handle, (int64_t)pos, whence, userdata);
+}
+/*}}}*/
+/* gas_map_pread() {{{*/
+GASresult gas_map_pread (void *handle, void *buffer, size_t size,
+                         uint64_t offset, size_t *done, void *userdata)
+{
+    GASmap* map = (GASmap*)handle;
+    size_t n = 0;
+
+    GAS_CHECK_PARAM(map);
+    GAS_CHECK_PARAM(done);
+
+    if (offset < map->size) {
+        n = map->size - offset;
+        if (n > size) {
+            n = size;
+        }
+        memcpy(buffer, map->data + offset, n);
+    }
+    *done = n;
+    return n < size ? GAS_ERR_FILE_EOF : GAS_OK;
+}
+/*}}}*/
+/* gas_map_borrow() {{{*/
+GASresult gas_map_borrow (void *handle, uint64_t offset, size_t size,
+                          const void **data, void *userdata)
+{
+    GASmap* map = (GASmap*)handle;
+
+    GAS_CHECK_PARAM(map);
+    GAS_CHECK_PARAM(data);
+
+    if (offset > map->size || size > map->size - offset) {
+        return GAS_ERR_FILE_EOF;
+    }
+    *data = map->data + offset;
+    return GAS_OK;
+}
+/*}}}*/
+/*@}*/
+
+/* gas_map_context_new() {{{*/
+/**
+ * @brief A context reading files through gas_map_open().
+ *
+ * It cannot write.  Its pread callback lets parsers skip by offset alone.
+ */
+GASresult gas_map_context_new (GAScontext** ctx, GASvoid* user_data)
+{
+    GASresult result;
+    GAScontext* c;
+
+    GAS_CHECK_PARAM(ctx);
+
+    result = gas_context_new(&c, user_data);
+    if (result != GAS_OK) { return result; }
+
+    c->open    = gas_map_open;
+    c->close   = gas_map_close;
+    c->read    = gas_map_read;
+    c->write   = gas_map_write;
+    c->seek    = gas_map_seek;
+    c->writev  = NULL;
+    c->read64  = gas_map_read64;
+    c->seek64  = gas_map_seek64;
+    c->pread   = gas_map_pread;
+    c->borrow  = gas_map_borrow;
+
+    *ctx = c;
+    return GAS_OK;
+}
+/*}}}*/
+
+/* vim: set sw=4 fdm=marker :*/
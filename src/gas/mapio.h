@@ -0,0 +1,102 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file mapio.h
+ * @brief mapio definition
+ */
+
+#include "context.h"
+
+#ifndef GAS_MAPIO_H
+#define GAS_MAPIO_H
+
+#ifdef __cplusplus
+extern "C"
+{
+/*}*/
+#endif
+
+
+/**
+ * @defgroup mapio Mapped IO
+ * @ingroup io
+ * @brief A read only context over files mapped into memory.
+ *
+ * Reads are copies out of the mapping, and seeks only move a position, so
+ * pruned chunks and skipped payloads are never touched.  A parser with
+ * GASparser::borrow set copies nothing at all:
+ *
+ * @code
+ * gas_map_context_new(&ctx, NULL);
+ * gas_map_open("archive.gas", "rb", &handle, &ctx->user_data);
+ * gas_parser_new(&p, ctx, handle);
+ * p->borrow = GAS_TRUE;
+ * gas_read_parser(p, &root);      // fields point into the mapping
+ * ...
+ * gas_destroy(root);
+ * gas_map_close(handle, ctx->user_data);
+ * @endcode
+ */
+/*@{*/
+
+/**
+ * @brief The handle of the mapped context.
+ */
+typedef struct
+{
+    GASubyte* data;
+    GASunum size;
+    /** @brief Position of read and seek; pread and borrow ignore it. */
+    GASunum pos;
+} GASmap;
+
+GASresult gas_map_context_new (GAScontext** ctx,
+                               GASvoid* DEFAULT_NULL(user_data));
+
+/**
+ * @name mapped callbacks
+ * @brief installed by gas_map_context_new().
+ */
+/*@{*/
+GASresult gas_map_open (const char *name, const char *mode,
+                        void **handle, void **userdata);
+GASresult gas_map_close (void *handle, void *userdata);
+GASresult gas_map_read (void *handle, void *buffer, unsigned int sizebytes,
+                        unsigned int *bytesread, void *userdata);
+GASresult gas_map_write (void *handle, void *buffer, unsigned int sizebytes,
+                         unsigned int *byteswritten, void *userdata);
+GASresult gas_map_seek (void *handle, unsigned long pos, int whence,
+                        void *userdata);
+GASresult gas_map_read64 (void *handle, void *buffer, size_t size,
+                          size_t *done, void *userdata);
+GASresult gas_map_seek64 (void *handle, int64_t pos, int whence,
+                          void *userdata);
+GASresult gas_map_pread (void *handle, void *buffer, size_t size,
+                         uint64_t offset, size_t *done, void *userdata);
+GASresult gas_map_borrow (void *handle, uint64_t offset, size_t size,
+                          const void **data, void *userdata);
+/*@}*/
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_MAPIO_H defined */
+
+/* vim: set sw=4 fdm=marker :*/
@@ -21,7 +21,120 @@
 #include "memory.h"
 
 #if GAS_DEBUG_MEMORY || defined(DOXYGEN)
+
+#include <string.h>
+#if HAVE_STDIO_H
+#include <stdio.h>
+#endif
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+/*
+ * Each thread counts its own calls, in counters only it writes, so that
+ * they need no lock.  The bytes in use are shared, since memory may be freed
+ * by another thread than the one allocating it, and peak with them.
+ */
+#if defined(__GNUC__)
+#  define GAS_THREAD_LOCAL __thread
+#  define counter_add(c, n) \
+    __atomic_store_n(&(c), (c) + (n), __ATOMIC_RELAXED)
+#  define counter_load(c) __atomic_load_n(&(c), __ATOMIC_RELAXED)
+#  define shared_add(v, n) __atomic_add_fetch(&(v), (n), __ATOMIC_RELAXED)
+#  define shared_sub(v, n) __atomic_sub_fetch(&(v), (n), __ATOMIC_RELAXED)
+#  define shared_max(v, n)                                                  \
+    do {                                                                    \
+        GASunum seen = __atomic_load_n(&(v), __ATOMIC_RELAXED);             \
+        while ((n) > seen &&                                                \
+               !__atomic_compare_exchange_n(&(v), &seen, (n), 1,            \
+                                            __ATOMIC_RELAXED,               \
+                                            __ATOMIC_RELAXED)) {            \
+        }                                                                   \
+    } while (0)
+#  define push_counters(c)                                                  \
+    do {                                                                    \
+        (c)->next = __atomic_load_n(&all_counters, __ATOMIC_ACQUIRE);       \
+    } while (!__atomic_compare_exchange_n(&all_counters, &(c)->next, (c),   \
+                                          1, __ATOMIC_RELEASE,              \
+                                          __ATOMIC_ACQUIRE))
+#  define first_counters() __atomic_load_n(&all_counters, __ATOMIC_ACQUIRE)
+#  define claim_counters(c) \
+    (__atomic_exchange_n(&(c)->in_use, 1, __ATOMIC_ACQUIRE) == 0)
+#  define release_counters(c) \
+    __atomic_store_n(&(c)->in_use, 0, __ATOMIC_RELEASE)
+#else
+/* no thread support known, a single set of counters */
+#  define GAS_THREAD_LOCAL
+#  define counter_add(c, n) ((c) += (n))
+#  define counter_load(c) (c)
+#  define shared_add(v, n) ((v) += (n))
+#  define shared_sub(v, n) ((v) -= (n))
+#  define shared_max(v, n) do { if ((n) > (v)) { (v) = (n); } } while (0)
+#  define push_counters(c) do { (c)->next = all_counters; \
+                                all_counters = (c); } while (0)
+#  define first_counters() all_counters
+#  define claim_counters(c) ((c)->in_use == 0 && ((c)->in_use = 1))
+#  define release_counters(c) ((c)->in_use = 0)
+#endif
+
+/* the spare counters are written by any thread, the others by their owner */
+#define counters_add(c, field, n)                                           \
+    do {                                                                    \
+        if ((c) == &spare_counters) {                                       \
+            shared_add((c)->field, (n));                                    \
+        } else {                                                            \
+            counter_add((c)->field, (n));                                   \
+        }                                                                   \
+    } while (0)
+
+typedef struct GASmemory_counters
+{
+    struct GASmemory_counters* next;
+    /* set while a thread counts in these */
+    int in_use;
+    GASunum allocations;
+    GASunum reallocations;
+    GASunum frees;
+    GASunum histogram[GAS_MEMORY_HISTOGRAM_SIZE];
+} GASmemory_counters;
+
 static GASunum bytes_allocated = 0;
+static GASunum peak_bytes = 0;
+
+/*
+ * Every thread's counters.  They are never unlinked, since gas_memory_stats()
+ * walks the list without a lock; those of a thread that exits keep its
+ * totals and are handed to the next thread that starts counting.
+ */
+static GASmemory_counters* all_counters = NULL;
+static GAS_THREAD_LOCAL GASmemory_counters* thread_counters = NULL;
+/* when a thread's own cannot be allocated, shared by all such threads */
+static GASmemory_counters spare_counters;
+
+#if HAVE_PTHREAD_H
+static pthread_once_t counters_once = PTHREAD_ONCE_INIT;
+static pthread_key_t counters_key;
+static int counters_key_created = 0;
+
+/* gas_memory_release_counters() {{{*/
+/**
+ * Run at the exit of a thread that has counted, to free its counters for
+ * the next thread.
+ */
+static void gas_memory_release_counters (void* counters)
+{
+    thread_counters = NULL;
+    release_counters((GASmemory_counters*)counters);
+}
+/*}}}*/
+/* gas_memory_create_key() {{{*/
+static void gas_memory_create_key (void)
+{
+    counters_key_created =
+        pthread_key_create(&counters_key, gas_memory_release_counters) == 0;
+}
+/*}}}*/
+#endif
 
 struct MemoryHeader
 {
@@ -30,12 +143,78 @@ struct MemoryHeader
 
 typedef struct MemoryHeader GASmemory_header;
 
+/* gas_memory_counters() {{{*/
+static GASmemory_counters* gas_memory_counters (void)
+{
+    GASmemory_counters* c = thread_counters;
+
+    if (c != NULL) {
+        return c;
+    }
 
-void* gas_default_alloc (unsigned int size, GASvoid* user_data)/*{{{*/
+#if HAVE_PTHREAD_H
+    pthread_once(&counters_once, gas_memory_create_key);
+    if (!counters_key_created) {
+        return &spare_counters;
+    }
+    for (c = first_counters(); c != NULL; c = c->next) {
+        if (claim_counters(c)) {
+            break;
+        }
+    }
+#endif
+    if (c == NULL) {
+        c = (GASmemory_counters*)malloc(sizeof(GASmemory_counters));
+        if (c == NULL) {
+            return &spare_counters;
+        }
+        memset(c, 0, sizeof(GASmemory_counters));
+        c->in_use = 1;
+        push_counters(c);
+    }
+#if HAVE_PTHREAD_H
+    if (pthread_setspecific(counters_key, c) != 0) {
+        release_counters(c);
+        return &spare_counters;
+    }
+#endif
+    thread_counters = c;
+    return c;
+}
+/*}}}*/
+/* gas_memory_size_class() {{{*/
+/**
+ * @return The histogram bucket of @a size: 0 for 0 bytes, then k for sizes
+ * from 2^(k-1) up to 2^k - 1.
+ */
+static GASunum gas_memory_size_class (GASunum size)
 {
+    GASunum k = 0;
+
+    while (size != 0) {
+        size >>= 1;
+        k++;
+    }
+    return k;
+}
+/*}}}*/
+/* gas_memory_count() {{{*/
+static GASvoid gas_memory_count (GASunum bytes)
+{
+    GASunum now = shared_add(bytes_allocated, bytes);
+    shared_max(peak_bytes, now);
+}
+/*}}}*/
+
+void* gas_default_alloc (GASunum size, GASvoid* user_data)/*{{{*/
+{
+    GASmemory_counters* counters = gas_memory_counters();
     GASmemory_header* header = NULL;
     GASubyte* p = NULL;
 
+    if (size > (GASunum)-1 - sizeof(GASmemory_header)) {
+        return NULL;
+    }
     p = malloc(size + sizeof(GASmemory_header));
     if (p == NULL) {
         return NULL;
@@ -44,29 +223,38 @@ void* gas_default_alloc (unsigned int size, GASvoid* user_data)/*{{{*/
     header = (GASmemory_header*)p;
     p += sizeof(GASmemory_header);
     header->bytes_allocated = size;
-    bytes_allocated += size;
 
+    gas_memory_count(size);
+    counters_add(counters, allocations, 1);
+    counters_add(counters, histogram[gas_memory_size_class(size)], 1);
 
     return p;
 }/*}}}*/
-void* gas_default_realloc (void *ptr, unsigned int size, GASvoid* user_data)/*{{{*/
+void* gas_default_realloc (void *ptr, GASunum size, GASvoid* user_data)/*{{{*/
 {
+    GASmemory_counters* counters;
     GASmemory_header* header = NULL;
     GASubyte* p = ptr;
-    GASnum delta;
+    GASunum delta;
 
     if (ptr == NULL) {
         return gas_default_alloc(size, user_data);
     }
 
+    counters = gas_memory_counters();
+    counters_add(counters, reallocations, 1);
+    counters_add(counters, histogram[gas_memory_size_class(size)], 1);
+
     p -= sizeof(GASmemory_header);
     header = (GASmemory_header*)p;
 
-    delta = size - header->bytes_allocated;
-
-    if (delta <= 0) {
+    if (size <= header->bytes_allocated) {
         return ptr;
     }
+    if (size > (GASunum)-1 - sizeof(GASmemory_header)) {
+        return NULL;
+    }
+    delta = size - header->bytes_allocated;
 
     p = realloc(p, size + sizeof(GASmemory_header));
     if (p == NULL) {
@@ -77,12 +265,13 @@ void* gas_default_realloc (void *ptr, unsigned int size, GASvoid* user_data)/*{{
     p += sizeof(GASmemory_header);
 
     header->bytes_allocated += delta;
-    bytes_allocated += delta;
+    gas_memory_count(delta);
 
     return p;
 }/*}}}*/
 void gas_default_free (void *ptr, GASvoid* user_data)/*{{{*/
 {
+    GASmemory_counters* counters;
     GASmemory_header* header = NULL;
     GASubyte* p = ptr;
 
@@ -90,7 +279,9 @@ void gas_default_free (void *ptr, GASvoid* user_data)/*{{{*/
         p -= sizeof(GASmemory_header);
         header = (GASmemory_header*)p;
 
-        bytes_allocated -= header->bytes_allocated;
+        shared_sub(bytes_allocated, header->bytes_allocated);
+        counters = gas_memory_counters();
+        counters_add(counters, frees, 1);
 
         free(p);
     }
@@ -98,16 +289,63 @@ void gas_default_free (void *ptr, GASvoid* user_data)/*{{{*/
 
 GASunum gas_memory_usage (void)/*{{{*/
 {
-    return bytes_allocated;
+    return counter_load(bytes_allocated);
+}/*}}}*/
+/**
+ * @brief Totals of the default allocator, over all threads.
+ *
+ * Counts made by other threads while the totals are gathered may or may
+ * not be included.
+ */
+GASresult gas_memory_stats (GASmemory_stats* stats)/*{{{*/
+{
+    GASmemory_counters* c;
+    GASunum i;
+
+    GAS_CHECK_PARAM(stats);
+
+    memset(stats, 0, sizeof(GASmemory_stats));
+    stats->bytes = counter_load(bytes_allocated);
+    stats->peak_bytes = counter_load(peak_bytes);
+
+    for (c = first_counters(); ; c = c->next) {
+        if (c == NULL) {
+            c = &spare_counters;
+        }
+        stats->allocations += counter_load(c->allocations);
+        stats->reallocations += counter_load(c->reallocations);
+        stats->frees += counter_load(c->frees);
+        for (i = 0; i < GAS_MEMORY_HISTOGRAM_SIZE; i++) {
+            stats->histogram[i] += counter_load(c->histogram[i]);
+        }
+        if (c == &spare_counters) {
+            break;
+        }
+    }
+
+    return GAS_OK;
+}/*}}}*/
+/**
+ * @brief Start measuring the peak again, from the bytes now in use.
+ */
+GASvoid gas_memory_reset_peak (void)/*{{{*/
+{
+#if defined(__GNUC__)
+    __atomic_store_n(&peak_bytes, __atomic_load_n(&bytes_allocated,
+                                                  __ATOMIC_RELAXED),
+                     __ATOMIC_RELAXED);
+#else
+    peak_bytes = bytes_allocated;
+#endif
 }/*}}}*/
 
 #else
 
-void* gas_default_alloc (unsigned int size, GASvoid* user_data)/*{{{*/
+void* gas_default_alloc (GASunum size, GASvoid* user_data)/*{{{*/
 {
     return malloc(size);
 }/*}}}*/
-void* gas_default_realloc (void *ptr, unsigned int size, GASvoid* user_data)/*{{{*/
+void* gas_default_realloc (void *ptr, GASunum size, GASvoid* user_data)/*{{{*/
 {
     return realloc(ptr, size);
 }/*}}}*/
@@ -118,12 +356,45 @@ void gas_default_free (void *ptr, GASvoid* user_data)/*{{{*/
 
 #endif
 
-GAS_MEMORY_ALLOC_CALLBACK   gas_alloc   = gas_default_alloc;
-GAS_MEMORY_REALLOC_CALLBACK gas_realloc = gas_default_realloc;
-GAS_MEMORY_FREE_CALLBACK    gas_free    = gas_default_free;
+void* gas_allocator_alloc (GASunum size, GASvoid* user_data)/*{{{*/
+{
+    GASallocator* a = (GASallocator*)user_data;
+
+    if (a == NULL) {
+        return gas_default_alloc(size, NULL);
+    }
+    return a->alloc(a, size);
+}/*}}}*/
+void* gas_allocator_realloc (void *ptr, GASunum size, GASvoid* user_data)/*{{{*/
+{
+    GASallocator* a = (GASallocator*)user_data;
+
+    if (a == NULL) {
+        return gas_default_realloc(ptr, size, NULL);
+    }
+    return a->realloc(a, ptr, size);
+}/*}}}*/
+void gas_allocator_free (void *ptr, GASvoid* user_data)/*{{{*/
+{
+    GASallocator* a = (GASallocator*)user_data;
+
+    if (a == NULL) {
+        gas_default_free(ptr, NULL);
+    } else {
+        a->free(a, ptr);
+    }
+}/*}}}*/
+
+GAS_MEMORY_ALLOC_CALLBACK   gas_alloc   = gas_allocator_alloc;
+GAS_MEMORY_REALLOC_CALLBACK gas_realloc = gas_allocator_realloc;
+GAS_MEMORY_FREE_CALLBACK    gas_free    = gas_allocator_free;
 
 /**
- * @warning pool usage is not currently supported!
+ * @brief Replace the process wide allocation callbacks.
+ *
+ * The callbacks receive the user_data given to the library as is, in place
+ * of a GASallocator.  Prefer an allocator object, which leaves the
+ * callbacks of other users of the library alone.
  */
 GASresult gas_memory_initialize (/*{{{*/
     GAS_MEMORY_ALLOC_CALLBACK   user_alloc,
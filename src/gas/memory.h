@@ -36,9 +36,31 @@ extern "C"
 /*}*/
 #endif
 
-typedef void* (*GAS_MEMORY_ALLOC_CALLBACK)   (unsigned int size,
+/**
+ * @brief An allocator object, passed as the user_data of the library.
+ *
+ * The user_data given to gas_new(), the readers, the parsers and the
+ * writers is handed to every allocation they make, and is stored on each
+ * chunk so that the tree is grown and released with it.  With the default
+ * callbacks, a NULL user_data uses malloc(), and any other must point to a
+ * GASallocator, usually the first member of a larger structure holding the
+ * allocator's state, like GASpool and GASarena.
+ *
+ * Each tree, or each thread, can so have an allocator of its own, without
+ * changing the process wide callbacks.  None of the methods are called
+ * concurrently by the library, unless the allocator is shared by trees in
+ * use on several threads.
+ */
+typedef struct GASallocator
+{
+    void* (*alloc)   (struct GASallocator* self, GASunum size);
+    void* (*realloc) (struct GASallocator* self, void *ptr, GASunum size);
+    void  (*free)    (struct GASallocator* self, void *ptr);
+} GASallocator;
+
+typedef void* (*GAS_MEMORY_ALLOC_CALLBACK)   (GASunum size,
                                               GASvoid* user_data);
-typedef void* (*GAS_MEMORY_REALLOC_CALLBACK) (void *ptr, unsigned int size,
+typedef void* (*GAS_MEMORY_REALLOC_CALLBACK) (void *ptr, GASunum size,
                                               GASvoid* user_data);
 typedef void  (*GAS_MEMORY_FREE_CALLBACK)    (void *ptr, GASvoid* user_data);
 
@@ -48,11 +70,68 @@ GASresult gas_memory_initialize (
     GAS_MEMORY_FREE_CALLBACK    user_free
     );
 
+/**
+ * @name default allocator
+ * @brief malloc(), realloc() and free(), counting the bytes in use when
+ * GAS_DEBUG_MEMORY is set.
+ */
+/*@{*/
+void* gas_default_alloc (GASunum size, GASvoid* user_data);
+void* gas_default_realloc (void *ptr, GASunum size, GASvoid* user_data);
+void  gas_default_free (void *ptr, GASvoid* user_data);
+/*@}*/
+
+/**
+ * @name allocator objects
+ * @brief The callbacks in use until gas_memory_initialize() is called,
+ * forwarding to the GASallocator in user_data, if any.
+ */
+/*@{*/
+void* gas_allocator_alloc (GASunum size, GASvoid* user_data);
+void* gas_allocator_realloc (void *ptr, GASunum size, GASvoid* user_data);
+void  gas_allocator_free (void *ptr, GASvoid* user_data);
+/*@}*/
+
 #if GAS_DEBUG_MEMORY || defined(DOXYGEN)
+/**
+ * @name memory accounting
+ * @brief Counts kept by the default allocator when GAS_DEBUG_MEMORY is set.
+ *
+ * Each thread counts its calls on its own, without locking, and
+ * gas_memory_stats() adds the counts up.  Only the bytes in use, and their
+ * peak, are shared between threads.  Thread safety relies on GCC style
+ * atomic builtins; other compilers get plain counters.
+ */
+/*@{*/
+
+/**
+ * @brief Number of buckets in GASmemory_stats::histogram.
+ */
+#define GAS_MEMORY_HISTOGRAM_SIZE (sizeof(GASunum) * 8 + 1)
+
+typedef struct
+{
+    /** @brief Bytes in use. */
+    GASunum bytes;
+    /** @brief Most bytes in use at once, see gas_memory_reset_peak(). */
+    GASunum peak_bytes;
+    GASunum allocations;
+    GASunum reallocations;
+    GASunum frees;
+    /**
+     * @brief Requested sizes, of allocations and reallocations: bucket 0
+     * for 0 bytes, then bucket k for 2^(k-1) up to 2^k - 1 bytes.
+     */
+    GASunum histogram[GAS_MEMORY_HISTOGRAM_SIZE];
+} GASmemory_stats;
+
 /**
  * @brief Get current memory usage from default allocator.
  */
 GASunum gas_memory_usage (void);
+GASresult gas_memory_stats (GASmemory_stats* stats);
+GASvoid gas_memory_reset_peak (void);
+/*@}*/
 #endif
 
 extern GAS_MEMORY_ALLOC_CALLBACK   gas_alloc;
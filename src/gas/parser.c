@@ -81,109 +81,488 @@
  * GASparser::build_tree to false, and assign any necessary callbacks, such as
  * @ref GASparser::on_pre_chunk, @ref GASparser::on_push_chunk, and @ref
  * GASparser::on_pop_chunk.
+ *
+ * @section read_ahead Read-Ahead
+ *
+ * With gas_parser_set_buffer_size(), the parser reads ahead of the context,
+ * through a buffer of @ref GAS_PARSER_BUFFER_SIZE bytes for instance, so that
+ * encoded numbers and small fields do not each cost a context read.  Large
+ * payloads are still read directly.  Read-ahead is off by default: a context
+ * that waits for the full count, like stdio on a pipe, would then wait for
+ * input the peer has not sent yet.
+ *
+ * @section lazy_reading Lazy Reading
+ *
+ * With @ref GASparser::lazy set, the parser reads a chunk's fields, but
+ * only records where its children are, using their sizes to seek over
+ * them.  Each child is read when first accessed, and
+ * @ref GASparser::lazy_limit bounds how many stay in memory.  See
+ * @ref lazy.
+ *
+ * @section push Push Parsing
+ *
+ * Instead of pulling input through a context, gas_parser_feed() accepts
+ * slices of a stream as they arrive, split anywhere, and never blocks.  The
+ * parser keeps an explicit stack of open chunks, runs the same callbacks as
+ * gas_parse(), and hands each complete tree to @ref GASparser::on_tree.
+ * This suits event loops serving many connections from one thread.
  */
 /*}}}*/
 
 #include "parser.h"
+#include "codec.h"
+#include "lazy.h"
 
 #include <string.h>
 #if HAVE_STDIO_H
 #include <stdio.h>
 #endif
 
-GASunum gas_encoded_size (GASunum value);
+/* push parser state {{{*/
+enum
+{
+    /* states that read a number */
+    FEED_SIZE,
+    FEED_ID_SIZE,
+    FEED_NB_ATTRIBUTES,
+    FEED_KEY_SIZE,
+    FEED_VALUE_SIZE,
+    FEED_PAYLOAD_SIZE,
+    FEED_NB_CHILDREN,
+    /* states that read a field */
+    FEED_ID,
+    FEED_KEY,
+    FEED_VALUE,
+    FEED_PAYLOAD,
+    /* states that discard input */
+    FEED_SKIP,
+    /* states that consume no input */
+    FEED_NEXT_ATTRIBUTE,
+    FEED_PUSH_CHUNK,
+    FEED_NEXT_CHILD,
+    FEED_END_CHUNK,
+    FEED_ERROR
+};
+
+typedef struct
+{
+    GASchunk* chunk;
+    GASunum attributes_left;
+    GASunum children_left;
+} GASfeed_frame;
+
+struct GASfeed
+{
+    GASenum state;
+    GASenum after_skip;
+    GASresult error;
+
+    /* a number split across slices */
+    GASubyte num[GAS_CODEC_MAX_LENGTH];
+    GASunum num_have;
+
+    /* the field being filled in */
+    GASubyte** field;
+    GASunum field_size;
+    GASunum field_have;
+
+    GASunum skip;
+
+    /* one frame per open chunk */
+    GASunum depth;
+    GASunum capacity;
+    GASfeed_frame* stack;
+
+    /* for the state itself, trees use the user_data of gas_parser_feed() */
+    GASvoid* user_data;
+};
+/*}}}*/
+
+/* read-ahead buffer {{{*/
+/**
+ * @brief Read up to @a size bytes of input, positionally when the context
+ * allows it.
+ */
+static GASresult gas_parser_input (GASparser *p, GASvoid* dest, GASunum size,
+                                   GASunum* bytes_read)
+{
+    GAScontext* ctx = p->context;
+    GASresult result;
+    size_t done = 0;
+
+    if (gas_context_has(ctx, pread)) {
+        result = ctx->pread(p->handle, dest, size, p->offset, &done,
+                            ctx->user_data);
+        *bytes_read = done;
+    } else {
+        result = gas_context_read(ctx, p->handle, dest, size, bytes_read);
+    }
+    p->offset += *bytes_read;
+    return result;
+}
+
+/**
+ * @brief Buffer at least @a want bytes, unless the input ends first.
+ *
+ * Each read asks for the free space of the whole buffer, so a context that
+ * returns whatever is available (like a socket) fills it in one call.  This
+ * is why read-ahead is only used when asked for.
+ */
+static GASresult gas_parser_fill (GASparser *p, GASunum want)
+{
+    GASresult result;
+    GASunum bytes_read;
+    GASunum avail = p->buffer_end - p->buffer_pos;
+
+    if (avail >= want) {
+        return GAS_OK;
+    }
+
+    if (p->buffer_pos > 0) {
+        memmove(p->buffer, p->buffer + p->buffer_pos, avail);
+        p->buffer_pos = 0;
+        p->buffer_end = avail;
+    }
+
+    while (p->buffer_end < want) {
+        bytes_read = 0;
+        result = gas_parser_input(p, p->buffer + p->buffer_end,
+                                  p->buffer_size - p->buffer_end, &bytes_read);
+        if (result != GAS_OK && result != GAS_ERR_FILE_EOF) {
+            return result;
+        }
+        p->buffer_end += bytes_read;
+        if (result == GAS_ERR_FILE_EOF || bytes_read == 0) {
+            /* the caller decides whether a short buffer is an error */
+            break;
+        }
+    }
+
+    return GAS_OK;
+}
+
+/**
+ * @brief Read a large field straight into @a out, and as much read-ahead as
+ * fits behind it into the empty buffer, with the context's readv.
+ */
+static GASresult gas_parser_readv (GASparser *p, GASubyte* out, GASunum size)
+{
+    GAScontext* ctx = p->context;
+    GASresult result;
+    GASiovec iov[2];
+    size_t done;
+
+    iov[1].iov_base = p->buffer;
+    iov[1].iov_len = p->buffer_size;
+
+    while (size > 0) {
+        iov[0].iov_base = out;
+        iov[0].iov_len = size;
+        done = 0;
+        result = ctx->readv(p->handle, iov, 2, &done, ctx->user_data);
+        if (result != GAS_OK && result != GAS_ERR_FILE_EOF) {
+            return result;
+        }
+        p->offset += done;
+        if (done >= size) {
+            p->buffer_pos = 0;
+            p->buffer_end = done - size;
+            return GAS_OK;
+        }
+        if (result == GAS_ERR_FILE_EOF || done == 0) {
+            return GAS_ERR_FILE_EOF;
+        }
+        out += done;
+        size -= done;
+    }
+    return GAS_OK;
+}
+
+/**
+ * @brief Read @a size bytes, from the buffer when small.
+ */
+static GASresult gas_parser_read (GASparser *p, GASvoid* dest, GASunum size)
+{
+    GASresult result;
+    GASunum bytes_read;
+    GASubyte* out = (GASubyte*)dest;
+    GASunum n = p->buffer_end - p->buffer_pos;
+
+    if (n > size) {
+        n = size;
+    }
+    if (n > 0) {
+        memcpy(out, p->buffer + p->buffer_pos, n);
+        p->buffer_pos += n;
+        out += n;
+        size -= n;
+    }
+
+    if (size == 0) {
+        return GAS_OK;
+    }
+
+    if (size < p->buffer_size) {
+        result = gas_parser_fill(p, size);
+        if (result != GAS_OK) { return result; }
+        if (p->buffer_end - p->buffer_pos < size) {
+            return GAS_ERR_FILE_EOF;
+        }
+        memcpy(out, p->buffer + p->buffer_pos, size);
+        p->buffer_pos += size;
+        return GAS_OK;
+    }
+
+    /* large reads bypass the buffer */
+    if (!gas_context_has(p->context, pread) &&
+        gas_context_has(p->context, readv) && p->buffer_size > 0)
+    {
+        return gas_parser_readv(p, out, size);
+    }
+    while (size > 0) {
+        bytes_read = 0;
+        result = gas_parser_input(p, out, size, &bytes_read);
+        if (result != GAS_OK) { return result; }
+        if (bytes_read == 0) {
+            return GAS_ERR_FILE_EOF;
+        }
+        out += bytes_read;
+        size -= bytes_read;
+    }
+    return GAS_OK;
+}
+
+/**
+ * @brief Whether fields are borrowed from the input, see GASparser::borrow.
+ */
+#define gas_parser_borrowing(p) \
+    ((p)->borrow && gas_context_has((p)->context, borrow))
+
+static GASresult gas_parser_skip (GASparser *p, GASunum size);
+
+/**
+ * @brief Point @a field at the next @a size bytes of input, and move past
+ * them.
+ */
+static GASresult gas_parser_borrow (GASparser *p, GASunum size,
+                                    GASubyte** field)
+{
+    GAScontext* ctx = p->context;
+    GASunum at = p->offset - (p->buffer_end - p->buffer_pos);
+    const void* data = NULL;
+    GASresult result;
+
+    result = ctx->borrow(p->handle, at, size, &data, ctx->user_data);
+    if (result != GAS_OK) { return result; }
+    *field = (GASubyte*)data;
+    return gas_parser_skip(p, size);
+}
+
+/**
+ * @brief Skip @a size bytes, seeking past whatever is not buffered.
+ *
+ * With pread, the offset moves instead, and the handle is not touched.
+ */
+static GASresult gas_parser_skip (GASparser *p, GASunum size)
+{
+    GASunum n = p->buffer_end - p->buffer_pos;
+
+    if (n > size) {
+        n = size;
+    }
+    p->buffer_pos += n;
+    size -= n;
 
+    if (size == 0) {
+        return GAS_OK;
+    }
+    p->offset += size;
+    if (gas_context_has(p->context, pread)) {
+        return GAS_OK;
+    }
+    return gas_context_seek(p->context, p->handle, size, GAS_SEEK_CUR);
+}
+/*}}}*/
 /* gas_read_encoded_num_parser() {{{*/
 GASresult gas_read_encoded_num_parser (GASparser *p, GASunum *out)
 {
     GASresult result = GAS_OK;
-    GASunum retval;
-    unsigned int bytes_read;
-    GASunum i, zero_byte_count, first_bit_set;
-    GASubyte byte, mask = 0x00;
-    GASunum additional_bytes_to_read;
+    GASubyte buf[GAS_CODEC_MAX_LENGTH];
+    GASnum length;
+    GASunum have = 0;
 
     GAS_CHECK_PARAM(p);
     GAS_CHECK_PARAM(out);
 
-    /* find first non 0x00 byte */
-    for (zero_byte_count = 0; 1; zero_byte_count++) {
-        result = p->context->read(p->handle, &byte, 1, &bytes_read,
-                                  p->context->user_data);
+    if (p->buffer_size > 0) {
+        /* peek at the buffered bytes, until the length is known */
+        do {
+            result = gas_parser_fill(p, have + 1);
+            if (result != GAS_OK) { return result; }
+            if (p->buffer_end - p->buffer_pos <= have) {
+                return GAS_ERR_FILE_EOF;
+            }
+            have = p->buffer_end - p->buffer_pos;
+            length = gas_codec_peek_length(p->buffer + p->buffer_pos, have);
+        } while (length == 0);
+
+        if (length < 0) {
+            return length;
+        }
+
+        result = gas_parser_fill(p, length);
         if (result != GAS_OK) { return result; }
-        if (bytes_read != 1) {
-            return GAS_ERR_FILE_EOF;
+
+        length = gas_codec_decode(p->buffer + p->buffer_pos,
+                                  p->buffer_end - p->buffer_pos, out);
+        if (length < 0) {
+            return length == GAS_ERR_UNKNOWN ? GAS_ERR_FILE_EOF : length;
         }
-        if (byte != 0x00)
-            break;
+        p->buffer_pos += length;
+        return GAS_OK;
     }
 
-    /* process initial byte */
-    for (first_bit_set = 7; first_bit_set >= 0; first_bit_set--)
-        if (byte & (1L << first_bit_set))
-            break;
-
-    for (i = 0; i < first_bit_set; i++)
-        mask |= (1L << i);
+    /* unbuffered, leading bytes until the length is known */
+    do {
+        result = gas_parser_read(p, buf + have, 1);
+        if (result != GAS_OK) { return result; }
+        have++;
+        length = gas_codec_peek_length(buf, have);
+    } while (length == 0);
 
-    additional_bytes_to_read = (7-first_bit_set) + (7*zero_byte_count);
+    if (length < 0) {
+        return length;
+    }
 
-    /* at this point, i have enough information to construct retval */
-    retval = mask & byte;
-    for (i = 0; i < additional_bytes_to_read; i++) {
-        result = p->context->read(p->handle, &byte, 1, &bytes_read,
-                                  p->context->user_data);
+    /* remainder of the number, in one read */
+    if (have < (GASunum)length) {
+        result = gas_parser_read(p, buf + have, length - have);
         if (result != GAS_OK) { return result; }
-        if (bytes_read != 1) {
-            return GAS_ERR_FILE_EOF;
-        }
-        retval = (retval << 8) | byte;
     }
-    *out = retval;
-    return GAS_OK;
+
+    length = gas_codec_decode(buf, length, out);
+    return length < 0 ? length : GAS_OK;
 }
 /*}}}*/
 /* gas_read_parser() {{{*/
 
-#define read_field(field)                                                   \
+/* borrowed fields are not freed */
+#define gas_parser_release(c) \
+    (borrowing ? gas_destroyn(c) : gas_destroy(c))
+
+#define read_field(field, local)                                            \
     do {                                                                    \
         result = gas_read_encoded_num_parser(p, &field##_size);             \
         if (result != GAS_OK) { goto abort; }                               \
-        field = (GASubyte*)gas_alloc(field##_size + 1, user_data);          \
+        if (borrowing) {                                                    \
+            result = gas_parser_borrow(p, field##_size, &field);            \
+            if (result != GAS_OK) { goto abort; }                           \
+            break;                                                          \
+        }                                                                   \
+        field = gas_field_alloc(local, field##_size, user_data);            \
         GAS_CHECK_MEM(field);                                               \
-        result = p->context->read(p->handle, field, field##_size,           \
-                                  &bytes_read, p->context->user_data);      \
+        result = gas_parser_read(p, field, field##_size);                   \
         if (result != GAS_OK) { goto abort; }                               \
         ((GASubyte*)field)[field##_size] = 0;                               \
     } while (0)
 
 
+/**
+ * @brief Intern the id and keys of @a c, which may be borrowed.
+ *
+ * Borrowed bytes are replaced by the table's, but not freed.  Fed chunks
+ * are never borrowed, whatever the parser's settings.
+ */
+static GASresult gas_parser_intern (GASparser *p, GASchunk* c)
+{
+    GASintern* t = p->intern;
+    GASattribute* a;
+    GASnum symbol;
+    GASunum i;
+
+    if (!c->borrowed) {
+        return gas_intern_chunk(t, c);
+    }
+
+    symbol = gas_intern(t, c->id, c->id_size);
+    if (symbol < 0) { return symbol; }
+    c->id = t->strings[symbol - 1];
+    c->id_symbol = symbol;
+
+    for (i = 0; i < c->nb_attributes; i++) {
+        a = &c->attributes[i];
+        symbol = gas_intern(t, a->key, a->key_size);
+        if (symbol < 0) { return symbol; }
+        a->key = t->strings[symbol - 1];
+        a->key_symbol = symbol;
+    }
+    return GAS_OK;
+}
+
+/**
+ * @brief Record where each child of @a c is, and skip over it, see
+ * @ref lazy.
+ */
+static GASresult gas_parser_defer (GASparser *p, GASchunk* c)
+{
+    GASresult result;
+    GASunum i, size;
+
+    if (c->nb_children == 0) {
+        return GAS_OK;
+    }
+    if (p->lazy_limit > 0 && p->lru == NULL) {
+        /* freed with the parser, so allocated like it */
+        p->lru = (struct GASlazy*)gas_alloc(sizeof(struct GASlazy),
+                                            p->feed->user_data);
+        GAS_CHECK_MEM(p->lru);
+        memset(p->lru, 0, sizeof(struct GASlazy));
+    }
+
+    result = gas_lazy_new(p, c);
+    if (result != GAS_OK) { return result; }
+
+    for (i = 0; i < c->nb_children; i++) {
+        c->lazy->offsets[i] = p->offset - (p->buffer_end - p->buffer_pos);
+        result = gas_read_encoded_num_parser(p, &size);
+        if (result != GAS_OK) { return result; }
+        result = gas_parser_skip(p, size);
+        if (result != GAS_OK) { return result; }
+    }
+
+    return GAS_OK;
+}
+
 /**
  * @brief Recursive context based gas parser.
  *
  * @warning Unlike other similar functions in the library, gas_read_parser is
- * intended for internal use only, via gas_parse().
+ * intended for internal use, via gas_parse(), except to keep the handle open
+ * while borrowing, see GASparser::borrow.
  */
 GASresult gas_read_parser (GASparser *p, GASchunk **out, GASvoid* user_data)
 {
     GASresult result = GAS_OK;
     GASunum i;
     GASchunk* c = NULL;
-    unsigned int bytes_read;
     GASbool cont;
+    GASbool borrowing;
     unsigned long jump = 0;
 
     GAS_CHECK_PARAM(p);
     GAS_CHECK_PARAM(out);
 
+    borrowing = gas_parser_borrowing(p);
+
     result = gas_new(&c, NULL, 0, user_data);
     if (result != GAS_OK) { goto abort; }
+    c->borrowed = borrowing;
 
     result = gas_read_encoded_num_parser(p, &c->size);
     if (result != GAS_OK) { goto abort; }
 
 /* id {{{*/
-    read_field(c->id);
+    read_field(c->id, c->id_inline);
 
     if (p->on_pre_chunk) {
         cont = p->on_pre_chunk(c->id_size, c->id, p->context->user_data);
@@ -193,11 +572,10 @@ GASresult gas_read_parser (GASparser *p, GASchunk **out, GASvoid* user_data)
 /*}}}*/
 
     if ( ! cont) {
-        jump = c->size - gas_encoded_size(c->id_size) - c->id_size;
-        result = p->context->seek(p->handle, jump, GAS_SEEK_CUR,
-                                  p->context->user_data);
+        jump = c->size - gas_codec_length(c->id_size) - c->id_size;
+        result = gas_parser_skip(p, jump);
         if (result != GAS_OK) { goto abort; }
-        gas_destroy(c);
+        gas_parser_release(c);
         *out = NULL;
         return GAS_OK;
     }
@@ -209,15 +587,22 @@ GASresult gas_read_parser (GASparser *p, GASchunk **out, GASvoid* user_data)
 /* attributes {{{*/
     result = gas_read_encoded_num_parser(p, &c->nb_attributes);
     if (result != GAS_OK) { goto abort; }
+    if (c->nb_attributes > (GASunum)-1 / sizeof(GASattribute)) {
+        result = GAS_ERR_OUT_OF_RANGE;
+        goto abort;
+    }
     if (c->nb_attributes > 0) {
         c->attributes = (GASattribute*)gas_alloc(
             c->nb_attributes * sizeof(GASattribute), user_data
             );
         GAS_CHECK_MEM(c->attributes);
+        c->attributes_capacity = c->nb_attributes;
+        memset(c->attributes, 0, c->nb_attributes * sizeof(GASattribute));
     }
     for (i = 0; i < c->nb_attributes; i++) {
-        read_field(c->attributes[i].key);
-        read_field(c->attributes[i].value);
+        read_field(c->attributes[i].key, c->attributes[i].key_inline);
+        read_field(c->attributes[i].value,
+                   c->attributes[i].value_inline);
         if (p->on_attribute) {
             p->on_attribute(c->attributes[i].key_size, c->attributes[i].key,
                          c->attributes[i].value_size, c->attributes[i].value,
@@ -227,7 +612,7 @@ GASresult gas_read_parser (GASparser *p, GASchunk **out, GASvoid* user_data)
 /*}}}*/
 /* payloads {{{*/
     if (p->get_payloads) {
-        read_field(c->payload);
+        read_field(c->payload, NULL);
         if (p->on_payload) {
             p->on_payload(c->payload_size, c->payload, p->context->user_data);
         }
@@ -236,13 +621,15 @@ GASresult gas_read_parser (GASparser *p, GASchunk **out, GASvoid* user_data)
         if (result != GAS_OK) { goto abort; }
         c->payload = NULL;
         jump = c->payload_size;
-        result = p->context->seek(p->handle, jump,
-                                  GAS_SEEK_CUR,
-                                  p->context->user_data);
+        result = gas_parser_skip(p, jump);
         if (result != GAS_OK) { goto abort; }
     }
 /*}}}*/
 
+    if (p->intern && p->build_tree) {
+        result = gas_parser_intern(p, c);
+        if (result != GAS_OK) { goto abort; }
+    }
     if (p->on_push_chunk) {
         p->on_push_chunk(c, p->context->user_data);
     }
@@ -250,17 +637,30 @@ GASresult gas_read_parser (GASparser *p, GASchunk **out, GASvoid* user_data)
 /* children {{{*/
     result = gas_read_encoded_num_parser(p, &c->nb_children);
     if (result != GAS_OK) { goto abort; }
+    if (c->nb_children > (GASunum)-1 / sizeof(GASchunk*)) {
+        result = GAS_ERR_OUT_OF_RANGE;
+        goto abort;
+    }
     if (c->nb_children > 0) {
         c->children = (GASchunk**)gas_alloc(c->nb_children * sizeof(GASchunk*),
                                             user_data);
         GAS_CHECK_MEM(c->children);
+        c->children_capacity = c->nb_children;
+        memset(c->children, 0, c->nb_children * sizeof(GASchunk*));
     }
-    for (i = 0; i < c->nb_children; i++) {
-        result = gas_read_parser(p, &c->children[i], user_data);
+    if (p->lazy && p->build_tree) {
+        result = gas_parser_defer(p, c);
         if (result != GAS_OK) { goto abort; }
-        if (p->build_tree) {
-            /* if we are not building the tree, then the child will be null */
-            c->children[i]->parent = c;
+        /* the size read above stands for the children not loaded yet */
+        c->dirty = GAS_FALSE;
+    } else {
+        for (i = 0; i < c->nb_children; i++) {
+            result = gas_read_parser(p, &c->children[i], user_data);
+            if (result != GAS_OK) { goto abort; }
+            if (c->children[i] != NULL) {
+                /* not building the tree, or pruned, leaves the child null */
+                c->children[i]->parent = c;
+            }
         }
     }
 /*}}}*/
@@ -275,13 +675,15 @@ GASresult gas_read_parser (GASparser *p, GASchunk **out, GASvoid* user_data)
     if (p->build_tree) {
         *out = c;
     } else {
-        gas_destroy(c);
+        gas_parser_release(c);
         *out = NULL;
     }
     return GAS_OK;
 
 abort:
-    gas_destroy(c);
+    if (c != NULL) {
+        gas_parser_release(c);
+    }
     *out = NULL;
     return result;
 }
@@ -311,6 +713,15 @@ GASresult gas_parser_new (/*{{{*/
     p->build_tree = GAS_TRUE;
     p->get_payloads = GAS_TRUE;
 
+    p->feed = (struct GASfeed*)gas_alloc(sizeof(struct GASfeed), user_data);
+    if (p->feed == NULL) {
+        gas_free(p, user_data);
+        return GAS_ERR_MEMORY;
+    }
+    memset(p->feed, 0, sizeof(struct GASfeed));
+    p->feed->state = FEED_SIZE;
+    p->feed->user_data = user_data;
+
     *parser = p;
 
     return GAS_OK;
@@ -318,10 +729,67 @@ GASresult gas_parser_new (/*{{{*/
 
 GASresult gas_parser_destroy (GASparser *p, GASvoid* user_data)/*{{{*/
 {
+    if (p->feed) {
+        gas_parser_feed_reset(p);
+        if (p->feed->stack) {
+            gas_free(p->feed->stack, user_data);
+        }
+        gas_free(p->feed, user_data);
+    }
+    if (p->buffer) {
+        gas_free(p->buffer, user_data);
+    }
+    if (p->lru) {
+        gas_free(p->lru, user_data);
+    }
     gas_free(p, user_data);
     return GAS_OK;
 }/*}}}*/
 
+/**
+ * @brief Resize the read-ahead buffer, keeping any buffered input.
+ *
+ * Sizes below the longest encoded number are rounded up, and a size of 0
+ * turns read-ahead off.
+ *
+ * @param user_data Not stored, only used for immediate memory routines.
+ */
+GASresult gas_parser_set_buffer_size (GASparser *p, GASunum size,/*{{{*/
+                                      GASvoid* user_data)
+{
+    GASubyte* buffer = NULL;
+    GASunum avail;
+
+    GAS_CHECK_PARAM(p);
+
+    if (size > 0 && size < GAS_CODEC_MAX_LENGTH) {
+        size = GAS_CODEC_MAX_LENGTH;
+    }
+    avail = p->buffer_end - p->buffer_pos;
+    if (size < avail) {
+        /* buffered input would be lost */
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    if (size > 0) {
+        buffer = (GASubyte*)gas_alloc(size, user_data);
+        GAS_CHECK_MEM(buffer);
+        if (avail > 0) {
+            memcpy(buffer, p->buffer + p->buffer_pos, avail);
+        }
+    }
+    if (p->buffer) {
+        gas_free(p->buffer, user_data);
+    }
+
+    p->buffer = buffer;
+    p->buffer_size = size;
+    p->buffer_pos = 0;
+    p->buffer_end = avail;
+
+    return GAS_OK;
+}/*}}}*/
+
 /**
  * @param user_data Will be stored in the tree.
  */
@@ -338,6 +806,8 @@ GASresult gas_parse (GASparser* p, const char *resource, GASchunk **out, GASvoid
     if (result < GAS_OK) {
         return result;
     }
+    p->buffer_pos = p->buffer_end = 0;
+    p->offset = 0;
     result = gas_read_parser(p, &c, user_data);
     if (result < GAS_OK) {
         return result;
@@ -349,4 +819,436 @@ GASresult gas_parse (GASparser* p, const char *resource, GASchunk **out, GASvoid
 }/*}}}*/
 /*}}}*/
 
+/* push parser {{{*/
+/* gas_feed_num() {{{*/
+/**
+ * @brief Decode a number that may be split across slices.
+ *
+ * @return 1 when the number is complete, 0 when more input is needed.
+ * Negative values are error codes.
+ */
+static GASnum gas_feed_num (struct GASfeed* f, const GASubyte** in,
+                            GASunum* len, GASunum* out)
+{
+    GASnum length;
+    GASunum n;
+
+    /* common case, the whole number is in this slice */
+    if (f->num_have == 0) {
+        length = gas_codec_decode(*in, *len, out);
+        if (length > 0) {
+            *in += length;
+            *len -= length;
+            return 1;
+        }
+        if (length != GAS_ERR_UNKNOWN) {
+            return length;
+        }
+    }
+
+    while (*len > 0) {
+        /* one byte until the length is known, then the remainder */
+        length = gas_codec_peek_length(f->num, f->num_have);
+        n = length > 0 ? length - f->num_have : 1;
+        if (n > *len) {
+            n = *len;
+        }
+        memcpy(f->num + f->num_have, *in, n);
+        f->num_have += n;
+        *in += n;
+        *len -= n;
+
+        length = gas_codec_peek_length(f->num, f->num_have);
+        if (length < 0) {
+            return length;
+        }
+        if (length > 0 && f->num_have == (GASunum)length) {
+            f->num_have = 0;
+            length = gas_codec_decode(f->num, length, out);
+            return length < 0 ? length : 1;
+        }
+    }
+
+    return 0;
+}
+/*}}}*/
+/* gas_feed_field() {{{*/
+/**
+ * @brief Allocate a field of @a size bytes, to be filled by later slices.
+ */
+static GASresult gas_feed_field (struct GASfeed* f, GASubyte** field,
+                                 GASubyte* local, GASunum* field_size,
+                                 GASunum size, GASvoid* user_data)
+{
+    if (size == (GASunum)-1) {
+        return GAS_ERR_OUT_OF_RANGE;
+    }
+
+    *field = gas_field_alloc(local, size, user_data);
+    GAS_CHECK_MEM(*field);
+    (*field)[size] = 0;
+    *field_size = size;
+
+    f->field = field;
+    f->field_size = size;
+    f->field_have = 0;
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_feed_push() {{{*/
+static GASresult gas_feed_push (struct GASfeed* f, GASchunk* c)
+{
+    GASfeed_frame* tmp;
+
+    if (f->depth == f->capacity) {
+        tmp = (GASfeed_frame*)gas_realloc(
+            f->stack, (f->capacity + 8) * 2 * sizeof(GASfeed_frame),
+            f->user_data
+            );
+        GAS_CHECK_MEM(tmp);
+        f->stack = tmp;
+        f->capacity = (f->capacity + 8) * 2;
+    }
+
+    f->stack[f->depth].chunk = c;
+    f->stack[f->depth].attributes_left = 0;
+    f->stack[f->depth].children_left = 0;
+    f->depth++;
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_parser_feed() {{{*/
+
+#define feed_data(p) ((p)->context ? (p)->context->user_data : NULL)
+
+/* the byte size of an array must fit a GASunum */
+#define check_count(count, type)                                            \
+    do {                                                                    \
+        if ((count) > (GASunum)-1 / sizeof(type)) {                         \
+            result = GAS_ERR_OUT_OF_RANGE;                                  \
+            goto fail;                                                      \
+        }                                                                   \
+    } while (0)
+
+/**
+ * @brief Push parse a slice of a stream of chunks.
+ *
+ * Slices may be split anywhere, even within a number.  The parser keeps
+ * its own state between calls, and runs the usual callbacks as soon as the
+ * data they report is complete.  When GASparser::build_tree is true, every
+ * complete top level tree is handed to GASparser::on_tree.
+ *
+ * The parser's context is not used, except for the user_data passed to the
+ * callbacks.
+ *
+ * After an error, the stream cannot be resynchronized; every call returns
+ * the same error until gas_parser_feed_reset().
+ *
+ * @param user_data Will be stored in the trees, and must be the same for
+ * every slice of a stream.
+ */
+GASresult gas_parser_feed (GASparser* p, const GASvoid* buf, GASunum len,
+                           GASvoid* user_data)
+{
+    struct GASfeed* f;
+    const GASubyte* in = (const GASubyte*)buf;
+    GASresult result;
+    GASfeed_frame* top;
+    GASchunk* c;
+    GASattribute* a;
+    GASunum v = 0, n;
+    GASbool cont;
+
+    GAS_CHECK_PARAM(p);
+
+    f = p->feed;
+    if (f->state == FEED_ERROR) {
+        return f->error;
+    }
+    if (len > 0) {
+        GAS_CHECK_PARAM(buf);
+    }
+
+    for (;;) {
+        top = f->depth > 0 ? &f->stack[f->depth - 1] : NULL;
+        c = top ? top->chunk : NULL;
+
+        /* input */
+        if (f->state <= FEED_NB_CHILDREN) {
+            result = gas_feed_num(f, &in, &len, &v);
+            if (result == 0) { return GAS_OK; }
+            if (result < 0) { goto fail; }
+        } else if (f->state <= FEED_PAYLOAD) {
+            n = f->field_size - f->field_have;
+            if (n > len) {
+                n = len;
+            }
+            if (n > 0) {
+                memcpy(*f->field + f->field_have, in, n);
+                f->field_have += n;
+                in += n;
+                len -= n;
+            }
+            if (f->field_have < f->field_size) { return GAS_OK; }
+        } else if (f->state == FEED_SKIP) {
+            n = f->skip < len ? f->skip : len;
+            f->skip -= n;
+            in += n;
+            len -= n;
+            if (f->skip > 0) { return GAS_OK; }
+        }
+
+        /* transitions */
+        result = GAS_OK;
+        switch (f->state) {
+/* chunk header {{{*/
+        case FEED_SIZE:
+            result = gas_new(&c, NULL, 0, user_data);
+            if (result != GAS_OK) { goto fail; }
+            c->size = v;
+            c->parent = top ? top->chunk : NULL;
+            result = gas_feed_push(f, c);
+            if (result != GAS_OK) {
+                gas_destroy(c);
+                goto fail;
+            }
+            f->state = FEED_ID_SIZE;
+            break;
+
+        case FEED_ID_SIZE:
+            result = gas_feed_field(f, &c->id, c->id_inline, &c->id_size, v,
+                                    c->user_data);
+            f->state = FEED_ID;
+            break;
+
+        case FEED_ID:
+            if (p->on_pre_chunk) {
+                cont = p->on_pre_chunk(c->id_size, c->id, feed_data(p));
+            } else {
+                cont = GAS_TRUE;
+            }
+            if ( ! cont) {
+                /* prune, skipping the rest of the chunk */
+                n = gas_codec_length(c->id_size) + c->id_size;
+                if (c->size < n) {
+                    result = GAS_ERR_UNKNOWN;
+                    goto fail;
+                }
+                f->skip = c->size - n;
+                f->after_skip = FEED_NEXT_CHILD;
+                f->state = FEED_SKIP;
+                f->depth--;
+                gas_destroy(c);
+                if (f->depth > 0) {
+                    f->stack[f->depth - 1].children_left--;
+                }
+                break;
+            }
+            if (p->on_push_id) {
+                p->on_push_id(c->id_size, c->id, feed_data(p));
+            }
+            f->state = FEED_NB_ATTRIBUTES;
+            break;
+/*}}}*/
+/* attributes {{{*/
+        case FEED_NB_ATTRIBUTES:
+            if (v > 0) {
+                check_count(v, GASattribute);
+                c->attributes = (GASattribute*)gas_alloc(
+                    v * sizeof(GASattribute), c->user_data
+                    );
+                if (c->attributes == NULL) {
+                    result = GAS_ERR_MEMORY;
+                    goto fail;
+                }
+                memset(c->attributes, 0, v * sizeof(GASattribute));
+                c->attributes_capacity = v;
+            }
+            top->attributes_left = v;
+            f->state = FEED_NEXT_ATTRIBUTE;
+            break;
+
+        case FEED_NEXT_ATTRIBUTE:
+            if (top->attributes_left > 0) {
+                f->state = FEED_KEY_SIZE;
+            } else {
+                f->state = FEED_PAYLOAD_SIZE;
+            }
+            break;
+
+        case FEED_KEY_SIZE:
+            a = &c->attributes[c->nb_attributes++];
+            result = gas_feed_field(f, &a->key, a->key_inline, &a->key_size, v,
+                                    c->user_data);
+            f->state = FEED_KEY;
+            break;
+
+        case FEED_KEY:
+            f->state = FEED_VALUE_SIZE;
+            break;
+
+        case FEED_VALUE_SIZE:
+            a = &c->attributes[c->nb_attributes - 1];
+            result = gas_feed_field(f, &a->value, a->value_inline,
+                                    &a->value_size, v, c->user_data);
+            f->state = FEED_VALUE;
+            break;
+
+        case FEED_VALUE:
+            a = &c->attributes[c->nb_attributes - 1];
+            if (p->on_attribute) {
+                p->on_attribute(a->key_size, a->key, a->value_size, a->value,
+                                feed_data(p));
+            }
+            top->attributes_left--;
+            f->state = FEED_NEXT_ATTRIBUTE;
+            break;
+/*}}}*/
+/* payload {{{*/
+        case FEED_PAYLOAD_SIZE:
+            if (p->get_payloads) {
+                result = gas_feed_field(f, &c->payload, NULL,
+                                        &c->payload_size, v, c->user_data);
+                f->state = FEED_PAYLOAD;
+            } else {
+                c->payload_size = v;
+                f->skip = v;
+                f->after_skip = FEED_PUSH_CHUNK;
+                f->state = FEED_SKIP;
+            }
+            break;
+
+        case FEED_PAYLOAD:
+            if (p->on_payload) {
+                p->on_payload(c->payload_size, c->payload, feed_data(p));
+            }
+            f->state = FEED_PUSH_CHUNK;
+            break;
+
+        case FEED_SKIP:
+            f->state = f->after_skip;
+            break;
+
+        case FEED_PUSH_CHUNK:
+            if (p->intern && p->build_tree) {
+                result = gas_parser_intern(p, c);
+                if (result != GAS_OK) { goto fail; }
+            }
+            if (p->on_push_chunk) {
+                p->on_push_chunk(c, feed_data(p));
+            }
+            f->state = FEED_NB_CHILDREN;
+            break;
+/*}}}*/
+/* children {{{*/
+        case FEED_NB_CHILDREN:
+            if (v > 0 && p->build_tree) {
+                check_count(v, GASchunk*);
+                c->children = (GASchunk**)gas_alloc(v * sizeof(GASchunk*),
+                                                    c->user_data);
+                if (c->children == NULL) {
+                    result = GAS_ERR_MEMORY;
+                    goto fail;
+                }
+                memset(c->children, 0, v * sizeof(GASchunk*));
+                c->children_capacity = v;
+            }
+            top->children_left = v;
+            f->state = FEED_NEXT_CHILD;
+            break;
+
+        case FEED_NEXT_CHILD:
+            if (top == NULL || top->children_left > 0) {
+                f->state = FEED_SIZE;
+            } else {
+                f->state = FEED_END_CHUNK;
+            }
+            break;
+
+        case FEED_END_CHUNK:
+            if (p->on_pop_chunk) {
+                p->on_pop_chunk(c, feed_data(p));
+            }
+            if (p->on_pop_id) {
+                p->on_pop_id(c->id_size, c->id, feed_data(p));
+            }
+
+            f->depth--;
+            if (f->depth > 0) {
+                top = &f->stack[f->depth - 1];
+                top->children_left--;
+                if (p->build_tree) {
+                    top->chunk->children[top->chunk->nb_children++] = c;
+                } else {
+                    gas_destroy(c);
+                }
+            } else if (p->build_tree && p->on_tree) {
+                p->on_tree(c, feed_data(p));
+            } else {
+                gas_destroy(c);
+            }
+            f->state = FEED_NEXT_CHILD;
+            break;
+/*}}}*/
+        }
+
+        if (result != GAS_OK) {
+            goto fail;
+        }
+    }
+
+fail:
+    gas_parser_feed_reset(p);
+    f->state = FEED_ERROR;
+    f->error = result;
+    return result;
+}
+
+#undef check_count
+#undef feed_data
+
+/*}}}*/
+/* gas_parser_feed_idle() {{{*/
+/**
+ * @brief Whether the parser is between top level chunks, such that the
+ * stream may end cleanly.
+ */
+GASbool gas_parser_feed_idle (GASparser* p)
+{
+    struct GASfeed* f = p->feed;
+
+    return f->state == FEED_SIZE && f->depth == 0 && f->num_have == 0;
+}
+/*}}}*/
+/* gas_parser_feed_reset() {{{*/
+/**
+ * @brief Discard any partially parsed chunks, and clear errors, so that a new
+ * stream may be fed.
+ */
+GASresult gas_parser_feed_reset (GASparser* p)
+{
+    struct GASfeed* f;
+
+    GAS_CHECK_PARAM(p);
+
+    f = p->feed;
+    /* incomplete chunks are not yet attached to their parents */
+    while (f->depth > 0) {
+        f->depth--;
+        gas_destroy(f->stack[f->depth].chunk);
+    }
+
+    f->state = FEED_SIZE;
+    f->error = GAS_OK;
+    f->num_have = 0;
+    f->skip = 0;
+    f->field = NULL;
+
+    return GAS_OK;
+}
+/*}}}*/
+/*}}}*/
+
 /* vim: set sw=4 fdm=marker : */
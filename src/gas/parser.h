@@ -20,6 +20,7 @@
  */
 
 #include "context.h"
+#include "intern.h"
 #include "tree.h"
 
 #ifndef GAS_PARSER_H
@@ -54,6 +55,17 @@ typedef GASvoid (*GAS_ON_ATTRIBUTE) (GASunum key_size, void *key,
 typedef GASvoid (*GAS_ON_PAYLOAD)   (GASunum payload_size, void *payload, void *user_data);
 typedef GASvoid (*GAS_POP_ID)       (GASunum id_size, void *id, void *user_data);
 typedef GASvoid (*GAS_POP_CHUNK)    (GASchunk* c, void *user_data);
+/**
+ * @brief Receives a complete top level tree from gas_parser_feed(), and
+ * takes ownership of it.
+ */
+typedef GASvoid (*GAS_ON_TREE)      (GASchunk* c, void *user_data);
+
+/**
+ * @brief Suggested size of the parser's read-ahead buffer, in bytes, see
+ * gas_parser_set_buffer_size().
+ */
+#define GAS_PARSER_BUFFER_SIZE 4096
 
 typedef struct
 {
@@ -77,6 +89,77 @@ typedef struct
     GAS_ON_PAYLOAD   on_payload;
     GAS_POP_ID       on_pop_id;
     GAS_POP_CHUNK    on_pop_chunk;
+
+    /**
+     * @brief Read-ahead buffer, in front of the context's read callback.
+     *
+     * Encoded numbers and small fields are served from this buffer, while
+     * reads of at least buffer_size bytes go straight to their destination.
+     * Consequently, the context's handle may be positioned ahead of the
+     * parser.  Off by default, since each fill asks the context for the
+     * whole free space: turn it on with gas_parser_set_buffer_size() for
+     * files, or contexts whose read returns what is available rather than
+     * waiting for the full count.
+     */
+    GASubyte* buffer;
+    GASunum buffer_size;
+    GASunum buffer_pos;
+    GASunum buffer_end;
+
+    /**
+     * @brief Position of the next read in the handle.
+     *
+     * Only needed by contexts with a pread callback, which the parser reads
+     * at this offset.  gas_parse() starts it at 0; set it before reading a
+     * handle whose input starts elsewhere.
+     */
+    GASunum offset;
+
+    /**
+     * @brief Called by gas_parser_feed() with each complete tree, when
+     * build_tree is true.
+     *
+     * Without it, trees are destroyed once their callbacks have run.
+     */
+    GAS_ON_TREE on_tree;
+
+    /**
+     * @brief When set, the ids and attribute keys of built trees are
+     * interned in this table, which must outlive them.
+     */
+    GASintern* intern;
+
+    /**
+     * @brief When set, and the context has a borrow callback, the ids,
+     * keys, values and payloads of built trees point into the input rather
+     * than being copied.
+     *
+     * Borrowed fields are not null terminated, and are only valid while the
+     * handle is open, so open it yourself and read with gas_read_parser(),
+     * then release trees before closing it.  The chunks are marked
+     * GASchunk::borrowed: they are read only, and gas_destroy() does not
+     * free their fields.  Positions are taken from GASparser::offset.
+     */
+    GASbool borrow;
+
+    /**
+     * @brief When set, gas_read_parser() only records where the children of
+     * a chunk are, and each is read when first accessed, see @ref lazy.
+     *
+     * The handle must be seekable, and stay open, and the parser must
+     * outlive the tree.
+     */
+    GASbool lazy;
+    /**
+     * @brief When not 0, at most this many subtrees read lazily stay in
+     * memory; the least recently accessed are released.
+     */
+    GASunum lazy_limit;
+
+    /** @brief Private state of gas_parser_feed(). */
+    struct GASfeed* feed;
+    /** @brief Private recently used list of lazy reading. */
+    struct GASlazy* lru;
 } GASparser;
 
 GASresult gas_parser_new (
@@ -87,6 +170,8 @@ GASresult gas_parser_new (
     );
 
 GASresult gas_parser_destroy (GASparser *p, GASvoid* DEFAULT_NULL(user_data));
+GASresult gas_parser_set_buffer_size (GASparser *p, GASunum size,
+                                      GASvoid* DEFAULT_NULL(user_data));
 
 GASresult gas_read_encoded_num_parser (GASparser *p, GASunum *out);
 GASresult gas_read_parser (GASparser *p, GASchunk **out,
@@ -95,6 +180,11 @@ GASresult gas_read_parser (GASparser *p, GASchunk **out,
 GASresult gas_parse (GASparser* p, const char *resource, GASchunk **out,
                      GASvoid* DEFAULT_NULL(user_data));
 
+GASresult gas_parser_feed (GASparser* p, const GASvoid* buf, GASunum len,
+                           GASvoid* DEFAULT_NULL(user_data));
+GASbool gas_parser_feed_idle (GASparser* p);
+GASresult gas_parser_feed_reset (GASparser* p);
+
 /*@}*/
 
 #ifdef __cplusplus
@@ -0,0 +1,249 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file pool.c
+ * @brief pool allocator implementation
+ */
+
+#include "pool.h"
+
+#include <string.h>
+#if HAVE_STDIO_H
+#include <stdio.h>
+#endif
+
+#define GAS_POOL_ALIGN 8
+#define gas_pool_align(n) \
+    (((n) + GAS_POOL_ALIGN - 1) & ~(GASunum)(GAS_POOL_ALIGN - 1))
+
+/* every allocation is preceded by its size, large ones by their links too */
+#define SLAB_HEADER_SIZE gas_pool_align(sizeof(GASpool_slab))
+#define LARGE_HEADER_SIZE gas_pool_align(sizeof(GASpool_large))
+#define ALLOC_HEADER_SIZE gas_pool_align(sizeof(GASunum))
+
+#define SMALLEST_CLASS 16
+#define class_size(k) ((GASunum)SMALLEST_CLASS << (k))
+#define LARGEST_SIZE (class_size(GAS_POOL_CLASSES - 1) - ALLOC_HEADER_SIZE)
+
+#define slab_data(s) ((GASubyte*)(s) + SLAB_HEADER_SIZE)
+#define alloc_size(ptr) (*(GASunum*)((GASubyte*)(ptr) - ALLOC_HEADER_SIZE))
+#define large_of(ptr) \
+    ((GASpool_large*)((GASubyte*)(ptr) - ALLOC_HEADER_SIZE - LARGE_HEADER_SIZE))
+/* a free slot links to the next through its data */
+#define next_free(ptr) (*(GASvoid**)(ptr))
+
+/* gas_pool_class() {{{*/
+/**
+ * @return The size class of @a size bytes, at most LARGEST_SIZE.
+ */
+static GASunum gas_pool_class (GASunum size)
+{
+    GASunum k = 0;
+
+    while (class_size(k) < size + ALLOC_HEADER_SIZE) {
+        k++;
+    }
+    return k;
+}
+/*}}}*/
+/* gas_pool_alloc_small() {{{*/
+static GASvoid* gas_pool_alloc_small (GASpool* pool, GASunum size)
+{
+    GASunum k = gas_pool_class(size);
+    GASpool_slab* s;
+    GASubyte* p;
+
+    p = (GASubyte*)pool->free_lists[k];
+    if (p != NULL) {
+        pool->free_lists[k] = next_free(p);
+    } else {
+        s = pool->slabs;
+        if (s == NULL || s->size - s->used < class_size(k)) {
+            /* the rest of the current slab is left unused */
+            s = (GASpool_slab*)gas_default_alloc(
+                    SLAB_HEADER_SIZE + pool->slab_size, NULL);
+            if (s == NULL) {
+                return NULL;
+            }
+            s->size = pool->slab_size;
+            s->used = 0;
+            s->next = pool->slabs;
+            pool->slabs = s;
+        }
+        p = slab_data(s) + s->used + ALLOC_HEADER_SIZE;
+        s->used += class_size(k);
+    }
+
+    alloc_size(p) = size;
+    return p;
+}
+/*}}}*/
+/* gas_pool_alloc_large() {{{*/
+static GASvoid* gas_pool_alloc_large (GASpool* pool, GASunum size)
+{
+    GASpool_large* l;
+    GASubyte* p;
+
+    if (size > (GASunum)-1 - LARGE_HEADER_SIZE - ALLOC_HEADER_SIZE) {
+        return NULL;
+    }
+    l = (GASpool_large*)gas_default_alloc(
+            LARGE_HEADER_SIZE + ALLOC_HEADER_SIZE + size, NULL);
+    if (l == NULL) {
+        return NULL;
+    }
+    l->prev = NULL;
+    l->next = pool->large;
+    if (pool->large != NULL) {
+        pool->large->prev = l;
+    }
+    pool->large = l;
+
+    p = (GASubyte*)l + LARGE_HEADER_SIZE + ALLOC_HEADER_SIZE;
+    alloc_size(p) = size;
+    return p;
+}
+/*}}}*/
+/* gas_pool_alloc() {{{*/
+static void* gas_pool_alloc (GASallocator* self, GASunum size)
+{
+    GASpool* pool = (GASpool*)self;
+
+    if (size > LARGEST_SIZE) {
+        return gas_pool_alloc_large(pool, size);
+    }
+    return gas_pool_alloc_small(pool, size);
+}
+/*}}}*/
+/* gas_pool_free() {{{*/
+static void gas_pool_free (GASallocator* self, void *ptr)
+{
+    GASpool* pool = (GASpool*)self;
+    GASpool_large* l;
+    GASunum k;
+
+    if (ptr == NULL) {
+        return;
+    }
+
+    if (alloc_size(ptr) > LARGEST_SIZE) {
+        l = large_of(ptr);
+        if (l->prev != NULL) {
+            l->prev->next = l->next;
+        } else {
+            pool->large = l->next;
+        }
+        if (l->next != NULL) {
+            l->next->prev = l->prev;
+        }
+        gas_default_free(l, NULL);
+        return;
+    }
+
+    k = gas_pool_class(alloc_size(ptr));
+    next_free(ptr) = pool->free_lists[k];
+    pool->free_lists[k] = ptr;
+}
+/*}}}*/
+/* gas_pool_realloc() {{{*/
+/**
+ * @brief Resize in place while the size stays within the slot.
+ */
+static void* gas_pool_realloc (GASallocator* self, void *ptr,
+                               GASunum size)
+{
+    GASunum old_size, capacity;
+    void* p;
+
+    if (ptr == NULL) {
+        return gas_pool_alloc(self, size);
+    }
+
+    old_size = alloc_size(ptr);
+    if (old_size > LARGEST_SIZE) {
+        capacity = size > LARGEST_SIZE ? old_size : 0;
+    } else {
+        capacity = class_size(gas_pool_class(old_size)) - ALLOC_HEADER_SIZE;
+    }
+    if (size <= capacity) {
+        alloc_size(ptr) = size;
+        return ptr;
+    }
+
+    p = gas_pool_alloc(self, size);
+    if (p == NULL) {
+        return NULL;
+    }
+    memcpy(p, ptr, old_size < size ? old_size : size);
+    gas_pool_free(self, ptr);
+
+    return p;
+}
+/*}}}*/
+/* gas_pool_new() {{{*/
+/**
+ * @param slab_size The size of each slab, or 0 for GAS_POOL_SLAB_SIZE.
+ */
+GASresult gas_pool_new (GASpool** pool, GASunum slab_size)
+{
+    GASpool* p;
+
+    GAS_CHECK_PARAM(pool);
+
+    p = (GASpool*)gas_default_alloc(sizeof(GASpool), NULL);
+    GAS_CHECK_MEM(p);
+    memset(p, 0, sizeof(GASpool));
+
+    p->allocator.alloc = gas_pool_alloc;
+    p->allocator.realloc = gas_pool_realloc;
+    p->allocator.free = gas_pool_free;
+    p->slab_size = slab_size > 0 ? slab_size : GAS_POOL_SLAB_SIZE;
+    if (p->slab_size < class_size(GAS_POOL_CLASSES - 1)) {
+        p->slab_size = class_size(GAS_POOL_CLASSES - 1);
+    }
+
+    *pool = p;
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_pool_destroy() {{{*/
+/**
+ * @brief Release the pool, and everything still allocated from it.
+ */
+GASresult gas_pool_destroy (GASpool* pool)
+{
+    GASpool_slab *s, *next_slab;
+    GASpool_large *l, *next_large;
+
+    GAS_CHECK_PARAM(pool);
+
+    for (s = pool->slabs; s != NULL; s = next_slab) {
+        next_slab = s->next;
+        gas_default_free(s, NULL);
+    }
+    for (l = pool->large; l != NULL; l = next_large) {
+        next_large = l->next;
+        gas_default_free(l, NULL);
+    }
+    gas_default_free(pool, NULL);
+
+    return GAS_OK;
+}
+/*}}}*/
+
+/* vim: set sw=4 fdm=marker :*/
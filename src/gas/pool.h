@@ -0,0 +1,97 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file pool.h
+ * @brief pool allocator definition
+ */
+
+#ifndef GAS_POOL_H
+#define GAS_POOL_H
+
+#include "memory.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+/*}*/
+#endif
+
+/**
+ * @defgroup pool Pool
+ * @ingroup memory
+ * @brief Size class allocation, for trees that are edited in place.
+ *
+ * A GASpool is a GASallocator, see @ref memory.  Small allocations are
+ * rounded up to a power of two and carved from large slabs; freed ones are
+ * kept on a list per size class and handed out again, so that a tree
+ * growing and shrinking over time reuses its memory without going back to
+ * malloc().  Allocations beyond the largest class are passed to the default
+ * allocator.
+ *
+ * Unlike GASarena, chunks are released one by one with gas_destroy(), and
+ * gas_pool_destroy() releases whatever is left.  A pool has no lock; give
+ * each thread a pool of its own.
+ */
+/*@{*/
+
+/**
+ * @brief Default size of a pool slab, in bytes.
+ */
+#define GAS_POOL_SLAB_SIZE 65536
+
+/**
+ * @brief Number of size classes, from 16 bytes up to 2 KB.
+ */
+#define GAS_POOL_CLASSES 8
+
+typedef struct GASpool_slab
+{
+    struct GASpool_slab* next;
+    GASunum size;
+    GASunum used;
+} GASpool_slab;
+
+typedef struct GASpool_large
+{
+    struct GASpool_large* next;
+    struct GASpool_large* prev;
+} GASpool_large;
+
+typedef struct
+{
+    GASallocator allocator;
+    /** @brief The current slab first. */
+    GASpool_slab* slabs;
+    GASunum slab_size;
+    /** @brief Freed slots by size class, linked through their first word. */
+    GASvoid* free_lists[GAS_POOL_CLASSES];
+    /** @brief Allocations beyond the largest class, still in use. */
+    GASpool_large* large;
+} GASpool;
+
+GASresult gas_pool_new (GASpool** pool, GASunum slab_size);
+GASresult gas_pool_destroy (GASpool* pool);
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_POOL_H defined */
+
+/* vim: set sw=4 fdm=marker :*/
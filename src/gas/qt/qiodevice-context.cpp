@@ -147,6 +147,7 @@ GAScontext* gas_new_qiodevice_context (void)
     ctx->read = gas_qiodevice_read;
     ctx->write = gas_qiodevice_write;
     ctx->seek = gas_qiodevice_seek;
+    ctx->writev = NULL;
 
     return ctx;
 }// }}}
@@ -51,6 +51,10 @@ GASresult gas_qtcpsocket_close (void *handle, void *user_data)
 
 /**
  * @brief called by gas to read from the socket.
+ *
+ * Returns the bytes available, up to @a size_bytes, waiting only while none
+ * are, so that the parser's read-ahead does not wait for data the peer has
+ * not sent.
  */
 static
 GASresult gas_qtcpsocket_read (void *handle, void *buffer,
@@ -58,8 +62,14 @@ GASresult gas_qtcpsocket_read (void *handle, void *buffer,
                                unsigned int *bytes_read, void *user_data)
 {// {{{
     QTcpSocket& io = *static_cast<QTcpSocket*>(handle);
+    qint64 n;
+
+    *bytes_read = 0;
+    if (size_bytes == 0) {
+        return GAS_OK;
+    }
 
-    for (int i = 0; io.bytesAvailable() < size_bytes && i < 5; i++) {
+    for (int i = 0; io.bytesAvailable() <= 0 && i < 5; i++) {
         if (! io.waitForReadyRead(300000)) {
             if (! io.isValid()) {
                 return GAS_ERR_UNKNOWN;
@@ -67,15 +77,16 @@ GASresult gas_qtcpsocket_read (void *handle, void *buffer,
         }
     }
 
-    if (io.bytesAvailable() < size_bytes) {
+    if (io.bytesAvailable() <= 0) {
         return GAS_ERR_UNKNOWN;
     }
 
-    *bytes_read = io.read((char*)buffer, size_bytes);
+    n = io.read((char*)buffer, size_bytes);
 
-    if (*bytes_read < 0) {
+    if (n < 0) {
         return GAS_ERR_UNKNOWN;
     }
+    *bytes_read = (unsigned int)n;
 
     return GAS_OK;
 }// }}}
@@ -105,7 +116,7 @@ GASresult gas_qtcpsocket_write (void *handle, void *buffer,
 }// }}}
 
 /**
- * @brief called by gas to write to the socket.
+ * @brief called by gas to skip bytes already received.
  */
 static
 GASresult gas_qtcpsocket_seek (void *handle, unsigned long pos,
@@ -128,9 +139,14 @@ GASresult gas_qtcpsocket_seek (void *handle, unsigned long pos,
         return GAS_ERR_UNKNOWN;
     }
 
-    // ignoring the QByteArray, other than to check its size
-    if (static_cast<unsigned long>(io.read(pos).size()) != pos) {
-        return GAS_ERR_UNKNOWN;
+    // discard through a local buffer, rather than allocating one
+    char buf[4096];
+    while (pos > 0) {
+        qint64 n = io.read(buf, qMin<unsigned long>(pos, sizeof(buf)));
+        if (n <= 0) {
+            return GAS_ERR_UNKNOWN;
+        }
+        pos -= n;
     }
 
     return GAS_OK;
@@ -147,6 +163,7 @@ GAScontext* gas_new_qtcpsocket_context (void)
     ctx->read = gas_qtcpsocket_read;
     ctx->write = gas_qtcpsocket_write;
     ctx->seek = gas_qtcpsocket_seek;
+    ctx->writev = NULL;
     return ctx;
 }// }}}
 
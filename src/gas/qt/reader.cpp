@@ -0,0 +1,122 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file reader.cpp
+ * @brief Non-blocking reading of chunks from a QIODevice.
+ */
+
+#include "reader.h"
+#include "reader.moc"
+
+#include <QIODevice>
+
+using namespace Gas;
+
+/* size of the slices read from the device */
+#define GAS_READER_SLICE 4096
+
+struct Gas::Reader::Private
+{
+    QIODevice* dev;
+    GAScontext* context;
+    GASparser* parser;
+    GASresult error;
+};
+
+Reader::Reader (QIODevice* dev, QObject* parent) :
+    QObject(parent),
+    d(new Private)
+{// {{{
+    d->dev = dev;
+    d->context = NULL;
+    d->parser = NULL;
+    d->error = gas_context_new(&d->context);
+    if (d->error == GAS_OK) {
+        /* the context only carries user_data, for the callbacks */
+        d->context->user_data = this;
+        d->error = gas_parser_new(&d->parser, d->context);
+    }
+    if (d->error == GAS_OK) {
+        d->parser->on_tree = onTree;
+    }
+
+    connect(dev, SIGNAL(readyRead()), this, SLOT(readAvailable()));
+}// }}}
+
+Reader::~Reader ()
+{// {{{
+    if (d->parser) {
+        gas_parser_destroy(d->parser);
+    }
+    if (d->context) {
+        gas_context_destroy(d->context);
+    }
+}// }}}
+
+QIODevice* Reader::device () const
+{// {{{
+    return d->dev;
+}// }}}
+
+GASparser* Reader::parser () const
+{// {{{
+    return d->parser;
+}// }}}
+
+GASresult Reader::error () const
+{// {{{
+    return d->error;
+}// }}}
+
+void Reader::reset ()
+{// {{{
+    if (d->parser == NULL) {
+        return;
+    }
+    gas_parser_feed_reset(d->parser);
+    d->error = GAS_OK;
+}// }}}
+
+/**
+ * @brief Feed everything the device has buffered, without waiting for more.
+ */
+void Reader::readAvailable ()
+{// {{{
+    char buf[GAS_READER_SLICE];
+    qint64 n;
+
+    while (d->error == GAS_OK && d->dev->bytesAvailable() > 0) {
+        n = d->dev->read(buf, sizeof(buf));
+        if (n <= 0) {
+            break;
+        }
+        d->error = gas_parser_feed(d->parser, buf, n);
+        if (d->error != GAS_OK) {
+            emit failed(d->error);
+        }
+    }
+}// }}}
+
+GASvoid Reader::onTree (GASchunk* c, void* user_data)
+{// {{{
+    Reader* self = static_cast<Reader*>(user_data);
+
+    emit self->chunkReady(c);
+    gas_destroy(c);
+}// }}}
+
+// vim: sw=4 fdm=marker
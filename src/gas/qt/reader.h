@@ -0,0 +1,93 @@
+/*
+ * Copyright 2008 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file reader.h
+ * @brief qt reader definition
+ */
+
+#ifndef GAS_QT_READER_H
+#define GAS_QT_READER_H
+
+#include "../parser.h"
+
+#include <QObject>
+#include <QScopedPointer>
+
+class QIODevice;
+
+namespace Gas
+{
+
+/**
+ * @brief Decodes the chunks arriving on a device, such as a QTcpSocket,
+ * from the event loop.
+ *
+ * Unlike the context of gas_new_qtcpsocket_context(), which blocks until
+ * each field has arrived, the reader takes whatever readyRead() brings and
+ * feeds it to gas_parser_feed(), so one thread can serve many sockets.
+ * Every complete top level chunk is emitted with chunkReady().  Set
+ * callbacks, such as on_pre_chunk to prune chunks without allocating them,
+ * through parser(); they are passed the reader as user_data.
+ */
+class Reader : public QObject
+{
+    Q_OBJECT
+
+public:
+    Reader (QIODevice* dev, QObject* parent = NULL);
+    virtual ~Reader ();
+
+    QIODevice* device () const;
+    GASparser* parser () const;
+
+    /** @brief The error that stopped the reader, or GAS_OK. */
+    GASresult error () const;
+    /** @brief Forget a partial chunk, and any error. */
+    void reset ();
+
+signals:
+    /**
+     * @brief A complete chunk was read.
+     *
+     * The chunk is destroyed once the signal returns, so receivers must be
+     * connected directly, and keep it with gas_clone().
+     */
+    void chunkReady (GASchunk* chunk);
+
+    /**
+     * @brief The stream could not be decoded; the reader stops until
+     * reset().
+     */
+    void failed (GASresult error);
+
+private slots:
+    void readAvailable ();
+
+private:
+    struct Private;
+    QScopedPointer<Private> d;
+
+    static GASvoid onTree (GASchunk* c, void* user_data);
+
+    Q_DISABLE_COPY(Reader);
+};
+
+} // namespace Gas
+
+#endif /* GAS_QT_READER_H defined */
+
+// vim: sw=4 fdm=marker
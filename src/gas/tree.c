@@ -29,6 +29,8 @@
  */
 
 #include "tree.h"
+#include "codec.h"
+#include "lazy.h"
 
 #include <string.h>
 
@@ -43,31 +45,63 @@ static int overwrite_attributes = GAS_TRUE;
 /* gas_encoded_size() {{{*/
 GASunum gas_encoded_size (GASunum value)
 {
-    int i, coded_length;
-	int zero_count, zero_bytes;
-
-    for (i = 1; 1; i++) {
-        /*if (value < (unsigned int)pow(2, 7*i)-2) {*/
-        if (value < ((1UL << (7UL*i))-1UL)) {
-            break;
-        }
+    return gas_codec_length(value);
+}
+/*}}}*/
+/* gas_field_alloc() {{{*/
+/**
+ * @brief Storage for a field of @a size bytes, and a null terminator.
+ *
+ * Fields shorter than GAS_INLINE_SIZE are kept in @a local, the inline
+ * buffer of their chunk or attribute, when there is one.
+ */
+GASubyte* gas_field_alloc (GASubyte* local, GASunum size, GASvoid* user_data)
+{
+    if (local != NULL && size < GAS_INLINE_SIZE) {
+        return local;
+    }
+    if (size == (GASunum)-1) {
+        /* no room for the terminator */
+        return NULL;
+    }
+    return (GASubyte*)gas_alloc(size + 1, user_data);
+}
+/*}}}*/
+/* gas_field_resize() {{{*/
+/**
+ * @brief Like gas_field_alloc(), in place of @a field, whose bytes are not
+ * kept.
+ */
+GASubyte* gas_field_resize (GASubyte* field, GASubyte* local, GASunum size,
+                            GASvoid* user_data)
+{
+    if (field == NULL || field == local) {
+        return gas_field_alloc(local, size, user_data);
+    }
+    if (local != NULL && size < GAS_INLINE_SIZE) {
+        gas_free(field, user_data);
+        return local;
+    }
+    if (size == (GASunum)-1) {
+        return NULL;
+    }
+    return (GASubyte*)gas_realloc(field, size + 1, user_data);
+}
+/*}}}*/
+/* gas_field_free() {{{*/
+GASvoid gas_field_free (GASubyte* field, GASubyte* local, GASvoid* user_data)
+{
+    if (field != local) {
+        gas_free(field, user_data);
     }
-    coded_length = i;  /* not including header */
-    /*printf("coded_length: %d\n", coded_length); */
-
-    zero_count = coded_length - 1;
-    zero_bytes = zero_count / 8;
-    /*int zero_bits = zero_count % 8; */
-
-    return coded_length + zero_bytes;
 }
 /*}}}*/
 /* macro copy_to_field() {{{*/
-#define copy_to_field(field)                                                \
+#define copy_to_field(field, local)                                         \
     do {                                                                    \
         c->field##_size = field##_size;                                     \
-        c->field = (GASubyte*)gas_realloc(c->field, field##_size + 1,       \
-                                          c->user_data);                    \
+        c->field = gas_field_resize(c->field, local, field##_size,          \
+                                    c->user_data);                          \
         GAS_CHECK_MEM(c->field);                                            \
         memcpy(c->field, field, field##_size);                              \
         ((GASubyte*)c->field)[field##_size] = 0;                            \
@@ -77,14 +111,158 @@ GASunum gas_encoded_size (GASunum value)
 #define copy_to_attribute(field)                                            \
     do {                                                                    \
         a->field##_size = field##_size;                                     \
-        ctmp = (GASubyte*)gas_realloc(a->field, field##_size + 1,           \
-                                      c->user_data);                        \
+        ctmp = gas_field_resize(a->field, a->field##_inline, field##_size,  \
+                                c->user_data);                              \
         GAS_CHECK_MEM(ctmp);                                                \
         a->field = ctmp;                                                    \
         memcpy(a->field, field, field##_size);                              \
         ((GASubyte*)a->field)[field##_size] = 0;                            \
     } while (0)
 /*}}}*/
+/* macro field_size() {{{*/
+/* bytes taken by a field and its encoded size */
+#define field_size(size) (gas_codec_length(size) + (size))
+/*}}}*/
+/* gas_is_writable() {{{*/
+/**
+ * @brief Whether @a c may be changed in place.
+ *
+ * Shared chunks, and those below them, are copied first, see
+ * gas_writable_child().  Chunks read lazily, and those below them, stay
+ * read only, see @ref lazy, as do borrowed ones, and detached ones whose
+ * owner is unknown.
+ */
+static GASbool gas_is_writable (GASchunk* c)
+{
+    for (; c != NULL; c = c->parent) {
+        if (c->refs > 1 || c->lazy != NULL || c->borrowed || c->detached) {
+            return GAS_FALSE;
+        }
+    }
+    return GAS_TRUE;
+}
+/*}}}*/
+/* gas_unlink_child() {{{*/
+/**
+ * @brief Forget that @a parent holds @a child, before it releases it.
+ *
+ * When other owners keep @a child, and @a parent was its linked parent,
+ * which of them remains is unknown: the child is detached.
+ */
+static GASvoid gas_unlink_child (GASchunk* parent, GASchunk* child)
+{
+    if (child->refs > 1 && child->parent == parent) {
+        child->parent = NULL;
+        child->detached = GAS_TRUE;
+    }
+}
+/*}}}*/
+/* macro check_writable() {{{*/
+#define check_writable(c)                                                   \
+    do {                                                                    \
+        if (!gas_is_writable(c)) { return GAS_ERR_INVALID_PARAM; }          \
+    } while (0)
+/*}}}*/
+/* gas_resize() {{{*/
+/**
+ * @brief Apply a change of @a delta bytes in @a c's own fields to its size,
+ * and to the sizes along its parent chain.
+ *
+ * Propagation stops at the first dirty chunk, since gas_update() will
+ * recompute it anyway.
+ */
+static GASvoid gas_resize (GASchunk* c, GASnum delta)
+{
+    GASunum before;
+
+    while (c != NULL && !c->dirty && delta != 0) {
+        before = field_size(c->size);
+        c->size += delta;
+        delta = (GASnum)(field_size(c->size) - before);
+        c = c->parent;
+    }
+}
+/*}}}*/
+/* gas_grow_capacity() {{{*/
+/**
+ * @brief The capacity to hold @a count elements past @a used, growing
+ * @a capacity geometrically.
+ */
+static GASresult gas_grow_capacity (GASunum* capacity, GASunum used,
+                                    GASunum count, GASunum element)
+{
+    GASunum need = used + count;
+    GASunum cap = *capacity;
+
+    if (need < used || need > ((GASunum)-1) / element) {
+        return GAS_ERR_OUT_OF_RANGE;
+    }
+    if (need <= cap) {
+        return GAS_OK;
+    }
+
+    cap = cap > 4 ? cap : 4;
+    while (cap < need && cap <= ((GASunum)-1) / element / 2) {
+        cap *= 2;
+    }
+    if (cap < need) {
+        cap = need;
+    }
+    *capacity = cap;
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_grow() {{{*/
+/**
+ * @brief Make room in @a array for @a count elements past @a used.
+ */
+static GASresult gas_grow (GASvoid** array, GASunum* capacity, GASunum used,
+                           GASunum count, GASunum element, GASvoid* user_data)
+{
+    GASunum cap = *capacity;
+    GASresult result;
+    GASvoid* tmp;
+
+    result = gas_grow_capacity(&cap, used, count, element);
+    if (result != GAS_OK || cap == *capacity) {
+        return result;
+    }
+
+    tmp = gas_realloc(*array, cap * element, user_data);
+    GAS_CHECK_MEM(tmp);
+    *array = tmp;
+    *capacity = cap;
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_move_attributes() {{{*/
+/**
+ * @brief Copy @a count attributes, in order, pointing inline keys and
+ * values at their new storage.
+ *
+ * @a to may overlap @a from, when it precedes it.
+ */
+static GASvoid gas_move_attributes (GASattribute* to, GASattribute* from,
+                                    GASunum count)
+{
+    GASbool key_inline, value_inline;
+    GASunum i;
+
+    for (i = 0; i < count; i++) {
+        key_inline = from[i].key == from[i].key_inline;
+        value_inline = from[i].value == from[i].value_inline;
+        memcpy(&to[i], &from[i], sizeof(GASattribute));
+        if (key_inline) {
+            to[i].key = to[i].key_inline;
+        }
+        if (value_inline) {
+            to[i].value = to[i].value_inline;
+        }
+    }
+}
+/*}}}*/
 /*}@*/
 
 /** @name cons/decons */
@@ -102,10 +280,12 @@ GASresult gas_new (GASchunk** chunk, const GASvoid *id, GASunum id_size,
     GAS_CHECK_MEM(c);
 
     memset(c, 0, sizeof(GASchunk));
+    c->refs = 1;
+    c->dirty = GAS_TRUE;
 
     if (id) {
         c->id_size = id_size;
-        c->id = (GASubyte*)gas_realloc(c->id, id_size + 1, user_data);
+        c->id = gas_field_alloc(c->id_inline, id_size, user_data);
         GAS_CHECK_MEM(c->id);
         memcpy(c->id, id, id_size);
         ((GASubyte*)c->id)[id_size] = 0;
@@ -128,6 +308,8 @@ GASresult gas_new_named (GASchunk**chunk, const char *id, GASvoid *user_data)
 /**
  * @brief Destroy a chunk tree.
  *
+ * A shared chunk only loses one owner, see gas_clone().
+ *
  * @note This does not release data for id, or the data contained in the
  * attributes, or the payload data.
  */
@@ -135,17 +317,42 @@ GASresult gas_destroy (GASchunk* c)
 {
     GASunum i;
     GASresult result;
+    GASattribute* a;
 
     GAS_CHECK_PARAM(c);
 
-    gas_free(c->id, c->user_data);
+    if (c->borrowed) {
+        /* the fields belong to the input, see GASparser::borrow */
+        return gas_destroyn(c);
+    }
+    if (c->refs > 1) {
+        c->refs--;
+        return GAS_OK;
+    }
+
+    if (c->lazy != NULL) {
+        gas_lazy_release(c);
+    }
+
+    if (c->id_symbol == 0) {
+        gas_field_free(c->id, c->id_inline, c->user_data);
+    }
     for (i = 0; i < c->nb_attributes; i++) {
-        gas_free(c->attributes[i].key, c->user_data);
-        gas_free(c->attributes[i].value, c->user_data);
+        a = &c->attributes[i];
+        if (a->key_symbol == 0) {
+            gas_field_free(a->key, a->key_inline, c->user_data);
+        }
+        gas_field_free(a->value, a->value_inline, c->user_data);
     }
     gas_free(c->attributes, c->user_data);
+    gas_free(c->attribute_index, c->user_data);
     gas_free(c->payload, c->user_data);
     for (i = 0; i < c->nb_children; i++) {
+        if (c->children[i] == NULL) {
+            /* pruned by the parser, or not read yet */
+            continue;
+        }
+        gas_unlink_child(c, c->children[i]);
         result = gas_destroy(c->children[i]);
 #ifdef GAS_DEBUG
         if (result != GAS_OK) { return result; }
@@ -171,8 +378,23 @@ GASresult gas_destroyn (GASchunk* c)
 
     GAS_CHECK_PARAM(c);
 
+    if (c->refs > 1) {
+        c->refs--;
+        return GAS_OK;
+    }
+
+    if (c->lazy != NULL) {
+        gas_lazy_release(c);
+    }
+
     gas_free(c->attributes, c->user_data);
+    gas_free(c->attribute_index, c->user_data);
     for (i = 0; i < c->nb_children; i++) {
+        if (c->children[i] == NULL) {
+            /* pruned by the parser, or not read yet */
+            continue;
+        }
+        gas_unlink_child(c, c->children[i]);
         result = gas_destroyn(c->children[i]);
 #ifdef GAS_DEBUG
         if (result != GAS_OK) { return result; }
@@ -191,10 +413,20 @@ GASresult gas_destroyn (GASchunk* c)
 /* gas_set_id() {{{*/
 GASresult gas_set_id (GASchunk* c, const GASvoid *id, GASunum id_size)
 {
+    GASunum before;
+
     GAS_CHECK_PARAM(c);
     GAS_CHECK_PARAM(id);
+    check_writable(c);
 
-    copy_to_field(id);
+    if (c->id_symbol != 0) {
+        /* the interned id belongs to its table */
+        c->id = NULL;
+        c->id_symbol = 0;
+    }
+    before = field_size(c->id_size);
+    copy_to_field(id, c->id_inline);
+    gas_resize(c, field_size(c->id_size) - before);
     return GAS_OK;
 }
 /*}}}*/
@@ -227,19 +459,109 @@ GASresult gas_get_id (GASchunk* c, GASvoid* id, GASunum* len)
 
 /** @name GASattribute access */
 /*@{*/
+/* gas_drop_attribute_index() {{{*/
+static GASvoid gas_drop_attribute_index (GASchunk* c)
+{
+    gas_free(c->attribute_index, c->user_data);
+    c->attribute_index = NULL;
+    c->attribute_index_size = 0;
+}
+/*}}}*/
+/* gas_insert_attribute_index() {{{*/
+/**
+ * @brief Add the attribute at @a index to the key hash.
+ *
+ * Of duplicate keys, the first one inserted is kept, so that lookups find
+ * the same attribute a scan would.
+ */
+static GASvoid gas_insert_attribute_index (GASchunk* c, GASunum index)
+{
+    GASattribute* a = &c->attributes[index];
+    GASattribute* other;
+    GASunum mask = c->attribute_index_size - 1;
+    GASunum slot = gas_hash(a->key, a->key_size) & mask;
+
+    while (c->attribute_index[slot] != 0) {
+        other = &c->attributes[c->attribute_index[slot] - 1];
+        if (other->key_size == a->key_size &&
+            memcmp(other->key, a->key, a->key_size) == 0)
+        {
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+    c->attribute_index[slot] = index + 1;
+}
+/*}}}*/
+/* gas_build_attribute_index() {{{*/
+/**
+ * @brief Hash every attribute key, into a table at most half full.
+ */
+static GASresult gas_build_attribute_index (GASchunk* c)
+{
+    GASunum size = GAS_ATTRIBUTE_INDEX_THRESHOLD * 2;
+    GASunum* tmp;
+    GASunum i;
+
+    while (size < c->nb_attributes * 2) {
+        size *= 2;
+    }
+
+    tmp = (GASunum*)gas_alloc(size * sizeof(GASunum), c->user_data);
+    GAS_CHECK_MEM(tmp);
+    memset(tmp, 0, size * sizeof(GASunum));
+
+    gas_drop_attribute_index(c);
+    c->attribute_index = tmp;
+    c->attribute_index_size = size;
+    for (i = 0; i < c->nb_attributes; i++) {
+        gas_insert_attribute_index(c, i);
+    }
+
+    return GAS_OK;
+}
+/*}}}*/
 /* gas_index_of_attribute() {{{*/
 /**
+ * Chunks with at least GAS_ATTRIBUTE_INDEX_THRESHOLD attributes are looked
+ * up through a hash of their keys, built here on first use.  Should that
+ * fail, the attributes are scanned.
+ *
+ * @warning Since it may build the hash, concurrent lookups on a wide chunk
+ * must be serialized until the first one returns.
+ *
  * @return signed index
  * @retval GAS_ERR_ATTR_NOT_FOUND failure, attribute not found
  */
 GASnum gas_index_of_attribute (GASchunk* c, const GASvoid* key, GASunum key_size)
 {
-    GASunum i;
+    GASunum i, mask;
     GASattribute* a;
 
     GAS_CHECK_PARAM(c);
     GAS_CHECK_PARAM(key);
 
+    if (c->attribute_index == NULL &&
+        c->nb_attributes >= GAS_ATTRIBUTE_INDEX_THRESHOLD)
+    {
+        gas_build_attribute_index(c);
+    }
+
+    if (c->attribute_index != NULL) {
+        mask = c->attribute_index_size - 1;
+        i = gas_hash(key, key_size) & mask;
+        while (c->attribute_index[i] != 0) {
+            a = &c->attributes[c->attribute_index[i] - 1];
+            if (a->key_size == key_size &&
+                memcmp(a->key, key, key_size) == 0)
+            {
+                return c->attribute_index[i] - 1;
+            }
+            i = (i + 1) & mask;
+        }
+        return GAS_ERR_ATTR_NOT_FOUND;
+    }
+
     for (i = 0; i < c->nb_attributes; i++ ) {
         a = &c->attributes[i];
         if (gas_cmp((GASubyte*)a->key, a->key_size,
@@ -251,41 +573,119 @@ GASnum gas_index_of_attribute (GASchunk* c, const GASvoid* key, GASunum key_size
     return GAS_ERR_ATTR_NOT_FOUND;
 }
 /*}}}*/
+/* gas_append_attribute() {{{*/
+/**
+ * @brief Add an attribute after the others, even if one has the same key.
+ */
+GASresult gas_append_attribute (GASchunk* c,
+                                const GASvoid *key, GASunum key_size,
+                                const GASvoid *value, GASunum value_size)
+{
+    GASattribute* a;
+    GASresult result;
+    GASubyte *ctmp;
+    GASunum before;
+
+    GAS_CHECK_PARAM(c);
+    GAS_CHECK_PARAM(key);
+    GAS_CHECK_PARAM(value);
+    check_writable(c);
+
+    result = gas_reserve_attributes(c, 1);
+    if (result != GAS_OK) { return result; }
+    before = gas_codec_length(c->nb_attributes);
+    c->nb_attributes++;
+
+    a = &c->attributes[c->nb_attributes-1];
+    a->key = NULL;
+    a->key_symbol = 0;
+    a->value = NULL;
+    copy_to_attribute(key);
+    copy_to_attribute(value);
+    gas_resize(c, gas_codec_length(c->nb_attributes) - before
+                  + field_size(a->key_size) + field_size(a->value_size));
+
+    if (c->attribute_index != NULL) {
+        if (c->nb_attributes * 2 > c->attribute_index_size) {
+            if (gas_build_attribute_index(c) != GAS_OK) {
+                gas_drop_attribute_index(c);
+            }
+        } else {
+            gas_insert_attribute_index(c, c->nb_attributes - 1);
+        }
+    }
+
+    return GAS_OK;
+}
+/*}}}*/
 /* gas_set_attribute() {{{*/
 GASresult gas_set_attribute (GASchunk* c,
                            const GASvoid *key, GASunum key_size,
                            const GASvoid *value, GASunum value_size)
 {
-	GASattribute* tmp, *a;
+    GASattribute* a;
     GASnum index;
     GASubyte *ctmp;
+    GASunum before;
 
     GAS_CHECK_PARAM(c);
     GAS_CHECK_PARAM(key);
     GAS_CHECK_PARAM(value);
+    check_writable(c);
 
     index = gas_index_of_attribute(c, key, key_size);
     if (index >= 0 && overwrite_attributes) {
         /* found, replace */
         a = &c->attributes[index];
-        copy_to_attribute(key);
+        before = field_size(a->value_size);
+        /* the key is unchanged, and may be interned */
         copy_to_attribute(value);
+        gas_resize(c, field_size(a->value_size) - before);
     } else {
         /* not found, append at end */
-        c->nb_attributes++;
+        return gas_append_attribute(c, key, key_size, value, value_size);
+    }
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_set_attribute_at() {{{*/
+/**
+ * @brief Replace the key and value of the attribute at @a index, in place.
+ *
+ * A NULL @a key or @a value keeps that field.  A new key is rehashed on
+ * the next lookup.
+ */
+GASresult gas_set_attribute_at (GASchunk* c, GASunum index,
+                                const GASvoid *key, GASunum key_size,
+                                const GASvoid *value, GASunum value_size)
+{
+    GASattribute* a;
+    GASubyte *ctmp;
+    GASunum before;
 
-        tmp = (GASattribute*)gas_realloc(c->attributes,
-                                     c->nb_attributes*sizeof(GASattribute), c->user_data);
-        GAS_CHECK_MEM(tmp);
-        c->attributes = tmp;
+    GAS_CHECK_PARAM(c);
+    check_writable(c);
 
-        a = &c->attributes[c->nb_attributes-1];
-        a->key = NULL;
-        a->value = NULL;
+    if (index >= c->nb_attributes) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+    a = &c->attributes[index];
+    before = field_size(a->key_size) + field_size(a->value_size);
+    if (key != NULL) {
+        gas_drop_attribute_index(c);
+        if (a->key_symbol != 0) {
+            /* the interned key belongs to its table */
+            a->key = NULL;
+            a->key_symbol = 0;
+        }
         copy_to_attribute(key);
+    }
+    if (value != NULL) {
         copy_to_attribute(value);
     }
-
+    gas_resize(c, field_size(a->key_size) + field_size(a->value_size)
+                  - before);
     return GAS_OK;
 }
 /*}}}*/
@@ -387,23 +787,67 @@ GASresult gas_delete_attribute_at (GASchunk* c, GASunum index)/*{{{*/
 {
     int trailing = 0;
     GASattribute *a = NULL;
+    GASunum before;
 
     GAS_CHECK_PARAM(c);
+    check_writable(c);
 
     if (index >= c->nb_attributes) {
         return GAS_ERR_INVALID_PARAM;
     }
+    /* indices shift, rehash on the next lookup */
+    gas_drop_attribute_index(c);
     a = &c->attributes[index];
-    gas_free(a->value, c->user_data);
-    gas_free(a->key, c->user_data);
+    before = gas_codec_length(c->nb_attributes)
+        + field_size(a->key_size) + field_size(a->value_size);
+    gas_field_free(a->value, a->value_inline, c->user_data);
+    if (a->key_symbol == 0) {
+        gas_field_free(a->key, a->key_inline, c->user_data);
+    }
     c->nb_attributes--;
     trailing = c->nb_attributes - index;
     if (trailing != 0) {
-        memmove(&c->attributes[index], &c->attributes[index+1],
-                trailing * sizeof(GASattribute));
+        gas_move_attributes(&c->attributes[index], &c->attributes[index+1],
+                            trailing);
     }
+    gas_resize(c, gas_codec_length(c->nb_attributes) - before);
     return GAS_OK;
 }/*}}}*/
+/* gas_reserve_attributes() {{{*/
+/**
+ * @brief Make room for @a count more attributes, so that adding them does
+ * not reallocate.
+ *
+ * gas_set_attribute() grows the array geometrically on its own; this only
+ * saves the intermediate copies when the final count is known.
+ */
+GASresult gas_reserve_attributes (GASchunk* c, GASunum count)
+{
+    GASunum cap;
+    GASresult result;
+    GASattribute* tmp;
+
+    GAS_CHECK_PARAM(c);
+    check_writable(c);
+
+    cap = c->attributes_capacity;
+    result = gas_grow_capacity(&cap, c->nb_attributes, count,
+                               sizeof(GASattribute));
+    if (result != GAS_OK || cap == c->attributes_capacity) {
+        return result;
+    }
+
+    /* not gas_realloc(), inline keys and values must be pointed again */
+    tmp = (GASattribute*)gas_alloc(cap * sizeof(GASattribute), c->user_data);
+    GAS_CHECK_MEM(tmp);
+    gas_move_attributes(tmp, c->attributes, c->nb_attributes);
+    gas_free(c->attributes, c->user_data);
+    c->attributes = tmp;
+    c->attributes_capacity = cap;
+
+    return GAS_OK;
+}
+/*}}}*/
 /*@}*/
 
 /** @name payload access */
@@ -414,13 +858,18 @@ GASresult gas_delete_attribute_at (GASchunk* c, GASunum index)/*{{{*/
  */
 GASresult gas_set_payload (GASchunk* c, const GASvoid *payload, GASunum payload_size)
 {
+    GASunum before;
+
     GAS_CHECK_PARAM(c);
+    check_writable(c);
 
+    before = field_size(c->payload_size);
     if (payload) {
-        copy_to_field(payload);
+        copy_to_field(payload, NULL);
     } else {
         c->payload_size = payload_size;
     }
+    gas_resize(c, field_size(c->payload_size) - before);
     return GAS_OK;
 }
 /*}}}*/
@@ -473,22 +922,39 @@ GASchunk* gas_get_parent(GASchunk* c)
 /* gas_add_child() {{{*/
 GASresult gas_add_child(GASchunk* parent, GASchunk* child)
 {
-    GASchunk** tmp;
+    GASresult result;
+    GASunum before;
 
     GAS_CHECK_PARAM(parent);
     GAS_CHECK_PARAM(child);
+    check_writable(parent);
+    if (child->lazy != NULL) {
+        /* its children are only known to its own parser */
+        return GAS_ERR_INVALID_PARAM;
+    }
 
+    result = gas_reserve_children(parent, 1);
+    if (result != GAS_OK) { return result; }
+    before = gas_codec_length(parent->nb_children);
     parent->nb_children++;
 
-    tmp = (GASchunk**)gas_realloc(parent->children,
-                                  parent->nb_children * sizeof(GASchunk*), parent->user_data);
-    GAS_CHECK_MEM(tmp);
-    parent->children = tmp;
-
     parent->children[parent->nb_children - 1] = child;
-    child->parent = parent;
+    if (child->refs <= 1) {
+        child->parent = parent;
+        child->user_data = parent->user_data;
+        child->detached = GAS_FALSE;
+    } else if (child->parent == NULL) {
+        /* one of several parents, linked until it releases it */
+        child->parent = parent;
+        child->detached = GAS_FALSE;
+    }
 
-    child->user_data = parent->user_data;
+    if (child->dirty) {
+        gas_mark_dirty(parent);
+    } else {
+        gas_resize(parent, gas_codec_length(parent->nb_children) - before
+                           + field_size(child->size));
+    }
 
     return GAS_OK;
 }
@@ -506,37 +972,292 @@ GASunum gas_nb_children (GASchunk *c)
 }
 /*}}}*/
 /* gas_get_child_at() {{{*/
+/**
+ * @brief The child at @a index, read first when read lazily, see
+ * gas_load_child_at().
+ *
+ * @return The child, or NULL when out of range, pruned, or not read.
+ */
 GASchunk* gas_get_child_at (GASchunk* c, GASunum index)
 {
+    GASchunk* child;
+
     if (index >= c->nb_children) {
         return NULL;
     }
+    if (c->lazy != NULL) {
+        return gas_load_child_at(c, index, &child) == GAS_OK ? child : NULL;
+    }
     return c->children[index];
 }
 /*}}}*/
 GASresult gas_delete_child_at (GASchunk* c, GASunum index)/*{{{*/
 {
     int trailing = 0;
+    GASunum before;
 
     GAS_CHECK_PARAM(c);
+    check_writable(c);
 
     if (index >= c->nb_children) {
         return GAS_ERR_INVALID_PARAM;
     }
-    gas_destroy(c->children[index]);
+    /* a dirty child has a dirty parent, which gas_resize() skips */
+    before = gas_codec_length(c->nb_children);
+    if (c->children[index] != NULL) {
+        /* not pruned by the parser */
+        before += field_size(c->children[index]->size);
+        gas_unlink_child(c, c->children[index]);
+        gas_destroy(c->children[index]);
+    }
     c->nb_children--;
     trailing = c->nb_children - index;
     if (trailing != 0) {
         memmove(&c->children[index], &c->children[index+1],
                 trailing * sizeof(GASchunk*));
     }
+    gas_resize(c, gas_codec_length(c->nb_children) - before);
     return GAS_OK;
 }/*}}}*/
+/* gas_get_child_by_id() {{{*/
+/**
+ * @return The first child with the id @a id, or NULL.
+ *
+ * Children read lazily are read in turn, until one matches.
+ *
+ * @see gas_get_child_by_symbol() for interned ids.
+ */
+GASchunk* gas_get_child_by_id (GASchunk* c, const GASvoid* id, GASunum id_size)
+{
+    GASchunk* child;
+    GASunum i;
+
+    if (c == NULL || id == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < c->nb_children; i++) {
+        child = c->lazy != NULL ? gas_get_child_at(c, i) : c->children[i];
+        if (child != NULL && child->id_size == id_size &&
+            (id_size == 0 || memcmp(child->id, id, id_size) == 0))
+        {
+            return child;
+        }
+    }
+    return NULL;
+}
+/*}}}*/
+/* gas_reserve_children() {{{*/
+/**
+ * @brief Make room for @a count more children, so that adding them does not
+ * reallocate.
+ *
+ * gas_add_child() grows the array geometrically on its own; this only saves
+ * the intermediate copies when the final count is known.
+ */
+GASresult gas_reserve_children (GASchunk* c, GASunum count)
+{
+    GAS_CHECK_PARAM(c);
+    check_writable(c);
+
+    return gas_grow((GASvoid**)&c->children, &c->children_capacity,
+                    c->nb_children, count, sizeof(GASchunk*), c->user_data);
+}
+/*}}}*/
+/* gas_clone() {{{*/
+/**
+ * @brief Share @a c with one more owner, without copying it.
+ *
+ * The result can be added to another parent, and is released with
+ * gas_destroy() like any other chunk.  Until then, @a c is read only, see
+ * gas_unshare().  @a c stays linked to its parent, if any, so that it is
+ * writable in place again once that parent is its only owner.
+ *
+ * @return @a c, or NULL when @a c is NULL.
+ */
+GASchunk* gas_clone (GASchunk* c)
+{
+    if (c == NULL) {
+        return NULL;
+    }
+    c->refs++;
+    return c;
+}
+/*}}}*/
+/* gas_copy_chunk() {{{*/
+/**
+ * @brief A copy of the fields of @a c, sharing its children.
+ *
+ * Interned ids and keys are shared with their table, as usual.  Chunks
+ * read lazily are refused, as their children not read yet would be lost.
+ */
+static GASresult gas_copy_chunk (GASchunk* c, GASchunk** copy)
+{
+    GASchunk* d;
+    GASattribute *from, *to;
+    GASresult result;
+    GASunum i;
+
+    if (c->lazy != NULL) {
+        return GAS_ERR_INVALID_PARAM;
+    }
+
+    result = gas_new(&d, c->id_symbol == 0 ? c->id : NULL, c->id_size,
+                     c->user_data);
+    if (result != GAS_OK) { return result; }
+
+    if (c->id_symbol != 0) {
+        d->id = c->id;
+        d->id_size = c->id_size;
+        d->id_symbol = c->id_symbol;
+    }
+
+    if (c->nb_attributes > 0) {
+        d->attributes = (GASattribute*)gas_alloc(
+                c->nb_attributes * sizeof(GASattribute), c->user_data);
+        if (d->attributes == NULL) { goto fail; }
+        memset(d->attributes, 0, c->nb_attributes * sizeof(GASattribute));
+        d->attributes_capacity = c->nb_attributes;
+    }
+    for (i = 0; i < c->nb_attributes; i++) {
+        from = &c->attributes[i];
+        to = &d->attributes[i];
+        /* counted first, so that gas_destroy() frees it on failure */
+        d->nb_attributes++;
+        if (from->key_symbol != 0) {
+            to->key = from->key;
+            to->key_symbol = from->key_symbol;
+        } else {
+            to->key = gas_field_alloc(to->key_inline, from->key_size,
+                                      c->user_data);
+            if (to->key == NULL) { goto fail; }
+            memcpy(to->key, from->key, from->key_size);
+            to->key[from->key_size] = 0;
+        }
+        to->key_size = from->key_size;
+        to->value = gas_field_alloc(to->value_inline, from->value_size,
+                                    c->user_data);
+        if (to->value == NULL) { goto fail; }
+        memcpy(to->value, from->value, from->value_size);
+        to->value[from->value_size] = 0;
+        to->value_size = from->value_size;
+    }
+
+    if (c->payload != NULL) {
+        d->payload = gas_field_alloc(NULL, c->payload_size, c->user_data);
+        if (d->payload == NULL) { goto fail; }
+        memcpy(d->payload, c->payload, c->payload_size);
+        d->payload[c->payload_size] = 0;
+    }
+    d->payload_size = c->payload_size;
+
+    if (c->nb_children > 0) {
+        d->children = (GASchunk**)gas_alloc(
+                c->nb_children * sizeof(GASchunk*), c->user_data);
+        if (d->children == NULL) { goto fail; }
+        memcpy(d->children, c->children, c->nb_children * sizeof(GASchunk*));
+        d->children_capacity = c->nb_children;
+        d->nb_children = c->nb_children;
+        for (i = 0; i < c->nb_children; i++) {
+            /* pruned by the parser */
+            if (d->children[i] != NULL) {
+                gas_clone(d->children[i]);
+            }
+        }
+    }
+
+    d->size = c->size;
+    d->dirty = c->dirty;
+
+    *copy = d;
+    return GAS_OK;
+
+fail:
+    gas_destroy(d);
+    return GAS_ERR_MEMORY;
+}
+/*}}}*/
+/* gas_unshare() {{{*/
+/**
+ * @brief Give the caller its own copy of @a *c, if it is shared.
+ *
+ * Only the chunk itself is copied; its children become shared between the
+ * copy and the original, see gas_writable_child().  @a *c is replaced by
+ * the copy, and the original loses an owner.  A detached chunk with no
+ * other owner is handed to the caller as is, see GASchunk::detached.
+ */
+GASresult gas_unshare (GASchunk** c)
+{
+    GASchunk* copy;
+    GASresult result;
+
+    GAS_CHECK_PARAM(c);
+    GAS_CHECK_PARAM(*c);
+
+    if ((*c)->refs <= 1) {
+        (*c)->detached = GAS_FALSE;
+        return GAS_OK;
+    }
+    result = gas_copy_chunk(*c, &copy);
+    if (result != GAS_OK) { return result; }
+    (*c)->refs--;
+    *c = copy;
+
+    return GAS_OK;
+}
+/*}}}*/
+/* gas_writable_child() {{{*/
+/**
+ * @brief The child of @a parent at @a index, copied first if it is shared.
+ *
+ * Walking down with this copies just the path to the chunk to change; the
+ * rest of the tree stays shared.  @a parent must itself be writable.
+ *
+ * @return The child, or NULL on error.
+ */
+GASchunk* gas_writable_child (GASchunk* parent, GASunum index)
+{
+    GASchunk *child, *shared;
+
+    if (parent == NULL || !gas_is_writable(parent) ||
+        index >= parent->nb_children)
+    {
+        return NULL;
+    }
+    child = parent->children[index];
+    if (child == NULL) {
+        return NULL;
+    }
+    if (child->refs > 1) {
+        shared = child;
+        if (gas_unshare(&child) != GAS_OK) {
+            return NULL;
+        }
+        parent->children[index] = child;
+        if (shared->parent == parent) {
+            /* released by this parent, see gas_unlink_child() */
+            shared->parent = NULL;
+            shared->detached = GAS_TRUE;
+        }
+    }
+    child->parent = parent;
+    child->detached = GAS_FALSE;
+
+    return child;
+}
+/*}}}*/
 /*@}*/
 
 /** @name management */
 /*@{*/
 /* gas_update() {{{*/
+/**
+ * @brief Recompute the sizes of the dirty chunks in the tree.
+ *
+ * Clean children keep their sizes, so after a few edits through the
+ * mutators, only the paths from the edited chunks up are visited.  Lazily
+ * read chunks are clean, their sizes coming from the input, and children
+ * not loaded yet are skipped.
+ */
 GASresult gas_update (GASchunk* c)
 {
     GASresult result;
@@ -547,44 +1268,73 @@ GASresult gas_update (GASchunk* c)
 
     GAS_CHECK_PARAM(c);
 
+    if (!c->dirty) {
+        return GAS_OK;
+    }
+
     sum = 0;
     /* id*/
-    sum += gas_encoded_size(c->id_size);
+    sum += gas_codec_length(c->id_size);
     sum += c->id_size;
     /* attributes */
-    sum += gas_encoded_size(c->nb_attributes);
+    sum += gas_codec_length(c->nb_attributes);
     for (i = 0; i < c->nb_attributes; i++) {
-        sum += gas_encoded_size(c->attributes[i].key_size);
+        sum += gas_codec_length(c->attributes[i].key_size);
         sum += c->attributes[i].key_size;
-        sum += gas_encoded_size(c->attributes[i].value_size);
+        sum += gas_codec_length(c->attributes[i].value_size);
         sum += c->attributes[i].value_size;
     }
     /* payload */
-    sum += gas_encoded_size(c->payload_size);
+    sum += gas_codec_length(c->payload_size);
     sum += c->payload_size;
     /* children */
-    sum += gas_encoded_size(c->nb_children);
+    sum += gas_codec_length(c->nb_children);
     for (i = 0; i < c->nb_children; i++) {
         GASchunk* child = c->children[i];
+        if (child == NULL) {
+            /* not loaded yet, see gas_load_child_at() */
+            continue;
+        }
         result = gas_update(child);
 #ifdef GAS_DEBUG
         if (result != GAS_OK) { return result; }
 #endif
-        sum += gas_encoded_size(child->size);
+        sum += gas_codec_length(child->size);
         sum += child->size;
     }
 
     /*printf("size: %ld\n", sum); */
     c->size = sum;
+    c->dirty = GAS_FALSE;
     /*fflush(stdout);*/
 
     return GAS_OK;
 }
 /*}}}*/
+/* gas_mark_dirty() {{{*/
+/**
+ * @brief Flag the chunk's size, and its ancestors' sizes, as stale.
+ *
+ * Only needed after changing a chunk's fields directly, rather than through
+ * the functions above.  The chunk's attribute keys are rehashed on the next
+ * lookup.
+ */
+GASvoid gas_mark_dirty (GASchunk* c)
+{
+    if (c != NULL) {
+        gas_drop_attribute_index(c);
+    }
+    while (c != NULL && !c->dirty) {
+        c->dirty = GAS_TRUE;
+        c = c->parent;
+    }
+}
+/*}}}*/
 /* gas_total_size() {{{*/
 /**
  * @brief Returns the total size of the chunk, including initial encoded size.
- * @warning The result is only valid after an update.
+ *
+ * Dirty chunks are updated first.
  * @warning no way of reporting an error.
  */
 GASunum gas_total_size (GASchunk* c)
@@ -592,7 +1342,10 @@ GASunum gas_total_size (GASchunk* c)
 #ifdef GAS_DEBUG
     if (c == NULL) { return 0; }
 #endif
-    return c->size + gas_encoded_size(c->size);
+    if (c->dirty) {
+        gas_update(c);
+    }
+    return c->size + gas_codec_length(c->size);
 }
 /*}}}*/
 /*@}*/
@@ -30,6 +30,9 @@
 #include <stdio.h>
 #endif
 
+/* see lazy.h */
+struct GASlazy_children;
+
 #if defined(GAS_ENABLE_CPP) && defined(__cplusplus)
 #include <exception>
 namespace Gas
@@ -37,37 +40,102 @@ namespace Gas
 /*}*/
 #endif
 
+/**
+ * @brief Ids, keys and values shorter than this are stored inside their
+ * chunk or attribute, rather than allocated.
+ */
+#define GAS_INLINE_SIZE 16
+
 /* Attribute {{{*/
 struct Attribute
 {
     GASunum key_size;
     GASubyte *key;
+    /** @brief Symbol of the key when interned, see @ref intern, or 0. */
+    GASunum key_symbol;
     GASunum value_size;
     GASubyte *value;
+
+    /** @brief Storage of short keys and values, see gas_field_alloc(). */
+    GASubyte key_inline[GAS_INLINE_SIZE];
+    GASubyte value_inline[GAS_INLINE_SIZE];
 };
 /* }}}*/
 
 /* Chunk {{{*/
 struct Chunk
 {
+    /**
+     * @brief The parent, or one of them when shared, see gas_clone().
+     *
+     * NULL for a root, or once the linked parent released a shared chunk.
+     */
     struct Chunk* parent;
+    /**
+     * @brief Number of owners: parents, and handles from gas_clone().
+     *
+     * Shared chunks, with more than one, are not changed in place.
+     */
+    GASunum refs;
 
     GASunum size;
+    /**
+     * @brief Whether size, or the size of a descendant, is stale.
+     *
+     * The mutators keep clean sizes up to date along the parent chain, and
+     * flag the chain dirty when they cannot.  A dirty chunk's parent is
+     * dirty too.  gas_update() only visits dirty chunks.
+     */
+    GASbool dirty;
 
     GASunum id_size;
     GASubyte *id;
+    /** @brief Symbol of the id when interned, see @ref intern, or 0. */
+    GASunum id_symbol;
+    /** @brief Storage of a short id, see gas_field_alloc(). */
+    GASubyte id_inline[GAS_INLINE_SIZE];
 
     GASunum nb_attributes;
     struct Attribute* attributes;
+    /** @brief Number of attributes allocated, see gas_reserve_attributes(). */
+    GASunum attributes_capacity;
+    /**
+     * @brief Open addressing hash of the attribute keys, holding index + 1,
+     * or NULL.  Built by gas_index_of_attribute() once a chunk has
+     * GAS_ATTRIBUTE_INDEX_THRESHOLD attributes.
+     */
+    GASunum* attribute_index;
+    GASunum attribute_index_size;
 
     GASunum payload_size;
     GASubyte *payload;
 
     GASunum nb_children;
     struct Chunk** children;
+    /** @brief Number of children allocated, see gas_reserve_children(). */
+    GASunum children_capacity;
 
     GASvoid* user_data;
 
+    /**
+     * @brief Whether the fields point into the input of a parser, see
+     * GASparser::borrow.  Such chunks are read only, and gas_destroy()
+     * leaves their fields alone.
+     */
+    GASbool borrowed;
+    /**
+     * @brief Set when the linked parent released this chunk while other
+     * owners kept it.  The remaining owner is then unknown, so the chunk
+     * stays read only until gas_writable_child() links it to a parent
+     * again, or gas_unshare() hands it to the caller.
+     */
+    GASbool detached;
+    /**
+     * @brief Where the children not read yet are, or NULL.  Set by a
+     * parser reading lazily, see @ref lazy.
+     */
+    struct GASlazy_children* lazy;
+
 #if defined(GAS_ENABLE_CPP) && defined(__cplusplus)
 public:
 
@@ -106,6 +174,8 @@ public:
     inline GASvoid set_payload (const GASchar *payload);
 
     inline Chunk* add_child (Chunk* child);
+    inline Chunk* reserve_children (GASunum count);
+    inline Chunk* reserve_attributes (GASunum count);
 
     inline Chunk* update (void);
 
@@ -142,6 +212,12 @@ typedef struct Attribute GASattribute;
 typedef struct Chunk GASchunk;
 #endif
 
+/**
+ * @brief Number of attributes from which a chunk's attribute keys are
+ * hashed, rather than scanned.
+ */
+#define GAS_ATTRIBUTE_INDEX_THRESHOLD 16
+
 
 /* C Functions {{{*/
 #ifdef __cplusplus
@@ -153,6 +229,12 @@ extern "C"
 GASunum gas_encoded_size (GASunum value);
 
 int gas_cmp(const GASubyte *a, GASunum a_len, const GASubyte *b, GASunum b_len);
+GASunum gas_hash (const GASvoid* bytes, GASunum size);
+
+GASubyte* gas_field_alloc (GASubyte* local, GASunum size, GASvoid* user_data);
+GASubyte* gas_field_resize (GASubyte* field, GASubyte* local, GASunum size,
+                            GASvoid* user_data);
+GASvoid gas_field_free (GASubyte* field, GASubyte* local, GASvoid* user_data);
 
 GASbool gas_id_is (const GASchunk* c, const GASchar* id);
 
@@ -203,11 +285,18 @@ GASnum gas_index_of_attribute (GASchunk* c, const GASvoid* key, GASunum key_size
 GASresult gas_set_attribute (GASchunk* c,
                              const GASvoid *key, GASunum key_size,
                              const GASvoid *value, GASunum value_size);
+GASresult gas_append_attribute (GASchunk* c,
+                                const GASvoid *key, GASunum key_size,
+                                const GASvoid *value, GASunum value_size);
+GASresult gas_set_attribute_at (GASchunk* c, GASunum index,
+                                const GASvoid *key, GASunum key_size,
+                                const GASvoid *value, GASunum value_size);
 GASbool gas_has_attribute (GASchunk* c, const GASvoid* key, GASunum key_size);
 GASnum gas_attribute_value_size (GASchunk* c, GASunum index);
 GASresult gas_get_attribute_at (GASchunk* c, GASunum index, GASvoid* value, GASunum* len);
 GASresult gas_get_attribute (GASchunk* c, const GASvoid* key, GASunum key_size, GASvoid* value, GASunum* len);
 GASresult gas_delete_attribute_at (GASchunk* c, GASunum index);
+GASresult gas_reserve_attributes (GASchunk* c, GASunum count);
 GASresult gas_delete_child_at (GASchunk* c, GASunum index);
 /*@}*/
 /**
@@ -222,15 +311,38 @@ GASunum gas_payload_size (GASchunk* c);
 /**
  * @defgroup children  Child Access
  * @ingroup access
+ * @brief Child access, and subtrees shared between parents.
+ *
+ * A chunk can be added to any number of parents: gas_clone() counts the
+ * extra owner, in constant time, and each gas_destroy() releases one.  While
+ * shared, a chunk and everything below it are read only; the mutators fail
+ * with GAS_ERR_INVALID_PARAM.  To change a shared subtree, copy the path
+ * down to the chunk with gas_writable_child(), starting from a root made
+ * writable with gas_unshare():
+ *
+ * @code
+ * gas_add_child(a, gas_clone(shared));
+ * gas_add_child(b, shared);
+ * item = gas_writable_child(a, 0);        // a gets its own copy ...
+ * item = gas_writable_child(item, 3);     // ... down to the chunk changed
+ * gas_set_payload(item, "x", 1);          // b is unchanged
+ * @endcode
  */
 /*@{*/
 GASchunk* gas_get_parent(GASchunk* c);
 GASresult gas_add_child(GASchunk* parent, GASchunk* child);
 GASunum gas_nb_children (GASchunk *c);
 GASchunk* gas_get_child_at (GASchunk* c, GASunum index);
+GASchunk* gas_get_child_by_id (GASchunk* c, const GASvoid* id,
+                               GASunum id_size);
+GASresult gas_reserve_children (GASchunk* c, GASunum count);
+GASchunk* gas_clone (GASchunk* c);
+GASresult gas_unshare (GASchunk** c);
+GASchunk* gas_writable_child (GASchunk* parent, GASunum index);
 /*@}*/
 
 GASresult gas_update (GASchunk* c);
+GASvoid gas_mark_dirty (GASchunk* c);
 GASunum gas_total_size (GASchunk* c);
 
 
@@ -56,8 +56,8 @@ inline char* Exception::what () throw()
 #define copy_to_field(field)                                                \
     do {                                                                    \
         this->field##_size = field##_size;                                  \
-        this->field = (GASubyte*)gas_realloc(this->field, field##_size +1,  \
-                                             user_data); \
+        this->field = gas_field_resize(this->field, this->field##_inline,   \
+                                       field##_size, user_data);            \
         if (this->field == NULL) { throw Gas::Exception("out of memory"); } \
         memcpy(this->field, field, field##_size);                           \
         ((GASubyte*)this->field)[field##_size] = 0;                         \
@@ -66,15 +66,25 @@ inline char* Exception::what () throw()
 
 inline Chunk::Chunk (GASunum id_size, const GASvoid *id, GASvoid* user_data) :/*{{{*/
     parent(0),
+    refs(1),
     size(0),
+    dirty(GAS_TRUE),
     id_size(0),
     id(0),
+    id_symbol(0),
     nb_attributes(0),
     attributes(0),
+    attributes_capacity(0),
+    attribute_index(0),
+    attribute_index_size(0),
     payload_size(0),
     payload(0),
     nb_children(0),
-    children(0)
+    children(0),
+    children_capacity(0),
+    borrowed(GAS_FALSE),
+    detached(GAS_FALSE),
+    lazy(0)
 {
     if (id) {
         copy_to_field(id);
@@ -82,15 +92,25 @@ inline Chunk::Chunk (GASunum id_size, const GASvoid *id, GASvoid* user_data) :/*
 }/*}}}*/
 inline Chunk::Chunk (const GASchar *id, GASvoid* user_data) :/*{{{*/
     parent(0),
+    refs(1),
     size(0),
+    dirty(GAS_TRUE),
     id_size(0),
     id(0),
+    id_symbol(0),
     nb_attributes(0),
     attributes(0),
+    attributes_capacity(0),
+    attribute_index(0),
+    attribute_index_size(0),
     payload_size(0),
     payload(0),
     nb_children(0),
-    children(0)
+    children(0),
+    children_capacity(0),
+    borrowed(GAS_FALSE),
+    detached(GAS_FALSE),
+    lazy(0)
 {
     if (id) {
         id_size = strlen(id);
@@ -101,15 +121,26 @@ inline Chunk::~Chunk ()/*{{{*/
 {
     GASunum i;
 
-    gas_free(id, this->user_data);
+    if (id_symbol == 0) {
+        gas_field_free(id, id_inline, this->user_data);
+    }
     for (i = 0; i < nb_attributes; i++) {
-        gas_free(attributes[i].key, this->user_data);
-        gas_free(attributes[i].value, this->user_data);
+        if (attributes[i].key_symbol == 0) {
+            gas_field_free(attributes[i].key, attributes[i].key_inline,
+                           this->user_data);
+        }
+        gas_field_free(attributes[i].value, attributes[i].value_inline,
+                       this->user_data);
     }
     gas_free(attributes, this->user_data);
+    gas_free(attribute_index, this->user_data);
     gas_free(payload, this->user_data);
     for (i = 0; i < nb_children; i++) {
-        delete children[i];
+        if (children[i]->refs > 1) {
+            children[i]->refs--;
+        } else {
+            delete children[i];
+        }
     }
     gas_free(children, this->user_data);
 }/*}}}*/
@@ -184,10 +215,11 @@ inline GASvoid Chunk::get_attribute (const GASchar* key, V& retval, bool auto_sw
 {
     GASresult r;
     GASunum len;
-#if GAS_DEBUG
     GASnum index;
+
     index = gas_index_of_attribute(this, key, strlen(key));
     GAS_CHECK_RESULT(index);
+#if GAS_DEBUG
     if (sizeof(retval) != this->attributes[index].value_size) {
 #if HAVE_FPRINTF
         fprintf(stderr, "gas warning: value size mismatch\n");
@@ -195,7 +227,7 @@ inline GASvoid Chunk::get_attribute (const GASchar* key, V& retval, bool auto_sw
     }
 #endif
     len = sizeof(retval);
-    r = gas_get_attribute_s(this, key, &retval, &len);
+    r = gas_get_attribute_at(this, index, &retval, &len);
     GAS_CHECK_RESULT(r);
     if (auto_swap) {
         switch (sizeof(V)) {
@@ -218,11 +250,12 @@ template<typename K, typename V>
 inline GASvoid Chunk::get_attribute (const K& key, V& retval)/*{{{*/
 {
     GASnum r;
+    GASunum len = sizeof(V);
 
     r = gas_index_of_attribute(this, &key, sizeof(K));
     GAS_CHECK_RESULT(r);
 
-    r = gas_get_attribute(this, r, &retval, sizeof(V));
+    r = gas_get_attribute_at(this, r, &retval, &len);
     GAS_CHECK_RESULT(r);
 }/*}}}*/
 
@@ -237,7 +270,30 @@ inline GASvoid Chunk::set_payload (const GASchar *payload)/*{{{*/
 
 inline Chunk* Chunk::add_child (Chunk* child)/*{{{*/
 {
-    gas_add_child(this, child);
+    if (gas_add_child(this, child) == GAS_ERR_MEMORY) {
+        throw Gas::Exception("out of memory");
+    }
+    return this;
+}/*}}}*/
+/**
+ * @brief Make room for @a count more children, see gas_reserve_children().
+ */
+inline Chunk* Chunk::reserve_children (GASunum count)/*{{{*/
+{
+    if (gas_reserve_children(this, count) == GAS_ERR_MEMORY) {
+        throw Gas::Exception("out of memory");
+    }
+    return this;
+}/*}}}*/
+/**
+ * @brief Make room for @a count more attributes, see
+ * gas_reserve_attributes().
+ */
+inline Chunk* Chunk::reserve_attributes (GASunum count)/*{{{*/
+{
+    if (gas_reserve_attributes(this, count) == GAS_ERR_MEMORY) {
+        throw Gas::Exception("out of memory");
+    }
     return this;
 }/*}}}*/
 
@@ -249,8 +305,7 @@ inline Chunk* Chunk::update (void)/*{{{*/
 
 inline Chunk* Chunk::operator<< (Chunk* child)/*{{{*/
 {
-    gas_add_child(this, child);
-    return this;
+    return add_child(child);
 }/*}}}*/
 
 inline GASbool Chunk::has_attribute (const GASchar* key)
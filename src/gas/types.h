@@ -56,9 +56,11 @@ typedef unsigned char  uint8_t;
 #if GAS_USE_LONG_TYPES
 typedef unsigned long int GASunum;
 typedef          long int GASnum;
+#  define GAS_SIZEOF_UNUM GAS_SIZEOF_LONG_INT
 #else
 typedef unsigned int GASunum;
 typedef          int GASnum;
+#  define GAS_SIZEOF_UNUM GAS_SIZEOF_INT
 #endif
 typedef unsigned char     GASubyte;
 typedef          char     GASchar;
@@ -15,6 +15,7 @@
  */
 
 #include "writer.h"
+#include "codec.h"
 
 #include <string.h>
 
@@ -22,102 +23,181 @@
 /* gas_write_encoded_num_writer() {{{*/
 GASresult gas_write_encoded_num_writer (GASwriter *writer, GASunum value)
 {
-    GASresult result = GAS_OK;
-    unsigned int bytes_written;
-    GASunum i, coded_length;
-    GASubyte byte, mask;
-    GASunum zero_count, zero_bytes, zero_bits;
-    GASnum si;  /* a signed i */
+    GASubyte buf[GAS_CODEC_MAX_LENGTH];
+    GASnum length;
 
     GAS_CHECK_PARAM(writer);
 
-    for (i = 1; 1; i++) {
-        if (value < ((1UL << (7UL*i))-1UL)) {
-            break;
-        }
-        if ((i * 7L) > (sizeof(GASunum) << 3)) {
-            /* warning, close to overflow */
-            /* i--; */
-            break;
-        }
+    length = gas_codec_encode(buf, sizeof(buf), value);
+    if (length <= 0) {
+        return GAS_ERR_UNKNOWN;
     }
-    coded_length = i;  /* not including header */
 
-    zero_count = coded_length - 1;
-    zero_bytes = zero_count / 8;
-    zero_bits = zero_count % 8;
+    return gas_context_write(writer->context, writer->handle, buf, length);
+}
+/*}}}*/
+
+
+/* staging {{{*/
+/* fields shorter than this are copied, rather than referenced */
+#define GAS_WRITER_COPY_LIMIT 64
 
-    byte = 0x0;
-    for (i = 0; i < zero_bytes; i++) {
-        result = writer->context->write(writer->handle, &byte, 1, &bytes_written, writer->context->user_data);
-        if (result != GAS_OK) {
-            return result;
+/**
+ * @brief Whether the context's writev callback may be used.
+ */
+static GASbool gas_writer_vectored (GAScontext* ctx)
+{
+    return ctx->writev != NULL;
+}
+
+/**
+ * @brief Append to the list, extending the last buffer when contiguous.
+ *
+ * The caller ensures there is room for another buffer.
+ */
+static GASvoid gas_writer_append (GASwriter* w, const GASvoid* data,
+                                  GASunum size)
+{
+    GASiovec* last;
+
+    if (w->iov_count > 0) {
+        last = &w->iov[w->iov_count - 1];
+        if ((const GASubyte*)last->iov_base + last->iov_len == data) {
+            last->iov_len += size;
+            return;
         }
     }
 
-    mask = 0x80;
-    mask >>= zero_bits;
+    w->iov[w->iov_count].iov_base = (GASvoid*)data;
+    w->iov[w->iov_count].iov_len = size;
+    w->iov_count++;
+}
 
-    /* write the first masked byte */
-    /*if ((coded_length - 1) <= sizeof(GASunum)) {*/
-    if (coded_length <= sizeof(GASunum)) {
-        byte = mask | ((value >> ((coded_length-zero_bytes-1)<<3)) & 0xff);
-    } else {
-        byte = mask;
+static GASresult gas_writer_reserve (GASwriter* w, GASunum size)
+{
+    if (w->buffer_used + size > GAS_WRITER_BUFFER_SIZE ||
+        w->iov_count == GAS_WRITER_IOV_SIZE) {
+        return gas_writer_flush(w);
     }
-    result = writer->context->write(writer->handle, &byte, 1, &bytes_written, writer->context->user_data);
-    if (result != GAS_OK) {
-        return result;
+    return GAS_OK;
+}
+
+static GASresult gas_writer_num (GASwriter* w, GASunum value)
+{
+    GASresult result;
+    GASubyte* dest;
+    GASnum length;
+
+    result = gas_writer_reserve(w, GAS_CODEC_MAX_LENGTH);
+    if (result != GAS_OK) { return result; }
+
+    dest = w->buffer + w->buffer_used;
+    length = gas_codec_encode(dest, GAS_CODEC_MAX_LENGTH, value);
+    if (length <= 0) {
+        return GAS_ERR_UNKNOWN;
     }
+    w->buffer_used += length;
+    gas_writer_append(w, dest, length);
 
-    /*
-     * write remaining bytes
-     * from coded length, subtract 1 byte because we count down to zero
-     * subtract an addition byte because one was already or'ed with the mask
-     *
-     * @internal
-     * @todo figure out why zero_bytes is subtracted
-     */
-    for (si = coded_length - 2 - zero_bytes; si >= 0; si--) {
-        byte = ((value >> (si<<3)) & 0xff);
-        result = writer->context->write(writer->handle, &byte, 1, &bytes_written, writer->context->user_data);
-        if (result != GAS_OK) {
-            return result;
-        }
+    return GAS_OK;
+}
+
+static GASresult gas_writer_field (GASwriter* w, const GASvoid* data,
+                                   GASunum size)
+{
+    GASresult result;
+    GASubyte* dest;
+
+    if (size == 0) {
+        return GAS_OK;
+    }
+
+    if (size < GAS_WRITER_COPY_LIMIT) {
+        result = gas_writer_reserve(w, size);
+        if (result != GAS_OK) { return result; }
+        dest = w->buffer + w->buffer_used;
+        memcpy(dest, data, size);
+        w->buffer_used += size;
+        gas_writer_append(w, dest, size);
+    } else {
+        result = gas_writer_reserve(w, 0);
+        if (result != GAS_OK) { return result; }
+        gas_writer_append(w, data, size);
     }
 
     return GAS_OK;
 }
 /*}}}*/
+/* gas_writer_flush() {{{*/
+/**
+ * @brief Write out everything staged by the writer.
+ *
+ * Referenced fields must remain valid until this returns.
+ */
+GASresult gas_writer_flush (GASwriter *writer)
+{
+    GAScontext* ctx;
+    GASresult result = GAS_OK;
+    GASunum i, total = 0;
+    unsigned long written = 0;
 
+    GAS_CHECK_PARAM(writer);
+
+    ctx = writer->context;
+    if (writer->iov_count == 0) {
+        return GAS_OK;
+    }
 
+    if (gas_writer_vectored(ctx)) {
+        for (i = 0; i < writer->iov_count; i++) {
+            total += writer->iov[i].iov_len;
+        }
+        result = ctx->writev(writer->handle, writer->iov,
+                             (unsigned int)writer->iov_count, &written,
+                             ctx->user_data);
+        if (result == GAS_OK && written != total) {
+            result = GAS_ERR_UNKNOWN;
+        }
+    } else {
+        for (i = 0; i < writer->iov_count; i++) {
+            result = gas_context_write(ctx, writer->handle,
+                                       writer->iov[i].iov_base,
+                                       writer->iov[i].iov_len);
+            if (result != GAS_OK) { break; }
+        }
+    }
+
+    writer->iov_count = 0;
+    writer->buffer_used = 0;
+
+    return result;
+}
+/*}}}*/
 /* gas_write_writer() {{{*/
 #define write_field(field)                                                  \
     do {                                                                    \
-        result = gas_write_encoded_num_writer(writer, self->field##_size);  \
+        result = gas_writer_num(writer, self->field##_size);                \
         if (result != GAS_OK) { return result; }                            \
-        result = writer->context->write(                                    \
-            writer->handle, self->field,                                    \
-            self->field##_size, &bytes_written,                             \
-            writer->context->user_data);                                    \
+        result = gas_writer_field(writer, self->field, self->field##_size); \
         if (result != GAS_OK) { return result; }                            \
     } while(0)
 
-GASresult gas_write_writer (GASwriter *writer, GASchunk* self)
+static GASresult gas_writer_stage (GASwriter *writer, GASchunk* self)
 {
     GASresult result = GAS_OK;
     GASunum i;
     unsigned int bytes_written;
 
-    GAS_CHECK_PARAM(writer);
     GAS_CHECK_PARAM(self);
+    /* children not read yet cannot be written, see @ref lazy */
+    if (self->lazy != NULL) { return GAS_ERR_INVALID_PARAM; }
 
     /* this chunk's size */
-    gas_write_encoded_num_writer(writer, self->size);
+    result = gas_writer_num(writer, self->size);
     if (result != GAS_OK) { return result; }
     write_field(id);
     /* attributes */
-    gas_write_encoded_num_writer(writer, self->nb_attributes);
+    result = gas_writer_num(writer, self->nb_attributes);
     if (result != GAS_OK) { return result; }
     for (i = 0; i < self->nb_attributes; i++) {
         write_field(attributes[i].key);
@@ -125,24 +205,51 @@ GASresult gas_write_writer (GASwriter *writer, GASchunk* self)
     }
     if (self->payload == NULL && writer->on_write_payload) {
         /// @todo test
-        result = gas_write_encoded_num_writer(writer, self->payload_size);
+        result = gas_writer_num(writer, self->payload_size);
         if (result != GAS_OK) { return result; }
 
+        /* the callback writes through the context itself */
+        result = gas_writer_flush(writer);
+        if (result != GAS_OK) { return result; }
         result = writer->on_write_payload(writer, self, &bytes_written);
         if (result != GAS_OK) { return result; }
     } else {
         write_field(payload);
     }
     /* children */
-    result = gas_write_encoded_num_writer(writer, self->nb_children);
+    result = gas_writer_num(writer, self->nb_children);
     if (result != GAS_OK) { return result; }
     for (i = 0; i < self->nb_children; i++) {
-        result = gas_write_writer(writer, self->children[i]);
+        result = gas_writer_stage(writer, self->children[i]);
         if (result != GAS_OK) { return result; }
     }
 
     return result;
 }
+
+#undef write_field
+
+/**
+ * @brief Write a tree, gathering its output into as few context writes as
+ * possible.
+ */
+GASresult gas_write_writer (GASwriter *writer, GASchunk* self)
+{
+    GASresult result;
+
+    GAS_CHECK_PARAM(writer);
+    GAS_CHECK_PARAM(self);
+
+    result = gas_writer_stage(writer, self);
+    if (result != GAS_OK) {
+        /* discard whatever was staged */
+        writer->iov_count = 0;
+        writer->buffer_used = 0;
+        return result;
+    }
+
+    return gas_writer_flush(writer);
+}
 /*}}}*/
 
 GASresult gas_writer_new (
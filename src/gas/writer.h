@@ -37,6 +37,15 @@ extern "C"
  */
 /*@{*/
 
+/**
+ * @brief Size of the writer's staging buffer, in bytes.
+ */
+#define GAS_WRITER_BUFFER_SIZE 4096
+/**
+ * @brief Number of buffers the writer gathers before flushing.
+ */
+#define GAS_WRITER_IOV_SIZE 64
+
 struct GASwriter;
 
 typedef GASresult (*GAS_WRITE_PAYLOAD) (struct GASwriter* writer,
@@ -49,10 +58,23 @@ typedef struct GASwriter
     GASvoid *handle;
 
     GAS_WRITE_PAYLOAD on_write_payload;
+
+    /**
+     * @brief Output staged by gas_write_writer(), until gas_writer_flush().
+     *
+     * Encoded numbers and small fields are copied into buffer, while larger
+     * fields are referenced in place.  The list is handed to the context's
+     * writev callback when it has one, or to write, a buffer at a time.
+     */
+    GASubyte buffer[GAS_WRITER_BUFFER_SIZE];
+    GASunum buffer_used;
+    GASiovec iov[GAS_WRITER_IOV_SIZE];
+    GASunum iov_count;
 } GASwriter;
 
 GASresult gas_write_encoded_num_writer (GASwriter *writer, GASunum value);
 GASresult gas_write_writer (GASwriter *writer, GASchunk* self);
+GASresult gas_writer_flush (GASwriter *writer);
 
 GASresult gas_writer_new (
     GASwriter** writer,
@@ -129,7 +129,9 @@ void EditWindow::load (QString fname)
     gas_add_child(dummy, c);
     tree_model->setRoot(dummy);
 
-    QtConcurrent::run(gas_update, c);
+    // not on a worker thread: edits update the same sizes and dirty flags,
+    // and only dirty chunks are visited anyway
+    gas_update(dummy);
 
     setInterfaceEnabled(true);
 }
@@ -197,7 +199,6 @@ void EditWindow::on_id_line_edit_editingFinished ()
 
     QString str = id_line_edit->text();
     gas_set_id(current_chunk, qPrintable(str), str.size());
-    QtConcurrent::run(gas_update, tree_model->root);
 }
 
 void EditWindow::on_attribute_table_cellChanged (int row, int col)
@@ -206,36 +207,29 @@ void EditWindow::on_attribute_table_cellChanged (int row, int col)
         return;
     }
 
-    GASattribute* attr = &current_chunk->attributes[row];
     QTableWidgetItem* key_item   = attribute_table->item(row, 0);
     QTableWidgetItem* value_item = attribute_table->item(row, 1);
 
+    // the sizes up the parent chain, and the key index, follow the change
     switch (col)
     {
     case 0:
     {
         QString key = key_item->text();
-        attr->key_size = key.size();
-        attr->key = (GASubyte*)gas_realloc(attr->key, attr->key_size + 1, NULL);
-        memcpy(attr->key, qPrintable(key), attr->key_size);
-        attr->key[attr->key_size] = 0;
+        gas_set_attribute_at(current_chunk, row, qPrintable(key), key.size(),
+                             NULL, 0);
         break;
     }
     case 1:
     {
         QString value = value_item->text();
-        attr->value_size = value.size();
-        attr->value = (GASubyte*)gas_realloc(attr->value, attr->value_size + 1, NULL);
-        memcpy(attr->value, qPrintable(value), attr->value_size);
-        attr->value[attr->value_size] = 0;
+        gas_set_attribute_at(current_chunk, row, NULL, 0,
+                             qPrintable(value), value.size());
         break;
     }
     default:
         break;
     }
-
-    QtConcurrent::run(gas_update, tree_model->root);
-
 }
 
 void EditWindow::on_payload_text_edit_textChanged ()
@@ -256,7 +250,6 @@ void EditWindow::on_payload_timer_timeout ()
     }
     QString str = payload_text_edit->toPlainText();
     gas_set_payload(current_chunk, qPrintable(str), str.size());
-    QtConcurrent::run(gas_update, tree_model->root);
 }
 
 void EditWindow::on_open_action_activated ()
@@ -32,13 +32,7 @@
 static inline
 unsigned int encoded_size (unsigned int value)
 {
-    unsigned int i;
-    for (i = 1; 1; i++) {
-        if (value < ((1UL << (7UL*i))-1UL)) {
-            break;
-        }
-    }
-    return i + ((i - 1) >> 3);
+    return gas_codec_length(value);
 }
 
 using namespace Gas;
@@ -28,6 +28,8 @@
 #include <QTextStream>
 #include <QBuffer>
 
+#include <gas/codec.h>
+
 namespace Gas
 {
 
@@ -23,56 +23,19 @@ template <typename T>
 inline
 unsigned int Chunk::encode (QIODevice* io, const T& value)
 {
-    unsigned int i, coded_length;
-    quint8 byte, mask;
-    unsigned int zero_count, zero_bytes, zero_bits;
-    int si;
-    unsigned int bytes_produced = 0;
+    GASubyte buf[GAS_CODEC_MAX_LENGTH];
+    GASnum length;
 
-    for (i = 1; 1; i++) {
-        if ((quint64)value < ((1UL << (7UL*i))-1UL)) {
-            break;
-        }
-        if ((i * 7UL) > (sizeof(T) << 3)) {
-            break;
-        }
-    }
-    coded_length = i;
-
-    zero_count = coded_length - 1;
-    zero_bytes = zero_count / 8;
-    zero_bits = zero_count % 8;
-
-    byte = 0x0;
-    for (i = 0; i < zero_bytes; i++) {
-        if (!io->putChar(byte)) {
-            return 0;
-        }
-        bytes_produced += 1;
-    }
-
-    mask = 0x80;
-    mask >>= zero_bits;
-
-    if (coded_length <= sizeof(T)) {
-        byte = mask | ((value >> ((coded_length-zero_bytes-1)<<3)) & 0xff);
-    } else {
-        byte = mask;
-    }
-    if (!io->putChar(byte)) {
+    length = gas_codec_encode(buf, sizeof(buf), static_cast<GASunum>(value));
+    if (length <= 0) {
         return 0;
     }
-    bytes_produced += 1;
 
-    for (si = coded_length - 2 - zero_bytes; si >= 0; si--) {
-        byte = ((value >> (si<<3)) & 0xff);
-        if (!io->putChar(byte)) {
-            return 0;
-        }
-        bytes_produced += 1;
+    if (io->write(reinterpret_cast<char*>(buf), length) != length) {
+        return 0;
     }
 
-    return bytes_produced;
+    return length;
 }
 
 /**
@@ -83,14 +46,13 @@ template <typename T>
 inline
 unsigned int Chunk::decode (QIODevice* io, T& value, bool block)
 {
-    quint64 retval = 0x0;
-    unsigned int zero_byte_count;
-    int i, first_bit_set, additional_bytes_to_read;
-    quint8 byte, mask = 0x00;
-    unsigned int bytes_consumed = 0;
+    GASubyte buf[GAS_CODEC_MAX_LENGTH];
+    GASnum length;
+    GASunum have = 0;
+    GASunum retval;
 
-    /* find first non 0x00 byte */
-    for (zero_byte_count = 0; 1; zero_byte_count++) {
+    /* leading bytes, until the length is known */
+    do {
 
         if (block) {
             while (io->bytesAvailable() < 1) {
@@ -101,45 +63,38 @@ unsigned int Chunk::decode (QIODevice* io, T& value, bool block)
             }
         }
 
-        if (!io->getChar(reinterpret_cast<char*>(&byte))) {
+        if (!io->getChar(reinterpret_cast<char*>(&buf[have]))) {
             return 0;
         }
-        bytes_consumed++;
-        if (byte != 0x00)
-            break;
-    }
-
-    /* process initial byte */
-    for (first_bit_set = 7; first_bit_set >= 0; first_bit_set--)
-        if (byte & (1L << first_bit_set))
-            break;
-
-    for (i = 0; i < first_bit_set; i++)
-        mask |= (1L << i);
+        have++;
+        length = gas_codec_peek_length(buf, have);
+    } while (length == 0);
 
-    additional_bytes_to_read = (7-first_bit_set) + (7*zero_byte_count);
-
-    retval = mask & byte;
-    for (i = 0; i < additional_bytes_to_read; i++) {
+    if (length < 0) {
+        return 0;
+    }
 
-        if (block) {
-            while (io->bytesAvailable() < 1) {
-                if (!io->waitForReadyRead(100)) {
-                    qWarning("%s", qPrintable(io->errorString()));
-                    return 0;
-                }
+    /* remainder of the number */
+    if (block) {
+        while (io->bytesAvailable() < static_cast<qint64>(length - have)) {
+            if (!io->waitForReadyRead(100)) {
+                qWarning("%s", qPrintable(io->errorString()));
+                return 0;
             }
         }
+    }
 
-        if (!io->getChar(reinterpret_cast<char*>(&byte))) {
-            return 0;
-        }
-        bytes_consumed++;
-        retval = (retval << 8) | byte;
+    if (io->read(reinterpret_cast<char*>(buf + have), length - have)
+        != static_cast<qint64>(length - have)) {
+        return 0;
+    }
+
+    if (gas_codec_decode(buf, length, &retval) < 0) {
+        return 0;
     }
 
-    value = retval;
-    return bytes_consumed;
+    value = static_cast<T>(retval);
+    return length;
 }
 
 /**
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2009 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "arena.moc"
+
+#include <QtTest>
+
+#include <gas/arena.h>
+#include <gas/bufio.h>
+#include <gas/ntstring.h>
+
+void TestArena::init ()
+{
+    QCOMPARE(gas_arena_initialize(), GAS_OK);
+}
+
+void TestArena::cleanup ()
+{
+    gas_memory_initialize(gas_allocator_alloc, gas_allocator_realloc,
+                          gas_allocator_free);
+}
+
+void TestArena::read_buf ()
+{
+    GASchunk *root, *c, *out;
+    GASarena *arena;
+    GASubyte expected[4096], buf[4096];
+    GASnum size;
+    int i;
+
+    gas_new_named(&root, "root");
+    for (i = 0; i < 20; i++) {
+        gas_new_named(&c, "child");
+        gas_set_attribute_ss(c, "key", "value");
+        gas_set_payload_s(c, "payload");
+        gas_add_child(root, c);
+    }
+    gas_update(root);
+    size = gas_write_buf(expected, sizeof(expected), root);
+    QVERIFY(size > 0);
+    gas_destroy(root);
+
+    QCOMPARE(gas_arena_new(&arena, 1024), GAS_OK);
+    for (i = 0; i < 3; i++) {
+        QCOMPARE(gas_read_buf(expected, size, &out, arena), size);
+        QVERIFY(out->user_data == arena);
+        QCOMPARE(gas_write_buf(buf, sizeof(buf), out), size);
+        QCOMPARE(memcmp(buf, expected, size), 0);
+        /* the whole tree goes at once */
+        QCOMPARE(gas_arena_clear(arena), GAS_OK);
+        QVERIFY(arena->blocks != NULL);
+        QVERIFY(arena->blocks->next == NULL);
+    }
+    gas_arena_destroy(arena);
+}
+
+void TestArena::grow ()
+{
+    GASchunk *root, *c;
+    GASarena *arena;
+    GASubyte big[2000];
+    char key[16];
+    int i;
+
+    QCOMPARE(gas_arena_new(&arena, 256), GAS_OK);
+    gas_new_named(&root, "root", arena);
+    for (i = 0; i < 50; i++) {
+        gas_new_named(&c, "child", arena);
+        gas_add_child(root, c);
+        sprintf(key, "key%d", i);
+        gas_set_attribute_ss(root, key, "value");
+    }
+    memset(big, 0x5a, sizeof(big));
+    gas_set_payload(root, big, sizeof(big));
+
+    QCOMPARE(gas_nb_children(root), static_cast<GASunum>(50));
+    QCOMPARE(root->nb_attributes, static_cast<GASunum>(50));
+    for (i = 0; i < 50; i++) {
+        QVERIFY(gas_get_child_at(root, i)->parent == root);
+        sprintf(key, "key%d", i);
+        QCOMPARE(QByteArray(gas_get_attribute_ss(root, key)), QByteArray("value"));
+    }
+    QCOMPARE(memcmp(root->payload, big, sizeof(big)), 0);
+
+    gas_arena_destroy(arena);
+}
+
+void TestArena::huge ()
+{
+    GASarena *arena;
+    GASubyte *p, *q;
+
+    QCOMPARE(gas_arena_new(&arena, 256), GAS_OK);
+    /* sizes near the top of GASunum must fail, not wrap around */
+    QVERIFY(gas_arena_alloc((GASunum)-1, arena) == NULL);
+    QVERIFY(gas_arena_alloc((GASunum)-8, arena) == NULL);
+    QVERIFY(gas_field_alloc(NULL, (GASunum)-1, arena) == NULL);
+
+    p = (GASubyte*)gas_arena_alloc(16, arena);
+    QVERIFY(p != NULL);
+    memset(p, 0x5a, 16);
+    QVERIFY(gas_arena_realloc(p, (GASunum)-1, arena) == NULL);
+    q = (GASubyte*)gas_arena_realloc(p, 32, arena);
+    QVERIFY(q == p);
+    QCOMPARE((int)q[15], 0x5a);
+
+    gas_arena_destroy(arena);
+}
+
+int arena (int argc, char** argv)
+{
+    TestArena tc;
+    return QTest::qExec(&tc, argc, argv);
+}
+
+/* vim: set sw=4 fdm=marker :*/
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2009 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "batch.moc"
+
+#include <QtTest>
+
+#include <gas/batch.h>
+#include <gas/bufio.h>
+#include <gas/codec.h>
+#include <gas/ntstring.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define NB_FILES 20
+
+static char paths[NB_FILES][32];
+
+/* payload sizes: some trees need a second read */
+static GASunum payload_size (int i)
+{
+    return i % 5 == 0 ? 10000 + i : i;
+}
+
+void TestBatch::initTestCase ()
+{
+    GASubyte buf[20000];
+    GASubyte payload[20000];
+    GASchunk* c;
+    GASnum size;
+    FILE* fs;
+    int i;
+
+    memset(payload, 0x5a, sizeof(payload));
+    for (i = 0; i < NB_FILES; i++) {
+        gas_new_named(&c, "file");
+        gas_set_attribute_ss(c, "name", "value");
+        gas_set_payload(c, payload, payload_size(i));
+        gas_update(c);
+        size = gas_write_buf(buf, sizeof(buf), c);
+        QVERIFY(size > 0);
+        gas_destroy(c);
+
+        sprintf(paths[i], "batch%d.gas", i);
+        fs = fopen(paths[i], "wb");
+        QVERIFY(fs != NULL);
+        // the last file is cut short
+        if (i == NB_FILES - 1) {
+            size -= 10;
+        }
+        QCOMPARE(fwrite(buf, 1, size, fs), static_cast<size_t>(size));
+        fclose(fs);
+    }
+}
+
+/* read every file, some by descriptor, and one missing */
+static void check (unsigned int flags, GASunum depth, GASbool* uring)
+{
+    GASbatch* b;
+    GASbatch_result done;
+    int fds[NB_FILES];
+    int seen[NB_FILES + 1];
+    int i, n = 0;
+
+    memset(seen, 0, sizeof(seen));
+    QCOMPARE(gas_batch_new(&b, depth, flags), GAS_OK);
+    *uring = b->uring;
+
+    for (i = 0; i < NB_FILES; i++) {
+        fds[i] = -1;
+        if (i % 3 == 0) {
+            fds[i] = open(paths[i], O_RDONLY);
+            QVERIFY(fds[i] >= 0);
+            QCOMPARE(gas_batch_add_fd(b, fds[i], &seen[i]), GAS_OK);
+        } else {
+            QCOMPARE(gas_batch_add_path(b, paths[i], &seen[i]), GAS_OK);
+        }
+    }
+    QCOMPARE(gas_batch_add_path(b, "missing.gas", &seen[NB_FILES]), GAS_OK);
+    QCOMPARE(b->nb_pending, static_cast<GASunum>(NB_FILES + 1));
+
+    while (gas_batch_next(b, &done) == GAS_OK) {
+        i = static_cast<int*>(done.tag) - seen;
+        QVERIFY(i >= 0 && i <= NB_FILES);
+        seen[i]++;
+        n++;
+        if (i == NB_FILES) {
+            QCOMPARE(done.result,
+                     static_cast<GASresult>(GAS_ERR_FILE_NOT_FOUND));
+            QVERIFY(done.tree == NULL);
+        } else if (i == NB_FILES - 1) {
+            QCOMPARE(done.result, static_cast<GASresult>(GAS_ERR_FILE_EOF));
+            QVERIFY(done.tree == NULL);
+        } else {
+            QCOMPARE(done.result, GAS_OK);
+            QVERIFY(gas_id_is(done.tree, "file"));
+            QCOMPARE(done.tree->payload_size, payload_size(i));
+            gas_destroy(done.tree);
+        }
+    }
+    QCOMPARE(n, NB_FILES + 1);
+    for (i = 0; i <= NB_FILES; i++) {
+        QCOMPARE(seen[i], 1);
+    }
+    QCOMPARE(gas_batch_next(b, &done),
+             static_cast<GASresult>(GAS_ERR_OUT_OF_RANGE));
+    gas_batch_destroy(b);
+
+    for (i = 0; i < NB_FILES; i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+}
+
+void TestBatch::uring ()
+{
+    GASbool uring;
+
+    // falls back to threads where io_uring is unavailable
+    check(0, 0, &uring);
+    if (!uring) {
+        QSKIP("io_uring is unavailable", SkipSingle);
+    }
+    check(0, 3, &uring);
+}
+
+void TestBatch::threads ()
+{
+    GASbool uring;
+
+    check(GAS_BATCH_NO_URING, 0, &uring);
+    QVERIFY(!uring);
+    check(GAS_BATCH_NO_URING, 1, &uring);
+}
+
+static void count (GASbatch_result* done, GASvoid* data)
+{
+    if (done->result == GAS_OK) {
+        (*static_cast<int*>(data))++;
+        gas_destroy(done->tree);
+    }
+}
+
+void TestBatch::run ()
+{
+    GASbatch* b;
+    int i, n = 0;
+
+    QCOMPARE(gas_batch_new(&b, 4, 0), GAS_OK);
+    for (i = 0; i < NB_FILES; i++) {
+        QCOMPARE(gas_batch_add_path(b, paths[i]), GAS_OK);
+    }
+    QCOMPARE(gas_batch_run(b, count, &n), GAS_OK);
+    QCOMPARE(n, NB_FILES - 1);
+    QCOMPARE(b->nb_pending, static_cast<GASunum>(0));
+
+    // files not returned are dropped
+    for (i = 0; i < NB_FILES; i++) {
+        QCOMPARE(gas_batch_add_path(b, paths[i]), GAS_OK);
+    }
+    QCOMPARE(gas_batch_destroy(b), GAS_OK);
+}
+
+void TestBatch::oversized ()
+{
+    GASbatch* b;
+    GASbatch_result done;
+    GASubyte buf[32];
+    GASnum length;
+    FILE* fs;
+
+    // a size too large to hand back from gas_read_buf()
+    memset(buf, 0, sizeof(buf));
+    length = gas_codec_encode(buf, sizeof(buf), (GASunum)-1 >> 1);
+    QVERIFY(length > 0);
+    fs = fopen("oversized.gas", "wb");
+    QVERIFY(fs != NULL);
+    QCOMPARE(fwrite(buf, 1, sizeof(buf), fs), sizeof(buf));
+    fclose(fs);
+
+    QCOMPARE(gas_batch_new(&b, 0, GAS_BATCH_NO_URING), GAS_OK);
+    QCOMPARE(gas_batch_add_path(b, "oversized.gas"), GAS_OK);
+    QCOMPARE(gas_batch_next(b, &done), GAS_OK);
+    QCOMPARE(done.result, static_cast<GASresult>(GAS_ERR_OUT_OF_RANGE));
+    QVERIFY(done.tree == NULL);
+    gas_batch_destroy(b);
+    unlink("oversized.gas");
+}
+
+void TestBatch::cleanupTestCase ()
+{
+    int i;
+
+    for (i = 0; i < NB_FILES; i++) {
+        unlink(paths[i]);
+    }
+}
+
+int batch (int argc, char** argv)
+{
+    TestBatch tc;
+    return QTest::qExec(&tc, argc, argv);
+}
+
+/* vim: set sw=4 fdm=marker :*/
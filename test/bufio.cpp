@@ -86,6 +86,28 @@ void TestBufIO::encode_failure_undersized_buffer_0xdeadbeefdeadbeef ()
     }
 }
 
+/**
+ * @brief 9 byte numbers carry 7 value bits after the leading zero byte.
+ */
+void TestBufIO::encode_0x100000000000000 ()
+{
+#if GAS_SIZEOF_UNUM >= 8
+    GASubyte expected_data[] = { 0x00, 0x81, 0x00, 0x00, 0x00,
+                                 0x00, 0x00, 0x00, 0x00 };
+    QByteArray expected (reinterpret_cast<char*>(expected_data),
+                         sizeof(expected_data));
+    GASnum result;
+    GASunum num;
+    result = gas_write_encoded_num_buf(buf, sizeof(buf), 0x100000000000000ul);
+    QCOMPARE(result, static_cast<GASnum>(sizeof(expected_data)));
+    QCOMPARE(QByteArray(reinterpret_cast<char*>(buf), result), expected);
+
+    result = gas_read_encoded_num_buf(buf, result, &num);
+    QCOMPARE(result, static_cast<GASnum>(sizeof(expected_data)));
+    QCOMPARE(num, 0x100000000000000ul);
+#endif
+}
+
 void TestBufIO::decode_0xdeadbeef ()
 {
     GASubyte data[] = { 0x08, 0xde, 0xad, 0xbe, 0xef };
@@ -130,6 +152,30 @@ void TestBufIO::decode_failure_undersized_buffer_0x8f ()
     }
 }
 
+void TestBufIO::roundtrip_length_boundaries ()
+{
+    GASunum i, num, value;
+    GASnum result;
+
+    for (i = 1; i * 7 < sizeof(GASunum) * 8; i++) {
+        for (value = (1ul << (7 * i)) - 3; value <= (1ul << (7 * i)); value++) {
+            result = gas_write_encoded_num_buf(buf, sizeof(buf), value);
+            QVERIFY(result > 0);
+            QCOMPARE(static_cast<GASunum>(result), gas_encoded_size(value));
+
+            result = gas_read_encoded_num_buf(buf, sizeof(buf), &num);
+            QCOMPARE(static_cast<GASunum>(result), gas_encoded_size(value));
+            QCOMPARE(num, value);
+        }
+    }
+
+    value = ~0ul;
+    result = gas_write_encoded_num_buf(buf, sizeof(buf), value);
+    QCOMPARE(static_cast<GASunum>(result), gas_encoded_size(value));
+    result = gas_read_encoded_num_buf(buf, sizeof(buf), &num);
+    QCOMPARE(num, value);
+}
+
 void TestBufIO::tree001 ()
 {
     GASresult result;
@@ -165,6 +211,48 @@ void TestBufIO::tree002 ()
     gas_destroy(c);
 }
 
+void TestBufIO::tree003 ()
+{
+    GASnum result, size;
+    GASchunk *root = NULL, *c, *parent;
+    GASubyte expected[4096], actual[4096];
+    GASubyte fill[200];
+    GASunum i;
+
+    // sizes on either side of the encoding boundaries
+    memset(fill, 'x', sizeof(fill));
+    gas_new_named(&root, "root");
+    parent = root;
+    for (i = 0; i < 12; i++) {
+        gas_new_named(&c, "child");
+        gas_set_attribute(c, "key", 3, fill, i * 11);
+        gas_set_payload(c, fill, 130 - i * 10);
+        gas_add_child(parent, c);
+        if (i % 3 == 0) {
+            parent = c;
+        }
+    }
+
+    // no gas_update() first
+    size = gas_write_buf_update(actual, sizeof(actual), root);
+    QVERIFY(size > 0);
+    QCOMPARE(static_cast<GASunum>(size), gas_total_size(root));
+
+    gas_update(root);
+    result = gas_write_buf(expected, sizeof(expected), root);
+    QCOMPARE(result, size);
+    QVERIFY(memcmp(actual, expected, size) == 0);
+
+    // exactly enough room, and 1 byte too few
+    result = gas_write_buf_update(actual, size, root);
+    QCOMPARE(result, size);
+    QVERIFY(memcmp(actual, expected, size) == 0);
+    result = gas_write_buf_update(actual, size - 1, root);
+    QVERIFY(result < 0);
+
+    gas_destroy(root);
+}
+
 
 
 int bufio (int argc, char **argv)
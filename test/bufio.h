@@ -38,13 +38,17 @@ private slots:
     void encode_0x7f ();
     void encode_failure_undersized_buffer_0xdeadbeef ();
     void encode_failure_undersized_buffer_0xdeadbeefdeadbeef ();
+    void encode_0x100000000000000 ();
 
     void decode_0xdeadbeef ();
     void decode_failure_undersized_buffer_0xdeadbeef ();
     void decode_failure_undersized_buffer_0x8f ();
 
+    void roundtrip_length_boundaries ();
+
     void tree001 ();
     void tree002 ();
+    void tree003 ();
 };
 
 // vim: sw=4 fdm=marker
@@ -0,0 +1,220 @@
+/*
+ * Copyright 2009 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "diff.moc"
+
+#include <QtTest>
+
+#include <gas/diff.h>
+#include <gas/bufio.h>
+#include <gas/ntstring.h>
+
+#include <stdio.h>
+
+static GASchunk* build (void)
+{
+    GASchunk *root, *c, *leaf;
+    char value[32];
+    int i, j;
+
+    gas_new_named(&root, "root");
+    gas_set_attribute_ss(root, "version", "1");
+    for (i = 0; i < 50; i++) {
+        gas_new_named(&c, "item");
+        sprintf(value, "%d", i);
+        gas_set_attribute_ss(c, "index", value);
+        gas_set_attribute_ss(c, "name", "an item of the state tree");
+        gas_set_payload_s(c, "some payload to make the item heavier");
+        for (j = 0; j < 4; j++) {
+            gas_new_named(&leaf, "leaf");
+            gas_set_payload_s(leaf, "leaf payload");
+            gas_add_child(c, leaf);
+        }
+        gas_add_child(root, c);
+    }
+    gas_update(root);
+    return root;
+}
+
+static GASnum encode (GASchunk* c, GASubyte* buf, GASunum limit)
+{
+    gas_update(c);
+    return gas_write_buf(buf, limit, c);
+}
+
+/* the patch as the other end sees it */
+static GASchunk* send (GASchunk* patch)
+{
+    GASubyte buf[65536];
+    GASchunk* received = NULL;
+    GASnum size;
+
+    size = encode(patch, buf, sizeof(buf));
+    if (size <= 0 || gas_read_buf(buf, size, &received) != size) {
+        return NULL;
+    }
+    return received;
+}
+
+void TestDiff::identical ()
+{
+    GASchunk *a, *b, *patch;
+
+    a = build();
+    b = build();
+    QVERIFY(gas_equal(a, b));
+    QCOMPARE(gas_diff(a, b, &patch), GAS_OK);
+    QVERIFY(gas_id_is(patch, "patch"));
+    QCOMPARE(gas_nb_children(patch), (GASunum)0);
+    QCOMPARE(gas_patch(a, patch), GAS_OK);
+    QVERIFY(gas_equal(a, b));
+
+    gas_destroy(patch);
+    gas_destroy(a);
+    gas_destroy(b);
+}
+
+void TestDiff::round_trip ()
+{
+    GASchunk *old_tree, *new_tree, *patch, *received, *c;
+    static GASubyte buf_a[65536], buf_b[65536];
+    GASnum size_a, size_b, patch_size;
+
+    old_tree = build();
+    new_tree = build();
+
+    gas_set_attribute_ss(new_tree, "version", "2");
+    c = gas_get_child_at(new_tree, 3);
+    gas_set_attribute_ss(c, "name", "renamed");
+    gas_set_attribute_ss(c, "extra", "added");
+    gas_delete_attribute_at(c, gas_index_of_attribute(c, "index", 5));
+    gas_set_payload_s(gas_get_child_at(c, 2), "a deep edit");
+    gas_set_id_s(gas_get_child_at(new_tree, 5), "other");
+    gas_delete_child_at(new_tree, 30);
+    gas_delete_child_at(new_tree, 30);
+    gas_new_named(&c, "inserted");
+    gas_add_child(new_tree, c);
+    // one the old tree is missing, inserted in the middle
+    gas_delete_child_at(old_tree, 20);
+    gas_new_named(&c, "appended");
+    gas_set_payload_s(c, "at the end");
+    gas_add_child(new_tree, c);
+    QVERIFY(!gas_equal(old_tree, new_tree));
+
+    QCOMPARE(gas_diff(old_tree, new_tree, &patch), GAS_OK);
+    received = send(patch);
+    QVERIFY(received != NULL);
+    QCOMPARE(gas_patch(old_tree, received), GAS_OK);
+    QVERIFY(gas_equal(old_tree, new_tree));
+
+    size_a = encode(old_tree, buf_a, sizeof(buf_a));
+    size_b = encode(new_tree, buf_b, sizeof(buf_b));
+    QCOMPARE(size_a, size_b);
+    QCOMPARE(memcmp(buf_a, buf_b, size_a), 0);
+
+    // a fraction of the tree
+    patch_size = encode(patch, buf_a, sizeof(buf_a));
+    QVERIFY(patch_size > 0 && patch_size * 10 < size_b);
+
+    // only the tree it was made from
+    QVERIFY(gas_patch(old_tree, received) != GAS_OK);
+    QCOMPARE(gas_patch(old_tree, old_tree), (GASresult)GAS_ERR_INVALID_PARAM);
+
+    gas_destroy(received);
+    gas_destroy(patch);
+    gas_destroy(old_tree);
+    gas_destroy(new_tree);
+}
+
+void TestDiff::attributes ()
+{
+    GASchunk *a, *b, *patch;
+
+    gas_new_named(&a, "c");
+    gas_set_attribute_ss(a, "x", "1");
+    gas_set_attribute_ss(a, "y", "2");
+    gas_set_attribute_ss(a, "z", "3");
+
+    // reordered, sent whole
+    gas_new_named(&b, "c");
+    gas_set_attribute_ss(b, "z", "3");
+    gas_set_attribute_ss(b, "x", "1");
+    QCOMPARE(gas_diff(a, b, &patch), GAS_OK);
+    QCOMPARE(gas_nb_children(patch), (GASunum)1);
+    QVERIFY(gas_id_is(gas_get_child_at(patch, 0), "attributes"));
+    QCOMPARE(gas_patch(a, patch), GAS_OK);
+    QVERIFY(gas_equal(a, b));
+    gas_destroy(patch);
+
+    // repeated keys
+    gas_append_attribute(b, "x", 1, "again", 5);
+    QCOMPARE(gas_diff(a, b, &patch), GAS_OK);
+    QCOMPARE(gas_patch(a, patch), GAS_OK);
+    QCOMPARE(a->nb_attributes, (GASunum)3);
+    QVERIFY(gas_equal(a, b));
+    gas_destroy(patch);
+
+    // kept in order, just the changes
+    gas_delete_attribute_at(a, 2);
+    gas_delete_attribute_at(b, 2);
+    gas_delete_attribute_at(b, 0);
+    gas_set_attribute_ss(b, "x", "changed");
+    gas_set_attribute_ss(b, "w", "new");
+    QCOMPARE(gas_diff(a, b, &patch), GAS_OK);
+    QCOMPARE(gas_nb_children(patch), (GASunum)2);
+    QVERIFY(gas_id_is(gas_get_child_at(patch, 0), "unset"));
+    QVERIFY(gas_id_is(gas_get_child_at(patch, 1), "set"));
+    QCOMPARE(gas_get_child_at(patch, 1)->nb_attributes, (GASunum)2);
+    QCOMPARE(gas_patch(a, patch), GAS_OK);
+    QVERIFY(gas_equal(a, b));
+    gas_destroy(patch);
+
+    gas_destroy(a);
+    gas_destroy(b);
+}
+
+void TestDiff::shared ()
+{
+    GASchunk *base, *edited, *copy, *patch;
+
+    base = build();
+    edited = build();
+    gas_set_payload_s(gas_get_child_at(gas_get_child_at(edited, 7), 1), "x");
+    QCOMPARE(gas_diff(base, edited, &patch), GAS_OK);
+
+    // patching a copy leaves the base alone, and shares what is untouched
+    copy = gas_clone(base);
+    QCOMPARE(gas_patch(copy, patch), (GASresult)GAS_ERR_INVALID_PARAM);
+    QCOMPARE(gas_unshare(&copy), GAS_OK);
+    QCOMPARE(gas_patch(copy, patch), GAS_OK);
+    QVERIFY(gas_equal(copy, edited));
+    QVERIFY(!gas_equal(base, edited));
+    QVERIFY(gas_get_child_at(copy, 6) == gas_get_child_at(base, 6));
+    QVERIFY(gas_get_child_at(copy, 7) != gas_get_child_at(base, 7));
+
+    gas_destroy(patch);
+    gas_destroy(copy);
+    gas_destroy(base);
+    gas_destroy(edited);
+}
+
+int diff (int argc, char** argv)
+{
+    TestDiff tc;
+    return QTest::qExec(&tc, argc, argv);
+}
+
+/* vim: set sw=4 fdm=marker :*/
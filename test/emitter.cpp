@@ -0,0 +1,433 @@
+/*
+ * Copyright 2009 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "emitter.moc"
+
+#include <QtTest>
+
+#include <gas/emitter.h>
+#include <gas/bufio.h>
+#include <gas/fdio.h>
+#include <gas/ntstring.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static GASubyte expected[4096];
+static GASubyte actual[4096];
+
+static GASchunk* build (void)
+{
+    GASchunk *root, *c, *gc;
+    int i;
+
+    gas_new_named(&root, "root");
+    gas_set_attribute_ss(root, "version", "1");
+    gas_set_payload_s(root, "root payload");
+    for (i = 0; i < 3; i++) {
+        gas_new_named(&c, "child");
+        gas_set_attribute_ss(c, "name", i == 1 ? "b" : "a");
+        gas_set_attribute_ss(c, "type", "leaf");
+        if (i == 2) {
+            gas_new_named(&gc, "grandchild");
+            gas_set_payload_s(gc, "payload");
+            gas_add_child(c, gc);
+        }
+        gas_add_child(root, c);
+    }
+    gas_update(root);
+
+    return root;
+}
+
+/* mirror a tree through the emitter */
+static GASresult emit (GASemitter* e, GASchunk* c, bool sized)
+{
+    GASresult r;
+    GASunum i;
+
+    if (sized) {
+        r = gas_emitter_begin_chunk_sized(e, c->id, c->id_size, c->size);
+        if (r != GAS_OK) { return r; }
+        r = gas_emitter_children(e, c->nb_children);
+    } else {
+        r = gas_emitter_begin_chunk(e, c->id, c->id_size);
+    }
+    if (r != GAS_OK) { return r; }
+
+    for (i = 0; i < c->nb_attributes; i++) {
+        r = gas_emitter_attribute(e,
+                                  c->attributes[i].key,
+                                  c->attributes[i].key_size,
+                                  c->attributes[i].value,
+                                  c->attributes[i].value_size);
+        if (r != GAS_OK) { return r; }
+    }
+    if (c->payload_size > 0) {
+        r = gas_emitter_payload(e, c->payload, c->payload_size);
+        if (r != GAS_OK) { return r; }
+    }
+    for (i = 0; i < c->nb_children; i++) {
+        r = emit(e, c->children[i], sized);
+        if (r != GAS_OK) { return r; }
+    }
+
+    return gas_emitter_end_chunk(e);
+}
+
+/* re-encode minimally, to compare with gas_write_buf() of the original */
+static GASnum reencode (GASubyte* buf, GASunum limit)
+{
+    GASchunk* c;
+    GASnum size;
+
+    size = gas_read_buf(buf, limit, &c);
+    if (size <= 0) {
+        return size;
+    }
+    gas_update(c);
+    size = gas_write_buf(buf, sizeof(actual), c);
+    gas_destroy(c);
+    return size;
+}
+
+void TestEmitter::backpatch_buf ()
+{
+    GASchunk* root = build();
+    GASemitter* e;
+    GASnum size;
+
+    size = gas_write_buf(expected, sizeof(expected), root);
+    QVERIFY(size > 0);
+
+    QCOMPARE(gas_emitter_new_buf(&e, actual, sizeof(actual)), GAS_OK);
+    QCOMPARE(emit(e, root, false), GAS_OK);
+    QCOMPARE(e->depth, static_cast<GASunum>(0));
+    QVERIFY(e->pos > static_cast<GASunum>(size));
+    QCOMPARE(reencode(actual, e->pos), size);
+    QVERIFY(memcmp(actual, expected, size) == 0);
+    gas_emitter_destroy(e);
+
+    gas_destroy(root);
+}
+
+void TestEmitter::sized_buf ()
+{
+    GASchunk* root = build();
+    GASemitter* e;
+    GASnum size;
+
+    size = gas_write_buf(expected, sizeof(expected), root);
+
+    // sizes given in advance give the minimal encoding
+    QCOMPARE(gas_emitter_new_buf(&e, actual, sizeof(actual)), GAS_OK);
+    QCOMPARE(emit(e, root, true), GAS_OK);
+    QCOMPARE(e->pos, static_cast<GASunum>(size));
+    QVERIFY(memcmp(actual, expected, size) == 0);
+    gas_emitter_destroy(e);
+
+    // too small a buffer
+    QCOMPARE(gas_emitter_new_buf(&e, actual, size - 1), GAS_OK);
+    QVERIFY(emit(e, root, true) < 0);
+    gas_emitter_destroy(e);
+
+    gas_destroy(root);
+}
+
+void TestEmitter::pipe ()
+{
+    GASchunk *root = build(), *out;
+    GASemitter* e;
+    int fds[2];
+
+    QCOMPARE(::pipe(fds), 0);
+    QCOMPARE(gas_emitter_new_fd(&e, fds[1]), GAS_OK);
+    QVERIFY(!e->seekable);
+
+    // nothing to backpatch with
+    QCOMPARE(gas_emitter_begin_chunk(e, "root", 4),
+             static_cast<GASresult>(GAS_ERR_INVALID_PARAM));
+
+    QCOMPARE(emit(e, root, true), GAS_OK);
+    gas_emitter_destroy(e);
+    close(fds[1]);
+
+    QCOMPARE(gas_read_fd(fds[0], &out), GAS_OK);
+    close(fds[0]);
+    QCOMPARE(gas_write_buf(actual, sizeof(actual), out),
+             gas_write_buf(expected, sizeof(expected), root));
+    QVERIFY(memcmp(actual, expected, gas_total_size(root)) == 0);
+
+    gas_destroy(out);
+    gas_destroy(root);
+}
+
+static GASnum produce (GASvoid* buf, GASunum limit, GASvoid* data)
+{
+    GASunum* produced = static_cast<GASunum*>(data);
+    GASunum i;
+
+    // odd sized pieces
+    if (limit > 1000) {
+        limit = 1000;
+    }
+    for (i = 0; i < limit; i++) {
+        static_cast<GASubyte*>(buf)[i] = (GASubyte)(*produced + i);
+    }
+    *produced += limit;
+    return limit;
+}
+
+void TestEmitter::file ()
+{
+    GASchunk *root = build(), *out;
+    GASemitter* e;
+    GASunum produced = 0, i;
+    const GASunum big = 3 * GAS_EMITTER_BUFFER_SIZE + 5;
+    int fd;
+
+    // the root header is written out long before it is backpatched
+    fd = open("emitter.gas", O_RDWR | O_CREAT | O_TRUNC, 0644);
+    QVERIFY(fd >= 0);
+    QCOMPARE(gas_emitter_new_fd(&e, fd), GAS_OK);
+    QVERIFY(e->seekable);
+    QCOMPARE(gas_emitter_begin_chunk(e, "big", 3), GAS_OK);
+    QCOMPARE(gas_emitter_payload_callback(e, big, produce, &produced), GAS_OK);
+    QCOMPARE(produced, big);
+    QCOMPARE(emit(e, root, false), GAS_OK);
+    QCOMPARE(gas_emitter_end_chunk(e), GAS_OK);
+    gas_emitter_destroy(e);
+
+    QCOMPARE(lseek(fd, 0, SEEK_SET), static_cast<off_t>(0));
+    QCOMPARE(gas_read_fd(fd, &out), GAS_OK);
+    close(fd);
+
+    QVERIFY(gas_id_is(out, "big"));
+    QCOMPARE(out->payload_size, big);
+    for (i = 0; i < big; i++) {
+        if (out->payload[i] != (GASubyte)i) {
+            break;
+        }
+    }
+    QCOMPARE(i, big);
+    QCOMPARE(out->nb_children, static_cast<GASunum>(1));
+    gas_update(out);
+    QCOMPARE(gas_write_buf(actual, sizeof(actual), out->children[0]),
+             gas_write_buf(expected, sizeof(expected), root));
+    QVERIFY(memcmp(actual, expected, gas_total_size(root)) == 0);
+
+    gas_destroy(out);
+    gas_destroy(root);
+}
+
+/* emit over the start of a larger file, by fd or through a context */
+static void overwrite_with (bool by_fd)
+{
+    static GASubyte data[100000];
+    GASchunk *root = build(), *out;
+    GAScontext* ctx = NULL;
+    GASemitter* e;
+    GASunum produced = 0;
+    const GASunum big = 3 * GAS_EMITTER_BUFFER_SIZE + 5;
+    GASnum length;
+    struct stat st;
+    FILE* fs = NULL;
+    int fd = -1;
+
+    memset(data, 0xee, sizeof(data));
+    fd = open("emitter.gas", O_RDWR | O_CREAT | O_TRUNC, 0644);
+    QVERIFY(fd >= 0);
+    QCOMPARE(write(fd, data, sizeof(data)), static_cast<ssize_t>(sizeof(data)));
+    QCOMPARE(lseek(fd, 0, SEEK_SET), static_cast<off_t>(0));
+
+    if (by_fd) {
+        QCOMPARE(gas_emitter_new_fd(&e, fd), GAS_OK);
+    } else {
+        fs = fdopen(fd, "r+b");
+        QVERIFY(fs != NULL);
+        QCOMPARE(gas_context_new(&ctx), GAS_OK);
+        QCOMPARE(gas_emitter_new(&e, ctx, fs), GAS_OK);
+    }
+    QVERIFY(e->seekable);
+    QCOMPARE(gas_emitter_begin_chunk(e, "big", 3), GAS_OK);
+    QCOMPARE(gas_emitter_payload_callback(e, big, produce, &produced), GAS_OK);
+    QCOMPARE(emit(e, root, false), GAS_OK);
+    QCOMPARE(gas_emitter_end_chunk(e), GAS_OK);
+    QCOMPARE(gas_emitter_flush(e), GAS_OK);
+    gas_emitter_destroy(e);
+    if (fs != NULL) {
+        fclose(fs);
+        gas_context_destroy(ctx);
+    } else {
+        close(fd);
+    }
+
+    // the rest of the file is untouched
+    QCOMPARE(stat("emitter.gas", &st), 0);
+    QCOMPARE(st.st_size, static_cast<off_t>(sizeof(data)));
+    fd = open("emitter.gas", O_RDONLY);
+    QVERIFY(fd >= 0);
+    QCOMPARE(read(fd, data, sizeof(data)), static_cast<ssize_t>(sizeof(data)));
+    close(fd);
+    length = gas_read_buf(data, sizeof(data), &out);
+    QVERIFY(length > 0);
+    QVERIFY(gas_id_is(out, "big"));
+    QCOMPARE(out->payload_size, big);
+    QCOMPARE(data[length], static_cast<GASubyte>(0xee));
+
+    gas_destroy(out);
+    gas_destroy(root);
+}
+
+void TestEmitter::overwrite ()
+{
+    overwrite_with(true);
+    overwrite_with(false);
+    unlink("emitter.gas");
+}
+
+/* memory context with only 64 bit and positional writes {{{*/
+struct MemorySink
+{
+    GASubyte* data;
+    size_t size;
+    size_t pos;
+    unsigned int pwrites;
+};
+
+static GASresult mem_write64 (void *handle, const void *buffer, size_t size,
+                              size_t *done, void *userdata)
+{
+    MemorySink* s = static_cast<MemorySink*>(handle);
+    if (size > s->size - s->pos) {
+        return GAS_ERR_UNKNOWN;
+    }
+    memcpy(s->data + s->pos, buffer, size);
+    s->pos += size;
+    *done = size;
+    return GAS_OK;
+}
+
+static GASresult mem_pwrite (void *handle, const void *buffer, size_t size,
+                             uint64_t offset, size_t *done, void *userdata)
+{
+    MemorySink* s = static_cast<MemorySink*>(handle);
+    if (offset + size > s->pos) {
+        return GAS_ERR_UNKNOWN;
+    }
+    memcpy(s->data + offset, buffer, size);
+    s->pwrites++;
+    *done = size;
+    return GAS_OK;
+}
+static GASresult mem_write (void *handle, void *buffer, unsigned int size,
+                            unsigned int *done, void *userdata)
+{
+    size_t n = 0;
+    GASresult result = mem_write64(handle, buffer, size, &n, userdata);
+    *done = static_cast<unsigned int>(n);
+    return result;
+}
+/*}}}*/
+
+void TestEmitter::positional ()
+{
+    static GASubyte out[4 * GAS_EMITTER_BUFFER_SIZE];
+    GASchunk *root = build(), *c;
+    GAScontext ctx;
+    GASemitter* e;
+    GASunum produced = 0;
+    const GASunum big = 2 * GAS_EMITTER_BUFFER_SIZE;
+    MemorySink s = { out, sizeof(out), 0, 0 };
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.version = GAS_CONTEXT_VERSION;
+    ctx.write64 = mem_write64;
+    ctx.pwrite = mem_pwrite;
+
+    QCOMPARE(gas_emitter_new(&e, &ctx, &s), GAS_OK);
+    e->seekable = GAS_TRUE;
+    QCOMPARE(gas_emitter_begin_chunk(e, "big", 3), GAS_OK);
+    QCOMPARE(gas_emitter_payload_callback(e, big, produce, &produced), GAS_OK);
+    QCOMPARE(emit(e, root, false), GAS_OK);
+    QCOMPARE(gas_emitter_end_chunk(e), GAS_OK);
+    QCOMPARE(gas_emitter_flush(e), GAS_OK);
+    gas_emitter_destroy(e);
+    QVERIFY(s.pwrites > 0);
+
+    QCOMPARE(gas_read_buf(out, s.pos, &c), static_cast<GASnum>(s.pos));
+    QVERIFY(gas_id_is(c, "big"));
+    QCOMPARE(c->payload_size, big);
+    QCOMPARE(c->nb_children, static_cast<GASunum>(1));
+    gas_destroy(c);
+
+    // the default seek alone does not make the handle a FILE
+    GAScontext* custom;
+    QCOMPARE(gas_context_new(&custom), GAS_OK);
+    custom->open = NULL;
+    custom->write = mem_write;
+    s.pos = 0;
+    QCOMPARE(gas_emitter_new(&e, custom, &s), GAS_OK);
+    QVERIFY(!e->seekable);
+    QCOMPARE(emit(e, root, true), GAS_OK);
+    QCOMPARE(gas_emitter_flush(e), GAS_OK);
+    gas_emitter_destroy(e);
+    gas_context_destroy(custom);
+    QCOMPARE(gas_read_buf(out, s.pos, &c), static_cast<GASnum>(s.pos));
+    QCOMPARE(gas_total_size(c), gas_total_size(root));
+    gas_destroy(c);
+
+    gas_destroy(root);
+}
+
+void TestEmitter::misuse ()
+{
+    GASemitter* e;
+
+    QCOMPARE(gas_emitter_new_buf(&e, actual, sizeof(actual)), GAS_OK);
+
+    QCOMPARE(gas_emitter_end_chunk(e),
+             static_cast<GASresult>(GAS_ERR_INVALID_PARAM));
+    QCOMPARE(gas_emitter_begin_chunk(e, "a", 1), GAS_OK);
+    QCOMPARE(gas_emitter_payload(e, "x", 1), GAS_OK);
+    QCOMPARE(gas_emitter_attribute(e, "k", 1, "v", 1),
+             static_cast<GASresult>(GAS_ERR_INVALID_PARAM));
+    QCOMPARE(gas_emitter_payload(e, "x", 1),
+             static_cast<GASresult>(GAS_ERR_INVALID_PARAM));
+    QCOMPARE(gas_emitter_end_chunk(e), GAS_OK);
+
+    // wrong size, and wrong number of children, given in advance
+    QCOMPARE(gas_emitter_begin_chunk_sized(e, "a", 1, 100), GAS_OK);
+    QCOMPARE(gas_emitter_end_chunk(e),
+             static_cast<GASresult>(GAS_ERR_OUT_OF_RANGE));
+    e->depth = 0;
+    QCOMPARE(gas_emitter_begin_chunk(e, "a", 1), GAS_OK);
+    QCOMPARE(gas_emitter_children(e, 1), GAS_OK);
+    QCOMPARE(gas_emitter_end_chunk(e),
+             static_cast<GASresult>(GAS_ERR_OUT_OF_RANGE));
+
+    gas_emitter_destroy(e);
+}
+
+int emitter (int argc, char** argv)
+{
+    TestEmitter tc;
+    return QTest::qExec(&tc, argc, argv);
+}
+
+/* vim: set sw=4 fdm=marker :*/
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2009 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flat.moc"
+
+#include <QtTest>
+
+#include <gas/flat.h>
+#include <gas/bufio.h>
+#include <gas/ntstring.h>
+
+static GASubyte data[4096];
+
+static GASnum build (void)
+{
+    GASchunk *root, *c, *gc;
+    GASnum size;
+    int i;
+
+    gas_new_named(&root, "root");
+    gas_set_attribute_ss(root, "version", "1");
+    for (i = 0; i < 3; i++) {
+        gas_new_named(&c, "child");
+        gas_set_attribute_ss(c, "name", i == 1 ? "b" : "a");
+        gas_set_attribute_ss(c, "type", "leaf");
+        gas_new_named(&gc, "grandchild");
+        gas_set_payload_s(gc, "payload");
+        gas_add_child(c, gc);
+        gas_add_child(root, c);
+    }
+    gas_update(root);
+    size = gas_write_buf(data, sizeof(data), root);
+    gas_destroy(root);
+
+    return size;
+}
+
+void TestFlat::read_buf ()
+{
+    GASflat *f;
+    GASnum size, index;
+    GASunum len;
+    uint32_t child, grandchild;
+    const GASubyte* value;
+
+    size = build();
+    QVERIFY(size > 0);
+    QCOMPARE(gas_flat_read_buf(data, size, &f), size);
+
+    QCOMPARE(f->nb_chunks, 7u);
+    QVERIFY(gas_flat_id_is(f, 0, "root"));
+    QCOMPARE(gas_flat_get_parent(f, 0), GAS_FLAT_NONE);
+    QCOMPARE(gas_flat_nb_children(f, 0), static_cast<GASunum>(3));
+    QCOMPARE(gas_flat_get_child_at(f, 0, 3), GAS_FLAT_NONE);
+
+    child = gas_flat_get_child_at(f, 0, 1);
+    QVERIFY(gas_flat_id_is(f, child, "child"));
+    QCOMPARE(gas_flat_get_parent(f, child), 0u);
+
+    index = gas_flat_index_of_attribute(f, child, "type", 4);
+    QCOMPARE(index, static_cast<GASnum>(1));
+    QCOMPARE(gas_flat_index_of_attribute(f, child, "none", 4),
+             static_cast<GASnum>(GAS_ERR_ATTR_NOT_FOUND));
+    value = gas_flat_get_attribute(f, child, "name", 4, &len);
+    QCOMPARE(QByteArray(reinterpret_cast<const char*>(value), len),
+             QByteArray("b"));
+
+    grandchild = gas_flat_get_child_at(f, child, 0);
+    QCOMPARE(gas_flat_get_parent(f, grandchild), child);
+    value = gas_flat_get_payload(f, grandchild, &len);
+    QCOMPARE(QByteArray(reinterpret_cast<const char*>(value), len),
+             QByteArray("payload"));
+
+    gas_flat_destroy(f);
+}
+
+void TestFlat::truncated ()
+{
+    GASflat *f;
+    GASnum size, i;
+
+    size = build();
+    for (i = 0; i < size; i++) {
+        QVERIFY(gas_flat_read_buf(data, i, &f) < 0);
+    }
+}
+
+int flat (int argc, char** argv)
+{
+    TestFlat tc;
+    return QTest::qExec(&tc, argc, argv);
+}
+
+/* vim: set sw=4 fdm=marker :*/
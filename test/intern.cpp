@@ -0,0 +1,318 @@
+/*
+ * Copyright 2009 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "intern.moc"
+
+#include <QtTest>
+
+#include <gas/intern.h>
+#include <gas/parser.h>
+#include <gas/bufio.h>
+#include <gas/mapio.h>
+#include <gas/ntstring.h>
+
+static GASchunk* build (void)
+{
+    GASchunk *root, *c;
+    int i;
+
+    gas_new_named(&root, "root");
+    for (i = 0; i < 20; i++) {
+        gas_new_named(&c, i % 2 ? "odd" : "even");
+        gas_set_attribute_ss(c, "key", "value");
+        gas_set_attribute_ss(c, "other", "value");
+        gas_add_child(root, c);
+    }
+    gas_update(root);
+    return root;
+}
+
+void TestIntern::table ()
+{
+    GASintern* t;
+    GASnum a, b;
+    GASunum i, size;
+    char name[16];
+
+    QCOMPARE(gas_intern_new(&t), GAS_OK);
+
+    a = gas_intern(t, "alpha", 5);
+    b = gas_intern(t, "beta", 4);
+    QVERIFY(a > 0 && b > 0 && a != b);
+    QCOMPARE(gas_intern(t, "alpha", 5), a);
+    QCOMPARE(gas_intern_lookup(t, "beta", 4), b);
+    QCOMPARE(gas_intern_lookup(t, "gamma", 5), (GASnum)0);
+    QCOMPARE(gas_intern_lookup(t, "alph", 4), (GASnum)0);
+    QCOMPARE(memcmp(gas_intern_bytes(t, a, &size), "alpha", 6), 0);
+    QCOMPARE(size, (GASunum)5);
+    QVERIFY(gas_intern_bytes(t, 0) == NULL);
+    QVERIFY(gas_intern_bytes(t, 1000) == NULL);
+
+    // symbols survive the hash growing
+    for (i = 0; i < 1000; i++) {
+        sprintf(name, "name%lu", (unsigned long)i);
+        QCOMPARE(gas_intern(t, name, strlen(name)), (GASnum)(i + 3));
+    }
+    QCOMPARE(gas_intern_lookup(t, "alpha", 5), a);
+    QCOMPARE(gas_intern_lookup(t, "name500", 7), (GASnum)503);
+
+    gas_intern_destroy(t);
+}
+
+/* failing allocator {{{*/
+struct Failing
+{
+    GASallocator allocator;
+    void* fail_ptr;
+};
+
+static void* failing_alloc (GASallocator* self, GASunum size)
+{
+    return gas_default_alloc(size, NULL);
+}
+
+static void* failing_realloc (GASallocator* self, void* ptr, GASunum size)
+{
+    if (ptr != NULL && ptr == ((Failing*)self)->fail_ptr) {
+        return NULL;
+    }
+    return gas_default_realloc(ptr, size, NULL);
+}
+
+static void failing_free (GASallocator* self, void* ptr)
+{
+    gas_default_free(ptr, NULL);
+}
+/*}}}*/
+
+void TestIntern::grow_failure ()
+{
+    Failing failing = { { failing_alloc, failing_realloc, failing_free },
+                        NULL };
+    GASintern* t;
+    GASunum i, capacity;
+    char name[16];
+
+    QCOMPARE(gas_intern_new(&t, &failing), GAS_OK);
+    for (i = 0; i < 32; i++) {
+        sprintf(name, "name%lu", (unsigned long)i);
+        QCOMPARE(gas_intern(t, name, strlen(name)), (GASnum)(i + 1));
+    }
+    capacity = t->capacity;
+    QCOMPARE(t->nb_symbols, capacity);
+
+    // the strings grow, the sizes do not
+    failing.fail_ptr = t->sizes;
+    QVERIFY(gas_intern(t, "extra", 5) < 0);
+    QCOMPARE(t->capacity, capacity);
+    QCOMPARE(t->nb_symbols, capacity);
+
+    failing.fail_ptr = NULL;
+    QCOMPARE(gas_intern(t, "extra", 5), (GASnum)(capacity + 1));
+    QVERIFY(t->capacity > capacity);
+    QCOMPARE(gas_intern_lookup(t, "name0", 5), (GASnum)1);
+
+    gas_intern_destroy(t);
+}
+
+void TestIntern::tree ()
+{
+    GASintern* t;
+    GASchunk *root, *c;
+    GASnum odd, key;
+    GASubyte buf[1024], expected[1024];
+    GASnum size;
+    GASunum i;
+
+    root = build();
+    size = gas_write_buf(expected, sizeof(expected), root);
+    QVERIFY(size > 0);
+
+    gas_intern_new(&t);
+    QCOMPARE(gas_intern_tree(t, root), GAS_OK);
+    QCOMPARE(t->nb_symbols, (GASunum)5);
+
+    odd = gas_intern_lookup(t, "odd", 3);
+    key = gas_intern_lookup(t, "key", 3);
+    QVERIFY(odd > 0 && key > 0);
+    for (i = 0; i < root->nb_children; i++) {
+        c = root->children[i];
+        QCOMPARE(gas_id_is_symbol(c, odd), i % 2 == 1);
+        QCOMPARE(gas_id_is(c, i % 2 ? "odd" : "even"), GAS_TRUE);
+        QCOMPARE(gas_index_of_attribute_symbol(c, key), (GASnum)0);
+        QVERIFY(c->attributes[1].key == root->children[0]->attributes[1].key);
+    }
+    QVERIFY(gas_get_child_by_symbol(root, odd) == root->children[1]);
+    QVERIFY(gas_get_child_by_id(root, "odd", 3) == root->children[1]);
+    QVERIFY(gas_get_child_by_id(root, "od", 2) == NULL);
+    QVERIFY(gas_get_child_by_symbol(root, 0) == NULL);
+    QCOMPARE(gas_index_of_attribute_symbol(root, key),
+             (GASnum)GAS_ERR_ATTR_NOT_FOUND);
+
+    // the encoding is unchanged
+    QCOMPARE(gas_write_buf(buf, sizeof(buf), root), size);
+    QCOMPARE(memcmp(buf, expected, size), 0);
+
+    // edits take a private copy again
+    c = root->children[1];
+    gas_set_id(c, "renamed", 7);
+    QVERIFY(!gas_id_is_symbol(c, odd));
+    QVERIFY(gas_id_is(c, "renamed"));
+    gas_set_attribute_ss(c, "key", "changed");
+    QCOMPARE(gas_index_of_attribute_symbol(c, key), (GASnum)0);
+    gas_delete_attribute_at(c, 0);
+    QCOMPARE(memcmp(gas_intern_bytes(t, key), "key", 4), 0);
+
+    gas_destroy(root);
+    gas_intern_destroy(t);
+}
+
+/* memory context {{{*/
+struct MemoryStream
+{
+    GASubyte* data;
+    unsigned int size;
+    unsigned int pos;
+};
+
+static GASresult mem_open (const char *name, const char *mode,
+                           void **handle, void **userdata)
+{
+    *handle = (void*)name;
+    return GAS_OK;
+}
+
+static GASresult mem_close (void *handle, void *userdata)
+{
+    return GAS_OK;
+}
+
+static GASresult mem_read (void *handle, void *buffer, unsigned int sizebytes,
+                           unsigned int *bytesread, void *userdata)
+{
+    MemoryStream* s = static_cast<MemoryStream*>(handle);
+    unsigned int n = qMin(sizebytes, s->size - s->pos);
+    memcpy(buffer, s->data + s->pos, n);
+    s->pos += n;
+    *bytesread = n;
+    return GAS_OK;
+}
+
+static GASresult mem_seek (void *handle, unsigned long pos, int whence,
+                           void *userdata)
+{
+    static_cast<MemoryStream*>(handle)->pos += pos;
+    return GAS_OK;
+}
+/*}}}*/
+
+static GASchunk* fed_tree = NULL;
+
+static void on_tree (GASchunk* c, void *user_data)
+{
+    fed_tree = c;
+}
+
+void TestIntern::parser ()
+{
+    GAScontext ctx = { mem_open, mem_close, mem_read, NULL, mem_seek, NULL };
+    GASparser *p;
+    GASintern* t;
+    GASchunk *root, *out;
+    GASubyte expected[1024], buf[1024];
+    GASnum size, even;
+    GASunum i;
+
+    root = build();
+    size = gas_write_buf(expected, sizeof(expected), root);
+    gas_destroy(root);
+
+    gas_intern_new(&t);
+    even = gas_intern(t, "even", 4);
+
+    MemoryStream s = { expected, static_cast<unsigned int>(size), 0 };
+    QCOMPARE(gas_parser_new(&p, &ctx), GAS_OK);
+    p->intern = t;
+    QCOMPARE(gas_parse(p, reinterpret_cast<const char*>(&s), &out), GAS_OK);
+    QCOMPARE(t->nb_symbols, (GASunum)5);
+    for (i = 0; i < out->nb_children; i += 2) {
+        QVERIFY(gas_id_is_symbol(out->children[i], even));
+    }
+    QCOMPARE(gas_write_buf(buf, sizeof(buf), out), size);
+    QCOMPARE(memcmp(buf, expected, size), 0);
+    gas_destroy(out);
+
+    p->on_tree = on_tree;
+    QCOMPARE(gas_parser_feed(p, expected, size), GAS_OK);
+    QVERIFY(fed_tree != NULL);
+    QCOMPARE(t->nb_symbols, (GASunum)5);
+    QVERIFY(gas_get_child_by_symbol(fed_tree, even) == fed_tree->children[0]);
+    gas_destroy(fed_tree);
+
+    gas_parser_destroy(p);
+    gas_intern_destroy(t);
+}
+
+void TestIntern::borrowed_feed ()
+{
+    GAScontext *ctx;
+    GASparser *p;
+    GASintern* t;
+    GASchunk *root, *c;
+    GASubyte expected[256];
+    GASnum size, id, key;
+
+    // ids and keys longer than the inline storage
+    gas_new_named(&root, "a root id longer than inline storage");
+    gas_new_named(&c, "a child id longer than inline storage");
+    gas_set_attribute_ss(c, "a key longer than inline storage", "value");
+    gas_add_child(root, c);
+    gas_update(root);
+    size = gas_write_buf(expected, sizeof(expected), root);
+    QVERIFY(size > 0);
+    gas_destroy(root);
+
+    // fed chunks own their fields, even when the context could lend them
+    gas_intern_new(&t);
+    QCOMPARE(gas_map_context_new(&ctx), GAS_OK);
+    QCOMPARE(gas_parser_new(&p, ctx), GAS_OK);
+    p->borrow = GAS_TRUE;
+    p->intern = t;
+    p->on_tree = on_tree;
+    fed_tree = NULL;
+    QCOMPARE(gas_parser_feed(p, expected, size), GAS_OK);
+    QVERIFY(fed_tree != NULL);
+    QVERIFY(!fed_tree->borrowed);
+    id = gas_intern_lookup(t, "a child id longer than inline storage", 37);
+    key = gas_intern_lookup(t, "a key longer than inline storage", 32);
+    QVERIFY(id > 0 && key > 0);
+    QVERIFY(gas_id_is_symbol(fed_tree->children[0], id));
+    QCOMPARE(gas_index_of_attribute_symbol(fed_tree->children[0], key),
+             (GASnum)0);
+    gas_destroy(fed_tree);
+
+    gas_parser_destroy(p);
+    gas_context_destroy(ctx);
+    gas_intern_destroy(t);
+}
+
+int intern (int argc, char** argv)
+{
+    TestIntern tc;
+    return QTest::qExec(&tc, argc, argv);
+}
+
+/* vim: set sw=4 fdm=marker :*/
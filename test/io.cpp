@@ -26,6 +26,8 @@
 #include <gas/fdio.h>
 #include <gas/ntstring.h>
 #include <gas/fsio.h>
+#include <gas/bufio.h>
+#include <gas/codec.h>
 
 #include <stdlib.h>
 #include <string.h>
@@ -33,6 +35,7 @@
 #include <stdio.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <fcntl.h>
 #include <unistd.h>
 //#include <linux/types.h>
@@ -153,6 +156,176 @@ void TestIo::test0004 (void)
     gas_destroy(root);
 }
 
+void TestIo::test0005 (void)
+{
+    GASchunk *root = NULL, *c;
+    GASunum i, bytes_written = 0;
+    GASnum size;
+    GASubyte big[5000];
+
+    /* more fields than one writev() takes */
+    gas_new_named(&root, "root");
+    for (i = 0; i < 2000; i++) {
+        gas_new_named(&c, "child");
+        gas_set_attribute_ss(c, "key", "value");
+        gas_add_child(root, c);
+    }
+    memset(big, 0xab, sizeof(big));
+    gas_set_payload(root, big, sizeof(big));
+    gas_update(root);
+
+    size = gas_total_size(root);
+    GASubyte* expected = new GASubyte[size];
+    GASubyte* actual = new GASubyte[size];
+    QCOMPARE(gas_write_buf(expected, size, root), size);
+
+    int fd = open("gather.gas", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    QVERIFY(fd >= 0);
+    QCOMPARE(gas_write_fd(fd, root, &bytes_written), GAS_OK);
+    QCOMPARE(bytes_written, static_cast<GASunum>(size));
+    close(fd);
+
+    FILE* fs = fopen("gather.gas", "r");
+    QCOMPARE(fread(actual, 1, size, fs), static_cast<size_t>(size));
+    fclose(fs);
+    QVERIFY(memcmp(actual, expected, size) == 0);
+
+    delete[] expected;
+    delete[] actual;
+    gas_destroy(root);
+}
+
+static GASchunk* new_tree (GASunum nb_children, GASunum payload_size)
+{
+    GASchunk *root = NULL, *c;
+    GASubyte* payload = new GASubyte[payload_size + 1];
+    GASunum i;
+
+    gas_new_named(&root, "root");
+    for (i = 0; i < nb_children; i++) {
+        gas_new_named(&c, "child");
+        gas_set_attribute_ss(c, "key", "value");
+        gas_add_child(root, c);
+    }
+    memset(payload, 0xcd, payload_size);
+    gas_set_payload(root, payload, payload_size);
+    gas_update(root);
+
+    delete[] payload;
+    return root;
+}
+
+static bool same_tree (GASchunk* a, GASchunk* b)
+{
+    GASnum size = gas_total_size(a);
+    if (size != (GASnum)gas_total_size(b)) {
+        return false;
+    }
+    GASubyte* x = new GASubyte[size];
+    GASubyte* y = new GASubyte[size];
+    gas_write_buf(x, size, a);
+    gas_write_buf(y, size, b);
+    bool same = memcmp(x, y, size) == 0;
+    delete[] x;
+    delete[] y;
+    return same;
+}
+
+void TestIo::reader (void)
+{
+    GASchunk* trees[3];
+    GASchunk* out;
+    GASfdreader* r;
+    GASunum i, sizes[2] = { 64, 0 };
+    int fds[2];
+
+    /* small, larger than the default buffer, and empty */
+    trees[0] = new_tree(10, 3);
+    trees[1] = new_tree(2000, 100000);
+    trees[2] = new_tree(0, 0);
+
+    int fd = open("trees.gas", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    QVERIFY(fd >= 0);
+    for (i = 0; i < 3; i++) {
+        QCOMPARE(gas_write_fd(fd, trees[i]), GAS_OK);
+    }
+    close(fd);
+
+    /* consecutive trees through one buffer */
+    for (GASunum s = 0; s < 2; s++) {
+        fd = open("trees.gas", O_RDONLY);
+        QVERIFY(fd >= 0);
+        QCOMPARE(gas_fd_reader_new(&r, fd, sizes[s]), GAS_OK);
+        for (i = 0; i < 3; i++) {
+            QCOMPARE(gas_read_fd_reader(r, &out), GAS_OK);
+            QVERIFY(same_tree(out, trees[i]));
+            gas_destroy(out);
+        }
+        QCOMPARE(gas_read_fd_reader(r, &out), GAS_ERR_FILE_EOF);
+        gas_fd_reader_destroy(r);
+        close(fd);
+    }
+
+    /* a pipe trickling a few bytes at a time */
+    QVERIFY(pipe(fds) == 0);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        GASubyte buf[64];
+        int in = open("trees.gas", O_RDONLY);
+        ssize_t n;
+        while ((n = read(in, buf, 3)) > 0) {
+            if (write(fds[1], buf, n) != n) {
+                break;
+            }
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    for (i = 0; i < 3; i++) {
+        QCOMPARE(gas_read_fd(fds[0], &out), GAS_OK);
+        QVERIFY(same_tree(out, trees[i]));
+        gas_destroy(out);
+    }
+    QCOMPARE(gas_read_fd(fds[0], &out), GAS_ERR_FILE_EOF);
+    close(fds[0]);
+    waitpid(pid, NULL, 0);
+
+    /* a tree cut short */
+    QVERIFY(truncate("trees.gas", gas_total_size(trees[0]) - 1) == 0);
+    fd = open("trees.gas", O_RDONLY);
+    QCOMPARE(gas_read_fd(fd, &out), GAS_ERR_FILE_EOF);
+    QVERIFY(out == NULL);
+    close(fd);
+
+    /* a corrupt header: sizes and counts that no array can hold */
+    GASubyte header[64];
+    GASunum values[][4] = {
+        { (GASunum)-1, 0, (GASunum)-1 / 8, 0 },
+        { (GASunum)-1, (GASunum)-1, 0, 0 },
+    };
+    for (i = 0; i < 2; i++) {
+        GASnum length = 0;
+        for (int v = 0; v < 4; v++) {
+            length += gas_codec_encode(header + length,
+                                       sizeof(header) - length, values[i][v]);
+        }
+        fd = open("trees.gas", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        QCOMPARE(write(fd, header, length), static_cast<ssize_t>(length));
+        close(fd);
+        fd = open("trees.gas", O_RDONLY);
+        QCOMPARE(gas_read_fd(fd, &out),
+                 static_cast<GASresult>(GAS_ERR_OUT_OF_RANGE));
+        QVERIFY(out == NULL);
+        close(fd);
+    }
+    unlink("trees.gas");
+
+    for (i = 0; i < 3; i++) {
+        gas_destroy(trees[i]);
+    }
+}
+
 
 int io (int argc, char** argv)
 {
@@ -27,4 +27,6 @@ private slots:
     void test0002 ();
     void test0003 ();
     void test0004 ();
+    void test0005 ();
+    void reader ();
 };
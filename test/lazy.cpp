@@ -0,0 +1,296 @@
+/*
+ * Copyright 2009 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "lazy.moc"
+
+#include <QtTest>
+
+#include <gas/lazy.h>
+#include <gas/bufio.h>
+#include <gas/mapio.h>
+#include <gas/fdio.h>
+#include <gas/ntstring.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NB_ITEMS 50
+#define NB_LEAVES 20
+
+static GASchunk* original = NULL;
+
+/* root, NB_ITEMS items, each of NB_LEAVES leaves with a payload */
+void TestLazy::initTestCase ()
+{
+    GASchunk *item, *leaf;
+    char payload[32];
+    int i, j;
+
+    gas_new_named(&original, "root");
+    gas_set_attribute_ss(original, "kind", "archive");
+    for (i = 0; i < NB_ITEMS; i++) {
+        gas_new_named(&item, "item");
+        gas_set_payload(item, &i, sizeof(i));
+        for (j = 0; j < NB_LEAVES; j++) {
+            gas_new_named(&leaf, j % 2 ? "odd" : "even");
+            sprintf(payload, "leaf %d.%d", i, j);
+            gas_set_payload(leaf, payload, strlen(payload));
+            gas_add_child(item, leaf);
+        }
+        gas_add_child(original, item);
+    }
+    gas_update(original);
+
+    int fd = open("lazy.gas", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    QVERIFY(fd >= 0);
+    QCOMPARE(gas_write_fd(fd, original), GAS_OK);
+    close(fd);
+}
+
+static bool same_bytes (const GASubyte* a, GASunum a_size,
+                        const GASubyte* b, GASunum b_size)
+{
+    return a_size == b_size && (a_size == 0 || memcmp(a, b, a_size) == 0);
+}
+
+/* the fields, but not the children */
+static bool same_chunk (GASchunk* a, GASchunk* b)
+{
+    return a != NULL && b != NULL &&
+        a->size == b->size &&
+        a->nb_attributes == b->nb_attributes &&
+        a->nb_children == b->nb_children &&
+        same_bytes(a->id, a->id_size, b->id, b->id_size) &&
+        same_bytes(a->payload, a->payload_size, b->payload, b->payload_size);
+}
+
+/* read a few leaves, and check that the rest was not */
+static void read_leaves (GASparser* p)
+{
+    GASchunk *root = NULL, *item, *leaf;
+    GASunum i;
+
+    QCOMPARE(gas_read_parser(p, &root), GAS_OK);
+    QVERIFY(same_chunk(root, original));
+    QVERIFY(root->lazy != NULL);
+    for (i = 0; i < NB_ITEMS; i++) {
+        QVERIFY(root->children[i] == NULL);
+    }
+
+    item = gas_get_child_at(root, 42);
+    QVERIFY(same_chunk(item, original->children[42]));
+    QVERIFY(item->parent == root);
+    leaf = gas_get_child_at(item, 7);
+    QVERIFY(same_chunk(leaf, original->children[42]->children[7]));
+    QVERIFY(gas_get_child_at(item, 6) != NULL);
+    QCOMPARE(gas_get_child_at(item, 7), leaf);
+
+    QCOMPARE(gas_load_child_at(root, 3, &item), GAS_OK);
+    QVERIFY(same_chunk(item, original->children[3]));
+    leaf = gas_get_child_by_id(item, "odd", 3);
+    QVERIFY(same_chunk(leaf, original->children[3]->children[1]));
+    QVERIFY(item->children[2] == NULL);
+    QCOMPARE(gas_load_child_at(root, NB_ITEMS, &item), GAS_ERR_OUT_OF_RANGE);
+
+    for (i = 0; i < NB_ITEMS; i++) {
+        QCOMPARE(root->children[i] != NULL, i == 3 || i == 42);
+    }
+
+    gas_destroy(root);
+}
+
+void TestLazy::seeked ()
+{
+    GAScontext* ctx = NULL;
+    GASparser* p = NULL;
+    GASvoid* handle = NULL;
+
+    QCOMPARE(gas_context_new(&ctx), GAS_OK);
+    QCOMPARE(ctx->open("lazy.gas", "rb", &handle, &ctx->user_data), GAS_OK);
+    QCOMPARE(gas_parser_new(&p, ctx, handle), GAS_OK);
+    p->lazy = GAS_TRUE;
+
+    read_leaves(p);
+    /* only needed with a limit */
+    QVERIFY(p->lru == NULL);
+
+    gas_parser_destroy(p);
+    ctx->close(handle, ctx->user_data);
+    gas_context_destroy(ctx);
+}
+
+void TestLazy::positional ()
+{
+    GAScontext* ctx = NULL;
+    GASparser* p = NULL;
+    GASvoid* handle = NULL;
+
+    QCOMPARE(gas_map_context_new(&ctx), GAS_OK);
+    QCOMPARE(gas_map_open("lazy.gas", "rb", &handle, &ctx->user_data),
+             GAS_OK);
+    QCOMPARE(gas_parser_new(&p, ctx, handle), GAS_OK);
+    p->lazy = GAS_TRUE;
+
+    read_leaves(p);
+
+    gas_parser_destroy(p);
+    gas_map_close(handle, ctx->user_data);
+    gas_context_destroy(ctx);
+}
+
+void TestLazy::limit ()
+{
+    GAScontext* ctx = NULL;
+    GASparser* p = NULL;
+    GASvoid* handle = NULL;
+    GASchunk *root = NULL, *item, *leaf, *kept;
+    GASunum i;
+
+    QCOMPARE(gas_map_context_new(&ctx), GAS_OK);
+    QCOMPARE(gas_map_open("lazy.gas", "rb", &handle, &ctx->user_data),
+             GAS_OK);
+    QCOMPARE(gas_parser_new(&p, ctx, handle), GAS_OK);
+    p->lazy = GAS_TRUE;
+    p->lazy_limit = 4;
+    QCOMPARE(gas_read_parser(p, &root), GAS_OK);
+
+    /* a clone outlives its release */
+    kept = gas_clone(gas_get_child_at(root, 0));
+    QVERIFY(kept != NULL);
+
+    for (i = 0; i < NB_ITEMS; i++) {
+        item = gas_get_child_at(root, i);
+        QVERIFY(same_chunk(item, original->children[i]));
+        leaf = gas_get_child_at(item, i % NB_LEAVES);
+        QVERIFY(same_chunk(leaf, original->children[i]->children[i % NB_LEAVES]));
+        /* the item above the leaf is spared */
+        QCOMPARE(root->children[i], item);
+        QVERIFY(p->lru->count <= 4);
+    }
+    QVERIFY(root->children[0] == NULL);
+    QVERIFY(same_chunk(kept, original->children[0]));
+    gas_destroy(kept);
+
+    /* the most recently accessed stay */
+    item = root->children[NB_ITEMS - 1];
+    QVERIFY(item != NULL);
+    QCOMPARE(gas_get_child_at(root, NB_ITEMS - 1), item);
+
+    gas_destroy(root);
+    QCOMPARE(p->lru->count, (GASunum)0);
+    QVERIFY(p->lru->head == NULL && p->lru->tail == NULL);
+
+    gas_parser_destroy(p);
+    gas_map_close(handle, ctx->user_data);
+    gas_context_destroy(ctx);
+}
+
+void TestLazy::read_only ()
+{
+    GAScontext* ctx = NULL;
+    GASparser* p = NULL;
+    GASvoid* handle = NULL;
+    GASchunk *root = NULL, *item, *leaf, *other, *shared;
+    GASubyte buf[256];
+
+    QCOMPARE(gas_map_context_new(&ctx), GAS_OK);
+    QCOMPARE(gas_map_open("lazy.gas", "rb", &handle, &ctx->user_data),
+             GAS_OK);
+    QCOMPARE(gas_parser_new(&p, ctx, handle), GAS_OK);
+    p->lazy = GAS_TRUE;
+    p->lazy_limit = 4;
+    QCOMPARE(gas_read_parser(p, &root), GAS_OK);
+    item = gas_get_child_at(root, 1);
+    leaf = gas_get_child_at(item, 2);
+    QVERIFY(leaf != NULL);
+
+    gas_new_named(&other, "other");
+    QCOMPARE(gas_add_child(root, other), GAS_ERR_INVALID_PARAM);
+    QCOMPARE(gas_add_child(item, other), GAS_ERR_INVALID_PARAM);
+    QCOMPARE(gas_nb_children(root), (GASunum)NB_ITEMS);
+    QCOMPARE(gas_nb_children(item), (GASunum)NB_LEAVES);
+    QCOMPARE(gas_delete_child_at(root, 5), GAS_ERR_INVALID_PARAM);
+    QCOMPARE(gas_set_payload_s(leaf, "changed"), GAS_ERR_INVALID_PARAM);
+    QVERIFY(same_chunk(leaf, original->children[1]->children[2]));
+    QVERIFY(gas_writable_child(root, 1) == NULL);
+
+    /* nor can it be moved, or copied */
+    QCOMPARE(gas_add_child(other, item), GAS_ERR_INVALID_PARAM);
+    QCOMPARE(gas_nb_children(other), (GASunum)0);
+    shared = gas_clone(root);
+    QCOMPARE(gas_unshare(&shared), GAS_ERR_INVALID_PARAM);
+    QCOMPARE(shared, root);
+    gas_destroy(shared);
+    gas_destroy(other);
+
+    /* writing fails before anything is written */
+    memset(buf, 0, sizeof(buf));
+    QCOMPARE(gas_write_buf(buf, sizeof(buf), root),
+             (GASnum)GAS_ERR_INVALID_PARAM);
+    QCOMPARE(gas_write_buf(buf, sizeof(buf), item),
+             (GASnum)GAS_ERR_INVALID_PARAM);
+    QCOMPARE(buf[0], (GASubyte)0);
+
+    gas_destroy(root);
+    gas_parser_destroy(p);
+    gas_map_close(handle, ctx->user_data);
+    gas_context_destroy(ctx);
+}
+
+void TestLazy::sizes ()
+{
+    GAScontext* ctx = NULL;
+    GASparser* p = NULL;
+    GASvoid* handle = NULL;
+    GASchunk *root = NULL, *item;
+
+    QCOMPARE(gas_map_context_new(&ctx), GAS_OK);
+    QCOMPARE(gas_map_open("lazy.gas", "rb", &handle, &ctx->user_data),
+             GAS_OK);
+    QCOMPARE(gas_parser_new(&p, ctx, handle), GAS_OK);
+    p->lazy = GAS_TRUE;
+    QCOMPARE(gas_read_parser(p, &root), GAS_OK);
+
+    /* the sizes read stand for the children not loaded */
+    QVERIFY(!root->dirty);
+    QCOMPARE(gas_total_size(root), gas_total_size(original));
+    QCOMPARE(gas_update(root), GAS_OK);
+    QCOMPARE(root->size, original->size);
+
+    item = gas_get_child_at(root, 9);
+    QVERIFY(item != NULL && !item->dirty);
+    QCOMPARE(gas_total_size(item), gas_total_size(original->children[9]));
+    QCOMPARE(gas_total_size(root), gas_total_size(original));
+
+    gas_destroy(root);
+    gas_parser_destroy(p);
+    gas_map_close(handle, ctx->user_data);
+    gas_context_destroy(ctx);
+}
+
+void TestLazy::cleanupTestCase ()
+{
+    gas_destroy(original);
+    unlink("lazy.gas");
+}
+
+int lazy (int argc, char** argv)
+{
+    TestLazy tc;
+    return QTest::qExec(&tc, argc, argv);
+}
+
+/* vim: set sw=4 fdm=marker :*/
@@ -16,6 +16,9 @@
 
 #include  <QtTest>
 #include  <gas/ntstring.h>
+#include  <gas/mapio.h>
+#include  <gas/parser.h>
+#include  <gas/fsio.h>
 #include "mapped.moc"
 
 void TestMapped::non_mapped ()
@@ -69,9 +72,87 @@ void TestMapped::mapped_treen ()
 #endif
 }
 
+static GASbool skip_pruned (GASunum id_size, void *id, void *user_data)
+{
+    return !(id_size == 6 && memcmp(id, "pruned", 6) == 0);
+}
 
+void TestMapped::borrowed ()
+{
+    GASchunk *root, *c, *out;
+    GAScontext* ctx;
+    GASparser* p;
+    GASmap* map;
+    void* handle;
+    GASubyte big[10000];
+    FILE* fs;
+    GASunum i;
+
+    gas_new_named(&root, "root");
+    gas_set_attribute_ss(root, "key", "value");
+    memset(big, 0xab, sizeof(big));
+    gas_set_payload(root, big, sizeof(big));
+    for (i = 0; i < 10; i++) {
+        gas_new_named(&c, i % 2 ? "pruned" : "kept");
+        gas_set_payload(c, big, sizeof(big));
+        gas_add_child(root, c);
+    }
+    gas_update(root);
+    fs = fopen("mapped.gas", "wb");
+    QVERIFY(fs != NULL);
+    QCOMPARE(gas_write_fs(fs, root), GAS_OK);
+    fclose(fs);
+    gas_destroy(root);
 
+    QCOMPARE(gas_map_context_new(&ctx), GAS_OK);
 
+    // copied, through gas_parse()
+    QCOMPARE(gas_parser_new(&p, ctx), GAS_OK);
+    QCOMPARE(gas_parse(p, "mapped.gas", &out), GAS_OK);
+    QCOMPARE(out->payload_size, static_cast<GASunum>(sizeof(big)));
+    QCOMPARE(out->nb_children, static_cast<GASunum>(10));
+    gas_destroy(out);
+    gas_parser_destroy(p);
+
+    // borrowed, and pruned without reading
+    QCOMPARE(gas_map_open("mapped.gas", "rb", &handle, &ctx->user_data),
+             GAS_OK);
+    map = static_cast<GASmap*>(handle);
+    QCOMPARE(gas_parser_new(&p, ctx, handle), GAS_OK);
+    p->borrow = GAS_TRUE;
+    p->on_pre_chunk = skip_pruned;
+    QCOMPARE(gas_read_parser(p, &out), GAS_OK);
+    QCOMPARE(map->pos, static_cast<GASunum>(0));
+    QCOMPARE(p->offset, map->size);
+    QVERIFY(out->payload >= map->data && out->payload < map->data + map->size);
+    QVERIFY(memcmp(out->payload, big, sizeof(big)) == 0);
+    QCOMPARE(memcmp(out->attributes[0].value, "value", 5), 0);
+    for (i = 0; i < out->nb_children; i++) {
+        if (i % 2) {
+            QVERIFY(out->children[i] == NULL);
+        } else {
+            QVERIFY(gas_id_is(out->children[i], "kept"));
+            QVERIFY(out->children[i]->payload > out->payload);
+        }
+    }
+    // read only, and released without freeing the mapping
+    QVERIFY(out->borrowed);
+    QCOMPARE(gas_set_id(out, "changed", 7),
+             static_cast<GASresult>(GAS_ERR_INVALID_PARAM));
+    QCOMPARE(gas_set_attribute_ss(out, "key", "changed"),
+             static_cast<GASresult>(GAS_ERR_INVALID_PARAM));
+    QCOMPARE(gas_set_payload(out->children[0], "changed", 7),
+             static_cast<GASresult>(GAS_ERR_INVALID_PARAM));
+    QCOMPARE(gas_context_write(ctx, handle, "changed", 7),
+             static_cast<GASresult>(GAS_ERR_UNKNOWN));
+    gas_destroy(out);
+    gas_parser_destroy(p);
+    QCOMPARE(gas_map_close(handle, ctx->user_data), GAS_OK);
+
+    QCOMPARE(gas_map_open("mapped.gas", "r+", &handle, &ctx->user_data),
+             static_cast<GASresult>(GAS_ERR_INVALID_PARAM));
+    gas_context_destroy(ctx);
+}
 
 int mapped (int argc, char **argv)
 {
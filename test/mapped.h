@@ -36,6 +36,7 @@ private slots:
     void non_mapped ();
     void mapped_tree ();
     void mapped_treen ();
+    void borrowed ();
 };
 
 // vim: sw=4 fdm=marker
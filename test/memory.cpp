@@ -0,0 +1,140 @@
+/*
+ * Copyright 2009 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "memory.moc"
+
+#include <QtTest>
+#include <QThread>
+
+#include <gas/tree.h>
+#include <gas/ntstring.h>
+
+#if GAS_DEBUG_MEMORY
+
+class Churn : public QThread
+{
+public:
+    GASchunk* adopted;
+
+    void run ()
+    {
+        GASchunk *root, *c;
+        int i, j;
+
+        gas_destroy(adopted);
+
+        for (i = 0; i < 20; i++) {
+            gas_new_named(&root, "a chunk id longer than inline storage");
+            for (j = 0; j < 50; j++) {
+                gas_new_named(&c, "child");
+                gas_set_payload_s(c, "a payload");
+                gas_add_child(root, c);
+            }
+            gas_destroy(root);
+        }
+    }
+};
+
+void TestMemory::stats ()
+{
+    GASmemory_stats before, during, after;
+    GASunum sum, i;
+    void* p;
+
+    QCOMPARE(gas_memory_stats(&before), GAS_OK);
+    gas_memory_reset_peak();
+
+    p = gas_alloc(1000, NULL);
+    p = gas_realloc(p, 3000, NULL);
+    QCOMPARE(gas_memory_stats(&during), GAS_OK);
+    QCOMPARE(during.bytes, before.bytes + 3000);
+    QVERIFY(during.peak_bytes >= before.bytes + 3000);
+    QCOMPARE(during.allocations, before.allocations + 1);
+    QCOMPARE(during.reallocations, before.reallocations + 1);
+    // 1000 and 3000 bytes fall in the 512..1023 and 2048..4095 buckets
+    QCOMPARE(during.histogram[10], before.histogram[10] + 1);
+    QCOMPARE(during.histogram[12], before.histogram[12] + 1);
+
+    gas_free(p, NULL);
+    QCOMPARE(gas_memory_stats(&after), GAS_OK);
+    QCOMPARE(after.bytes, before.bytes);
+    QCOMPARE(after.frees, before.frees + 1);
+    QCOMPARE(after.peak_bytes, during.peak_bytes);
+    QCOMPARE(gas_memory_usage(), after.bytes);
+
+    for (sum = 0, i = 0; i < GAS_MEMORY_HISTOGRAM_SIZE; i++) {
+        sum += after.histogram[i];
+    }
+    QCOMPARE(sum, after.allocations + after.reallocations);
+}
+
+void TestMemory::threads ()
+{
+    GASmemory_stats before, after;
+    Churn workers[4];
+    GASchunk* c;
+    int i, round;
+
+    QCOMPARE(gas_memory_stats(&before), GAS_OK);
+
+    gas_new_named(&c, "kept");
+    // the second round counts in the counters left by the first
+    for (round = 1; round <= 2; round++) {
+        // chunks allocated here, and freed by the workers
+        for (i = 0; i < 4; i++) {
+            gas_new_named(&workers[i].adopted, "adopted");
+            gas_set_payload_s(workers[i].adopted, "freed by another thread");
+        }
+        for (i = 0; i < 4; i++) {
+            workers[i].start();
+        }
+        for (i = 0; i < 4; i++) {
+            workers[i].wait();
+        }
+        QCOMPARE(gas_memory_stats(&after), GAS_OK);
+        QVERIFY(after.bytes > before.bytes);
+        QVERIFY(after.allocations >=
+                before.allocations + round * 4 * 20 * 51);
+    }
+
+    gas_destroy(c);
+    QCOMPARE(gas_memory_stats(&after), GAS_OK);
+    QCOMPARE(after.bytes, before.bytes);
+    QCOMPARE(after.allocations - before.allocations,
+             after.frees - before.frees);
+}
+
+#else
+
+void TestMemory::stats ()
+{
+    QSKIP("needs GAS_DEBUG_MEMORY", SkipAll);
+}
+
+void TestMemory::threads ()
+{
+    QSKIP("needs GAS_DEBUG_MEMORY", SkipAll);
+}
+
+#endif
+
+int memory (int argc, char** argv)
+{
+    TestMemory tc;
+    return QTest::qExec(&tc, argc, argv);
+}
+
+/* vim: set sw=4 fdm=marker :*/
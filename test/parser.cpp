@@ -21,8 +21,12 @@
 
 #include <gas/parser.h>
 #include <gas/ntstring.h>
+#include <gas/bufio.h>
 
+#include <fcntl.h>
 #include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 static int indent_level = -1;
 
@@ -118,6 +122,288 @@ void TestParser::parser ()
 #endif
 }
 
+/* memory context {{{*/
+struct MemoryStream
+{
+    GASubyte* data;
+    unsigned int size;
+    unsigned int pos;
+    unsigned int reads;
+};
+
+static GASresult mem_open (const char *name, const char *mode,
+                           void **handle, void **userdata)
+{
+    *handle = (void*)name;
+    return GAS_OK;
+}
+
+static GASresult mem_close (void *handle, void *userdata)
+{
+    return GAS_OK;
+}
+
+/* returns at most 7 bytes per call, like a slow socket */
+static GASresult mem_read (void *handle, void *buffer, unsigned int sizebytes,
+                           unsigned int *bytesread, void *userdata)
+{
+    MemoryStream* s = static_cast<MemoryStream*>(handle);
+    unsigned int n = qMin(qMin(sizebytes, 7u), s->size - s->pos);
+    memcpy(buffer, s->data + s->pos, n);
+    s->pos += n;
+    s->reads++;
+    *bytesread = n;
+    return GAS_OK;
+}
+
+static GASresult mem_seek (void *handle, unsigned long pos, int whence,
+                           void *userdata)
+{
+    static_cast<MemoryStream*>(handle)->pos += pos;
+    return GAS_OK;
+}
+/*}}}*/
+
+void TestParser::read_ahead ()
+{
+    GASchunk *root, *c, *out;
+    GAScontext ctx = { mem_open, mem_close, mem_read, NULL, mem_seek, NULL };
+    GASparser *p;
+    GASubyte expected[8192], buf[8192];
+    GASubyte big[1000];
+    GASnum size;
+    GASunum buffer_sizes[] = { 0, 1, 64, GAS_PARSER_BUFFER_SIZE };
+    unsigned int i, reads[4];
+
+    gas_new_named(&root, "root");
+    for (i = 0; i < 50; i++) {
+        gas_new_named(&c, "child");
+        gas_set_attribute_ss(c, "key", "value");
+        gas_add_child(root, c);
+    }
+    memset(big, 0xab, sizeof(big));
+    gas_set_payload(root, big, sizeof(big));
+    gas_update(root);
+    size = gas_write_buf(expected, sizeof(expected), root);
+    QVERIFY(size > 0);
+    gas_destroy(root);
+
+    for (i = 0; i < 4; i++) {
+        MemoryStream s = { expected, static_cast<unsigned int>(size), 0, 0 };
+        QCOMPARE(gas_parser_new(&p, &ctx), GAS_OK);
+        QCOMPARE(gas_parser_set_buffer_size(p, buffer_sizes[i]), GAS_OK);
+        QCOMPARE(gas_parse(p, reinterpret_cast<const char*>(&s), &out), GAS_OK);
+        QCOMPARE(s.pos, s.size);
+        QCOMPARE(gas_write_buf(buf, sizeof(buf), out), size);
+        QCOMPARE(memcmp(buf, expected, size), 0);
+        reads[i] = s.reads;
+        gas_destroy(out);
+        gas_parser_destroy(p);
+    }
+    QVERIFY(reads[3] < reads[0]);
+}
+
+/* positional and vectored reads {{{*/
+struct MemoryFile
+{
+    GASubyte* data;
+    size_t size;
+    size_t pos;
+    unsigned int preads;
+    unsigned int readvs;
+};
+
+static GASresult mem_read64 (void *handle, void *buffer, size_t size,
+                             size_t *done, void *userdata)
+{
+    MemoryFile* f = static_cast<MemoryFile*>(handle);
+    size_t n = qMin(size, f->size - f->pos);
+    memcpy(buffer, f->data + f->pos, n);
+    f->pos += n;
+    *done = n;
+    return GAS_OK;
+}
+
+static GASresult mem_pread (void *handle, void *buffer, size_t size,
+                            uint64_t offset, size_t *done, void *userdata)
+{
+    MemoryFile* f = static_cast<MemoryFile*>(handle);
+    size_t n = offset < f->size ? qMin(size, f->size - (size_t)offset) : 0;
+    memcpy(buffer, f->data + offset, n);
+    f->preads++;
+    *done = n;
+    return n < size ? GAS_ERR_FILE_EOF : GAS_OK;
+}
+
+static GASresult mem_readv (void *handle, const GASiovec *iov,
+                            unsigned int iovcnt, size_t *done,
+                            void *userdata)
+{
+    MemoryFile* f = static_cast<MemoryFile*>(handle);
+    size_t n;
+    unsigned int i;
+
+    *done = 0;
+    for (i = 0; i < iovcnt; i++) {
+        n = qMin((size_t)iov[i].iov_len, f->size - f->pos);
+        memcpy(iov[i].iov_base, f->data + f->pos, n);
+        f->pos += n;
+        *done += n;
+    }
+    f->readvs++;
+    return GAS_OK;
+}
+/*}}}*/
+
+void TestParser::positional ()
+{
+    GASchunk *root, *c, *out;
+    GAScontext ctx;
+    GASparser *p;
+    GASubyte expected[32768], buf[32768];
+    GASubyte big[2 * GAS_PARSER_BUFFER_SIZE];
+    GASnum size;
+    unsigned int i;
+
+    gas_new_named(&root, "root");
+    memset(big, 0xab, sizeof(big));
+    gas_set_payload(root, big, sizeof(big));
+    for (i = 0; i < 20; i++) {
+        gas_new_named(&c, "child");
+        gas_set_attribute_ss(c, "key", "value");
+        gas_set_payload(c, big, i == 10 ? sizeof(big) : 1);
+        gas_add_child(root, c);
+    }
+    gas_update(root);
+    size = gas_write_buf(expected, sizeof(expected), root);
+    QVERIFY(size > 0);
+    gas_destroy(root);
+
+    /* pread: the handle itself is never read nor moved */
+    MemoryFile f1 = { expected, static_cast<size_t>(size), 0, 0, 0 };
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.open = mem_open;
+    ctx.close = mem_close;
+    ctx.version = GAS_CONTEXT_VERSION;
+    ctx.read64 = mem_read64;
+    ctx.pread = mem_pread;
+    QCOMPARE(gas_parser_new(&p, &ctx), GAS_OK);
+    p->get_payloads = GAS_FALSE;
+    QCOMPARE(gas_parse(p, reinterpret_cast<const char*>(&f1), &out), GAS_OK);
+    QCOMPARE(f1.pos, static_cast<size_t>(0));
+    QVERIFY(f1.preads > 0);
+    QCOMPARE(p->offset, static_cast<GASunum>(size));
+    QCOMPARE(out->nb_children, static_cast<GASunum>(20));
+    gas_destroy(out);
+    gas_parser_destroy(p);
+
+    /* readv: large payloads refill the read-ahead buffer on the way */
+    MemoryFile f2 = { expected, static_cast<size_t>(size), 0, 0, 0 };
+    ctx.pread = NULL;
+    ctx.readv = mem_readv;
+    QCOMPARE(gas_parser_new(&p, &ctx), GAS_OK);
+    QCOMPARE(gas_parser_set_buffer_size(p, GAS_PARSER_BUFFER_SIZE), GAS_OK);
+    QCOMPARE(gas_parse(p, reinterpret_cast<const char*>(&f2), &out), GAS_OK);
+    QCOMPARE(f2.readvs, 2u);
+    QCOMPARE(gas_write_buf(buf, sizeof(buf), out), size);
+    QCOMPARE(memcmp(buf, expected, size), 0);
+    gas_destroy(out);
+    gas_parser_destroy(p);
+}
+
+void TestParser::open_stream ()
+{
+    GASchunk *c, *out;
+    GAScontext *ctx;
+    GASparser *p;
+    GASubyte buf[64], check[64];
+    GASnum size;
+    int fd;
+
+    gas_new_named(&c, "message");
+    gas_set_payload_s(c, "hi");
+    gas_update(c);
+    size = gas_write_buf(buf, sizeof(buf), c);
+    QVERIFY(size > 0);
+
+    /* a writer stays open, so reading past the message would block */
+    unlink("parser.fifo");
+    QCOMPARE(mkfifo("parser.fifo", 0600), 0);
+    fd = open("parser.fifo", O_RDWR);
+    QVERIFY(fd >= 0);
+    QCOMPARE(write(fd, buf, size), static_cast<ssize_t>(size));
+
+    QCOMPARE(gas_context_new(&ctx), GAS_OK);
+    QCOMPARE(gas_parser_new(&p, ctx), GAS_OK);
+    alarm(10);
+    QCOMPARE(gas_parse(p, "parser.fifo", &out), GAS_OK);
+    alarm(0);
+    QCOMPARE(gas_write_buf(check, sizeof(check), out), size);
+    QCOMPARE(memcmp(check, buf, size), 0);
+
+    gas_destroy(out);
+    gas_destroy(c);
+    gas_parser_destroy(p);
+    gas_context_destroy(ctx);
+    close(fd);
+    unlink("parser.fifo");
+}
+
+static GASchunk* fed_tree = NULL;
+
+static void my_on_tree (GASchunk* c, void *user_data)
+{
+    fed_tree = c;
+}
+
+void TestParser::feed ()
+{
+    GASchunk *root, *c;
+    GAScontext *ctx;
+    GASparser *p;
+    GASubyte expected[4096], buf[4096];
+    GASnum size;
+    int i;
+
+    gas_new_named(&root, "root");
+    for (i = 0; i < 10; i++) {
+        gas_new_named(&c, "child");
+        gas_set_attribute_ss(c, "key", "value");
+        gas_set_payload_s(c, "payload");
+        gas_add_child(root, c);
+    }
+    gas_update(root);
+    size = gas_write_buf(expected, sizeof(expected), root);
+    QVERIFY(size > 0);
+    gas_destroy(root);
+
+    gas_context_new(&ctx);
+    gas_parser_new(&p, ctx);
+    p->on_tree = my_on_tree;
+
+    /* one byte at a time, splitting every number and field */
+    for (i = 0; i < size; i++) {
+        QVERIFY(fed_tree == NULL);
+        QCOMPARE(gas_parser_feed(p, expected + i, 1), GAS_OK);
+    }
+    QVERIFY(fed_tree != NULL);
+    QVERIFY(gas_parser_feed_idle(p));
+    QCOMPARE(gas_write_buf(buf, sizeof(buf), fed_tree), size);
+    QCOMPARE(memcmp(buf, expected, size), 0);
+    gas_destroy(fed_tree);
+    fed_tree = NULL;
+
+    /* a partial stream is discarded on reset */
+    QCOMPARE(gas_parser_feed(p, expected, size / 2), GAS_OK);
+    QVERIFY( ! gas_parser_feed_idle(p));
+    QCOMPARE(gas_parser_feed_reset(p), GAS_OK);
+    QVERIFY(gas_parser_feed_idle(p));
+    QVERIFY(fed_tree == NULL);
+
+    gas_parser_destroy(p);
+    gas_context_destroy(ctx);
+}
+
 int parser (int argc, char** argv)
 {
     TestParser tc;
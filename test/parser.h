@@ -24,4 +24,8 @@ class TestParser : public QObject
 
 private slots:
     void parser ();
+    void read_ahead ();
+    void positional ();
+    void open_stream ();
+    void feed ();
 };
@@ -0,0 +1,192 @@
+/*
+ * Copyright 2009 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pool.moc"
+
+#include <QtTest>
+
+#include <gas/pool.h>
+#include <gas/arena.h>
+#include <gas/bufio.h>
+#include <gas/ntstring.h>
+
+#include <stdio.h>
+
+static GASchunk* build (GASvoid* user_data)
+{
+    GASchunk *root, *c;
+    char key[16];
+    int i;
+
+    gas_new_named(&root, "root", user_data);
+    for (i = 0; i < 100; i++) {
+        gas_new_named(&c, "child", user_data);
+        sprintf(key, "key%d", i);
+        gas_set_attribute_ss(c, key, "a value longer than inline storage");
+        gas_set_payload_s(c, "payload");
+        gas_add_child(root, c);
+    }
+    gas_update(root);
+    return root;
+}
+
+static int count_slabs (GASpool* pool)
+{
+    GASpool_slab* s;
+    int n = 0;
+
+    for (s = pool->slabs; s != NULL; s = s->next) {
+        n++;
+    }
+    return n;
+}
+
+void TestPool::reuse ()
+{
+    GASpool* pool;
+    GASchunk* root;
+    GASubyte expected[16384], buf[16384];
+    GASnum size;
+    int slabs, i;
+
+    QCOMPARE(gas_pool_new(&pool, 4096), GAS_OK);
+
+    root = build(pool);
+    QVERIFY(root->user_data == pool);
+    QVERIFY(gas_get_child_at(root, 50)->user_data == pool);
+    size = gas_write_buf(expected, sizeof(expected), root);
+    QVERIFY(size > 0);
+    slabs = count_slabs(pool);
+    QVERIFY(slabs > 1);
+    gas_destroy(root);
+
+    // freed slots come back, without new slabs
+    for (i = 0; i < 5; i++) {
+        root = build(pool);
+        QCOMPARE(gas_write_buf(buf, sizeof(buf), root), size);
+        QCOMPARE(memcmp(buf, expected, size), 0);
+        gas_destroy(root);
+        QCOMPARE(count_slabs(pool), slabs);
+    }
+
+    gas_pool_destroy(pool);
+}
+
+void TestPool::large ()
+{
+    GASpool* pool;
+    GASchunk* c;
+    GASubyte big[10000];
+
+    QCOMPARE(gas_pool_new(&pool, 0), GAS_OK);
+    gas_new_named(&c, "big", pool);
+
+    memset(big, 0x5a, sizeof(big));
+    gas_set_payload(c, big, 3000);
+    QVERIFY(pool->large != NULL);
+    gas_set_payload(c, big, sizeof(big));
+    QCOMPARE(memcmp(c->payload, big, sizeof(big)), 0);
+    QVERIFY(pool->large != NULL && pool->large->next == NULL);
+    gas_set_payload(c, big, 100);
+    QVERIFY(pool->large == NULL);
+
+    // whatever is left goes with the pool
+    gas_set_payload(c, big, sizeof(big));
+    gas_pool_destroy(pool);
+}
+
+void TestPool::read_buf ()
+{
+    GASpool* pool;
+    GASchunk *root, *out;
+    GASubyte expected[16384], buf[16384];
+    GASnum size;
+
+    root = build(NULL);
+    size = gas_write_buf(expected, sizeof(expected), root);
+    gas_destroy(root);
+
+    QCOMPARE(gas_pool_new(&pool, 0), GAS_OK);
+    QCOMPARE(gas_read_buf(expected, size, &out, pool), size);
+    QVERIFY(out->user_data == pool);
+    QVERIFY(gas_get_child_at(out, 99)->user_data == pool);
+    gas_set_attribute_ss(gas_get_child_at(out, 3), "added", "later");
+    gas_delete_child_at(out, 4);
+    gas_update(out);
+    QVERIFY(gas_write_buf(buf, sizeof(buf), out) > 0);
+    gas_destroy(out);
+    gas_pool_destroy(pool);
+}
+
+/* counts what is in use, in front of the default allocator */
+struct Counting
+{
+    GASallocator allocator;
+    int live;
+};
+
+static void* counting_alloc (GASallocator* self, GASunum size)
+{
+    ((Counting*)self)->live++;
+    return gas_default_alloc(size, NULL);
+}
+
+static void* counting_realloc (GASallocator* self, void* ptr,
+                               GASunum size)
+{
+    if (ptr == NULL) {
+        ((Counting*)self)->live++;
+    }
+    return gas_default_realloc(ptr, size, NULL);
+}
+
+static void counting_free (GASallocator* self, void* ptr)
+{
+    if (ptr != NULL) {
+        ((Counting*)self)->live--;
+    }
+    gas_default_free(ptr, NULL);
+}
+
+void TestPool::custom ()
+{
+    Counting counting = { { counting_alloc, counting_realloc, counting_free },
+                          0 };
+    GASarena* arena;
+    GASchunk *root, *other;
+
+    root = build(&counting);
+    QVERIFY(counting.live > 100);
+    gas_destroy(root);
+    QCOMPARE(counting.live, 0);
+
+    // allocators side by side, with the default callbacks
+    QCOMPARE(gas_arena_new(&arena, 0), GAS_OK);
+    root = build(arena);
+    other = build(&counting);
+    QCOMPARE(gas_nb_children(root), gas_nb_children(other));
+    gas_destroy(other);
+    QCOMPARE(counting.live, 0);
+    gas_arena_destroy(arena);
+}
+
+int pool (int argc, char** argv)
+{
+    TestPool tc;
+    return QTest::qExec(&tc, argc, argv);
+}
+
+/* vim: set sw=4 fdm=marker :*/
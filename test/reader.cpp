@@ -0,0 +1,135 @@
+/*
+ * Copyright 2009 Blanton Black
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "reader.moc"
+
+#include <QtTest>
+#include <QtNetwork>
+
+#include <gas/qt/reader.h>
+#include <gas/bufio.h>
+#include <gas/ntstring.h>
+
+void TestReader::onChunk (GASchunk* c)
+{
+    chunks.append(gas_clone(c));
+}
+
+/* write trees named @a ids to @a client, a few bytes at a time */
+static void send (QTcpSocket& client, const char** ids, int count)
+{
+    GASubyte buf[256];
+    GASchunk* c;
+    GASnum size, i;
+    int n;
+
+    for (n = 0; n < count; n++) {
+        gas_new_named(&c, ids[n]);
+        gas_set_attribute_ss(c, "key", "value");
+        gas_set_payload_s(c, "payload");
+        gas_update(c);
+        size = gas_write_buf(buf, sizeof(buf), c);
+        gas_destroy(c);
+        for (i = 0; i < size; i += 5) {
+            client.write(reinterpret_cast<char*>(buf) + i,
+                         qMin<GASnum>(5, size - i));
+            client.flush();
+            QTest::qWait(1);
+        }
+    }
+}
+
+static GASbool skip_pruned (GASunum id_size, void* id, void* user_data)
+{
+    return !(id_size == 6 && memcmp(id, "pruned", 6) == 0);
+}
+
+static void wait_for (const QList<GASchunk*>& chunks, int count)
+{
+    for (int i = 0; chunks.size() < count && i < 100; i++) {
+        QTest::qWait(10);
+    }
+}
+
+void TestReader::socket ()
+{
+    QTcpServer server;
+    QTcpSocket client;
+    QTcpSocket* peer;
+    const char* ids[] = { "one", "two", "three" };
+    int i;
+
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(server.waitForNewConnection(5000));
+    peer = server.nextPendingConnection();
+    QVERIFY(client.waitForConnected(5000));
+
+    Gas::Reader reader (peer);
+    connect(&reader, SIGNAL(chunkReady(GASchunk*)),
+            this, SLOT(onChunk(GASchunk*)), Qt::DirectConnection);
+
+    send(client, ids, 3);
+    wait_for(chunks, 3);
+
+    QCOMPARE(chunks.size(), 3);
+    for (i = 0; i < 3; i++) {
+        QVERIFY(gas_id_is(chunks[i], ids[i]));
+        QCOMPARE(chunks[i]->payload_size, static_cast<GASunum>(7));
+        gas_destroy(chunks[i]);
+    }
+    chunks.clear();
+    QCOMPARE(reader.error(), GAS_OK);
+}
+
+void TestReader::pruned ()
+{
+    QTcpServer server;
+    QTcpSocket client;
+    QTcpSocket* peer;
+    const char* ids[] = { "pruned", "kept", "pruned", "kept" };
+
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(server.waitForNewConnection(5000));
+    peer = server.nextPendingConnection();
+    QVERIFY(client.waitForConnected(5000));
+
+    Gas::Reader reader (peer);
+    reader.parser()->on_pre_chunk = skip_pruned;
+    connect(&reader, SIGNAL(chunkReady(GASchunk*)),
+            this, SLOT(onChunk(GASchunk*)), Qt::DirectConnection);
+
+    send(client, ids, 4);
+    wait_for(chunks, 2);
+    QTest::qWait(50);
+
+    QCOMPARE(chunks.size(), 2);
+    foreach (GASchunk* c, chunks) {
+        QVERIFY(gas_id_is(c, "kept"));
+        gas_destroy(c);
+    }
+    chunks.clear();
+}
+
+int reader (int argc, char** argv)
+{
+    QCoreApplication app (argc, argv);
+    TestReader tc;
+    return QTest::qExec(&tc, argc, argv);
+}
+
+/* vim: set sw=4 fdm=marker :*/
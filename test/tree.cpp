@@ -24,6 +24,7 @@
 #include <QtTest>
 
 #include <gas/gas.h>
+#include <gas/bufio.h>
 #include <gas/ntstring.h>
 
 #include <stdio.h>
@@ -141,6 +142,434 @@ void TestTree::test003 (void)
     gas_destroy(root);
 }
 
+/* sizes recomputed from scratch, for comparison {{{*/
+static GASunum reference_size (GASchunk* c)
+{
+    GASunum i, sum = 0, child;
+
+    sum += gas_encoded_size(c->id_size) + c->id_size;
+    sum += gas_encoded_size(c->nb_attributes);
+    for (i = 0; i < c->nb_attributes; i++) {
+        sum += gas_encoded_size(c->attributes[i].key_size);
+        sum += c->attributes[i].key_size;
+        sum += gas_encoded_size(c->attributes[i].value_size);
+        sum += c->attributes[i].value_size;
+    }
+    sum += gas_encoded_size(c->payload_size) + c->payload_size;
+    sum += gas_encoded_size(c->nb_children);
+    for (i = 0; i < c->nb_children; i++) {
+        child = reference_size(c->children[i]);
+        sum += gas_encoded_size(child) + child;
+    }
+    return sum;
+}
+
+static bool sizes_match (GASchunk* c)
+{
+    GASunum i;
+
+    if (c->size != reference_size(c)) {
+        return false;
+    }
+    for (i = 0; i < c->nb_children; i++) {
+        if (!sizes_match(c->children[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+/*}}}*/
+
+void TestTree::incremental_sizes (void)
+{
+    GASchunk *root = NULL, *mid, *leaf, *fresh;
+    GASubyte fill[300];
+    GASunum i;
+
+    memset(fill, 'x', sizeof(fill));
+
+    gas_new_named(&root, "root");
+    gas_new_named(&mid, "mid");
+    gas_new_named(&leaf, "leaf");
+    gas_add_child(root, mid);
+    gas_add_child(mid, leaf);
+    QVERIFY(root->dirty);
+
+    gas_update(root);
+    QVERIFY(!root->dirty && !mid->dirty && !leaf->dirty);
+    QVERIFY(sizes_match(root));
+
+    // edits on a clean tree keep it clean, and correct
+    for (i = 0; i < sizeof(fill); i += 7) {
+        gas_set_payload(leaf, fill, i);
+        QVERIFY(!root->dirty);
+        QVERIFY(sizes_match(root));
+    }
+    for (i = 0; i < 140; i++) {
+        gas_set_attribute(leaf, &i, sizeof(i), fill, i);
+        QVERIFY(sizes_match(root));
+    }
+    gas_set_attribute(leaf, &i, sizeof(i), fill, 0);
+    gas_set_id(mid, fill, 200);
+    QVERIFY(sizes_match(root));
+    while (leaf->nb_attributes > 0) {
+        gas_delete_attribute_at(leaf, leaf->nb_attributes / 2);
+        QVERIFY(sizes_match(root));
+    }
+    gas_set_payload(mid, NULL, 1000);
+    QVERIFY(sizes_match(root));
+    QVERIFY(!root->dirty);
+
+    // a new chunk is dirty until updated, and so is its new parent
+    gas_new_named(&fresh, "fresh");
+    gas_add_child(leaf, fresh);
+    QVERIFY(leaf->dirty && mid->dirty && root->dirty);
+    gas_set_payload(fresh, fill, 10);
+    QCOMPARE(gas_total_size(root),
+             reference_size(root) + gas_encoded_size(reference_size(root)));
+    QVERIFY(!root->dirty && !fresh->dirty);
+    QVERIFY(sizes_match(root));
+
+    // a clean chunk joins without an update
+    gas_new_named(&fresh, "fresh");
+    gas_update(fresh);
+    gas_add_child(root, fresh);
+    QVERIFY(!root->dirty);
+    QVERIFY(sizes_match(root));
+
+    gas_delete_child_at(mid, 0);
+    QVERIFY(!root->dirty);
+    QVERIFY(sizes_match(root));
+
+    // direct edits are flagged by hand
+    mid->payload_size = 3;
+    gas_mark_dirty(mid);
+    QVERIFY(root->dirty && !fresh->dirty);
+    gas_update(root);
+    QVERIFY(sizes_match(root));
+
+    gas_destroy(root);
+}
+
+void TestTree::wide_attributes (void)
+{
+    GASchunk *c = NULL;
+    GASunum i, value, len;
+    GASnum index;
+
+    gas_new_named(&c, "wide");
+
+    // lookups by gas_set_attribute() hash the keys past the threshold
+    for (i = 0; i < 300; i++) {
+        value = i * 3;
+        gas_set_attribute(c, &i, sizeof(i), &value, sizeof(value));
+    }
+    QCOMPARE(c->nb_attributes, (GASunum)300);
+    QVERIFY(c->attribute_index != NULL);
+    for (i = 0; i < 300; i++) {
+        QCOMPARE(gas_index_of_attribute(c, &i, sizeof(i)), (GASnum)i);
+    }
+
+    // the hash is kept in sync as it grows
+    for (i = 300; i < 700; i++) {
+        value = i * 3;
+        gas_set_attribute(c, &i, sizeof(i), &value, sizeof(value));
+        QVERIFY(gas_has_attribute(c, &i, sizeof(i)));
+    }
+    QVERIFY(c->attribute_index != NULL);
+    i = 700;
+    QVERIFY(!gas_has_attribute(c, &i, sizeof(i)));
+    QVERIFY(!gas_has_attribute(c, &i, sizeof(i) - 1));
+
+    // replacing a value keeps the attribute's place
+    i = 42;
+    value = 7;
+    gas_set_attribute(c, &i, sizeof(i), &value, sizeof(value));
+    QCOMPARE(c->nb_attributes, (GASunum)700);
+    value = 0;
+    len = sizeof(value);
+    QCOMPARE(gas_get_attribute(c, &i, sizeof(i), &value, &len), GAS_OK);
+    QCOMPARE(value, (GASunum)7);
+
+    // deletes shift the indices
+    for (i = 0; i < 700; i += 2) {
+        index = gas_index_of_attribute(c, &i, sizeof(i));
+        QVERIFY(index >= 0);
+        gas_delete_attribute_at(c, index);
+    }
+    QCOMPARE(c->nb_attributes, (GASunum)350);
+    for (i = 0; i < 700; i++) {
+        index = gas_index_of_attribute(c, &i, sizeof(i));
+        if (i % 2 == 0) {
+            QCOMPARE(index, (GASnum)GAS_ERR_ATTR_NOT_FOUND);
+        } else {
+            QCOMPARE(index, (GASnum)(i / 2));
+            len = sizeof(value);
+            QCOMPARE(gas_get_attribute(c, &i, sizeof(i), &value, &len),
+                     GAS_OK);
+            QCOMPARE(value, i * 3);
+        }
+    }
+
+    // keys edited in place are rehashed once marked
+    i = 1001;
+    memcpy(c->attributes[0].key, &i, sizeof(i));
+    gas_mark_dirty(c);
+    QCOMPARE(gas_index_of_attribute(c, &i, sizeof(i)), (GASnum)0);
+    i = 1;
+    QVERIFY(!gas_has_attribute(c, &i, sizeof(i)));
+
+    // or right away through gas_set_attribute_at(), which keeps the sizes
+    gas_update(c);
+    QVERIFY(gas_index_of_attribute(c, &i, sizeof(i)) < 0);
+    QVERIFY(c->attribute_index != NULL);
+    i = 2002;
+    QCOMPARE(gas_set_attribute_at(c, 1, &i, sizeof(i), NULL, 0), GAS_OK);
+    QCOMPARE(gas_index_of_attribute(c, &i, sizeof(i)), (GASnum)1);
+    i = 3;
+    QVERIFY(!gas_has_attribute(c, &i, sizeof(i)));
+    QCOMPARE(gas_set_attribute_at(c, 1, NULL, 0, "value", 5), GAS_OK);
+    QCOMPARE(c->attributes[1].value_size, (GASunum)5);
+    QVERIFY(!c->dirty);
+    QVERIFY(sizes_match(c));
+    QCOMPARE(gas_set_attribute_at(c, 350, &i, sizeof(i), NULL, 0),
+             (GASresult)GAS_ERR_INVALID_PARAM);
+
+    gas_destroy(c);
+}
+
+void TestTree::reserve (void)
+{
+    GASchunk *root = NULL, *child;
+    GASchunk** children;
+    GASunum i, capacity;
+
+    gas_new_named(&root, "root");
+    gas_update(root);
+
+    // appends grow the capacity geometrically
+    capacity = 0;
+    for (i = 0; i < 1000; i++) {
+        gas_new_named(&child, "child");
+        QCOMPARE(gas_add_child(root, child), GAS_OK);
+        QVERIFY(root->children_capacity >= root->nb_children);
+        if (root->children_capacity != capacity) {
+            QVERIFY(root->children_capacity >= 2 * capacity);
+            capacity = root->children_capacity;
+        }
+    }
+    QVERIFY(capacity < 2048);
+
+    // reserved room is used without reallocating
+    QCOMPARE(gas_reserve_children(root, 5000), GAS_OK);
+    QVERIFY(root->children_capacity >= 6000);
+    children = root->children;
+    capacity = root->children_capacity;
+    for (i = 0; i < 5000; i++) {
+        gas_new_named(&child, "child");
+        gas_add_child(root, child);
+    }
+    QVERIFY(root->children == children);
+    QCOMPARE(root->children_capacity, capacity);
+    gas_update(root);
+    QVERIFY(sizes_match(root));
+
+    // deletes keep the capacity
+    gas_delete_child_at(root, 0);
+    QCOMPARE(root->children_capacity, capacity);
+    QCOMPARE(gas_nb_children(root), (GASunum)5999);
+
+    QCOMPARE(gas_reserve_attributes(root, 100), GAS_OK);
+    QVERIFY(root->attributes_capacity >= 100);
+    capacity = root->attributes_capacity;
+    for (i = 0; i < 100; i++) {
+        gas_set_attribute(root, &i, sizeof(i), &i, sizeof(i));
+    }
+    QCOMPARE(root->attributes_capacity, capacity);
+    QVERIFY(sizes_match(root));
+
+    QCOMPARE(gas_reserve_children(root, (GASunum)-1),
+             GAS_ERR_OUT_OF_RANGE);
+
+    gas_destroy(root);
+}
+
+void TestTree::inline_storage (void)
+{
+    GASchunk *c = NULL, *copy = NULL;
+    GASattribute* a;
+    GASubyte buf[8192], again[8192];
+    GASchar key[32], value[64];
+    GASnum size;
+    GASunum i;
+
+    gas_new_named(&c, "short");
+    QVERIFY(c->id == c->id_inline);
+    gas_set_id_s(c, "a rather longer chunk id");
+    QVERIFY(c->id != c->id_inline);
+    QVERIFY(gas_id_is(c, "a rather longer chunk id"));
+    gas_set_id_s(c, "0123456789abcde");
+    QVERIFY(c->id == c->id_inline);
+    QCOMPARE(c->id[15], (GASubyte)0);
+
+    // keys and values stay put as the attributes move
+    for (i = 0; i < 200; i++) {
+        sprintf(key, "k%lu", (unsigned long)i);
+        memset(value, 'v', sizeof(value));
+        value[i % 40] = 0;
+        gas_set_attribute_ss(c, key, value);
+    }
+    for (i = 0; i < 200; i += 3) {
+        gas_delete_attribute_at(c, c->nb_attributes - 1 - i / 3 * 2);
+    }
+    gas_set_attribute_ss(c, "k1", "now quite a bit longer");
+    gas_set_attribute_ss(c, "k39", "short");
+    for (i = 0; i < c->nb_attributes; i++) {
+        a = &c->attributes[i];
+        QCOMPARE(a->key == a->key_inline, a->key_size < GAS_INLINE_SIZE);
+        QCOMPARE(a->value == a->value_inline,
+                 a->value_size < GAS_INLINE_SIZE);
+        QCOMPARE(a->key[a->key_size], (GASubyte)0);
+        QCOMPARE(a->value[a->value_size], (GASubyte)0);
+        QCOMPARE(strlen((const char*)a->value), a->value_size);
+    }
+    a = &c->attributes[gas_index_of_attribute(c, "k1", 2)];
+    QVERIFY(strcmp((const char*)a->value, "now quite a bit longer") == 0);
+    a = &c->attributes[gas_index_of_attribute(c, "k39", 3)];
+    QVERIFY(strcmp((const char*)a->value, "short") == 0);
+
+    // so do those of read trees
+    gas_update(c);
+    size = gas_write_buf(buf, sizeof(buf), c);
+    QVERIFY(size > 0);
+    QCOMPARE(gas_read_buf(buf, size, &copy), size);
+    QVERIFY(copy->id == copy->id_inline);
+    for (i = 0; i < copy->nb_attributes; i++) {
+        a = &copy->attributes[i];
+        QCOMPARE(a->key == a->key_inline, a->key_size < GAS_INLINE_SIZE);
+        QCOMPARE(a->value == a->value_inline,
+                 a->value_size < GAS_INLINE_SIZE);
+        QCOMPARE(a->value[a->value_size], (GASubyte)0);
+    }
+    gas_update(copy);
+    QCOMPARE(gas_write_buf(again, sizeof(again), copy), size);
+    QCOMPARE(memcmp(buf, again, size), 0);
+
+    gas_destroy(copy);
+    gas_destroy(c);
+}
+
+void TestTree::shared_subtrees (void)
+{
+    GASchunk *shared, *leaf, *a, *b, *c, *item, *root;
+    GASubyte before[256], buf_a[256], buf_b[256];
+    GASnum size, size_a, size_b;
+
+    gas_new_named(&shared, "item");
+    gas_set_attribute_ss(shared, "kind", "shared");
+    gas_new_named(&leaf, "leaf");
+    gas_set_payload(leaf, "original", 8);
+    gas_add_child(shared, leaf);
+
+    gas_new_named(&a, "parent");
+    gas_new_named(&b, "parent");
+    gas_new_named(&c, "parent");
+    QVERIFY(gas_add_child(a, gas_clone(shared)) == GAS_OK);
+    QVERIFY(gas_add_child(b, gas_clone(shared)) == GAS_OK);
+    QVERIFY(gas_add_child(c, shared) == GAS_OK);
+    QCOMPARE(shared->refs, (GASunum)3);
+    // linked to the first parent still holding it
+    QVERIFY(gas_get_parent(shared) == a);
+
+    // one subtree, three identical trees
+    gas_update(a);
+    gas_update(b);
+    size = gas_write_buf(before, sizeof(before), b);
+    QVERIFY(size > 0);
+    QCOMPARE(gas_write_buf(buf_a, sizeof(buf_a), a), size);
+    QCOMPARE(memcmp(before, buf_a, size), 0);
+
+    // shared chunks are read only
+    QCOMPARE(gas_set_attribute_ss(shared, "kind", "mine"),
+             (GASresult)GAS_ERR_INVALID_PARAM);
+    gas_new_named(&item, "extra");
+    QCOMPARE(gas_add_child(shared, item), (GASresult)GAS_ERR_INVALID_PARAM);
+    gas_destroy(item);
+    // and so is everything below them
+    QCOMPARE(leaf->refs, (GASunum)1);
+    QCOMPARE(gas_set_payload(leaf, "changed", 7),
+             (GASresult)GAS_ERR_INVALID_PARAM);
+    QCOMPARE(gas_set_attribute_ss(leaf, "kind", "mine"),
+             (GASresult)GAS_ERR_INVALID_PARAM);
+    QVERIFY(gas_writable_child(shared, 0) == NULL);
+
+    // writing through a copies just its path
+    item = gas_writable_child(a, 0);
+    QVERIFY(item != NULL && item != shared);
+    QCOMPARE(item->refs, (GASunum)1);
+    QCOMPARE(shared->refs, (GASunum)2);
+    QCOMPARE(leaf->refs, (GASunum)2);
+    item = gas_writable_child(item, 0);
+    QVERIFY(item != NULL && item != leaf);
+    QCOMPARE(leaf->refs, (GASunum)1);
+    QCOMPARE(gas_set_payload(item, "changed in a", 12), GAS_OK);
+    QCOMPARE(gas_set_attribute_ss(a->children[0], "kind", "mine"), GAS_OK);
+    QVERIFY(sizes_match(a));
+    QVERIFY(b->children[0] == shared && c->children[0] == shared);
+    QVERIFY(shared->children[0] == leaf);
+
+    size_b = gas_write_buf(buf_b, sizeof(buf_b), b);
+    QCOMPARE(size_b, size);
+    QCOMPARE(memcmp(before, buf_b, size), 0);
+    size_a = gas_write_buf(buf_a, sizeof(buf_a), a);
+    QVERIFY(size_a > 0 && size_a != size);
+
+    // a shared root is copied whole
+    root = gas_clone(b);
+    QVERIFY(gas_unshare(&root) == GAS_OK);
+    QVERIFY(root != b);
+    QCOMPARE(b->refs, (GASunum)1);
+    QCOMPARE(shared->refs, (GASunum)3);
+    gas_update(root);
+    QCOMPARE(gas_write_buf(buf_b, sizeof(buf_b), root), size);
+    QCOMPARE(memcmp(before, buf_b, size), 0);
+
+    // each owner releases its reference
+    gas_destroy(a);
+    gas_destroy(b);
+    QCOMPARE(shared->refs, (GASunum)2);
+    gas_destroy(root);
+    QCOMPARE(shared->refs, (GASunum)1);
+
+    // c is the last owner, but it was not the linked parent
+    gas_update(c);
+    QVERIFY(gas_get_parent(shared) == NULL);
+    QCOMPARE(gas_set_payload(leaf, "changed", 7),
+             (GASresult)GAS_ERR_INVALID_PARAM);
+    QVERIFY(gas_writable_child(c, 0) == shared);
+    QVERIFY(gas_get_parent(shared) == c);
+    QCOMPARE(gas_set_payload(leaf, "changed in c", 12), GAS_OK);
+    QVERIFY(sizes_match(c));
+    gas_destroy(c);
+
+    // a share ending leaves the linked parent writable through its child
+    gas_new_named(&a, "parent");
+    gas_new_named(&b, "parent");
+    gas_new_named(&item, "item");
+    gas_add_child(a, item);
+    gas_update(a);
+    QVERIFY(gas_add_child(b, gas_clone(item)) == GAS_OK);
+    QVERIFY(gas_get_parent(item) == a);
+    gas_destroy(b);
+    QCOMPARE(item->refs, (GASunum)1);
+    QVERIFY(gas_get_parent(item) == a);
+    QCOMPARE(gas_set_payload(item, "a longer payload", 16), GAS_OK);
+    QVERIFY(sizes_match(a));
+    size = gas_write_buf(buf_a, sizeof(buf_a), a);
+    QCOMPARE(size, (GASnum)gas_total_size(a));
+    gas_destroy(a);
+}
+
 
 int tree (int argc, char** argv)
 {
@@ -26,4 +26,9 @@ private slots:
     void test001 ();
     void test002 ();
     void test003 ();
+    void incremental_sizes ();
+    void wide_attributes ();
+    void reserve ();
+    void inline_storage ();
+    void shared_subtrees ();
 };
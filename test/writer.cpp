@@ -86,6 +86,142 @@ void TestWriter::test002 ()
     gas_writer_destroy(w);
 }
 
+/* in-memory context {{{*/
+struct MemorySink
+{
+    GASubyte* data;
+    unsigned int size;
+    unsigned int pos;
+    unsigned int writes;
+    unsigned int writevs;
+};
+
+static GASresult mem_open (const char *name, const char *mode,
+                           void **handle, void **userdata)
+{
+    *handle = (void*)name;
+    return GAS_OK;
+}
+
+static GASresult mem_close (void *handle, void *userdata)
+{
+    return GAS_OK;
+}
+
+static GASresult mem_write (void *handle, void *buffer, unsigned int sizebytes,
+                            unsigned int *byteswritten, void *userdata)
+{
+    MemorySink* s = static_cast<MemorySink*>(handle);
+    if (sizebytes > s->size - s->pos) {
+        return GAS_ERR_UNKNOWN;
+    }
+    memcpy(s->data + s->pos, buffer, sizebytes);
+    s->pos += sizebytes;
+    s->writes++;
+    *byteswritten = sizebytes;
+    return GAS_OK;
+}
+
+static GASresult mem_writev (void *handle, const GASiovec *iov,
+                             unsigned int iovcnt, unsigned long *byteswritten,
+                             void *userdata)
+{
+    MemorySink* s = static_cast<MemorySink*>(handle);
+    unsigned int i, n;
+    unsigned long total = 0;
+    for (i = 0; i < iovcnt; i++) {
+        if (mem_write(handle, iov[i].iov_base, iov[i].iov_len, &n,
+                      userdata) != GAS_OK) {
+            return GAS_ERR_UNKNOWN;
+        }
+        total += n;
+    }
+    s->writes -= iovcnt;
+    s->writevs++;
+    *byteswritten = total;
+    return GAS_OK;
+}
+/*}}}*/
+
+void TestWriter::gather ()
+{
+    GASchunk *root, *c;
+    GAScontext ctx = { mem_open, mem_close, NULL, mem_write, NULL, NULL };
+    GASwriter *w;
+    GASubyte expected[8192], out[8192];
+    GASubyte big[1000];
+    GASnum size;
+    unsigned int i;
+
+    gas_new_named(&root, "root");
+    for (i = 0; i < 50; i++) {
+        gas_new_named(&c, "child");
+        gas_set_attribute_ss(c, "key", "value");
+        gas_add_child(root, c);
+    }
+    memset(big, 0xab, sizeof(big));
+    gas_set_payload(root, big, sizeof(big));
+    gas_update(root);
+    size = gas_write_buf(expected, sizeof(expected), root);
+    QVERIFY(size > 0);
+
+    /* one write per gathered buffer */
+    MemorySink s1 = { out, sizeof(out), 0, 0, 0 };
+    QCOMPARE(gas_writer_new(&w, &ctx), GAS_OK);
+    QCOMPARE(gas_write(w, reinterpret_cast<const char*>(&s1), root), GAS_OK);
+    QCOMPARE(s1.pos, static_cast<unsigned int>(size));
+    QVERIFY(memcmp(out, expected, size) == 0);
+    QVERIFY(s1.writes < 10);
+    QCOMPARE(s1.writevs, 0u);
+    gas_writer_destroy(w);
+
+    /* one writev per flush */
+    MemorySink s2 = { out, sizeof(out), 0, 0, 0 };
+    memset(out, 0, sizeof(out));
+    ctx.writev = mem_writev;
+    QCOMPARE(gas_writer_new(&w, &ctx), GAS_OK);
+    QCOMPARE(gas_write(w, reinterpret_cast<const char*>(&s2), root), GAS_OK);
+    QCOMPARE(s2.pos, static_cast<unsigned int>(size));
+    QVERIFY(memcmp(out, expected, size) == 0);
+    QCOMPARE(s2.writes, 0u);
+    QCOMPARE(s2.writevs, 1u);
+    gas_writer_destroy(w);
+
+    gas_destroy(root);
+}
+
+void TestWriter::custom_context ()
+{
+    GASchunk *c;
+    GAScontext *ctx;
+    GASwriter *w;
+    GASubyte expected[64], out[64];
+    GASnum size;
+
+    gas_new_named(&c, "custom");
+    gas_set_payload_s(c, "payload");
+    gas_update(c);
+    size = gas_write_buf(expected, sizeof(expected), c);
+    QVERIFY(size > 0);
+
+    /* only open and write replaced, the default writev must not be used */
+    MemorySink s = { out, sizeof(out), 0, 0, 0 };
+    QCOMPARE(gas_context_new(&ctx), GAS_OK);
+    QVERIFY(ctx->writev == NULL);
+    ctx->open = mem_open;
+    ctx->close = mem_close;
+    ctx->write = mem_write;
+    QCOMPARE(gas_writer_new(&w, ctx), GAS_OK);
+    QCOMPARE(gas_write(w, reinterpret_cast<const char*>(&s), c), GAS_OK);
+    QCOMPARE(s.pos, static_cast<unsigned int>(size));
+    QVERIFY(memcmp(out, expected, size) == 0);
+    QCOMPARE(s.writevs, 0u);
+
+    gas_writer_destroy(w);
+    gas_context_destroy(ctx);
+    gas_destroy(c);
+}
+
 int writer (int argc, char **argv)
 {
     TestWriter test;
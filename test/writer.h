@@ -24,6 +24,7 @@
 #include  <QObject>
 #include <gas/writer.h>
 #include <gas/ntstring.h>
+#include <gas/bufio.h>
 
 class TestWriter : public QObject
 {
@@ -35,6 +36,8 @@ private:
 private slots:
     void test001 (void);
     void test002 (void);
+    void gather (void);
+    void custom_context (void);
 };
 
 // vim: sw=4 fdm=marker